@@ -1,33 +1,37 @@
-#version 330 core
+#version 430 core
 
 in vec2 ex_TexCoord;
 in vec3 ex_Normal;
 in vec4 ex_Color;
 in vec3 FragPos;
-in vec4 FragPosLightSpace;
 
 in float zDepth;
 
 out vec4 out_Color;
 
-struct Material {
+layout(std140) uniform MaterialBlock {
     float ambientStrength;
 	float specularStrength;
     float shininess;
 	float transparency;
 	int type;
-};
+} material;
 
 vec3 lightColor = vec3(1);
 
-uniform vec3 lightPos;
-uniform vec3 viewPos;
-uniform sampler2D shadowMap;
-  
-uniform Material material;
+#include "frame_block.glsl"
+uniform sampler2DArray shadowMap;
+
 uniform sampler2D ourSampler;
+uniform sampler2DArray layerSampler;
+#if defined(INSTANCED) || defined(INDIRECT)
+flat in int ex_TextureLayer;
+#define TEXTURE_LAYER ex_TextureLayer
+#else
+uniform int textureLayer = -1;
+#define TEXTURE_LAYER textureLayer
+#endif
 uniform float pi = 3.14159;
-uniform float powerSlide = 1;
 
 vec4 marble(float x, float y, float turbulence, vec4 color, float transparency) {
 	vec4 newColor = vec4(transparency);
@@ -121,14 +125,71 @@ vec4 squareTexture(float x, float y, float turbulenceX, float turbulenceY, vec4
 	return newColor;
 }
 
+#ifdef VIRTUAL_TEXTURE
+uniform sampler2D pageAtlas;
+uniform usampler2D pageTable;
+// Corner of the surface on the XZ plane and the inverse of its size
+uniform vec4 virtualSurface;
+// Pages across the finest level, texels across a page, border texels, texels across the atlas
+uniform vec4 virtualLayout;
+
+// The page table points every page to the slot of the sharpest resident page covering it
+vec4 sampleVirtual(vec3 position) {
+	vec2 uv = (position.xz - virtualSurface.xy) * virtualSurface.zw;
+	vec2 texels = uv * virtualLayout.x * virtualLayout.y;
+	vec2 dx = dFdx(texels), dy = dFdy(texels);
+	int levels = textureQueryLevels(pageTable);
+	int level = clamp(int(floor(0.5 * log2(max(max(dot(dx, dx), dot(dy, dy)), 1.0)))), 0, levels - 1);
+
+	// The surface repeats, its noise tiles
+	uv = fract(uv);
+	int pages = int(virtualLayout.x) >> level;
+	uvec4 entry = texelFetch(pageTable, min(ivec2(uv * float(pages)), ivec2(pages - 1)), level);
+	if(entry.a == 0u) {
+		return vec4(0.5, 0.5, 0.5, 1);
+	}
+	vec2 inPage = fract(uv * (virtualLayout.x / exp2(float(entry.b))));
+	float slotSize = virtualLayout.y + 2.0 * virtualLayout.z;
+	vec2 atlas = vec2(entry.rg) * slotSize + virtualLayout.z + inPage * virtualLayout.y;
+	return textureLod(pageAtlas, atlas / virtualLayout.w, 0.0);
+}
+#endif
+
+// Packed textures live in a layer of the texture array, the others in ourSampler
+vec4 sampleTexture(vec2 texCoord) {
+#ifdef NO_TEXTURE
+	return vec4(1);
+#elif defined(VIRTUAL_TEXTURE)
+	return sampleVirtual(FragPos);
+#else
+	if(TEXTURE_LAYER >= 0) {
+		return texture(layerSampler, vec3(texCoord, TEXTURE_LAYER));
+	}
+	return texture(ourSampler, texCoord);
+#endif
+}
+
 float colorToFloat(vec4 color){
 	return (color.x + color.y + color.z)/3;
 }
 
-float ShadowCalculation(vec4 fragPosLightSpace) {
+float ShadowCalculation() {
+	// The first cascade that reaches the view depth of the fragment
+	int cascade = 0;
+	while(cascade < cascadeCount && zDepth > cascadeSplits[cascade]) {
+		cascade++;
+	}
+	if(cascade == cascadeCount) {
+		return 0.0;
+	}
+	vec4 fragPosLightSpace = lightSpaceMatrices[cascade] * vec4(FragPos, 1.0);
     vec3 projCoords = fragPosLightSpace.xyz / fragPosLightSpace.w;
     projCoords = projCoords * 0.5 + 0.5;
-    float closestDepth = texture(shadowMap, projCoords.xy).r; 
+	// Cascades under the layer size only cover a corner of it
+	if(any(lessThan(projCoords.xy, vec2(0))) || any(greaterThan(projCoords.xy, vec2(1)))) {
+		return 0.0;
+	}
+    float closestDepth = texture(shadowMap, vec3(projCoords.xy * cascadeScales[cascade], cascade)).r; 
     float currentDepth = projCoords.z;
 	
 	vec3 lightDir = normalize(lightPos - FragPos);
@@ -152,20 +213,27 @@ void main(void) {
 	float specularStrength = material.specularStrength;
 	float transparency = material.transparency;
 
+	// Permutations know their material type, the branches on it fold away at compile time
+#ifdef MATERIAL_TYPE
+	const int materialType = MATERIAL_TYPE;
+#else
+	int materialType = material.type;
+#endif
+
 	//Texture
-	vec4 color = texture(ourSampler, texCoord);
-	if(material.type == 1) {
+	vec4 color = sampleTexture(texCoord);
+	if(materialType == 1) {
 		color = marble(texCoord.x, texCoord.y, colorToFloat(color), ex_Color, transparency);
 	}
-	if(material.type == 2) {
+	if(materialType == 2) {
 		color = wood(texCoord.x, texCoord.y, colorToFloat(color), ex_Color, transparency);
 	}
-	if(material.type == 3) {
+	if(materialType == 3) {
 		vec2 invCoord = vec2(1 - texCoord.x, 1 - texCoord.y);
-		vec4 invColor = texture(ourSampler, invCoord);
+		vec4 invColor = sampleTexture(invCoord);
 		color = squareTexture(texCoord.x, texCoord.y, colorToFloat(color), colorToFloat(invColor), ex_Color, transparency);
 	}
-	if(material.type == 4) {
+	if(materialType == 4) {
 		color = melon(texCoord.x, texCoord.y, colorToFloat(color), ex_Color, transparency);
 	} else {
 		color.w = transparency;
@@ -186,7 +254,9 @@ void main(void) {
 	vec3 specular = specularStrength * spec * lightColor;
 
 	float shadow = 0.0f;
-	shadow = ShadowCalculation(FragPosLightSpace);
+#ifndef NO_SHADOWS
+	shadow = ShadowCalculation();
+#endif
 	
 	//final color
 	vec3 result = (ambient + (1.0 - shadow) * (diffuse + specular));
@@ -0,0 +1,14 @@
+// Per-frame values, written once a frame to the stream buffer and bound at FRAME_BP
+#define MAX_CASCADES 4
+
+layout(std140) uniform FrameBlock {
+	// Light view projection of each shadow cascade
+	mat4 lightSpaceMatrices[MAX_CASCADES];
+	// Far view depth of each cascade, and the part of its layer it uses
+	vec4 cascadeSplits;
+	vec4 cascadeScales;
+	vec3 lightPos;
+	float powerSlide;
+	vec3 viewPos;
+	int cascadeCount;
+};
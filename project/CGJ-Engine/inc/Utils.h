@@ -163,6 +163,60 @@ namespace engine {
 			return IO::readLinesFromFile(&file);
 		}
 
+		/**
+		* Reads the whole file, owned by the caller unlike readLinesFromFile
+		*
+		* @param file The file to read
+		* @return string The contents, empty if the file is not open
+		*/
+		static std::string readFile(std::ifstream* file) {
+			if (!file->is_open()) {
+				return std::string();
+			}
+			std::stringstream contents;
+			contents << file->rdbuf();
+			file->close();
+			return contents.str();
+		}
+
+		/**
+		* Reads the whole file with given filename
+		*
+		* @param filename The name of the file to read
+		* @param contents The contents read
+		* @return bool False if the file cannot be opened
+		*/
+		static bool readFile(const std::string& filename, std::string& contents) {
+			std::ifstream file(filename);
+			if (!file.is_open()) {
+				return false;
+			}
+			contents = readFile(&file);
+			return true;
+		}
+
+		/**
+		* Gets the directory part of a path
+		*
+		* @param path The path
+		* @return string The directory, empty for a file in the working directory
+		*/
+		static std::string directoryOf(const std::string& path) {
+			const size_t separator = path.find_last_of("/\\");
+			return separator == std::string::npos ? std::string() : path.substr(0, separator);
+		}
+
+		/**
+		* Joins a directory and a relative path
+		*
+		* @param directory The directory, may be empty
+		* @param path The path relative to the directory
+		* @return string The joined path
+		*/
+		static std::string joinPath(const std::string& directory, const std::string& path) {
+			return directory.empty() ? path : directory + "/" + path;
+		}
+
 	};
 
 }
\ No newline at end of file
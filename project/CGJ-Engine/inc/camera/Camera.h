@@ -16,7 +16,7 @@ namespace engine {
 	private:
 
 		// The shader variables
-		GLuint VaoId, VboId, ubo_bp;
+		GLuint VaoId, ubo_bp;
 
 		// View properties
 		Vector3 eye = Vector3(1.0, 0.0, 20.0);
@@ -167,6 +167,35 @@ namespace engine {
 
 		Vector3 getEye() { return eye; }
 
+		/**
+		* Gets the direction the camera looks at
+		*
+		* @return the normalized view direction
+		*/
+		Vector3 getDirection() const;
+
+		/**
+		* Gets the vertical field-of-view of the perspective projection
+		*
+		* @return the field-of-view, in degrees
+		*/
+		const float getFov() const;
+
+		const float getAspect() const;
+
+		const float getNear() const;
+
+		const float getFar() const;
+
+		/**
+		* Gets the half extents of the orthographic projection box
+		*
+		* @return the half width and half height
+		*/
+		Vector2 getOrthographicExtent() const;
+
+		const bool isOrthographic() const;
+
 		/**
 		* Gets the View Matrix
 		*
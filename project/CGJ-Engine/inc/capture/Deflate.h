@@ -0,0 +1,161 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace engine {
+
+	/**
+	* Speed and size trade-off of the compressor
+	*/
+	enum class CompressionLevel {
+		// One match candidate and no lazy matching, for real time captures
+		FAST,
+		// Deeper match search with lazy matching, for screenshots
+		DEFAULT
+	};
+
+	/**
+	* Deflate (RFC 1951) compressor with dynamic Huffman blocks
+	*
+	* Each call compresses one independent piece of data: matches never reach
+	* into an earlier piece, and a piece that is not final ends with an empty
+	* stored block (a zlib sync flush), so its output is byte aligned and the
+	* outputs of consecutive pieces can simply be concatenated into a single
+	* stream. That is what lets PngEncoder deflate row bands on many threads.
+	*
+	* An instance keeps its match tables between calls, use one per thread.
+	*/
+	class Deflate {
+
+	private:
+
+		static const int WINDOW_BITS = 15;
+		static const int WINDOW_SIZE = 1 << WINDOW_BITS;
+		static const int HASH_BITS = 15;
+		static const int MIN_MATCH = 3;
+		static const int MAX_MATCH = 258;
+
+		// Symbols per Huffman block
+		static const size_t BLOCK_SYMBOLS = 1 << 16;
+
+		/**
+		* A literal (distance 0) or a match, as written to a block
+		*/
+		struct Symbol {
+			uint16_t length;
+			uint16_t distance;
+		};
+
+		/**
+		* Collects the bits of the output, least significant first
+		*/
+		struct BitWriter {
+			std::vector<unsigned char>& out;
+			uint64_t buffer = 0;
+			int count = 0;
+
+			BitWriter(std::vector<unsigned char>& output) : out(output) {}
+
+			void put(const uint32_t, const int);
+
+			// Pads to the next byte
+			void align();
+		};
+
+		CompressionLevel level;
+
+		// Number of candidates checked per position, and the length that ends the search
+		int maxChain, niceLength;
+
+		bool lazy;
+
+		// Most recent position of each hash, and the previous position with the same hash
+		std::vector<int32_t> head;
+
+		std::vector<int32_t> prev;
+
+		std::vector<Symbol> symbols;
+
+		/**
+		* Finds the longest earlier match of a position
+		*
+		* @return the match length, 0 if shorter than MIN_MATCH
+		*/
+		int findMatch(const unsigned char*, const size_t, const size_t, int&) const;
+
+		void insert(const unsigned char*, const size_t);
+
+		/**
+		* Writes the collected symbols as one dynamic Huffman block
+		*/
+		void writeBlock(BitWriter&, const bool);
+
+		/**
+		* Computes Huffman code lengths limited to a maximum length
+		*/
+		static void buildLengths(const std::vector<uint32_t>&, const int, std::vector<uint8_t>&);
+
+		/**
+		* Computes the canonical codes of code lengths, bit reversed for the writer
+		*/
+		static void buildCodes(const std::vector<uint8_t>&, std::vector<uint16_t>&);
+
+	public:
+
+		Deflate(const CompressionLevel = CompressionLevel::DEFAULT);
+
+		/**
+		* Compresses a piece of data and appends the raw deflate output
+		*
+		* @param data the data
+		* @param length the size of the data
+		* @param final true for the last piece of the stream, false to end with a sync flush
+		* @param out the output, appended to
+		*/
+		void compress(const unsigned char*, const size_t, const bool, std::vector<unsigned char>&);
+
+		/**
+		* Updates an Adler-32 checksum, the zlib stream trailer
+		*
+		* @param data the data
+		* @param length the size of the data
+		* @param adler the checksum of the preceding data, 1 to start
+		* @return the checksum including the data
+		*/
+		static uint32_t adler32(const unsigned char*, const size_t, const uint32_t = 1);
+
+		/**
+		* Combines the Adler-32 checksums of two consecutive pieces of data
+		*
+		* @param first the checksum of the first piece
+		* @param second the checksum of the second piece
+		* @param length the size of the second piece
+		* @return the checksum of both pieces
+		*/
+		static uint32_t adler32Combine(const uint32_t, const uint32_t, const size_t);
+
+		/**
+		* Updates a CRC-32, as used by the PNG chunks
+		*
+		* @param data the data
+		* @param length the size of the data
+		* @param crc the CRC of the preceding data, 0 to start
+		* @return the CRC including the data
+		*/
+		static uint32_t crc32(const unsigned char*, const size_t, const uint32_t = 0);
+
+		/**
+		* Compresses data to a zlib stream, with the signature of STBIW_ZLIB_COMPRESS
+		*
+		* @param data the data
+		* @param length the size of the data
+		* @param outLength the size of the stream
+		* @param quality the stb compression level, FAST below 5
+		* @return the stream allocated with malloc, freed by stb
+		*/
+		static unsigned char* zlibCompress(unsigned char*, int, int*, int);
+
+	};
+
+}
@@ -0,0 +1,198 @@
+#pragma once
+#include <fstream>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+#include <GL/glew.h>
+#include "capture/PngEncoder.h"
+#include "loader/ThreadPool.h"
+
+namespace engine {
+
+	/**
+	* What a recording writes
+	*/
+	enum class CaptureFormat {
+		// One PNG file per frame, <basename>_000000.png
+		PNG_SEQUENCE,
+		// Planar YUV 4:2:0 (I420) frames appended to <basename>.yuv
+		RAW_YUV
+	};
+
+	/**
+	* Screenshots and frame recording without stalling the GPU
+	*
+	* The back buffer is read into one of two pixel pack buffers, which
+	* returns at once, and a fence is placed after the read. The buffer is
+	* only mapped once its fence has signaled, usually on the next frame, so
+	* the CPU never waits for the GPU to catch up. The mapped pixels are
+	* copied out and encoded by worker threads: PNG files on the shared
+	* AssetLoader workers, which also split each image in bands (@see
+	* PngEncoder), YUV frames on a single writer thread of their own so the
+	* stream keeps the frame order.
+	*
+	* When the encoders fall behind by more than MAX_PENDING frames, recorded
+	* frames are dropped instead of piling up in memory; getDropped counts
+	* them. A screenshot is never dropped.
+	*
+	* GL thread only, except for the encoding jobs it hands out.
+	*/
+	class FrameCapture {
+
+	private:
+
+		static const int BUFFERS = 2;
+
+		// Frames copied out of the pixel buffers and not yet written
+		static const unsigned int MAX_PENDING = 8;
+
+		/**
+		* A pixel pack buffer and the read it holds
+		*/
+		struct Readback {
+			GLuint buffer = 0;
+			GLsizeiptr capacity = 0;
+			GLsync fence = 0;
+			GLsizei width = 0, height = 0;
+			// Destinations of the frame, each may be empty
+			std::string screenshot;
+			std::string path;
+			std::shared_ptr<std::ofstream> stream;
+		};
+
+		Readback readbacks[BUFFERS];
+
+		// Next buffer to read into, the oldest read
+		int next = 0;
+
+		// Writes the YUV frames in order
+		ThreadPool writer;
+
+		std::string screenshotPath;
+
+		bool recording = false;
+
+		CaptureFormat format = CaptureFormat::PNG_SEQUENCE;
+
+		std::string basename;
+
+		// Shared by the jobs of the recording, the file closes with the last one
+		std::shared_ptr<std::ofstream> stream;
+
+		unsigned int frame = 0;
+
+		// Size of the last frame read
+		GLsizei width = 0, height = 0;
+
+		unsigned int dropped = 0;
+
+		unsigned int stalls = 0;
+
+		// Encodes and writes handed to the workers, true when they succeed
+		std::vector<std::future<bool>> jobs;
+
+		unsigned int failed = 0;
+
+		// Compression of the PNG sequences, screenshots always use the default level
+		CompressionLevel compression = CompressionLevel::FAST;
+
+		// Pixels encoded to PNG by the current recording, and the time it took
+		std::mutex statsMutex;
+
+		size_t encodedBytes = 0;
+
+		double encodeSeconds = 0.0;
+
+		/**
+		* Drops the finished jobs, counting the failed ones
+		*/
+		void finishJobs();
+
+		/**
+		* Maps a signaled buffer and hands its pixels to the encoders
+		*
+		* @param readback the buffer
+		* @param wait true to block until the read is done
+		* @return false if the read is still in flight
+		*/
+		bool collect(Readback&, const bool);
+
+		/**
+		* Converts top-down RGB pixels to I420 and appends them to the stream
+		*/
+		static bool writeYUV(std::ofstream&, const std::vector<unsigned char>&, const GLsizei, const GLsizei);
+
+	public:
+
+		FrameCapture();
+
+		/**
+		* Waits for every read and encode in flight, needs the GL context
+		*/
+		~FrameCapture();
+
+		/**
+		* Saves the next captured frame as a PNG file
+		*
+		* @param path the file path
+		*/
+		void screenshot(const std::string&);
+
+		/**
+		* Starts capturing every frame
+		*
+		* @param basename the path of the files, without extension
+		* @param format a PNG sequence or a raw YUV stream
+		* @return false if the stream cannot be opened
+		*/
+		bool startRecording(const std::string&, const CaptureFormat);
+
+		/**
+		* Stops capturing, the frames in flight are still written
+		*/
+		void stopRecording();
+
+		const bool isRecording() const;
+
+		/**
+		* Sets the compression of the PNG sequences
+		*
+		* @param level FAST to keep up with real time, DEFAULT for smaller files
+		*/
+		void setCompression(const CompressionLevel);
+
+		/**
+		* Collects the finished reads and reads the back buffer if a frame is wanted
+		* Call after the frame is drawn and before the buffers are swapped
+		*
+		* @param width the framebuffer width
+		* @param height the framebuffer height
+		*/
+		void endFrame(const GLsizei, const GLsizei);
+
+		/**
+		* Gets the number of frames captured by the current or last recording
+		*
+		* @return the number of frames
+		*/
+		const unsigned int getFrames() const;
+
+		/**
+		* Gets the number of recorded frames dropped because the encoders fell behind
+		*
+		* @return the number of frames
+		*/
+		const unsigned int getDropped() const;
+
+		/**
+		* Gets the number of frames that had to wait for a read of an older frame
+		*
+		* @return the number of frames
+		*/
+		const unsigned int getStalls() const;
+
+	};
+
+}
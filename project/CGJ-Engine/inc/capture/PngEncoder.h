@@ -0,0 +1,92 @@
+#pragma once
+#include <string>
+#include <vector>
+#include "capture/Deflate.h"
+#include "loader/ThreadPool.h"
+
+namespace engine {
+
+	/**
+	* Timing of one encode
+	*/
+	struct PngStats {
+		// Size of the pixels and of the file, in bytes
+		size_t rawBytes = 0;
+		size_t encodedBytes = 0;
+		double seconds = 0.0;
+
+		/**
+		* Gets the encoding speed
+		*
+		* @return the megabytes of pixels encoded per second
+		*/
+		const double getThroughput() const {
+			return seconds > 0.0 ? rawBytes / (1024.0 * 1024.0) / seconds : 0.0;
+		}
+	};
+
+	/**
+	* PNG encoder that filters and deflates bands of rows in parallel
+	*
+	* The image is cut in bands of whole rows. Each band is filtered (the
+	* filters read the row above, which is still in the source pixels) and
+	* deflated on its own, ending with a sync flush, and becomes one IDAT
+	* chunk. The chunks concatenate into a single zlib stream whose Adler-32
+	* is combined from the checksums of the bands. Matches cannot reach into
+	* the previous band, bands are kept large enough for that not to matter.
+	*
+	* Worker threads of the given pool help with the bands while the calling
+	* thread encodes bands itself, so the encoder can be called from a task
+	* of that same pool without deadlocking.
+	*/
+	class PngEncoder {
+
+	private:
+
+		// Smallest band worth a thread, in bytes of filtered rows
+		static const size_t MIN_BAND_BYTES = 256 * 1024;
+
+		/**
+		* Filters one row, picking the filter with the smallest sum of absolute differences
+		*
+		* @param row the row
+		* @param prior the row above, nullptr for the first row
+		* @param bpp the bytes per pixel
+		* @param length the bytes of the row
+		* @param level FAST only tries the Sub and Up filters
+		* @param out the filter type and the filtered row
+		* @param scratch room for one filtered row
+		*/
+		static void filterRow(const unsigned char*, const unsigned char*, const int, const size_t,
+			const CompressionLevel, unsigned char*, std::vector<unsigned char>&);
+
+	public:
+
+		/**
+		* Encodes 8 bit pixels to a PNG file in memory
+		*
+		* @param pixels the rows, top-down, without padding
+		* @param width the width
+		* @param height the height
+		* @param channels 1 (gray), 2 (gray and alpha), 3 (RGB) or 4 (RGBA)
+		* @param out the file
+		* @param level the compression level
+		* @param workers the pool helping with the bands, nullptr to encode on the calling thread
+		* @param stats the timing of the encode, optional
+		* @return false for an invalid image
+		*/
+		static bool encode(const unsigned char*, const int, const int, const int, std::vector<unsigned char>&,
+			const CompressionLevel = CompressionLevel::DEFAULT, ThreadPool* = nullptr, PngStats* = nullptr);
+
+		/**
+		* Encodes 8 bit pixels to a PNG file on disk
+		*
+		* @return false if the image is invalid or the file cannot be written
+		* @see encode for the other parameters
+		*/
+		static bool write(const std::string&, const unsigned char*, const int, const int, const int,
+			const CompressionLevel = CompressionLevel::DEFAULT, ThreadPool* = nullptr, PngStats* = nullptr);
+
+	};
+
+}
@@ -0,0 +1,201 @@
+#pragma once
+#include <atomic>
+#include <deque>
+#include <functional>
+#include <future>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+#include "loader/ThreadPool.h"
+#include "mesh/Mesh.h"
+#include "shader/ShaderProgram.h"
+#include "skybox/CubeMap.h"
+#include "textures/PerlinTexture.h"
+#include "textures/Texture.h"
+#include "textures/TextureArray.h"
+
+namespace engine {
+
+	/**
+	* Asynchronous asset streaming
+	*
+	* Every load returns the asset immediately, holding a placeholder (textures
+	* and cubemaps) or drawing nothing (meshes). File I/O and decoding run on the
+	* worker threads; the GL uploads are queued and applied on the GL thread by
+	* processUploads(), within a per-frame time budget.
+	*
+	* Assets handed out by the loader must outlive their pending load.
+	*/
+	class AssetLoader {
+
+		////////////////////
+		// Static members //
+		////////////////////
+
+	private:
+
+		static AssetLoader* instance;
+
+	public:
+
+		static AssetLoader* getInstance();
+
+		/////////////
+		// Members //
+		/////////////
+
+	private:
+
+		ThreadPool* workers;
+
+		// Uploads waiting for the GL thread
+		std::deque<std::function<void()>> uploads;
+
+		std::mutex uploadMutex;
+
+		// Decode job of each asset, so callers can wait for the CPU data
+		std::map<const void*, std::shared_future<void>> decodes;
+
+		// Assets requested but not yet uploaded
+		std::atomic<unsigned int> pending;
+
+		//////////////////////////////////////////////
+		// Constructor								//
+		// Should only be used by the static method //
+		//////////////////////////////////////////////
+
+	private:
+
+		AssetLoader();
+
+		/**
+		* Queues work that must run on the GL thread
+		*
+		* @param upload the upload to run
+		*/
+		void enqueueUpload(std::function<void()>);
+
+		/**
+		* Starts the decode job of the given asset on a worker
+		*
+		* @param asset the asset being decoded
+		* @param decode the decode job, which enqueues the upload when done
+		*/
+		void startDecode(const void*, std::function<void()>);
+
+		/**
+		* Decodes the images in parallel, one worker task per image
+		* The last task to finish hands the images to onDecoded
+		*
+		* @param files the image paths
+		* @param onDecoded called on a worker with the images and the decode time of each one
+		* @return the future that is ready once every image is decoded
+		*/
+		std::shared_future<void> decodeImages(const std::vector<std::string>&,
+			std::function<void(std::vector<ImageData>&, std::vector<double>&)>);
+
+		/**
+		* Prints the decode and upload times of a parallel image load
+		*
+		* @param name the name of the asset
+		* @param files the image paths
+		* @param decodeTimes the decode time of each image in milliseconds
+		* @param wallTime the time from the request until every image was decoded
+		* @param uploadTime the time spent uploading on the GL thread
+		*/
+		void reportTimings(const std::string&, const std::vector<std::string>&, const std::vector<double>&, const double, const double) const;
+
+	public:
+
+		/**
+		* Streams a texture in
+		* DDS/KTX2 files are read on a worker and uploaded as block compressed textures
+		*
+		* @param fileName the image path
+		* @return the texture, showing a placeholder until loaded
+		*/
+		Texture* loadTexture(const std::string);
+
+		/**
+		* Streams a texture into the next free layer of a texture array
+		*
+		* @param textures the texture array
+		* @param fileName the image path
+		* @return the layer index, -1 if the array is full
+		*/
+		int loadLayer(TextureArray*, const std::string);
+
+		/**
+		* Generates a perlin noise image on a worker into the next free layer of a texture array
+		*
+		* @param textures the texture array
+		* @return the layer index, -1 if the array is full
+		*/
+		int loadPerlinLayer(TextureArray*);
+
+		/**
+		* Streams a mesh in, interned through the MeshCache
+		*
+		* @param path the wavefront OBJ path
+		* @param shaderProgram the shader program that defines the vertex layout
+		* @return the mesh, which is not drawn until loaded
+		*/
+		Mesh* loadMesh(const char*, ShaderProgram*);
+
+		/**
+		* Streams a cubemap in, decoding each face on its own worker
+		*
+		* @param faces the paths of the six faces
+		* @param mesh the mesh the cubemap is drawn with
+		* @return the cubemap, showing a placeholder until loaded
+		*/
+		Cubemap* loadCubemap(std::vector<std::string>, Mesh*);
+
+		/**
+		* Generates a perlin noise texture on a worker, textures with the same parameters share one image
+		*
+		* @param params the noise parameters
+		* @return the texture, showing a placeholder until loaded
+		*/
+		PerlinTexture* loadPerlin(const NoiseParams& = NoiseParams());
+
+		/**
+		* Blocks until the CPU data of the asset is decoded (not uploaded)
+		*
+		* @param asset the asset returned by one of the load methods
+		*/
+		void wait(const void*);
+
+		/**
+		* Applies queued uploads until the time budget is spent (GL thread only)
+		* At least one upload is applied per call if any is queued
+		*
+		* @param budget the time budget in milliseconds
+		* @return the number of uploads applied
+		*/
+		const unsigned int processUploads(const double);
+
+		/**
+		* Blocks until every requested asset is uploaded (GL thread only)
+		*/
+		void finish();
+
+		/**
+		* Gets the number of assets requested but not yet uploaded
+		*
+		* @return the number of pending assets
+		*/
+		const unsigned int getPending() const;
+
+		/**
+		* Gets the worker pool, shared with other CPU-heavy engine jobs
+		*
+		* @return the worker pool
+		*/
+		ThreadPool* getWorkers() const;
+
+	};
+
+}
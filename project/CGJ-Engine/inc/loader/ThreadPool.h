@@ -0,0 +1,102 @@
+#pragma once
+#include <vector>
+#include <deque>
+#include <atomic>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <future>
+#include <functional>
+#include <memory>
+
+namespace engine {
+
+	/**
+	* Fixed size pool of worker threads consuming a FIFO task queue
+	*
+	* Workers must never touch the OpenGL context, which is only current on
+	* the main thread. Results that need GL are handed back to that thread.
+	*/
+	class ThreadPool {
+
+	private:
+
+		std::vector<std::thread> workers;
+
+		std::deque<std::function<void()>> tasks;
+
+		std::mutex mutex;
+
+		std::condition_variable condition;
+
+		std::condition_variable idleCondition;
+
+		// Number of tasks currently being executed by a worker
+		unsigned int running = 0;
+
+		bool stopping = false;
+
+		/**
+		* Worker thread main loop
+		*/
+		void work();
+
+	public:
+
+		/**
+		* Constructs a ThreadPool
+		*
+		* @param threads the number of workers, 0 uses one less than the hardware threads
+		*/
+		ThreadPool(unsigned int = 0);
+
+		/**
+		* Finishes the queued tasks and joins every worker
+		*/
+		~ThreadPool();
+
+		/**
+		* Queues a task to be run by a worker
+		*
+		* @param task the callable to run
+		* @return the future holding the result of the task
+		*/
+		template<typename F>
+		std::future<typename std::result_of<F()>::type> submit(F task) {
+			typedef typename std::result_of<F()>::type R;
+			std::shared_ptr<std::packaged_task<R()>> job = std::make_shared<std::packaged_task<R()>>(task);
+			std::future<R> result = job->get_future();
+			{
+				std::lock_guard<std::mutex> lock(mutex);
+				tasks.push_back([job]() { (*job)(); });
+			}
+			condition.notify_one();
+			return result;
+		}
+
+		/**
+		* Blocks until the queue is empty and no worker is busy
+		*/
+		void waitIdle();
+
+		/**
+		* Runs a body for every index, on the calling thread and on the idle workers
+		*
+		* The calling thread claims indices too and only waits for the ones already
+		* being run, so a task of this pool can call it without deadlocking.
+		*
+		* @param count the number of indices
+		* @param body the callable run with each index from 0 to count - 1
+		*/
+		void parallelFor(const int, const std::function<void(int)>&);
+
+		/**
+		* Gets the number of worker threads
+		*
+		* @return the number of workers
+		*/
+		const unsigned int size() const;
+
+	};
+
+}
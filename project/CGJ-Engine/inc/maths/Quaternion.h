@@ -1,4 +1,5 @@
 #pragma once
+#include <cstddef>
 #include <string>
 
 #include "Vector.h"
@@ -10,6 +11,10 @@ namespace engine {
 	* Quaternion class
 	*
 	* For other members not represented here, @see Vector.h#Vector4 for details
+	*
+	* Quaternions are laid out as 4 packed floats (x, y, z, t), so arrays of them
+	* can be converted, normalized and interpolated 4 at a time with SSE by the
+	* batch methods, which the transform and animation updates use.
 	*/
 	class Quaternion {
 
@@ -20,7 +25,7 @@ namespace engine {
 		/**
 		* The threshold used to clean the values
 		*/
-		const float threshold = (float)1.0e-5;
+		static const float threshold;
 
 		//////////////////
 		// Constructors //
@@ -47,7 +52,8 @@ namespace engine {
 		operator const Vector4() const;
 
 		/**
-		* Casts this quaternion to a mat4
+		* Casts this quaternion to a mat4, in closed form
+		* The rotation is scaled by the squared length, which unit quaternions do not change
 		*/
 		operator const Matrix4() const;
 
@@ -213,8 +219,9 @@ namespace engine {
 		const Quaternion inverse() const;
 
 		/**
-		* Calculates the linear interpolation of the quaternion
-		* with the given quaternion and angles of rotation
+		* Calculates the normalized linear interpolation (nlerp) of the quaternion
+		* with the given quaternion, on the shortest arc
+		* The cheapest interpolation, but it does not rotate at a constant speed
 		*
 		* @return the calculation of the lerp
 		*/
@@ -222,18 +229,81 @@ namespace engine {
 
 		/**
 		* Calculates the spherical linear interpolation of the
-		* quaternion with the given quaternion and angles of rotation
+		* quaternion with the given quaternion, on the shortest arc
 		*
-		* @return the calculation of the lerp
+		* @return the calculation of the slerp
 		*/
 		const Quaternion slerp(const Quaternion, const float) const;
 
+		/**
+		* Approximates the spherical linear interpolation of the quaternion with the given
+		* quaternion: an nlerp whose factor is corrected by a polynomial fit of the slerp
+		* curve, within about 0.07 degrees (1.2e-3 radians) of slerp without any trigonometry
+		*
+		* @return the calculation of the approximated slerp
+		*/
+		const Quaternion fastSlerp(const Quaternion, const float) const;
+
 		/**
 		* Cleans this quaternion's coordinates, setting the values
 		* with a threshold bias
 		*/
 		void clean();
 
+		/////////////
+		// Batches //
+		/////////////
+
+	public:
+
+		/**
+		* Converts quaternions to mat4s, @see operator const Matrix4()
+		*
+		* @param quaternions the quaternions to convert
+		* @param matrices the converted matrices
+		* @param count the number of quaternions
+		*/
+		static void toMatrices(const Quaternion*, Matrix4*, const size_t);
+
+		/**
+		* Normalizes quaternions in place, the ones of length 0 are left as they are
+		*
+		* @param quaternions the quaternions to normalize
+		* @param count the number of quaternions
+		*/
+		static void normalize(Quaternion*, const size_t);
+
+		/**
+		* Interpolates pairs of quaternions with lerp, @see lerp(const Quaternion, const float)
+		*
+		* @param from the quaternions to interpolate from
+		* @param to the quaternions to interpolate to
+		* @param k the interpolation factor of each pair
+		* @param out the interpolated quaternions, may be from or to
+		* @param count the number of pairs
+		*/
+		static void lerp(const Quaternion*, const Quaternion*, const float*, Quaternion*, const size_t);
+
+		/**
+		* Interpolates pairs of quaternions with fastSlerp, @see fastSlerp(const Quaternion, const float)
+		*
+		* @param from the quaternions to interpolate from
+		* @param to the quaternions to interpolate to
+		* @param k the interpolation factor of each pair
+		* @param out the interpolated quaternions, may be from or to
+		* @param count the number of pairs
+		*/
+		static void fastSlerp(const Quaternion*, const Quaternion*, const float*, Quaternion*, const size_t);
+
+	private:
+
+		/**
+		* Interpolates pairs of quaternions on the shortest arc and normalizes them
+		*
+		* @param corrected true to correct the factors towards slerp
+		*/
+		static void interpolate(const Quaternion*, const Quaternion*, const float*, Quaternion*, const size_t, const bool);
+
 		/////////////
 		// Streams //
 		/////////////
@@ -4,6 +4,7 @@
 #include "BufferObject.h"
 #include "maths/Matrix.h"
 #include "shader/ShaderProgram.h"
+#include "render/InstanceBuffer.h"
 
 namespace engine {
 
@@ -75,6 +76,26 @@ namespace engine {
 		}
 	};
 
+	/**
+	* Joints influencing a vertex of a skinned mesh, and their weights
+	* normalized to bytes that add up to 255
+	*
+	*/
+	struct SkinWeights {
+		GLubyte joints[4];
+		GLubyte weights[4];
+
+		/**
+		* Keeps the 4 largest influences and normalizes their weights
+		*
+		* @param joints the joint indices
+		* @param weights the weights, any positive scale
+		* @param count the number of influences
+		* @return the influences, all on joint 0 if no weight is positive
+		*/
+		static SkinWeights fromWeights(const int*, const float*, const int);
+	};
+
 	/**
 	* Represents a Mesh
 	*
@@ -95,16 +116,38 @@ namespace engine {
 
 		std::vector<TexCoord> texCoordData;
 
-		Vertex color = { 1.0f, 1.0f, 1.0f, 1.0f };
+		// One per vertex, empty if the mesh is not skinned
+		std::vector<SkinWeights> skinWeights;
+
+		// One per position, from the "vs" lines of the file
+		std::vector<SkinWeights> skinData;
 
 		bool TexcoordsLoaded = false, NormalsLoaded = false;
 
+		// Vertices rewritten every frame, uploaded with GL_DYNAMIC_DRAW
+		bool dynamic = false;
+
+		// Bounding sphere of the vertices, in mesh space
+		Vector3 boundsCenter;
+		float boundsRadius = 0.0f;
+
+		/**
+		* Computes the bounding sphere of the processed vertices
+		*/
+		void computeBounds();
+
 		void parseVertex(std::stringstream&);
 
 		void parseTexCoord(std::stringstream&);
 
 		void parseNormal(std::stringstream&);
 
+		/**
+		* Parses the joint influences of the last position, "vs joint weight ..." with up to 4 pairs
+		* (an extension of the OBJ format, files without these lines load unskinned)
+		*/
+		void parseSkin(std::stringstream&);
+
 		void parseFace(std::stringstream&);
 
 		void parseLine(std::stringstream&);
@@ -121,11 +164,21 @@ namespace engine {
 
 		void setNormalAttrib(const GLuint);
 
+		void setSkinAttribs(const GLuint, const GLuint);
+
+		/**
+		* Creates the buffer of the joint influences and adds it to the vertex array
+		*/
+		void createSkinBuffer();
+
 	protected:
 
-		GLuint VaoId = 0, IndexVboId = 0, VboId = 0, TexCoordVboId = 0, NormalVboId = 0;
+		GLuint VaoId = 0, IndexVboId = 0, VboId = 0, TexCoordVboId = 0, NormalVboId = 0, SkinVboId = 0;
+
+		// Instance buffer the vertex array reads its instance attributes from
+		GLuint InstanceVboId = 0;
 
-		static int indexAttrib, vertexAttrib, texcoordAttrib, normalAttrib;
+		static int indexAttrib, vertexAttrib, texcoordAttrib, normalAttrib, jointAttrib, weightAttrib;
 
 		Matrix4 modelMatrix = MatrixFactory::Identity4();
 
@@ -143,10 +196,41 @@ namespace engine {
 		*/
 		virtual const std::vector<Vertex> getVertices() const;
 
+		/**
+		* Gets the texture coordinates of this object, one per vertex
+		*
+		* @return texCoords The array of texture coordinates, empty if the mesh has none
+		*/
+		const std::vector<TexCoord>& getTexCoords() const;
+
+		/**
+		* Gets the normals of this object, one per vertex
+		*
+		* @return normals The array of normals, empty if the mesh has none
+		*/
+		const std::vector<Vertex>& getNormals() const;
+
+		/**
+		* Gets the joint influences of this object, one per vertex
+		*
+		* @return skinWeights The array of influences, empty if the mesh is not skinned
+		*/
+		const std::vector<SkinWeights>& getSkinWeights() const;
+
+		/**
+		* Sets the joint influences of every vertex, uploaded with the mesh
+		* or right away if it already is (GL thread only then)
+		*
+		* @param weights the influences, one per vertex
+		*/
+		void setSkinWeights(const std::vector<SkinWeights>&);
+
+		const bool isSkinned() const;
+
 	public:
 
 		Mesh();
-		~Mesh();
+		virtual ~Mesh();
 
 		const bool operator == (const Mesh&) const;
 
@@ -154,7 +238,66 @@ namespace engine {
 
 		static Mesh* parseMesh(const char*, ShaderProgram*);
 
-		const Vertex getColor() const;
+		/**
+		* Parses the OBJ file into CPU memory (safe on a worker thread)
+		*
+		* @param path the wavefront OBJ path
+		*/
+		void loadFromFile(const char*);
+
+		/**
+		* Creates the GPU buffers for the parsed data (GL thread only)
+		*
+		* @param shaderProgram the shader program that defines the vertex layout
+		*/
+		void upload(ShaderProgram*);
+
+		/**
+		* Creates a position only copy of an uploaded mesh, meant to have its
+		* vertices replaced every frame (GL thread only)
+		*
+		* @return the copy, uploaded
+		*/
+		Mesh* createDynamicCopy() const;
+
+		/**
+		* Replaces the vertices of a dynamic copy and updates its bounds (GL thread only)
+		*
+		* @param vertices the vertices, as many as the mesh has
+		*/
+		void updateVertices(const std::vector<Vertex>&);
+
+		/**
+		* Checks if the GPU buffers have been created
+		*
+		* @return true if the mesh can be drawn, false otherwise
+		*/
+		const bool isLoaded() const;
+
+		/**
+		* Gets the center of the bounding sphere of the vertices, once parsed
+		*
+		* @return the center, in mesh space
+		*/
+		const Vector3& getBoundsCenter() const;
+
+		/**
+		* Gets the radius of the bounding sphere of the vertices, once parsed
+		*
+		* @return the radius, in mesh space
+		*/
+		const float getBoundsRadius() const;
+
+		/**
+		* Draws several instances of the mesh, reading their model matrix,
+		* color and texture layer from the instance buffer
+		*
+		* @param instances the instance buffer
+		* @param shaderProgram the instanced shader program, for the attribute bindings
+		* @param count the number of instances
+		* @param baseInstance the index of the first instance in the buffer
+		*/
+		void drawInstanced(const InstanceBuffer*, const ShaderProgram*, const GLsizei, const GLuint);
 
 		/**
 		* Scales the object
@@ -179,8 +322,6 @@ namespace engine {
 		*/
 		void translate(const float, const float, const float = 0);
 
-		Mesh* inColor(Vertex);
-
 		std::vector<float> getBoundingCoords() const;
 
 		////////////////////////////////////////////////////////
@@ -0,0 +1,119 @@
+#pragma once
+#include <map>
+#include <string>
+#include "mesh/Mesh.h"
+#include "shader/ShaderProgram.h"
+
+namespace engine {
+
+	/**
+	* Shared Mesh resource cache
+	*
+	* Interns meshes by file path and vertex layout, so every usage of the same
+	* OBJ with the same attribute bindings (e.g. the main and the shadow pass)
+	* shares a single parsed Mesh and a single set of GPU buffers.
+	* Per-instance properties (color, material, ...) live in the SceneNode.
+	*/
+	class MeshCache {
+
+		////////////////////
+		// Static members //
+		////////////////////
+
+	private:
+
+		static MeshCache* instance;
+
+	public:
+
+		static MeshCache* getInstance();
+
+		/**
+		* Gets the mesh for the given file and shader layout, parsing it only once
+		*
+		* @param path the wavefront OBJ path
+		* @param shaderProgram the shader program that defines the vertex layout
+		* @return the shared mesh
+		*/
+		static Mesh* loadMesh(const char*, ShaderProgram*);
+
+		/////////////
+		// Members //
+		/////////////
+
+	private:
+
+		std::map<std::string, Mesh*> meshes;
+
+		// Number of requests served without parsing the file again
+		unsigned int hits = 0;
+
+		//////////////////////////////////////////////
+		// Constructor								//
+		// Should only be used by the static method //
+		//////////////////////////////////////////////
+
+	private:
+
+		MeshCache();
+
+		/**
+		* Builds the interning key from the path and the attribute bindings
+		*
+		* @param path the wavefront OBJ path
+		* @param shaderProgram the shader program that defines the vertex layout
+		* @return the key
+		*/
+		const std::string createKey(const char*, ShaderProgram*) const;
+
+	public:
+
+		/**
+		* Gets the mesh for the given file and shader layout, parsing it only once
+		*
+		* @param path the wavefront OBJ path
+		* @param shaderProgram the shader program that defines the vertex layout
+		* @return the shared mesh
+		*/
+		Mesh* load(const char*, ShaderProgram*);
+
+		/**
+		* Finds an already interned mesh
+		*
+		* @param path the wavefront OBJ path
+		* @param shaderProgram the shader program that defines the vertex layout
+		* @return the shared mesh, nullptr if it was never requested
+		*/
+		Mesh* find(const char*, ShaderProgram*) const;
+
+		/**
+		* Interns a mesh created elsewhere (e.g. still being streamed in)
+		*
+		* @param path the wavefront OBJ path
+		* @param shaderProgram the shader program that defines the vertex layout
+		* @param mesh the mesh to share
+		*/
+		void insert(const char*, ShaderProgram*, Mesh*);
+
+		/**
+		* Gets the number of unique meshes held by the cache
+		*
+		* @return the number of meshes
+		*/
+		const size_t size() const;
+
+		/**
+		* Gets the number of loads that were served from the cache
+		*
+		* @return the number of cache hits
+		*/
+		const unsigned int getHits() const;
+
+		/**
+		* Destroys every cached mesh (and its GPU buffers)
+		*/
+		void clear();
+
+	};
+
+}
@@ -16,6 +16,11 @@ namespace engine {
 
 		std::vector<Collider*> inCollision;
 
+	protected:
+
+		// The debug draw color of this collider
+		Vertex color = { 1.0f, 1.0f, 1.0f, 0.2f };
+
 	public:
 
 		virtual bool isInside(Vertex, std::vector<float>) const = 0;
@@ -30,6 +35,8 @@ namespace engine {
 
 		const float getWidth() const;
 
+		const Vertex getColor() const;
+
 	public:
 
 		virtual void update() override;
@@ -0,0 +1,64 @@
+#pragma once
+#include <vector>
+#include <GL/glew.h>
+#include "render/InstanceBuffer.h"
+
+namespace engine {
+
+	/**
+	* Command of glMultiDrawElementsIndirect, laid out as GL expects it
+	*/
+	struct DrawCommand {
+		GLuint count;
+		GLuint instanceCount;
+		GLuint firstIndex;
+		GLint baseVertex;
+		GLuint baseInstance;
+	};
+
+	/**
+	* Indirect commands and per-draw parameters of the multi-draw indirect path,
+	* written to the StreamBuffer
+	*
+	* The parameters are read through a shader storage binding by the
+	* DrawBlock of the INDIRECT shader variants. They reuse the InstanceData
+	* layout, which matches the std430 layout of the DrawParameters struct.
+	*/
+	class IndirectBuffer {
+
+	private:
+
+		// Offsets of the commands and parameters of the pass in the stream buffer
+		GLintptr commandOffset = 0, parameterOffset = 0;
+
+		GLsizeiptr parameterSize = 0;
+
+	public:
+
+		/**
+		* Writes the commands and parameters of the pass to the stream buffer (GL thread only)
+		*
+		* @param commands the commands of the pass
+		* @param parameters the draw parameters, one per command
+		* @return false if the stream buffer is full
+		*/
+		bool upload(const std::vector<DrawCommand>&, const std::vector<InstanceData>&);
+
+		/**
+		* Binds the commands to the indirect target and the parameters to a storage binding point
+		*
+		* @param bindingPoint the binding point of the DrawBlock
+		*/
+		void bind(const GLuint) const;
+
+		/**
+		* Gets the offset to pass to glMultiDrawElementsIndirect for a command
+		*
+		* @param command the index of the first command to draw
+		* @return the offset in the indirect buffer
+		*/
+		const GLintptr getCommandOffset(const GLuint) const;
+
+	};
+
+}
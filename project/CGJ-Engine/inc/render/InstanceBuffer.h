@@ -0,0 +1,56 @@
+#pragma once
+#include <vector>
+#include <GL/glew.h>
+#include "shader/ShaderProgram.h"
+
+namespace engine {
+
+	/**
+	* Per-instance data of an instanced draw, read with an attribute divisor of 1
+	*/
+	struct InstanceData {
+		GLfloat modelMatrix[16];
+		GLfloat color[4];
+		GLint textureLayer;
+		GLint padding[3];
+	};
+
+	/**
+	* InstanceData of every instanced draw of a pass, written to the StreamBuffer
+	*
+	* The whole pass is uploaded at once; each draw picks its range with the
+	* base instance of glDrawArraysInstancedBaseInstance, offset by the first
+	* instance of the pass in the stream buffer.
+	*/
+	class InstanceBuffer {
+
+	private:
+
+		// Index of the first instance of the pass, counted from the start of the stream buffer
+		GLuint firstInstance = 0;
+
+	public:
+
+		/**
+		* Writes the instances of the pass to the stream buffer (GL thread only)
+		*
+		* @param instances the instances of the pass
+		* @return false if the stream buffer is full
+		*/
+		bool upload(const std::vector<InstanceData>&);
+
+		/**
+		* Sets the instance attributes of a vertex array to read from this buffer
+		*
+		* @param vertexArray the vertex array
+		* @param shaderProgram the shader program that defines the attribute bindings
+		*/
+		void attach(const GLuint, const ShaderProgram*) const;
+
+		const GLuint getId() const;
+
+		const GLuint getFirstInstance() const;
+
+	};
+
+}
@@ -0,0 +1,112 @@
+#pragma once
+#include <unordered_map>
+#include <vector>
+#include <GL/glew.h>
+#include "mesh/Mesh.h"
+#include "shader/ShaderProgram.h"
+
+namespace engine {
+
+	/**
+	* Interleaved vertex of the mesh arena
+	*/
+	struct ArenaVertex {
+		GLfloat position[3];
+		GLfloat texCoord[2];
+		GLfloat normal[3];
+	};
+
+	/**
+	* Shared vertex and index buffers holding every mesh drawn with multi-draw indirect
+	*
+	* Meshes are added the first time they are drawn once loaded. Their
+	* triangles are deduplicated into indexed vertices and appended to the
+	* arena; a draw then only needs the range of its mesh, so draws of
+	* different meshes can share one vertex array and one draw call.
+	*
+	* The vertex array also reads a draw id per instance (divisor 1). Each
+	* indirect command sets its base instance to its own index, which the
+	* shaders use to read their draw parameters; GL 4.3 has no gl_DrawID.
+	*/
+	class MeshArena {
+
+	public:
+
+		/**
+		* Indices of a mesh in the arena, as expected by an indirect command
+		*/
+		struct Range {
+			GLuint firstIndex;
+			GLuint indexCount;
+			GLint baseVertex;
+		};
+
+	private:
+
+		GLuint VaoId = 0, VboId = 0, IndexVboId = 0, DrawIdVboId = 0;
+
+		std::vector<ArenaVertex> vertices;
+
+		std::vector<GLuint> indices;
+
+		std::unordered_map<const Mesh*, Range> ranges;
+
+		// True if geometry was added since the last upload
+		bool dirty = false;
+
+		// Number of draw ids in the draw id buffer
+		size_t drawIds = 0;
+
+		/**
+		* Appends the triangles of a loaded mesh to the arena
+		*
+		* @param mesh the mesh
+		* @return the range of the mesh
+		*/
+		const Range& add(const Mesh*);
+
+		/**
+		* Creates the vertex array and sets its attributes (GL thread only)
+		*
+		* @param shaderProgram the shader program that defines the attribute bindings
+		*/
+		void createVertexArray(const ShaderProgram*);
+
+	public:
+
+		MeshArena();
+
+		~MeshArena();
+
+		/**
+		* Gets the range of a mesh, adding the mesh to the arena if needed
+		*
+		* @param mesh the mesh
+		* @return the range, nullptr if the mesh is not loaded yet
+		*/
+		const Range* find(const Mesh*);
+
+		/**
+		* Uploads the geometry added since the last call and grows the draw id
+		* buffer to the given number of draws (GL thread only)
+		*
+		* @param shaderProgram the shader program that defines the attribute bindings
+		* @param drawCount the number of draws of the frame
+		*/
+		void upload(const ShaderProgram*, const size_t);
+
+		/**
+		* Binds the vertex array of the arena
+		*/
+		void bind() const;
+
+		/**
+		* Gets the number of unique vertices in the arena
+		*
+		* @return the number of vertices
+		*/
+		const size_t getVertexCount() const;
+
+	};
+
+}
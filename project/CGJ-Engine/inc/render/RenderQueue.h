@@ -0,0 +1,254 @@
+#pragma once
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+#include "shader/ShaderProgram.h"
+#include "render/IndirectBuffer.h"
+#include "render/InstanceBuffer.h"
+#include "render/MeshArena.h"
+
+namespace engine {
+
+	class SceneNode;
+
+	/**
+	* Render passes, in submission order
+	* DEPTH is the optional camera depth pre-pass of the opaque draws
+	*/
+	enum class RenderPass { SHADOW = 0, DEPTH = 1, MAIN = 2 };
+
+	/**
+	* Draw packets sorted by a 64 bit key
+	*
+	* The scene traversal only emits packets; sorting them before submission
+	* groups draws that share state, and orders translucent draws back to
+	* front after every opaque draw so blending no longer depends on the
+	* order of the nodes in the scene graph.
+	*
+	* Consecutive opaque packets that share their state and mesh are drawn
+	* as one instanced draw when their program has an instanced variant.
+	*
+	* With multi-draw indirect (GL 4.3) consecutive packets that share their
+	* state are drawn with one glMultiDrawElementsIndirect whatever their
+	* mesh: the meshes live in a shared MeshArena and the model matrix, color
+	* and texture layer of each draw are read from a storage buffer. The
+	* shadow pass has a single state, so it becomes a single draw call.
+	*
+	* The shadow and depth pre-pass packets draw the depth mesh of their node
+	* with the depth program given to submit. After a depth pre-pass the
+	* opaque main pass draws are tested with GL_EQUAL and write no depth, so
+	* only their visible fragments run the material shaders.
+	*
+	* Key layout, most significant bits first:
+	*   pass (4) | translucent (1) | opaque:      shader (10) | material (12) | texture (12) | mesh (10) | depth (14)
+	*                                translucent: inverted depth (24) | shader (10) | material (12) | texture (12)
+	*
+	* The ids are truncated to their bits, so different objects can share them:
+	* the key only orders the packets, batches are confirmed against the
+	* program, material, texture and mesh of the nodes themselves.
+	*/
+	class RenderQueue {
+
+	public:
+
+		struct DrawPacket {
+			uint64_t key;
+			SceneNode* node;
+		};
+
+	private:
+
+		/**
+		* How the packets of a batch are drawn
+		*/
+		enum class BatchType { SINGLE, INSTANCED, INDIRECT };
+
+		/**
+		* Run of packets drawn with one draw call unless single
+		* For indirect batches baseInstance is the first command
+		*/
+		struct Batch {
+			size_t first;
+			size_t count;
+			GLuint baseInstance;
+			BatchType type;
+			// Indirect commands of the batch, packets still streaming in have none
+			GLsizei commandCount;
+		};
+
+		std::vector<DrawPacket> packets;
+
+		std::vector<Batch> batches;
+
+		// Instance data of every instanced batch of the pass
+		std::vector<InstanceData> instances;
+
+		InstanceBuffer* instanceBuffer = nullptr;
+
+		// Indirect commands and their draw parameters, one per packet of the indirect batches
+		std::vector<DrawCommand> commands;
+
+		std::vector<InstanceData> parameters;
+
+		IndirectBuffer* indirectBuffer = nullptr;
+
+		MeshArena* arena = nullptr;
+
+		// Requested by the user, only used if supported
+		bool indirect = true;
+
+		// Set when a depth pre-pass filled the depth buffer before the main pass
+		bool depthEqual = false;
+
+		// Small stable ids of the materials and textures, to fit in the key
+		std::unordered_map<const void*, unsigned int> ids;
+
+		static const int SHADER_BITS = 10, MATERIAL_BITS = 12, TEXTURE_BITS = 12, MESH_BITS = 10;
+		static const int DEPTH_BITS = 24, OPAQUE_DEPTH_BITS = 14;
+
+		// Smallest run of packets worth an instanced draw
+		static const size_t MIN_INSTANCES = 2;
+
+		/**
+		* Checks if two packets can be drawn by the same instanced draw
+		*
+		* @param first the first packet of the run
+		* @param packet the candidate packet
+		* @return true if they share pass, state and mesh and are opaque
+		*/
+		static bool canBatch(const DrawPacket&, const DrawPacket&);
+
+		/**
+		* Gets the bits of a key that must match for packets to share a draw call
+		*
+		* @param key the key
+		* @return the pass, translucency and state bits
+		*/
+		static uint64_t getState(const uint64_t);
+
+		/**
+		* Checks if two packets draw with the same state: the same state bits,
+		* and the same program, material and texture behind the truncated ids
+		*
+		* @param first the first packet of the run
+		* @param packet the candidate packet
+		* @return true if one state binding draws both
+		*/
+		static bool isSameState(const DrawPacket&, const DrawPacket&);
+
+		/**
+		* Checks if a key belongs to a depth only pass
+		*
+		* @param key the key
+		* @return true for the shadow and depth pre-pass packets
+		*/
+		static bool isDepthOnly(const uint64_t);
+
+		/**
+		* Gets the per-draw data of a packet
+		*
+		* @param node the node of the packet
+		* @return the model matrix, color and texture layer of the node
+		*/
+		static InstanceData getDrawData(const SceneNode*);
+
+		/**
+		* Adds the indirect commands of a run of packets that share their state
+		*
+		* @param first the first packet of the run
+		* @param end one past the last packet of the run
+		* @return the batch, with no commands if no mesh of the run is loaded yet
+		*/
+		Batch buildIndirectBatch(const size_t, const size_t);
+
+		/**
+		* Groups the packets into batches and fills the instance data
+		*
+		* @param depthShader the shader used for the shadow and depth pre-pass packets
+		*/
+		void buildBatches(ShaderProgram*);
+
+	public:
+
+		/**
+		* Builds the sort key of a draw
+		*
+		* @param pass the render pass
+		* @param translucent true if the draw is blended
+		* @param shader the shader program id
+		* @param material the material id (@see getId)
+		* @param texture the texture id (@see getId)
+		* @param mesh the mesh id (@see getId)
+		* @param depth the view space distance to the camera
+		* @return the key
+		*/
+		static uint64_t makeKey(const RenderPass, const bool, const unsigned int, const unsigned int, const unsigned int, const unsigned int, const float);
+
+		/**
+		* Gets the render pass of a key
+		*
+		* @param key the key
+		* @return the render pass
+		*/
+		static RenderPass getPass(const uint64_t);
+
+		/**
+		* Gets a small id for a material or texture object, 0 for none
+		*
+		* @param object the object
+		* @return the id, stable for the lifetime of the queue, truncated in the keys
+		*/
+		unsigned int getId(const void*);
+
+		void clear();
+
+		void push(const uint64_t, SceneNode*);
+
+		void sort();
+
+		~RenderQueue();
+
+		/**
+		* Checks if the context supports the multi-draw indirect path
+		*
+		* @return true on GL 4.3 or with the equivalent extensions
+		*/
+		static bool isIndirectSupported();
+
+		/**
+		* Enables or disables the multi-draw indirect path, if supported
+		*
+		* @param enabled true to draw through the mesh arena
+		*/
+		void setIndirect(const bool);
+
+		const bool isIndirect() const;
+
+		/**
+		* Tests the opaque main pass draws with GL_EQUAL without depth writes,
+		* translucent draws keep GL_LEQUAL
+		*
+		* @param enabled true if a depth pre-pass was submitted before the main pass
+		*/
+		void setDepthEqual(const bool);
+
+		/**
+		* Issues the draws in key order, through multi-draw indirect if enabled
+		* or instancing the runs of matching packets otherwise
+		*
+		* @param depthShader the shader used for the shadow and depth pre-pass packets
+		*/
+		void submit(ShaderProgram* = nullptr);
+
+		/**
+		* Gets the number of draw calls issued by the last submit
+		*
+		* @return the number of draw calls
+		*/
+		const size_t getDrawCalls() const;
+
+		const size_t size() const;
+
+	};
+
+}
@@ -0,0 +1,199 @@
+#pragma once
+#include <map>
+#include <utility>
+#include <GL/glew.h>
+
+namespace engine {
+
+	/**
+	* Shadow copy of the OpenGL state
+	*
+	* Every bind or state change goes through this cache, which skips the GL
+	* call when the state is already set. The cache only stays correct if all
+	* the engine code changes that state through it, and objects must tell it
+	* when they are deleted, since GL silently unbinds deleted objects.
+	*
+	* GL thread only.
+	*/
+	class RenderState {
+
+		////////////////////
+		// Static members //
+		////////////////////
+
+	private:
+
+		static RenderState* instance;
+
+	public:
+
+		static RenderState* getInstance();
+
+		/////////////
+		// Members //
+		/////////////
+
+	private:
+
+		// Marks state that has not been set through the cache yet
+		static const GLuint UNKNOWN = 0xFFFFFFFF;
+
+		GLuint program;
+
+		GLuint vertexArray;
+
+		GLuint activeUnit;
+
+		// Texture bound to each (unit, target)
+		std::map<std::pair<GLuint, GLenum>, GLuint> textures;
+
+		// Buffer bound to each target
+		std::map<GLenum, GLuint> buffers;
+
+		// Buffer bound to each indexed (target, index) binding point
+		std::map<std::pair<GLenum, GLuint>, GLuint> indexedBuffers;
+
+		// Range bound to each indexed binding point, size 0 for the whole buffer
+		std::map<std::pair<GLenum, GLuint>, std::pair<GLintptr, GLsizeiptr>> indexedRanges;
+
+		// Enabled capabilities
+		std::map<GLenum, bool> capabilities;
+
+		GLenum blendSource;
+
+		GLenum blendDestination;
+
+		GLenum cullMode;
+
+		GLenum frontFaceMode;
+
+		GLenum depthFunction;
+
+		GLuint depthWrite;
+
+		// Written color channels, all or none
+		GLuint colorWrite;
+
+		// Calls issued and skipped during the current and the last frame
+		unsigned int issued, avoided;
+
+		unsigned int lastIssued, lastAvoided;
+
+		//////////////////////////////////////////////
+		// Constructor								//
+		// Should only be used by the static method //
+		//////////////////////////////////////////////
+
+	private:
+
+		RenderState();
+
+		/**
+		* Counts the call and checks if it changes the state
+		*
+		* @param current the cached state, updated to the new value
+		* @param value the new state
+		* @return true if the GL call must be issued
+		*/
+		bool change(GLuint&, const GLuint);
+
+	public:
+
+		/**
+		* Forgets the whole cached state, so every next call is issued
+		* Use after code outside the engine changed the GL state
+		*/
+		void invalidate();
+
+		/**
+		* Ends the frame: keeps its counters for getIssued/getAvoided and resets them
+		*/
+		void endFrame();
+
+		void useProgram(const GLuint);
+
+		void bindVertexArray(const GLuint);
+
+		void activeTexture(const GLuint);
+
+		/**
+		* Binds a texture to the active texture unit (for uploads)
+		*
+		* @param target the texture target
+		* @param texture the texture id
+		*/
+		void bindTexture(const GLenum, const GLuint);
+
+		/**
+		* Binds a texture to the given texture unit
+		*
+		* @param unit the texture unit
+		* @param target the texture target
+		* @param texture the texture id
+		*/
+		void bindTexture(const GLuint, const GLenum, const GLuint);
+
+		void bindBuffer(const GLenum, const GLuint);
+
+		void bindBufferBase(const GLenum, const GLuint, const GLuint);
+
+		/**
+		* Binds a range of a buffer to an indexed binding point
+		*
+		* @param target the indexed target
+		* @param index the binding point
+		* @param buffer the buffer id
+		* @param offset the offset of the range in bytes
+		* @param size the size of the range in bytes
+		*/
+		void bindBufferRange(const GLenum, const GLuint, const GLuint, const GLintptr, const GLsizeiptr);
+
+		void enable(const GLenum);
+
+		void disable(const GLenum);
+
+		void blendFunc(const GLenum, const GLenum);
+
+		void cullFace(const GLenum);
+
+		void frontFace(const GLenum);
+
+		void depthFunc(const GLenum);
+
+		void depthMask(const GLboolean);
+
+		/**
+		* Enables or disables writes to every color channel
+		*
+		* @param flag GL_TRUE to write colors
+		*/
+		void colorMask(const GLboolean);
+
+		/**
+		* Drops the deleted objects from the cache, GL unbinds them on deletion
+		*/
+		void forgetProgram(const GLuint);
+
+		void forgetVertexArray(const GLuint);
+
+		void forgetTexture(const GLuint);
+
+		void forgetBuffer(const GLuint);
+
+		/**
+		* Gets the number of state calls issued to GL during the last frame
+		*
+		* @return the number of calls
+		*/
+		const unsigned int getIssued() const;
+
+		/**
+		* Gets the number of redundant state calls skipped during the last frame
+		*
+		* @return the number of calls
+		*/
+		const unsigned int getAvoided() const;
+
+	};
+
+}
@@ -0,0 +1,218 @@
+#pragma once
+#include <GL/glew.h>
+#include "camera/Camera.h"
+#include "maths/Matrix.h"
+#include "maths/Vector.h"
+
+namespace engine {
+
+	/**
+	* Cascaded shadow maps of a directional light
+	*
+	* The view range of the camera, up to the shadow distance, is split in
+	* cascades that get shorter close to the camera (the practical split
+	* scheme, a blend of logarithmic and uniform splits). Each cascade renders
+	* the bounding sphere of its slice of the camera frustum into one layer of
+	* a depth texture array: the sphere keeps the size of the cascade constant
+	* when the camera turns, and its origin is snapped to whole texels of the
+	* light view, depth included, so shadow edges do not shimmer when the
+	* camera moves and the cascade only changes once it moved by a texel.
+	*
+	* Every cascade has its own resolution budget. A cascade smaller than the
+	* layers renders into their corner, and the fragment shader scales its
+	* lookups by getScale.
+	*
+	* The depth of the static casters can be kept in a second texture array:
+	* storeCache copies a cascade there after its static casters are drawn,
+	* and restoreCache copies it back in later frames instead of drawing
+	* them again, as long as the light view projection of the cascade is
+	* unchanged. Needs glCopyImageSubData (GL 4.3 or ARB_copy_image).
+	*/
+	class ShadowCascades {
+
+	public:
+
+		static const int MAX_CASCADES = 4;
+
+	private:
+
+		GLuint texture = 0, framebuffer = 0;
+
+		// Static caster depth of each cascade, and the matrices it was drawn with
+		GLuint cacheTexture = 0;
+
+		bool cached[MAX_CASCADES];
+
+		Matrix4 cachedMatrices[MAX_CASCADES];
+
+		bool caching = true;
+
+		int count = 0;
+
+		// Side of the layers, the largest resolution budget
+		GLsizei size = 0;
+
+		GLsizei resolutions[MAX_CASCADES];
+
+		// 1 for logarithmic splits, 0 for uniform splits
+		float splitWeight = 0.75f;
+
+		// View depth past which nothing receives shadows
+		float maxDistance = 60.0f;
+
+		// Room kept towards the light for casters outside the slice of a cascade
+		float casterDistance = 50.0f;
+
+		// Far view depth of each cascade
+		float splits[MAX_CASCADES];
+
+		// Light view projection of each cascade
+		Matrix4 matrices[MAX_CASCADES];
+
+		// Set when the texture no longer matches the budgets
+		bool dirty = true;
+
+		/**
+		* (Re)allocates the depth texture array for the current cascades and budgets
+		*/
+		void allocate();
+
+	public:
+
+		/**
+		* Creates the cascades, the texture is allocated on the first bindLayer
+		*
+		* @param count the number of cascades, 1 to MAX_CASCADES
+		* @param resolution the resolution budget of every cascade
+		*/
+		ShadowCascades(const int, const GLsizei);
+
+		~ShadowCascades();
+
+		/**
+		* Sets the number of cascades
+		*
+		* @param count the number of cascades, clamped to 1 to MAX_CASCADES
+		*/
+		void setCascadeCount(const int);
+
+		const int getCascadeCount() const;
+
+		/**
+		* Sets the resolution budget of a cascade
+		*
+		* @param cascade the cascade
+		* @param resolution the side of the cascade, in texels
+		*/
+		void setResolution(const int, const GLsizei);
+
+		/**
+		* Sets the resolution budget of every cascade
+		*
+		* @param resolution the side of each cascade, in texels
+		*/
+		void setResolution(const GLsizei);
+
+		const GLsizei getResolution(const int) const;
+
+		/**
+		* Sets how far from the camera shadows are drawn
+		*
+		* @param distance the view depth of the end of the last cascade
+		*/
+		void setMaxDistance(const float);
+
+		/**
+		* Sets the split scheme
+		*
+		* @param weight 1 for logarithmic splits, 0 for uniform splits
+		*/
+		void setSplitWeight(const float);
+
+		/**
+		* Fits the cascades to the camera frustum
+		*
+		* @param camera the camera
+		* @param lightPos the position of the light, which looks at the origin
+		*/
+		void update(Camera*, const Vector3&);
+
+		/**
+		* Gets the light view projection of a cascade
+		*
+		* @param cascade the cascade
+		* @return the matrix, for the shadow pass and the lookups
+		*/
+		const Matrix4& getMatrix(const int) const;
+
+		/**
+		* Gets the far view depth of a cascade
+		*
+		* @param cascade the cascade
+		* @return the view depth where the next cascade starts
+		*/
+		const float getSplit(const int) const;
+
+		/**
+		* Gets the part of its layer a cascade uses
+		*
+		* @param cascade the cascade
+		* @return the resolution of the cascade over the size of the layers
+		*/
+		const float getScale(const int) const;
+
+		/**
+		* Binds the layer of a cascade as the depth attachment, with the viewport of its budget
+		* The depth is not cleared
+		*
+		* @param cascade the cascade
+		*/
+		void bindLayer(const int);
+
+		/**
+		* Gets the depth texture array, one layer per cascade
+		*
+		* @return the texture id, 0 before the first bindLayer
+		*/
+		const GLuint getTexture() const;
+
+		/**
+		* Checks if the context can copy between the shadow textures
+		*
+		* @return true on GL 4.3 or with ARB_copy_image
+		*/
+		static bool isCacheSupported();
+
+		/**
+		* Enables or disables the static caster cache
+		*
+		* @param enabled true to cache the static casters, if supported
+		*/
+		void setCaching(const bool);
+
+		const bool isCaching() const;
+
+		/**
+		* Forgets the cached static casters, to call when one of them or the light changes
+		*/
+		void invalidateCache();
+
+		/**
+		* Copies the static casters of a cascade from the cache to its bound layer
+		*
+		* @param cascade the cascade, bound with bindLayer
+		* @return false if the cache of the cascade is missing or stale, the layer must be drawn
+		*/
+		bool restoreCache(const int);
+
+		/**
+		* Copies the layer of a cascade to the cache, after its static casters are drawn
+		*
+		* @param cascade the cascade
+		* @return false if caching is disabled or not supported
+		*/
+		bool storeCache(const int);
+
+	};
+
+}
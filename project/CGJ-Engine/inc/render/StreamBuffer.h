@@ -0,0 +1,154 @@
+#pragma once
+#include <vector>
+#include <GL/glew.h>
+
+namespace engine {
+
+	/**
+	* Ring buffer for the data written every frame (camera, lights, instances, draws)
+	*
+	* The buffer is split in one region per frame in flight. Each frame bump
+	* allocates from its own region and fences it when done; a region is only
+	* written again once its fence signals, so the CPU never writes data the
+	* GPU is still reading and the driver never has to synchronize or copy.
+	*
+	* With ARB_buffer_storage the buffer is persistently and coherently mapped,
+	* allocations are written in place. Otherwise allocations are written to a
+	* CPU copy of the region, uploaded by flush(), and the buffer is orphaned
+	* whenever the ring wraps around.
+	*
+	* GL thread only.
+	*/
+	class StreamBuffer {
+
+		////////////////////
+		// Static members //
+		////////////////////
+
+	private:
+
+		static StreamBuffer* instance;
+
+	public:
+
+		static StreamBuffer* getInstance();
+
+		/**
+		* Part of the ring reserved by allocate()
+		*/
+		struct Allocation {
+			// Where to write the data, nullptr if the allocation failed
+			void* data;
+			// Offset of the data in the buffer, for binds and draw offsets
+			GLintptr offset;
+			GLsizeiptr size;
+
+			const bool isValid() const { return data != nullptr; }
+		};
+
+		/////////////
+		// Members //
+		/////////////
+
+	private:
+
+		static const int FRAMES = 3;
+
+		// Size of the region of each frame in bytes
+		static const GLsizeiptr FRAME_SIZE = 4 * 1024 * 1024;
+
+		GLuint BufferId = 0;
+
+		bool persistent;
+
+		// Persistent mapping of the whole buffer
+		unsigned char* mapped = nullptr;
+
+		// Fallback: CPU copy of the current region
+		std::vector<unsigned char> staging;
+
+		GLsync fences[FRAMES];
+
+		// Current region and bump pointer inside it
+		int frame = 0;
+
+		GLsizeiptr head = 0;
+
+		// Fallback: bytes of the current region already uploaded
+		GLsizeiptr flushed = 0;
+
+		GLint uniformAlignment = 256, storageAlignment = 256;
+
+		// Frames the CPU had to wait for the GPU to release a region
+		unsigned int waits = 0;
+
+		bool overflowReported = false;
+
+		//////////////////////////////////////////////
+		// Constructor								//
+		// Should only be used by the static method //
+		//////////////////////////////////////////////
+
+	private:
+
+		StreamBuffer();
+
+	public:
+
+		~StreamBuffer();
+
+		/**
+		* Starts a frame: waits until the GPU is done with the region of the frame
+		*/
+		void beginFrame();
+
+		/**
+		* Ends the frame: fences its region and moves to the next one
+		*/
+		void endFrame();
+
+		/**
+		* Reserves part of the current region
+		*
+		* @param size the size in bytes
+		* @param alignment the alignment of the offset in the buffer, in bytes
+		* @return the allocation, invalid if the region is full
+		*/
+		Allocation allocate(const GLsizeiptr, const GLsizeiptr);
+
+		/**
+		* Reserves part of the current region, aligned for glBindBufferRange(GL_UNIFORM_BUFFER)
+		*
+		* @param size the size in bytes
+		* @return the allocation, invalid if the region is full
+		*/
+		Allocation allocateUniform(const GLsizeiptr);
+
+		/**
+		* Reserves part of the current region, aligned for glBindBufferRange(GL_SHADER_STORAGE_BUFFER)
+		*
+		* @param size the size in bytes
+		* @return the allocation, invalid if the region is full
+		*/
+		Allocation allocateStorage(const GLsizeiptr);
+
+		/**
+		* Makes the allocations written since the last flush visible to GL
+		* Nothing to do with a persistent mapping, call it before drawing anyway
+		*/
+		void flush();
+
+		const GLuint getId() const;
+
+		const bool isPersistent() const;
+
+		/**
+		* Gets the number of frames that waited for the GPU to release their region
+		*
+		* @return the number of waits since the buffer was created
+		*/
+		const unsigned int getWaits() const;
+
+	};
+
+}
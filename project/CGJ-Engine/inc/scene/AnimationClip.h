@@ -0,0 +1,172 @@
+#pragma once
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace engine {
+
+	/**
+	* The transform of one animation target, a node or a joint
+	*/
+	struct ClipTransform {
+		float translation[3] = { 0.0f, 0.0f, 0.0f };
+		// x, y, z, w
+		float rotation[4] = { 0.0f, 0.0f, 0.0f, 1.0f };
+		float scale[3] = { 1.0f, 1.0f, 1.0f };
+	};
+
+	/**
+	* The channel of a target a curve animates
+	*/
+	enum class ClipChannel : uint8_t { TRANSLATION, ROTATION, SCALE };
+
+	/**
+	* Playback state of a clip, one per playing instance
+	* Remembers the key each curve was last sampled at, so sampling forward in time
+	* only steps over the keys passed since, O(1) amortized per curve
+	*/
+	struct ClipCursor {
+		std::vector<uint16_t> keys;
+	};
+
+	/**
+	* Keyframed translation, rotation and scale curves
+	*
+	* Curves are stored compressed, 8 bytes a key:
+	*  - key times are whole frames at the clip sample rate, in 16 bits
+	*  - translations and scales are quantized to 16 bits per component,
+	*    over the range of the curve
+	*  - rotations are stored as their three smallest components, 15 bits each,
+	*    the largest one is rebuilt from the unit length and its index takes
+	*    the remaining 2 bits
+	*
+	* compress() builds a clip from curves sampled at every frame, dropping the
+	* keys that interpolating their neighbours reproduces within a tolerance.
+	* Curves are sampled with linear interpolation and rotations with nlerp,
+	* which the key reduction accounts for.
+	*
+	* Clips are stored in a little endian binary file:
+	*  - "EXAC", version (uint32), sample rate (float), frames (uint32), curves (uint32)
+	*  - per curve: target (uint16), channel (uint8), padding (uint8), keys (uint32),
+	*    range minimum and extent (3 floats each, zeros for rotations),
+	*    then the frames (uint16 per key) and the values (3 uint16 per key)
+	*/
+	class AnimationClip {
+
+	public:
+
+		/**
+		* A curve sampled at every frame, the input of compress()
+		*/
+		struct RawCurve {
+			uint16_t target;
+			ClipChannel channel;
+			// 3 floats per frame, or 4 (x, y, z, w) for rotations
+			std::vector<float> values;
+		};
+
+	private:
+
+		static const uint32_t VERSION = 1;
+
+		struct Curve {
+			uint16_t target;
+			ClipChannel channel;
+			float minimum[3];
+			float extent[3];
+			std::vector<uint16_t> frames;
+			std::vector<uint16_t> values;
+		};
+
+		std::vector<Curve> curves;
+
+		float sampleRate = 30.0f;
+
+		// Frames of the clip, the last one is at (frames - 1) / sampleRate seconds
+		uint32_t frames = 0;
+
+		// Highest target index plus one
+		int targetCount = 0;
+
+		/**
+		* Packs a unit quaternion into its three smallest components
+		*/
+		static void encodeRotation(const float*, uint16_t*);
+
+		static void decodeRotation(const uint16_t*, float*);
+
+		/**
+		* Decodes the value of a key
+		*/
+		void decode(const Curve&, const size_t, float*) const;
+
+		/**
+		* Chooses the keys to keep from a curve sampled at every frame
+		*
+		* @param values the samples
+		* @param components 3, or 4 for rotations
+		* @param frameCount the number of samples
+		* @param tolerance the largest error allowed, in units or radians for rotations
+		* @return the frames of the kept keys, the first and last always among them
+		*/
+		static std::vector<uint16_t> reduceKeys(const float*, const int, const size_t, const float);
+
+	public:
+
+		/**
+		* Builds a compressed clip
+		*
+		* @param raw the curves, sampled at every frame, all with the same number of frames
+		* @param sampleRate the frames per second
+		* @param translationTolerance the largest translation and scale error kept
+		* @param rotationTolerance the largest rotation error kept, in radians
+		* @return the clip, nullptr if the curves are invalid
+		*/
+		static AnimationClip* compress(const std::vector<RawCurve>&, const float, const float = 0.001f, const float = 0.001f);
+
+		/**
+		* Loads a clip from a binary file
+		*
+		* @param path the file path
+		* @return the clip, nullptr if the file cannot be read or is not a clip
+		*/
+		static AnimationClip* loadFromFile(const std::string&);
+
+		/**
+		* Saves the clip to a binary file
+		*
+		* @param path the file path
+		* @return false if the file cannot be written
+		*/
+		bool saveToFile(const std::string&) const;
+
+		/**
+		* Samples every curve, writing the channels they animate
+		*
+		* @param time the time in seconds, clamped to the clip
+		* @param cursor the playback state of the instance, reset if it belongs to another clip
+		* @param out the transforms, getTargetCount() of them
+		*/
+		void sample(const float, ClipCursor&, ClipTransform*) const;
+
+		/**
+		* Gets the length of the clip
+		*
+		* @return the seconds from the first to the last frame
+		*/
+		const float getDuration() const;
+
+		const int getTargetCount() const;
+
+		const size_t getKeyCount() const;
+
+		/**
+		* Gets the memory the curves take
+		*
+		* @return the bytes of keys and ranges
+		*/
+		const size_t getMemoryUsage() const;
+
+	};
+
+}
@@ -0,0 +1,313 @@
+#pragma once
+#include <vector>
+#include "maths/Vector.h"
+#include "maths/Quaternion.h"
+#include "scene/SceneNode.h"
+#include "scene/AnimationClip.h"
+#include "scene/Skin.h"
+
+namespace engine {
+
+	/**
+	* Easing curves of a track, applied to its normalized time
+	*/
+	enum class Easing { LINEAR, EASE_IN, EASE_OUT, EASE_IN_OUT, EASE_IN_CUBIC, EASE_OUT_CUBIC };
+
+	/**
+	* Animates the position, rotation and scale of scene nodes
+	*
+	* Every active track lives in contiguous arrays, one per component (struct
+	* of arrays), with translations, scales and rotations kept apart. update()
+	* advances them all by the real time elapsed, so animations take the same
+	* time at any frame rate, and evaluates them in batches: every easing curve
+	* is a cubic polynomial, so the curves of a batch are computed without
+	* branching, then positions and scales are blended linearly and rotations
+	* with Quaternion::fastSlerp, 4 at a time. The results are written
+	* straight into the transform of the nodes.
+	*
+	* Keyframed clips play the same way: every instance only keeps its clip,
+	* time and sampling cursor, the compressed curves are shared, and each
+	* update samples the clip straight into the node transform.
+	*
+	* Clips played on a Skin animate its joints: each update samples the pose
+	* of every skin and computes its palette, one skin per task. Then the skins
+	* with CPU skinning are deformed, their vertices split in chunks spread
+	* over the workers.
+	*
+	* A node is a dynamic shadow caster while it has a track or a clip, so
+	* its shadow is not frozen in the cached static casters.
+	*
+	* Large batches can be split over the AssetLoader workers. A node has at
+	* most one track per channel and one clip: animating a channel again starts
+	* a new track from its current value, playing a clip replaces the previous one.
+	*/
+	class AnimationSystem {
+
+		////////////////////
+		// Static members //
+		////////////////////
+
+	private:
+
+		static AnimationSystem* instance;
+
+	public:
+
+		static AnimationSystem* getInstance();
+
+		/////////////
+		// Members //
+		/////////////
+
+	private:
+
+		// Tracks evaluated per task when running in parallel
+		static const size_t BATCH = 1024;
+
+		// Skins posed per task, and vertices deformed per task
+		static const size_t SKIN_BATCH = 4, VERTEX_BATCH = 4096;
+
+		/**
+		* Easing coefficients and timing shared by every kind of track
+		*/
+		struct Timing {
+			std::vector<float> elapsed, inverseDuration;
+			// eased = ((a * t + b) * t + c) * t
+			std::vector<float> curveA, curveB, curveC;
+			// Filled by evaluate, the eased time of each track
+			std::vector<float> weights;
+
+			void push(const float, const Easing);
+			void remove(const size_t);
+		};
+
+		/**
+		* Tracks blending a Vector3 (positions and scales)
+		*/
+		struct VectorTracks {
+			Timing timing;
+			std::vector<float> fromX, fromY, fromZ, toX, toY, toZ;
+			std::vector<Vector3*> targets;
+			// Node of each target, counted as animated while the track runs
+			std::vector<SceneNode*> nodes;
+
+			const size_t size() const { return targets.size(); }
+		};
+
+		/**
+		* Tracks blending a rotation, the end rotation is kept on the hemisphere of the start one
+		*/
+		struct RotationTracks {
+			Timing timing;
+			// Packed quaternions, interpolated in batches
+			std::vector<Quaternion> from, to;
+			std::vector<Quaternion*> targets;
+			std::vector<SceneNode*> nodes;
+
+			const size_t size() const { return targets.size(); }
+		};
+
+		/**
+		* Clips playing on nodes
+		*/
+		struct ClipInstances {
+			std::vector<const AnimationClip*> clips;
+			std::vector<SceneNode*> nodes;
+			std::vector<float> times, speeds;
+			std::vector<uint8_t> loops;
+			std::vector<ClipCursor> cursors;
+
+			const size_t size() const { return nodes.size(); }
+		};
+
+		/**
+		* Clips playing on skins
+		*/
+		struct SkinInstances {
+			std::vector<const AnimationClip*> clips;
+			std::vector<Skin*> skins;
+			std::vector<float> times, speeds;
+			std::vector<uint8_t> loops;
+			std::vector<ClipCursor> cursors;
+
+			const size_t size() const { return skins.size(); }
+		};
+
+		/**
+		* Range of vertices of a skin to deform
+		*/
+		struct VertexBatch {
+			Skin* skin;
+			size_t first, last;
+		};
+
+		VectorTracks translations, scales;
+
+		RotationTracks rotations;
+
+		ClipInstances clips;
+
+		SkinInstances skins;
+
+		// Filled by every update, reused to avoid allocating
+		std::vector<VertexBatch> vertexBatches;
+
+		bool parallel = true;
+
+		//////////////////////////////////////////////
+		// Constructor								//
+		// Should only be used by the static method //
+		//////////////////////////////////////////////
+
+	private:
+
+		AnimationSystem();
+
+		/**
+		* Advances the tracks and computes their eased weights
+		*
+		* @param timing the tracks
+		* @param first the first track of the batch
+		* @param last one past the last track of the batch
+		* @param deltaTime the seconds elapsed
+		*/
+		static void advance(Timing&, const size_t, const size_t, const float);
+
+		static void evaluate(VectorTracks&, const size_t, const size_t);
+
+		static void evaluate(RotationTracks&, const size_t, const size_t);
+
+		/**
+		* Advances the clip instances and samples them into their nodes
+		*
+		* @param instances the instances
+		* @param first the first instance of the batch
+		* @param last one past the last instance of the batch
+		* @param deltaTime the seconds elapsed
+		*/
+		static void evaluate(ClipInstances&, const size_t, const size_t, const float);
+
+		/**
+		* Advances the skin instances, samples their pose and computes their palette
+		*/
+		static void evaluate(SkinInstances&, const size_t, const size_t, const float);
+
+		/**
+		* Drops the tracks that reached their end, moving the last ones into their place
+		*/
+		static void removeFinished(VectorTracks&);
+
+		static void removeFinished(RotationTracks&);
+
+		static void removeFinished(ClipInstances&);
+
+		static void removeClip(ClipInstances&, const SceneNode*);
+
+		static void removeFinished(SkinInstances&);
+
+		static void removeClip(SkinInstances&, const Skin*);
+
+		static void removeTarget(VectorTracks&, const Vector3*);
+
+		static void removeTarget(RotationTracks&, const Quaternion*);
+
+		static void addTrack(VectorTracks&, SceneNode*, Vector3*, const Vector3&, const float, const Easing);
+
+		/**
+		* Runs a batch evaluation over every track, in parallel if enabled and worth it
+		*
+		* @param count the number of tracks
+		* @param batch the evaluation of a range of tracks
+		* @param size the tracks per range
+		*/
+		template<typename F>
+		void forEachBatch(const size_t, F, const size_t = BATCH);
+
+	public:
+
+		/**
+		* Moves a node from its current position
+		*
+		* @param node the node
+		* @param position the position to reach
+		* @param duration the seconds it takes
+		* @param easing the easing curve
+		*/
+		void moveTo(SceneNode*, const Vector3&, const float, const Easing = Easing::EASE_IN_OUT);
+
+		/**
+		* Rotates a node from its current rotation, along the shortest arc
+		*
+		* @param node the node
+		* @param rotation the rotation to reach
+		* @param duration the seconds it takes
+		* @param easing the easing curve
+		*/
+		void rotateTo(SceneNode*, const Quaternion&, const float, const Easing = Easing::EASE_IN_OUT);
+
+		/**
+		* Scales a node from its current scale
+		*
+		* @param node the node
+		* @param scale the scale to reach
+		* @param duration the seconds it takes
+		* @param easing the easing curve
+		*/
+		void scaleTo(SceneNode*, const Vector3&, const float, const Easing = Easing::EASE_IN_OUT);
+
+		/**
+		* Plays a clip on a node, its first target animating the node
+		*
+		* @param node the node
+		* @param clip the clip, which must outlive its playback
+		* @param loop whether the clip starts over when it ends, otherwise it stops at its end
+		* @param speed the playback rate, negative to play backwards
+		*/
+		void play(SceneNode*, const AnimationClip*, const bool = true, const float = 1.0f);
+
+		/**
+		* Plays a clip on a skin, each target animating the joint with its index
+		*
+		* @param skin the skin
+		* @param clip the clip, which must outlive its playback
+		* @param loop whether the clip starts over when it ends, otherwise it stops at its end
+		* @param speed the playback rate, negative to play backwards
+		*/
+		void play(Skin*, const AnimationClip*, const bool = true, const float = 1.0f);
+
+		/**
+		* Stops the clip of a skin, leaving it in its current pose
+		*
+		* @param skin the skin
+		*/
+		void stop(Skin*);
+
+		/**
+		* Stops every track and clip of a node, leaving it where it is
+		*
+		* @param node the node
+		*/
+		void stop(SceneNode*);
+
+		/**
+		* Advances every track and writes the results into the nodes
+		*
+		* @param deltaTime the seconds since the previous update
+		*/
+		void update(const float);
+
+		void setParallel(const bool);
+
+		const size_t getTrackCount() const;
+
+		/**
+		* Deforms the vertices of the skins with CPU skinning, in chunks spread over the workers
+		* update() ends with it for the skins playing a clip
+		*
+		* @param skins the skins, those without CPU skinning are skipped
+		*/
+		void skinVertices(const std::vector<Skin*>&);
+
+	};
+
+}
@@ -2,6 +2,7 @@
 #include "Drawable.h"
 #include "camera/Camera.h"
 #include "scene/SceneNode.h"
+#include "render/RenderQueue.h"
 
 namespace engine {
 
@@ -14,6 +15,25 @@ namespace engine {
 
 		SceneNode* root = NULL;
 
+		RenderQueue queue;
+
+		// Draws the opaque depth before the main pass, so the main pass shades each pixel once
+		bool depthPrepass = false;
+
+		// GL_SAMPLES_PASSED queries of the main pass, alternated so reading one never waits
+		GLuint sampleQueries[2] = { 0, 0 };
+
+		unsigned int frame = 0;
+
+		GLuint shadedSamples = 0;
+
+		/**
+		* Draws the depth of the opaque nodes with the DEPTH_ONLY depth program
+		*
+		* @return true if the depth buffer holds the pre-pass
+		*/
+		bool drawDepthPrepass();
+
 	public:
 
 		SceneGraph();
@@ -25,6 +45,38 @@ namespace engine {
 
 		SceneNode* createNode();
 
+		/**
+		* Gets the render queue of the last pass drawn
+		*
+		* @return the render queue
+		*/
+		const RenderQueue& getRenderQueue() const;
+
+		/**
+		* Gets the render queue, to change how it submits
+		*
+		* @return the render queue
+		*/
+		RenderQueue& getRenderQueue();
+
+		/**
+		* Enables or disables the depth pre-pass of the main pass
+		* The pre-pass uses the shadow shader program of the root node
+		*
+		* @param enabled true to draw the opaque depth first
+		*/
+		void setDepthPrepass(const bool);
+
+		const bool isDepthPrepass() const;
+
+		/**
+		* Gets the samples that passed the depth test in the main pass, a frame or two late
+		* With the pre-pass these are the fragments shaded once each
+		*
+		* @return the sample count of the last finished query
+		*/
+		const GLuint getShadedSamples() const;
+
 		////////////////////////////////////////////////
 		// Drawable - @see Drawable.h for definitions //
 		////////////////////////////////////////////////
@@ -32,7 +84,15 @@ namespace engine {
 	public:
 
 		void draw() override;
-		void drawDepthMap(engine::ShaderProgram* shader);
+
+		/**
+		* Draws the shadow casters that intersect a light frustum
+		*
+		* @param shader the depth shader program
+		* @param lightSpace the light view projection of the shadow map being drawn
+		* @param casters the casters to draw, static ones can be drawn once and cached
+		*/
+		void drawDepthMap(engine::ShaderProgram* shader, const Matrix4& lightSpace, const ShadowCasters casters = ShadowCasters::ALL);
 
 	};
 
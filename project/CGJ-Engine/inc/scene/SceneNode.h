@@ -9,6 +9,10 @@
 #include "textures/Texture.h"
 #include "textures/Material.h"
 #include "textures/PerlinTexture.h"
+#include "textures/TextureArray.h"
+#include "textures/VirtualTexture.h"
+#include "scene/Skin.h"
+#include "render/RenderQueue.h"
 #include <vector>
 
 namespace engine {
@@ -17,6 +21,12 @@ namespace engine {
 
 	class RigidBody;
 
+	/**
+	* Shadow casters emitted by SceneNode::collectCasters
+	* Dynamic casters have a RigidBody with mass, are marked as dynamic, or have a dynamic ancestor
+	*/
+	enum class ShadowCasters { ALL, STATIC, DYNAMIC };
+
 	class SceneNode : public Drawable {
 
 	private:
@@ -34,12 +44,37 @@ namespace engine {
 		Mesh* mesh;
 		Mesh* shadowMesh;
 
+		// Per-instance color, meshes are shared between nodes
+		Vertex color = { 1.0f, 1.0f, 1.0f, 1.0f };
+
 		Texture* texture;
 
 		PerlinTexture* perlinTexture;
 
+		// Packed texture, shared between nodes that only differ by their layer
+		TextureArray* textureArray;
+
+		int textureLayer;
+
+		// Streamed procedural texture, takes the place of the other textures
+		VirtualTexture* virtualTexture;
+
+		// Pose of a skinned mesh, deforms the mesh in every pass
+		Skin* skin;
+
 		Material* material;
 
+		bool receiveShadows;
+
+		// Moved by something else than a RigidBody with mass, so its shadow cannot be cached
+		bool dynamicCaster;
+
+		// Tracks and clips of the AnimationSystem moving this node
+		int animations;
+
+		// Incremented whenever a node starts or stops being a dynamic caster on its own
+		static unsigned int casterVersion;
+
 		ShaderProgram* shaderProgram;
 		ShaderProgram* shadowShaderProgram;
 
@@ -49,7 +84,22 @@ namespace engine {
 
 		std::vector<SceneNodeComponent*> components;
 
-		Matrix4* getMatrix() const;
+		/**
+		* Composes the local transform of this node
+		*
+		* @param rotation the rotation of this node as a matrix
+		* @return the local matrix, translated, rotated and scaled
+		*/
+		const Matrix4 getMatrix(const Matrix4&) const;
+
+		const Matrix4 getMatrix() const;
+
+		void updateWorldMatrix(const Matrix4&);
+
+		/**
+		* Updates the world matrices of the children, their rotations converted in one batch
+		*/
+		void updateChildMatrices();
 
 	protected:
 
@@ -88,6 +138,19 @@ namespace engine {
 		virtual void setMesh(Mesh*);
 		void setShadowMesh(Mesh*);
 
+		Mesh* getShadowMesh() const;
+
+		/**
+		* Gets the mesh of the depth only passes
+		*
+		* @return the position only shadow mesh, or the mesh itself if the node has none
+		*/
+		Mesh* getDepthMesh() const;
+
+		const Vertex getColor() const;
+
+		void setColor(Vertex);
+
 		Texture* getTexture() const;
 
 		void setTexture(Texture*);
@@ -96,6 +159,33 @@ namespace engine {
 
 		void setPerlinTexture(PerlinTexture*);
 
+		TextureArray* getTextureArray() const;
+
+		const int getTextureLayer() const;
+
+		void setTextureLayer(TextureArray*, int);
+
+		VirtualTexture* getVirtualTexture() const;
+
+		void setVirtualTexture(VirtualTexture*);
+
+		/**
+		* Gets the texture object the main pass samples, whichever kind it is
+		*
+		* @return the virtual texture, texture array, texture or Perlin texture, nullptr for none
+		*/
+		const void* getDrawTexture() const;
+
+		Skin* getSkin() const;
+
+		/**
+		* Skins the mesh of this node: drawn with the SKINNED permutations, and its
+		* shadow taken from the CPU skinned vertices if the skin has them
+		*
+		* @param skin the pose, of the mesh of this node
+		*/
+		void setSkin(Skin*);
+
 		Material* getMaterial() const;
 
 		void setMaterial(Material*);
@@ -103,6 +193,61 @@ namespace engine {
 		ShaderProgram* getShaderProgram() const;
 		ShaderProgram* getShadowShaderProgram() const;
 
+		const bool getReceiveShadows() const;
+
+		void setReceiveShadows(const bool);
+
+		/**
+		* Checks if the node moves, so its shadow is drawn every frame
+		*
+		* @return true if marked as dynamic, skinned, animated, or if its RigidBody has mass
+		*/
+		const bool isDynamicCaster() const;
+
+		/**
+		* Marks the node as moving even without a RigidBody with mass
+		*
+		* @param dynamic true to draw its shadow every frame
+		*/
+		void setDynamicCaster(const bool);
+
+		/**
+		* Counts the animations moving this node, it is a dynamic caster while it has any
+		* Called by the AnimationSystem when a track or clip starts (1) and ends (-1)
+		*
+		* @param count the animations started, or ended if negative
+		*/
+		void addAnimations(const int);
+
+		/**
+		* Gets the version of the shadow casters: cached static shadows are stale once it changes,
+		* they may hold a node that now moves, or miss one that stopped or whose mesh just loaded
+		*
+		* @return the version
+		*/
+		static const unsigned int getCasterVersion();
+
+		/**
+		* Changes the caster version, for casters whose shadow changes without moving:
+		* a mesh still streaming in is skipped by the depth passes until it is uploaded
+		*/
+		static void invalidateCasters();
+
+		/**
+		* Gets the shader permutation features this node needs: its material type,
+		* whether it has a texture, whether it receives shadows and whether it is skinned
+		*
+		* @return the feature set (@see ShaderProgram)
+		*/
+		const unsigned int getShaderFeatures() const;
+
+		/**
+		* Gets the permutation of the shader program that draws this node
+		*
+		* @return the permutation, the shader program itself if it has none
+		*/
+		ShaderProgram* getDrawProgram() const;
+
 		void setShaderProgram(ShaderProgram*);
 		void setShadowShaderProgram(ShaderProgram*);
 
@@ -118,12 +263,43 @@ namespace engine {
 
 		void addForce(Vector3);
 
+		/**
+		* Updates the world matrices of the subtree and emits its draw packets
+		*
+		* @param queue the render queue
+		* @param pass the camera pass to emit packets for, MAIN or DEPTH
+		* @param view the camera view matrix, for the depth part of the keys
+		*/
+		void collect(RenderQueue&, const RenderPass, const Matrix4&);
+
+		/**
+		* Updates the world matrices of the subtree and emits the shadow pass packets
+		* of its opaque casters that intersect a light frustum
+		*
+		* @param queue the render queue
+		* @param lightSpace the light view projection to cull against
+		* @param casters the casters to emit
+		* @param dynamic true if an ancestor of the subtree is a dynamic caster
+		*/
+		void collectCasters(RenderQueue&, const Matrix4&, const ShadowCasters, const bool = false);
+
+		/**
+		* Uses the program and binds the textures and material of this node,
+		* everything but the per-instance uniforms
+		*
+		* @param program the program to draw with
+		*/
+		void bindDrawState(ShaderProgram*) const;
+
 		////////////////////////////////////////////////
 		// Drawable - @see Drawable.h for definitions //
 		////////////////////////////////////////////////
 
 	public:
 
+		/**
+		* Draws this node only, its children are drawn through their own packets
+		*/
 		void draw() override;
 		void drawShadow(engine::ShaderProgram* shader) const;
 
@@ -0,0 +1,121 @@
+#pragma once
+#include <string>
+#include <vector>
+#include "maths/Quaternion.h"
+#include "mesh/Mesh.h"
+#include "scene/AnimationClip.h"
+
+namespace engine {
+
+	/**
+	* Affine transform of a joint, the first three rows of a 4x4 matrix
+	* Also the layout of a joint in the SkinBlock of the shaders
+	*/
+	struct JointMatrix {
+		float rows[3][4];
+	};
+
+	/**
+	* Joint hierarchy of a skinned mesh
+	*
+	* Joints are stored parents first, so a pose is evaluated in a single pass:
+	* each joint transform (a ClipTransform, relative to its parent) is turned
+	* into an affine matrix and multiplied by the model transform of its parent.
+	* The palette of a pose holds, for every joint, its model transform times the
+	* inverse of its bind transform, which takes a vertex from the bind pose to
+	* the animated pose.
+	*
+	* Joint indices are the targets of the AnimationClip curves that animate the
+	* skeleton. A skeleton is shared by every Skin of its mesh.
+	*/
+	class Skeleton {
+
+	public:
+
+		// Joints addressed by the skin weights
+		static const int MAX_JOINTS = 256;
+
+	private:
+
+		std::vector<std::string> names;
+
+		// Parent of every joint, -1 for the roots
+		std::vector<int> parents;
+
+		// Joint transforms relative to their parent, in the bind pose
+		std::vector<ClipTransform> bindPose;
+
+		std::vector<JointMatrix> inverseBind;
+
+	public:
+
+		/**
+		* Adds a joint after its parent
+		*
+		* @param name the joint name
+		* @param parent the index of the parent joint, -1 for a root
+		* @param bind the transform of the joint relative to its parent, in the bind pose
+		* @return the index of the joint, -1 if the parent is not a joint yet or the skeleton is full
+		*/
+		const int addJoint(const std::string&, const int, const ClipTransform&);
+
+		/**
+		* Finds a joint by name
+		*
+		* @param name the joint name
+		* @return the index of the joint, -1 if the skeleton has none with that name
+		*/
+		const int findJoint(const std::string&) const;
+
+		const int getJointCount() const;
+
+		const int getParent(const int) const;
+
+		const std::vector<ClipTransform>& getBindPose() const;
+
+		/**
+		* Computes the palette of a pose
+		*
+		* @param pose the transform of every joint relative to its parent
+		* @param model the model transform of every joint, getJointCount() of them
+		* @param palette the skinning matrix of every joint, getJointCount() of them
+		*/
+		void computePalette(const ClipTransform*, JointMatrix*, JointMatrix*) const;
+
+		/**
+		* Binds the vertices of a mesh to the nearest bones, for meshes without
+		* authored weights: each vertex takes its 4 nearest bones (from a joint to
+		* its first child), weighted by their inverse squared distance
+		*
+		* @param vertices the vertices, in the bind pose
+		* @param falloff the distance at which a bone weighs half as much as a touching one
+		* @return the influences, one per vertex
+		*/
+		std::vector<SkinWeights> computeSkinWeights(const std::vector<Vertex>&, const float) const;
+
+		/**
+		* Builds the affine matrix of a transform, translation * rotation * scale
+		* The rotation is the matrix of Quaternion, so a clip turns a joint the way it turns a node
+		*/
+		static JointMatrix toMatrix(const ClipTransform&);
+
+		/**
+		* Multiplies two affine matrices
+		*
+		* @param a the left matrix
+		* @param b the right matrix
+		* @param out a * b, which may not be a or b
+		*/
+		static void multiply(const JointMatrix&, const JointMatrix&, JointMatrix&);
+
+		/**
+		* Inverts an affine matrix
+		*
+		* @param m the matrix
+		* @param out the inverse, identity if m is singular
+		*/
+		static void invert(const JointMatrix&, JointMatrix&);
+
+	};
+
+}
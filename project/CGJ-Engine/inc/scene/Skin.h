@@ -0,0 +1,141 @@
+#pragma once
+#include <vector>
+#include "mesh/Mesh.h"
+#include "scene/Skeleton.h"
+
+namespace engine {
+
+	/**
+	* Pose of a skinned mesh, one per animated instance
+	*
+	* The pose (a transform per joint, usually sampled from an AnimationClip
+	* by the AnimationSystem) is turned into a joint palette, which the mesh
+	* can be deformed with in two ways:
+	*  - on the GPU: the SKINNED shader permutations read the palette from the
+	*    SkinBlock storage block, bound by bind() before each draw
+	*  - on the CPU: skinVertices() deforms ranges of the bind pose vertices
+	*    with SSE, from any thread, into vertices that colliders can query and
+	*    that getPosedMesh() uploads as the shadow mesh of the instance
+	*
+	* The skeleton and the mesh are shared, and must outlive the skin.
+	*/
+	class Skin {
+
+	private:
+
+		const Skeleton* skeleton;
+
+		Mesh* mesh;
+
+		std::vector<ClipTransform> pose;
+
+		// Model transform of each joint, and the palette
+		std::vector<JointMatrix> joints, palette;
+
+		// Incremented by every new palette
+		unsigned int poseVersion = 0;
+
+		bool cpuSkinning = false;
+
+		std::vector<Vertex> bindVertices, skinnedVertices;
+
+		// Position only mesh of the CPU skinned vertices, and the palette it was uploaded with
+		Mesh* posedMesh = nullptr;
+
+		unsigned int posedVersion = 0;
+
+	public:
+
+		/**
+		* Creates a skin in the bind pose
+		*
+		* @param skeleton the joint hierarchy
+		* @param mesh the skinned mesh, its joint influences already set
+		*/
+		Skin(const Skeleton*, Mesh*);
+
+		~Skin();
+
+		const Skeleton* getSkeleton() const;
+
+		Mesh* getMesh() const;
+
+		/**
+		* Gets the pose to animate, the transform of every joint relative to its parent
+		* updatePalette() must be called once it is modified
+		*
+		* @return the pose
+		*/
+		std::vector<ClipTransform>& getPose();
+
+		/**
+		* Computes the palette of the current pose
+		*/
+		void updatePalette();
+
+		const std::vector<JointMatrix>& getPalette() const;
+
+		/**
+		* Gets the model transform of every joint in the current pose, to attach things to them
+		*
+		* @return the transforms, in mesh space
+		*/
+		const std::vector<JointMatrix>& getJointTransforms() const;
+
+		/**
+		* Enables the CPU skinned vertices, for the shadow passes and colliders
+		*
+		* @param enabled true to keep a copy of the bind pose and deform it every update
+		*/
+		void setCpuSkinning(const bool);
+
+		const bool isCpuSkinning() const;
+
+		const size_t getVertexCount() const;
+
+		/**
+		* Deforms a range of vertices with the current palette
+		* Disjoint ranges can be deformed on different threads
+		*
+		* @param first the first vertex
+		* @param last one past the last vertex
+		*/
+		void skinVertices(const size_t, const size_t);
+
+		/**
+		* Gets the vertices deformed by skinVertices()
+		*
+		* @return the vertices, in mesh space, empty without CPU skinning
+		*/
+		const std::vector<Vertex>& getSkinnedVertices() const;
+
+		/**
+		* Gets the mesh of the CPU skinned vertices, uploading them if the pose changed (GL thread only)
+		*
+		* @return the mesh, nullptr without CPU skinning or if the mesh is not loaded
+		*/
+		Mesh* getPosedMesh();
+
+		/**
+		* Writes the palette to the stream buffer and binds it to the SkinBlock (GL thread only)
+		*
+		* @param binding the binding point of the SkinBlock
+		* @return false if the stream buffer is full
+		*/
+		const bool bind(const GLuint) const;
+
+		/**
+		* Deforms vertices with a palette, blending the rows of the joint matrices
+		* of each vertex before transforming it
+		*
+		* @param vertices the vertices in the bind pose
+		* @param weights the joint influences of each vertex
+		* @param palette the palette
+		* @param out the deformed vertices
+		* @param count the number of vertices
+		*/
+		static void skin(const Vertex*, const SkinWeights*, const JointMatrix*, Vertex*, const size_t);
+
+	};
+
+}
@@ -0,0 +1,84 @@
+#pragma once
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "GL/glew.h"
+
+namespace engine {
+
+	/**
+	* On disk cache of linked program binaries
+	*
+	* Programs are stored with glGetProgramBinary under a hash of their
+	* sources (defines included, they are injected into the sources) and of
+	* the driver vendor, renderer and version strings. A driver update or a
+	* shader edit changes the key; a binary the driver rejects anyway is
+	* compiled from source again and overwritten.
+	*/
+	class ShaderCache {
+
+	private:
+
+		static std::string directory;
+
+		/**
+		* Gets the path of the binary stored under a key
+		*
+		* @param key the program key
+		* @return the file path
+		*/
+		static std::string getPath(const uint64_t);
+
+		/**
+		* Creates the cache directory if needed
+		*
+		* @return true if the directory exists
+		*/
+		static bool createDirectory();
+
+	public:
+
+		/**
+		* Checks if the driver can retrieve and load program binaries
+		*
+		* @return true if ARB_get_program_binary is supported with at least one format
+		*/
+		static bool isSupported();
+
+		/**
+		* Sets the directory of the cache, relative to the working directory
+		*
+		* @param directory the directory
+		*/
+		static void setDirectory(const std::string&);
+
+		/**
+		* Builds the key of a program
+		*
+		* @param sources the shader sources, defines included, and anything else fixed at link time
+		* @param kind the kind of program, programs of different kinds bind different attributes
+		* @return the 64 bit FNV-1a hash of the sources and the driver strings
+		*/
+		static uint64_t makeKey(const std::vector<std::string>&, const int);
+
+		/**
+		* Loads a cached binary into a program
+		*
+		* @param program the program id
+		* @param key the program key
+		* @return true if the program is linked from the cache, false to compile it
+		*/
+		static bool load(const GLuint, const uint64_t);
+
+		/**
+		* Stores the binary of a linked program
+		* The program must have been linked with GL_PROGRAM_BINARY_RETRIEVABLE_HINT set
+		*
+		* @param program the program id
+		* @param key the program key
+		*/
+		static void save(const GLuint, const uint64_t);
+
+	};
+
+}
@@ -1,8 +1,10 @@
 #pragma once
+#include <cstdint>
 #include <fstream>
 #include <vector>
 #include <map>
 #include <string>
+#include <unordered_map>
 #include "GL/glew.h"
 
 namespace engine {
@@ -10,24 +12,114 @@ namespace engine {
 	/**
 	* Shader program class
 	*
+	* Programs created from files keep their sources, and build permutations
+	* of themselves on demand: the same sources compiled with a set of
+	* #define features, cached by feature set.
+	*
+	* Programs created with fromFiles also remember their paths and the files
+	* they #include, so they can be reloaded while the engine runs (see
+	* ShaderWatcher). A reload links new program objects first and only swaps
+	* them in, base and permutations together, when all of them link.
 	*/
 	class ShaderProgram {
 
+	public:
+
+		/**
+		* Permutation features
+		* The material type takes MATERIAL_BITS bits from MATERIAL_SHIFT, stored as
+		* type + 1; 0 keeps the runtime branch on material.type
+		* DEPTH_ONLY turns a depth program into the camera depth pre-pass one
+		* VIRTUAL_TEXTURE samples a VirtualTexture instead of the node textures
+		* SKINNED deforms the vertices with the joint palette of the SkinBlock
+		*/
+		static const unsigned int INSTANCED = 1 << 0, INDIRECT = 1 << 1, NO_SHADOWS = 1 << 2, NO_TEXTURE = 1 << 3;
+
+		static const unsigned int DEPTH_ONLY = 1 << 7, VIRTUAL_TEXTURE = 1 << 8, SKINNED = 1 << 9;
+
+		static const unsigned int MATERIAL_SHIFT = 4, MATERIAL_BITS = 3;
+
 	private:
 
 		GLuint ProgramId = 0;
 		float isShadowShader = 0;
 
-		std::map<std::string, GLuint> uniforms;
+		// Locations of every active uniform, reflected at link time
+		std::unordered_map<std::string, GLint> uniforms;
+
+		// Indices of every active uniform block, reflected at link time
+		std::unordered_map<std::string, GLuint> uniformBlocks;
 
 		const std::map<std::string, const int> bindings = {
 			{ "VERTICES",	0 },
 			{ "COLORS",		1 },
 			{ "TEX_COORDS",	2 },
 			{ "NORMALS",	3 },
-			{ "UBO_BP",		0 }
+			{ "INSTANCE_MATRIX",	4 },
+			{ "INSTANCE_COLOR",	8 },
+			{ "INSTANCE_LAYER",	9 },
+			{ "DRAW_ID",	10 },
+			{ "JOINTS",		11 },
+			{ "WEIGHTS",	12 },
+			{ "UBO_BP",		0 },
+			{ "MATERIAL_BP",	1 },
+			{ "DRAW_BP",	2 },
+			{ "FRAME_BP",	3 },
+			{ "CASCADE_BP",	4 },
+			{ "SKIN_BP",	5 }
 		};
 
+		// Sources the program was created from, empty if it cannot build permutations
+		std::string vertexSource, fragmentSource;
+
+		// Features of this permutation, and the program it was built from
+		unsigned int features = 0;
+
+		ShaderProgram* base = nullptr;
+
+		// Permutations built so far, by feature set (owned by the base program)
+		std::unordered_map<unsigned int, ShaderProgram*> variants;
+
+		/**
+		* Gets the #define lines of a feature set
+		*
+		* @param features the feature set
+		* @return the names to define
+		*/
+		static std::vector<std::string> getDefines(const unsigned int);
+
+		// Key of the program in the binary cache
+		uint64_t cacheKey = 0;
+
+		// Result of the last link, or of the binary cache load
+		bool linked = false;
+
+		// Files of a program created with fromFiles, #included files first
+		std::string vertexPath, fragmentPath;
+
+		std::vector<std::string> dependencies;
+
+		static const int MAX_INCLUDE_DEPTH = 16;
+
+		/**
+		* Reads a shader file, replacing #include "file" lines with the file contents
+		* Included paths are relative to the including file
+		*
+		* @param path the file path
+		* @param source the expanded source
+		* @param dependencies the files read, appended to
+		* @param depth the include depth
+		* @return false if a file cannot be read or an #include is malformed
+		*/
+		static bool readSource(const std::string&, std::string&, std::vector<std::string>&, const int depth = 0);
+
+		/**
+		* Exchanges the GL program and its reflection with another program
+		*
+		* @param other the program to swap with
+		*/
+		void swapProgram(ShaderProgram&);
+
 		void Init(const char*, const char*);
 		void InitShadow(const char*, const char*);
 		void InitSkyBox(const char*, const char*);
@@ -48,15 +140,61 @@ namespace engine {
 		*/
 		const GLuint checkLinkage() const;
 
-		void insertUniform(const char*);
+		/**
+		* Creates the program object, linking it from the binary cache when possible
+		*
+		* @param vertexShader the vertex shader source
+		* @param fragmentShader the fragment shader source
+		* @return true if the program was loaded from the cache and is ready to use
+		*/
+		const bool createProgram(const char*, const char*);
+
+		/**
+		* Writes the binding points in name order, part of the cache key:
+		* attribute locations are fixed in the binary at link time
+		*
+		* @return the bindings, as NAME=point pairs
+		*/
+		const std::string getBindingKey() const;
+
+		/**
+		* Links the attached shaders, stores the binary in the cache and reflects the program
+		*/
+		void link();
+
+		/**
+		* Reflects the active uniforms and uniform blocks of the linked program,
+		* and binds the known uniform and storage blocks to their binding points
+		*/
+		void reflect();
 
 	public:
 
 		ShaderProgram();
 		ShaderProgram(const char*, const char*, bool isShadowShader);
 		ShaderProgram(std::ifstream*, std::ifstream*, bool isShadowShader);
+
+		/**
+		* Creates the program with the given preprocessor defines
+		*
+		* @param vertexSource the vertex shader source
+		* @param fragmentSource the fragment shader source
+		* @param isShadowShader true for the depth only programs
+		* @param defines the names to define in both stages, right after #version
+		*/
+		ShaderProgram(const std::string&, const std::string&, bool isShadowShader, const std::vector<std::string>&);
 		~ShaderProgram();
 
+		/**
+		* Creates a program from shader files, expanding their #include lines
+		*
+		* @param vertexPath the vertex shader file
+		* @param fragmentPath the fragment shader file
+		* @param isShadowShader true for the depth only programs
+		* @return the program, which can be reloaded from its files
+		*/
+		static ShaderProgram* fromFiles(const std::string&, const std::string&, bool isShadowShader);
+
 		////////////////
 		// Assignment //
 		////////////////
@@ -76,10 +214,68 @@ namespace engine {
 		*/
 		const GLuint addShader(const char*, const GLenum);
 
-		const GLuint getUniform(std::string) const;
+		/**
+		* Gets the location of an active uniform (hashed lookup, no driver call)
+		*
+		* @param name the uniform name, array uniforms can also be found without "[0]"
+		* @return the location, -1 if the uniform is not active in this program
+		*/
+		const GLint getUniform(const std::string&) const;
+
+		/**
+		* Gets the index of an active uniform block
+		*
+		* @param name the block name
+		* @return the block index, GL_INVALID_INDEX if the block is not active in this program
+		*/
+		const GLuint getUniformBlock(const std::string&) const;
 
 		const int getBinding(std::string) const;
 
+		/**
+		* Gets the permutation of this program with extra features, building it on first use
+		*
+		* @param features the features to add to the ones of this program
+		* @return the permutation, nullptr if the program was not created from files
+		*/
+		ShaderProgram* getVariant(const unsigned int);
+
+		const unsigned int getFeatures() const;
+
+		/**
+		* Reads the files again and relinks the program and every permutation built so far
+		* On any compile or link error the running programs are kept untouched
+		*
+		* @return true if the new programs were swapped in
+		*/
+		bool reload();
+
+		/**
+		* Gets the files the program was created from, #included files included
+		*
+		* @return the paths, empty if the program was not created with fromFiles
+		*/
+		const std::vector<std::string>& getDependencies() const;
+
+		const bool isLinked() const;
+
+		/**
+		* Gets the permutation feature of a material type
+		*
+		* @param type the material type
+		* @return the feature bits, 0 if the type does not fit
+		*/
+		static unsigned int materialFeature(const int);
+
+		/**
+		* Inserts #define lines after the #version directive of a shader source
+		*
+		* @param source the shader source
+		* @param defines the names to define
+		* @return the new source
+		*/
+		static std::string injectDefines(const std::string&, const std::vector<std::string>&);
+
 		GLuint getShaderId() { return ProgramId; };
 
 		void use() const;
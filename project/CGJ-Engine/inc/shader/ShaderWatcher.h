@@ -0,0 +1,104 @@
+#pragma once
+#include <chrono>
+#include <ctime>
+#include <map>
+#include <set>
+#include <string>
+#include <vector>
+#include "shader/ShaderProgram.h"
+
+namespace engine {
+
+	/**
+	* Watches the files of shader programs and reloads the programs when they change
+	*
+	* On Linux the directories of the watched files are watched with inotify, so
+	* editors that save through a temporary file and a rename are seen as well.
+	* Other platforms compare the modification times of the files, at most every
+	* POLL_INTERVAL seconds. Either way the programs are only reloaded from poll(),
+	* which must run on the GL thread at the start of a frame so no draw of the
+	* frame sees a half swapped program.
+	*/
+	class ShaderWatcher {
+
+	private:
+
+		static ShaderWatcher* instance;
+
+		static const double POLL_INTERVAL;
+
+		std::vector<ShaderProgram*> programs;
+
+		// Watched files, with their last seen modification time
+		std::map<std::string, time_t> files;
+
+		// Files reported as changed since the last reload
+		std::set<std::string> changed;
+
+		std::chrono::steady_clock::time_point lastPoll;
+
+#ifdef __linux__
+		int notifier = -1;
+
+		// Watched directories, by inotify watch descriptor
+		std::map<int, std::string> directories;
+
+		/**
+		* Reads the pending inotify events into the changed files
+		*/
+		void readEvents();
+#endif
+
+		ShaderWatcher();
+
+		/**
+		* Starts watching the files of a program
+		*
+		* @param program the program
+		*/
+		void addFiles(const ShaderProgram*);
+
+		/**
+		* Compares the modification times of the watched files with the last seen ones
+		*/
+		void checkTimes();
+
+		/**
+		* Gets the modification time of a file
+		*
+		* @param path the file path
+		* @return the time, 0 if the file does not exist
+		*/
+		static time_t getModifiedTime(const std::string&);
+
+	public:
+
+		~ShaderWatcher();
+
+		static ShaderWatcher* getInstance();
+
+		/**
+		* Reloads the program when one of its files changes
+		* The program must have been created with ShaderProgram::fromFiles
+		*
+		* @param program the program to watch
+		*/
+		void watch(ShaderProgram*);
+
+		/**
+		* Stops watching a program
+		*
+		* @param program the program
+		*/
+		void unwatch(ShaderProgram*);
+
+		/**
+		* Reloads the programs whose files changed (GL thread only, at frame start)
+		*
+		* @return the number of programs swapped to their new sources
+		*/
+		const unsigned int poll();
+
+	};
+
+}
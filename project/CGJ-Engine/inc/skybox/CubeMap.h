@@ -3,16 +3,19 @@
 #include <vector>
 #include <string>
 #include "mesh/Mesh.h"
+#include "textures/ImageData.h"
 #include <GL/glew.h>
 #include <assert.h>
-#include "ImageLoader.h"
 #include <iostream>
 
 namespace engine {
 	class Cubemap
 	{
 	public:
-		Cubemap();
+		/**
+		* Creates a cubemap holding 1x1 placeholder faces until upload() is called
+		*/
+		Cubemap(Mesh* mesh);
 		Cubemap(std::vector<std::string> faces, Mesh* mesh);
 
 		~Cubemap();
@@ -21,6 +24,20 @@ namespace engine {
 
 		void drawCubemap();
 
+		/**
+		* Uploads the decoded faces (+X, -X, +Y, -Y, +Z, -Z), replacing the placeholder (GL thread only)
+		*
+		* @param faces the decoded faces
+		*/
+		void upload(const std::vector<ImageData>& faces);
+
+		/**
+		* Checks if the real faces have been uploaded
+		*
+		* @return true if loaded, false if still showing the placeholder
+		*/
+		bool isLoaded() const { return loaded; }
+
 		static Cubemap* loadCubemap(std::vector<std::string> faces, Mesh* mesh);
 
 	private:
@@ -28,7 +45,9 @@ namespace engine {
 
 		Mesh* mesh;
 
+		bool loaded = false;
+
 	};
 
 
-}
\ No newline at end of file
+}
@@ -0,0 +1,56 @@
+#pragma once
+#include <string>
+
+namespace engine {
+
+	/**
+	* Decoded RGBA8 image kept in CPU memory
+	*
+	* Decoding does not need the OpenGL context, so it can run on any thread.
+	* The owner must call release() once the pixels have been uploaded.
+	*/
+	struct ImageData {
+		int width = 0;
+		int height = 0;
+		unsigned char* pixels = nullptr;
+
+		/**
+		* Checks if the image was decoded successfully
+		*
+		* @return true if there are pixels, false otherwise
+		*/
+		bool isValid() const { return pixels != nullptr; }
+
+		/**
+		* Frees the pixels of this image
+		*/
+		void release();
+
+		/**
+		* Builds the next mip level with a 2x2 box filter
+		* The new image owns its pixels and must be released too
+		*
+		* @return the image with half the width and height (at least 1)
+		*/
+		ImageData downsample() const;
+
+		/**
+		* Resamples the image to the given size with bilinear filtering
+		* The new image owns its pixels and must be released too
+		*
+		* @param width the new width
+		* @param height the new height
+		* @return the resampled image
+		*/
+		ImageData resize(const int width, const int height) const;
+
+		/**
+		* Decodes the image file into RGBA8 pixels
+		*
+		* @param fileName the image path
+		* @return the decoded image, invalid if the file could not be decoded
+		*/
+		static ImageData decode(const std::string fileName);
+	};
+
+}
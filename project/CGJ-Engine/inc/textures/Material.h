@@ -1,22 +1,48 @@
 #pragma once
 #include "maths/Vector.h"
+#include <GL/glew.h>
 
 namespace engine {
+	/**
+	* std140 layout of the MaterialBlock uniform block
+	*/
+	struct MaterialBlock {
+		GLfloat ambientStrength;
+		GLfloat specularStrength;
+		GLfloat shininess;
+		GLfloat transparency;
+		GLint type;
+		GLint padding[3];
+	};
+
 	struct Material {
+	private:
 		float ambientStrength;
 		float specularStrength;
 		float shininess;
 		float transparency;
 		int materialType;
 
+		// Uniform buffer holding the MaterialBlock, re-uploaded only when dirty
+		GLuint ubo = 0;
+		bool dirty = true;
+
+	public:
+
 		Material();
 		Material(float newAmbient, float newSpecular, float newShininess, float newTransperance, int materialType);
 
-		void setAmbientStrength(float newAmbient) { ambientStrength = newAmbient; }
-		void setSpecularStrength(float newSpecular) { specularStrength = newSpecular; }
-		void setShininess(float newShininess) { shininess = newShininess; }
-		void setTransparency(float newTransperance) { transparency = newTransperance; }
-		void setMaterialType(int type) { materialType = type; }
+		~Material();
+
+		// Owns its uniform buffer, a copy would delete it twice
+		Material(const Material&) = delete;
+		Material& operator=(const Material&) = delete;
+
+		void setAmbientStrength(float newAmbient) { ambientStrength = newAmbient; dirty = true; }
+		void setSpecularStrength(float newSpecular) { specularStrength = newSpecular; dirty = true; }
+		void setShininess(float newShininess) { shininess = newShininess; dirty = true; }
+		void setTransparency(float newTransperance) { transparency = newTransperance; dirty = true; }
+		void setMaterialType(int type) { materialType = type; dirty = true; }
 
 		float getAmbientStrength() { return ambientStrength; }
 		float getSpecularStrength() { return specularStrength; }
@@ -25,6 +51,13 @@ namespace engine {
 		int getMaterialType() { return materialType; }
 		bool isTranslucent();
 
+		/**
+		* Binds the MaterialBlock uniform buffer, uploading it first if the material changed
+		*
+		* @param bindingPoint the uniform block binding point (MATERIAL_BP)
+		*/
+		void bind(GLuint bindingPoint);
+
 		static Material* parseMaterial();
 		static Material* parseMaterial(float newAmbient, float newSpecular, float newShininess, float newTransperance, int materialType);
 
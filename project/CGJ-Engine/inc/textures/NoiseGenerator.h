@@ -0,0 +1,147 @@
+#pragma once
+#include <GL/glew.h>
+#include <cstddef>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+namespace engine {
+
+	/**
+	* Parameters of a turbulence noise image
+	*/
+	struct NoiseParams {
+		// Side of the square image, in texels; the image always spans [0, 1) of noise space
+		int resolution = 256;
+		// Added to the octave index to pick the permutation of each octave
+		int seed = 0;
+		int octaves = 6;
+		float lacunarity = 2.0f;
+		float gain = 0.5f;
+		// Slice of the 3D noise
+		float depth = 3.2f;
+
+		bool operator==(const NoiseParams&) const;
+
+		/**
+		* Hashes the parameters, for the image cache
+		*/
+		struct Hash {
+			size_t operator()(const NoiseParams&) const;
+		};
+	};
+
+	/**
+	* Generates and shares turbulence noise images
+	*
+	* The noise is the stb_perlin turbulence (its permutation and gradient
+	* tables, so images match the scalar stb result), evaluated 8 texels at a
+	* time with AVX2 or 4 at a time with SSE2, picked at runtime from the CPU,
+	* in tiles spread over the AssetLoader workers. Images are cached by their
+	* parameters: every texture asking for the same noise shares one image, and
+	* concurrent requests for an image being generated wait for it.
+	*
+	* Images are RGBA8 with the noise in red and green, blue at 255 and alpha 0.
+	*
+	* Thread safe.
+	*/
+	class NoiseGenerator {
+
+		////////////////////
+		// Static members //
+		////////////////////
+
+	private:
+
+		static NoiseGenerator* instance;
+
+	public:
+
+		static NoiseGenerator* getInstance();
+
+		/**
+		* Instruction set of the noise kernel
+		*/
+		enum class Kernel { SCALAR, SSE2, AVX2 };
+
+		typedef std::shared_ptr<const std::vector<GLubyte>> Image;
+
+		/////////////
+		// Members //
+		/////////////
+
+	private:
+
+		// Side of the square tiles handed to the workers
+		static const int TILE = 64;
+
+		std::unordered_map<NoiseParams, std::shared_future<Image>, NoiseParams::Hash> images;
+
+		std::mutex mutex;
+
+		Kernel kernel;
+
+		//////////////////////////////////////////////
+		// Constructor								//
+		// Should only be used by the static method //
+		//////////////////////////////////////////////
+
+	private:
+
+		NoiseGenerator();
+
+		/**
+		* Fills an image, tile by tile
+		*
+		* @param params the noise parameters
+		* @return the RGBA8 texels
+		*/
+		Image createImage(const NoiseParams&) const;
+
+	public:
+
+		/**
+		* Gets the image of the given parameters, generating it on the first request
+		*
+		* @param params the noise parameters
+		* @return the shared RGBA8 texels, params.resolution squared
+		*/
+		Image generate(const NoiseParams&);
+
+		/**
+		* Computes one row of turbulence
+		*
+		* @param x the first coordinate, the same for the whole row
+		* @param y the second coordinate of each value
+		* @param count the number of values
+		* @param params the octaves, lacunarity, gain, depth and seed
+		* @param out the turbulence of each value
+		*/
+		void turbulenceRow(const float, const float*, const int, const NoiseParams&, float*) const;
+
+		/**
+		* Drops the cached images, the ones still in use stay alive with their users
+		*/
+		void clear();
+
+		/**
+		* Selects the noise kernel, the best supported one is used by default
+		*
+		* @param kernel the kernel, falls back to a supported one
+		*/
+		void setKernel(const Kernel);
+
+		const Kernel getKernel() const;
+
+		/**
+		* Gets the best kernel the CPU supports
+		*
+		* @return the kernel
+		*/
+		static Kernel detectKernel();
+
+	};
+
+}
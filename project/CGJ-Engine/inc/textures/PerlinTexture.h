@@ -1,13 +1,14 @@
 #pragma once
 #include <GL/glew.h>
-
-#define imageWidth 256
+#include <vector>
+#include "textures/ImageData.h"
+#include "textures/NoiseGenerator.h"
 
 namespace engine {
 	class PerlinTexture
 	{
 	public:
-		PerlinTexture();
+		PerlinTexture(const NoiseParams& = NoiseParams());
 		~PerlinTexture();
 
 		static PerlinTexture* parsePerlin();
@@ -15,12 +16,43 @@ namespace engine {
 		void Bind(unsigned int unit);
 		void testPerlin(float x, float y);
 
+		/**
+		* Generates the noise image in CPU memory, or takes it from the NoiseGenerator cache
+		* (safe on a worker thread)
+		*/
+		void createImage();
+
+		/**
+		* Uploads the generated image and frees the CPU copy (GL thread only)
+		*/
+		void upload();
+
+		/**
+		* Generates the noise image as a standalone RGBA8 image (safe on a worker thread),
+		* for packing into a TextureArray
+		*
+		* @param params the noise parameters
+		* @return the image, which must be released by the caller
+		*/
+		static ImageData createImageData(const NoiseParams& = NoiseParams());
+
+		/**
+		* Checks if the noise image has been uploaded
+		*
+		* @return true if loaded, false otherwise
+		*/
+		bool isLoaded() const { return loaded; }
+
+		const NoiseParams& getParams() const { return params; }
+
 	private:
 		GLuint 	m_texture_id = 0;
-		void createImage();
-		
+		bool loaded = false;
+		NoiseParams params;
+		// Shared with the NoiseGenerator cache until uploaded
+		NoiseGenerator::Image imageData;
 		
 	};
 
 	
-}
\ No newline at end of file
+}
@@ -2,22 +2,64 @@
 
 #include <string>
 #include <GL/glew.h>
+#include "textures/ImageData.h"
+#include "textures/TextureCompression.h"
 
 namespace engine {
 	class Texture
 	{
 	public:
+		/**
+		* Creates a texture holding a 1x1 placeholder texel until upload() is called
+		*/
 		Texture();
+
+		/**
+		* Loads the texture from an image file, or from a DDS/KTX2 file for block compressed textures
+		*
+		* @param fileName the texture path
+		*/
 		Texture(const std::string fileName);
 
 		~Texture();
 		void Bind(unsigned int unit);
 
+		/**
+		* Uploads the decoded image and generates its mip chain,
+		* replacing the placeholder (GL thread only)
+		*
+		* @param image the decoded image
+		*/
+		void upload(const ImageData& image);
+
+		/**
+		* Uploads a block compressed image with the mip levels it holds,
+		* replacing the placeholder (GL thread only)
+		*
+		* @param image the compressed image
+		*/
+		void upload(const CompressedImage& image);
+
+		/**
+		* Checks if the real image has been uploaded
+		*
+		* @return true if loaded, false if still showing the placeholder
+		*/
+		bool isLoaded() const { return loaded; }
+
 		static Texture* parseTexture(const std::string fileName);
 
 	private:
+		/**
+		* Enables trilinear (and anisotropic, if supported) filtering over the mip levels
+		*
+		* @param maxLevel the last mip level of the texture
+		*/
+		void setMipmapFiltering(int maxLevel);
+
 		GLuint 	m_texture_id = 0;
+		bool loaded = false;
 	};
 
 	
-}
\ No newline at end of file
+}
@@ -0,0 +1,75 @@
+#pragma once
+#include <GL/glew.h>
+#include "textures/ImageData.h"
+
+namespace engine {
+
+	/**
+	* Packs many small textures into the layers of one GL_TEXTURE_2D_ARRAY
+	*
+	* Every image is resampled to the layer size, so nodes sharing the array
+	* only differ by their layer index and keep the same texture binding,
+	* which lets their draws be batched together.
+	*/
+	class TextureArray {
+
+	private:
+
+		GLuint m_texture_id = 0;
+
+		int width;
+
+		int height;
+
+		int layers;
+
+		int levels;
+
+		// Layers handed out so far
+		int used = 0;
+
+	public:
+
+		/**
+		* Allocates the immutable storage of the array with its full mip chain
+		*
+		* @param width the width of every layer
+		* @param height the height of every layer
+		* @param layers the maximum number of layers
+		*/
+		TextureArray(const int width, const int height, const int layers);
+
+		~TextureArray();
+
+		/**
+		* Hands out the next free layer, to be filled later by upload()
+		*
+		* @return the layer index, -1 if the array is full
+		*/
+		int reserveLayer();
+
+		/**
+		* Resamples the image to the layer size and uploads it with its mip chain (GL thread only)
+		*
+		* @param layer the layer to fill
+		* @param image the decoded image
+		*/
+		void upload(const int layer, const ImageData& image);
+
+		/**
+		* Reserves a layer and uploads the image into it (GL thread only)
+		*
+		* @param image the decoded image
+		* @return the layer index, -1 if the array is full
+		*/
+		int addLayer(const ImageData& image);
+
+		void Bind(unsigned int unit);
+
+		const int getLayers() const;
+
+		const int getUsedLayers() const;
+
+	};
+
+}
@@ -0,0 +1,162 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <GL/glew.h>
+#include "textures/ImageData.h"
+
+namespace engine {
+
+	/**
+	* Block compressed formats supported by the engine
+	*
+	* BC1: RGB + 1 bit alpha, 4 bits per texel (8x smaller than RGBA8)
+	* BC3: RGBA, 8 bits per texel (4x smaller than RGBA8)
+	* BC7: high quality RGBA, 8 bits per texel (4x smaller than RGBA8)
+	*/
+	enum class BlockFormat { BC1, BC3, BC7 };
+
+	/**
+	* Block compressed image with its full mip chain, ready for glCompressedTexImage2D
+	*/
+	struct CompressedImage {
+
+		struct Level {
+			int width = 0;
+			int height = 0;
+			std::vector<unsigned char> data;
+		};
+
+		BlockFormat format = BlockFormat::BC1;
+		bool srgb = false;
+		std::vector<Level> levels;
+
+		/**
+		* Checks if the image holds at least one level
+		*
+		* @return true if valid, false otherwise
+		*/
+		bool isValid() const { return !levels.empty(); }
+
+		/**
+		* Gets the OpenGL internal format of this image
+		*
+		* @return the internal format
+		*/
+		GLenum getInternalFormat() const;
+
+		/**
+		* Gets the size in bytes of one 4x4 block
+		*
+		* @return 8 for BC1, 16 otherwise
+		*/
+		int getBlockSize() const;
+
+		/**
+		* Writes this image to a DDS file (DX10 header for BC7)
+		*
+		* @param fileName the DDS path
+		* @return true if the file was written, false otherwise
+		*/
+		bool saveDDS(const std::string fileName) const;
+
+		/**
+		* Checks if the file is a compressed texture container by its extension
+		*
+		* @param fileName the texture path
+		* @return true for .dds and .ktx2 files
+		*/
+		static bool isCompressedFile(const std::string fileName);
+
+		/**
+		* Loads a compressed texture container (.dds or .ktx2)
+		*
+		* @param fileName the texture path
+		* @return the image, invalid if the file or its format is not supported
+		*/
+		static CompressedImage load(const std::string fileName);
+
+		/**
+		* Loads a BC1/BC3/BC7 DDS file (legacy DXT1/DXT5 or DX10 header)
+		*
+		* @param fileName the DDS path
+		* @return the image, invalid if the file or its format is not supported
+		*/
+		static CompressedImage loadDDS(const std::string fileName);
+
+		/**
+		* Loads a BC1/BC3/BC7 KTX2 file without supercompression
+		*
+		* @param fileName the KTX2 path
+		* @return the image, invalid if the file or its format is not supported
+		*/
+		static CompressedImage loadKTX2(const std::string fileName);
+	};
+
+	/**
+	* CPU block compression encoder
+	*
+	* Used offline (see the --compress command line option) or on load, to build
+	* compressed textures with their full mip chain from any stb_image input.
+	*/
+	class TextureCompressor {
+
+	private:
+
+		/**
+		* Encodes the color part of a 4x4 block as BC1 (always in 4 color mode)
+		*
+		* @param rgba the 16 texels of the block
+		* @param out the 8 byte block
+		*/
+		static void encodeBC1Block(const unsigned char*, unsigned char*);
+
+		/**
+		* Encodes the alpha part of a 4x4 block as a BC3 alpha block
+		*
+		* @param rgba the 16 texels of the block
+		* @param out the 8 byte block
+		*/
+		static void encodeAlphaBlock(const unsigned char*, unsigned char*);
+
+		/**
+		* Encodes a 4x4 block as BC7 mode 6 (single subset RGBA, 4 bit indices)
+		*
+		* @param rgba the 16 texels of the block
+		* @param out the 16 byte block
+		*/
+		static void encodeBC7Block(const unsigned char*, unsigned char*);
+
+		/**
+		* Compresses one level
+		*
+		* @param image the level to compress
+		* @param format the block format
+		* @return the compressed level
+		*/
+		static CompressedImage::Level compressLevel(const ImageData&, const BlockFormat);
+
+	public:
+
+		/**
+		* Compresses the image, optionally with its full mip chain
+		*
+		* @param image the RGBA8 image
+		* @param format the block format
+		* @param mipmaps true to build and compress the mip chain
+		* @return the compressed image
+		*/
+		static CompressedImage compress(const ImageData&, const BlockFormat, const bool = true);
+
+		/**
+		* Decodes an image file, compresses it with its mip chain and writes it as DDS
+		*
+		* @param source the source image path (any stb_image format)
+		* @param destination the DDS path
+		* @param format the block format
+		* @return true if the file was written, false otherwise
+		*/
+		static bool compressFile(const std::string, const std::string, const BlockFormat);
+
+	};
+
+}
@@ -0,0 +1,203 @@
+#pragma once
+#include <GL/glew.h>
+#include <cstdint>
+#include <future>
+#include <list>
+#include <unordered_map>
+#include <vector>
+#include "camera/Camera.h"
+#include "maths/Matrix.h"
+#include "maths/Vector.h"
+#include "shader/ShaderProgram.h"
+#include "textures/NoiseGenerator.h"
+
+namespace engine {
+
+	/**
+	* The PerlinNoise.h octave sums a virtual texture can be made of
+	*/
+	enum class NoiseType { FBM, RIDGE, TURBULENCE };
+
+	/**
+	* Procedural texture streamed in pages, for surfaces too large for one texture
+	*
+	* The texture is projected from above onto a rectangle of the XZ plane and
+	* split into square pages, with a mip chain of coarser pages down to a
+	* single one covering the whole surface. Every frame update() walks that
+	* quadtree against the camera frustum, descending until the texels of a
+	* page are no larger than the pixels they cover, and requests the pages it
+	* reaches. Missing pages are generated on the AssetLoader workers.
+	*
+	* Generated pages are uploaded into the slots of a fixed size atlas, each
+	* page with a border so bilinear filtering does not bleed between slots.
+	* The atlas is an LRU page cache: a new page takes a free slot, or the one
+	* least recently requested, but never one requested this frame. Memory is
+	* bounded by the atlas size whatever the size of the surface.
+	*
+	* A page table, with a mip level per page level, maps every page to the
+	* slot holding it or, while it is not resident, to its nearest resident
+	* ancestor, so the shader always finds the sharpest page available.
+	*
+	* The noise repeats across the edges of the surface when the period is a
+	* whole number and the lacunarity 2, so the texture tiles without seams.
+	*/
+	class VirtualTexture {
+
+	public:
+
+		// Side of a page in texels, and of the border around it
+		static const int PAGE_SIZE = 128, BORDER = 1;
+
+	private:
+
+		// Page generations in flight, and pages uploaded per frame
+		static const int MAX_GENERATING = 16, MAX_UPLOADS = 8;
+
+		NoiseType type;
+
+		NoiseParams noise;
+
+		// Noise cells across the surface
+		float period;
+
+		// Pages across the finest level, a power of two
+		int pages;
+
+		int levels;
+
+		// Slots across the atlas
+		int slots;
+
+		GLuint atlas = 0, pageTable = 0;
+
+		// World position of the corner of the surface and its size on the XZ plane
+		Vector3 origin;
+
+		Vector2 size = Vector2(1.0f, 1.0f);
+
+		std::vector<int> freeSlots;
+
+		// Least recently requested pages at the back, with the frame of their last request
+		std::list<uint32_t> lru;
+
+		struct Resident {
+			int slot;
+			unsigned int lastUsed;
+			std::list<uint32_t>::iterator position;
+		};
+
+		std::unordered_map<uint32_t, Resident> resident;
+
+		std::unordered_map<uint32_t, std::future<std::vector<GLubyte>>> generating;
+
+		// RGBA8UI entries of each level of the page table: slot column, slot row, page level, valid
+		std::vector<std::vector<GLubyte>> entries;
+
+		bool tableDirty = true;
+
+		unsigned int frame = 0;
+
+		// Slots holding a page requested this frame, which cannot be evicted
+		int touched = 0;
+
+		// Totals since creation
+		unsigned int generated = 0, evicted = 0;
+
+		/**
+		* Packs the level and coordinates of a page into a key
+		*/
+		static uint32_t makeKey(const int level, const int x, const int y);
+
+		/**
+		* Generates the texels of a page, border included (safe on a worker thread)
+		*
+		* @param key the page
+		* @return the RGBA8 texels
+		*/
+		std::vector<GLubyte> generatePage(const uint32_t) const;
+
+		/**
+		* Walks the page quadtree, collecting the pages the camera needs
+		*
+		* @param level the level of the page
+		* @param x the column of the page
+		* @param y the row of the page
+		* @param viewProjection the camera view projection
+		* @param eye the camera position
+		* @param pixelScale the world size of a pixel one unit away from the camera, or of every pixel for orthographic cameras
+		* @param orthographic true if pixels have the same size at every distance
+		* @param requests the pages to load, appended to
+		*/
+		void collectPages(const int, const int, const int, const Matrix4&, const Vector3&, const float, const bool, std::vector<uint32_t>&);
+
+		/**
+		* Marks a resident page as requested this frame, moving it to the front of the LRU
+		*/
+		void touch(const uint32_t);
+
+		/**
+		* Uploads a generated page into a free or evicted slot
+		*
+		* @return false if every slot holds a page requested this frame
+		*/
+		bool place(const uint32_t, const std::vector<GLubyte>&);
+
+		/**
+		* Points every page table entry to its page or its nearest resident ancestor and uploads the table
+		*/
+		void updatePageTable();
+
+	public:
+
+		/**
+		* Allocates the atlas and the page table
+		*
+		* @param pages the pages across the finest level, rounded up to a power of two
+		* @param slots the slots across the atlas, which holds slots * slots pages
+		* @param type the octave sum
+		* @param noise the seed, octaves, lacunarity, gain and depth (the resolution is unused)
+		* @param period the noise cells across the surface
+		*/
+		VirtualTexture(const int, const int, const NoiseType = NoiseType::TURBULENCE, const NoiseParams& = NoiseParams(), const float = 8.0f);
+
+		/**
+		* Waits for the pages being generated and deletes the textures
+		*/
+		~VirtualTexture();
+
+		/**
+		* Places the surface in the world
+		*
+		* @param origin the corner with the smallest X and Z, its Y is the height of the surface
+		* @param size the extent along X and Z
+		*/
+		void setSurface(const Vector3&, const Vector2&);
+
+		/**
+		* Requests the pages the camera sees, starts their generation and uploads
+		* the finished ones (GL thread only, once per frame before drawing)
+		*
+		* @param camera the camera
+		* @param viewportHeight the height of the viewport in pixels
+		*/
+		void update(Camera*, const int);
+
+		/**
+		* Binds the atlas to the unit and the page table to the next one, and sets the uniforms of the VIRTUAL_TEXTURE permutation
+		*
+		* @param program the program drawing with the texture
+		* @param unit the texture unit of the atlas
+		*/
+		void Bind(ShaderProgram*, const unsigned int);
+
+		const int getResidentPages() const;
+
+		const int getCapacity() const;
+
+		const unsigned int getGeneratedPages() const;
+
+		const unsigned int getEvictedPages() const;
+
+	};
+
+}
@@ -1,9 +1,57 @@
-#version 330 core
+#version 430 core
 in vec3 in_Position;
 
-uniform mat4 lightSpaceMatrix = mat4(1.0f);
+// DEPTH_ONLY must write the exact depth of the main pass, which tests it with GL_EQUAL
+invariant gl_Position;
+
+#ifdef DEPTH_ONLY
+uniform SharedMatrices {
+	mat4 ViewMatrix;
+	mat4 ProjectionMatrix;
+};
+#else
+// Light view projection of the cascade being drawn
+layout(std140) uniform CascadeBlock {
+	mat4 cascadeMatrix;
+};
+#endif
+
+#ifdef INDIRECT
+struct DrawParameters {
+	mat4 modelMatrix;
+	vec4 color;
+	int textureLayer;
+};
+
+layout(std430) readonly buffer DrawBlock {
+	DrawParameters draws[];
+};
+
+in uint in_DrawId;
+#elif defined(INSTANCED)
+in mat4 in_ModelMatrix;
+#else
 uniform mat4 model = mat4(1.0f);
+#endif
+
+#ifdef SKINNED
+#include "skin_block.glsl"
+#endif
 
 void main() {
-    gl_Position = lightSpaceMatrix * model * vec4(in_Position, 1.0);
+#ifdef INDIRECT
+    mat4 world = draws[in_DrawId].modelMatrix;
+#elif defined(INSTANCED)
+    mat4 world = in_ModelMatrix;
+#else
+    mat4 world = model;
+#endif
+#ifdef SKINNED
+    world = world * skinMatrix();
+#endif
+#ifdef DEPTH_ONLY
+    gl_Position = ProjectionMatrix * ViewMatrix * world * vec4(in_Position, 1);
+#else
+    gl_Position = cascadeMatrix * world * vec4(in_Position, 1.0);
+#endif
 } 
\ No newline at end of file
@@ -0,0 +1,25 @@
+// Joint palette of the skinned node being drawn, written to the stream buffer and bound at SKIN_BP
+// Each joint is an affine matrix stored as its first three rows (see Skin)
+// A storage block, so it can be bound with exactly the size of the palette
+layout(std430) readonly buffer SkinBlock {
+	vec4 jointRows[];
+};
+
+in uvec4 in_Joints;
+in vec4 in_Weights;
+
+// Blends the rows of the joints influencing the vertex, the weights add up to 1
+// Only the joints of the palette are bound, unused influences are not read
+mat4 skinMatrix() {
+	vec4 row0 = vec4(0.0), row1 = vec4(0.0), row2 = vec4(0.0);
+	for (int i = 0; i < 4; i++) {
+		if (in_Weights[i] == 0.0) {
+			continue;
+		}
+		uint joint = in_Joints[i] * 3u;
+		row0 += jointRows[joint] * in_Weights[i];
+		row1 += jointRows[joint + 1u] * in_Weights[i];
+		row2 += jointRows[joint + 2u] * in_Weights[i];
+	}
+	return transpose(mat4(row0, row1, row2, vec4(0.0, 0.0, 0.0, 1.0)));
+}
@@ -3,19 +3,37 @@
 #include <GL/glew.h>
 #include <GLFW/glfw3.h>
 #include "shader/ShaderProgram.h"
+#include "shader/ShaderCache.h"
+#include "shader/ShaderWatcher.h"
 #include "mesh/Mesh.h"
+#include "mesh/MeshCache.h"
+#include "loader/AssetLoader.h"
 #include "camera/Camera.h"
 #include "input/KeyBuffer.h"
 #include "scene/SceneGraph.h"
-#include "scene/Animator.h"
+#include "scene/AnimationSystem.h"
+#include "scene/Skeleton.h"
+#include "scene/Skin.h"
 #include "physics/Physics.h"
+#include "render/RenderState.h"
+#include "render/StreamBuffer.h"
+#include "render/ShadowCascades.h"
+#include "capture/FrameCapture.h"
 #include <malloc.h>
 #include <time.h>
 #include "skybox/CubeMap.h"
+#include "textures/TextureArray.h"
+#include "textures/TextureCompression.h"
+#include "textures/VirtualTexture.h"
 #include <vector>
 #include <string>
+#include <cstring>
+#include <chrono>
+#include <cmath>
 
 #define STB_IMAGE_WRITE_IMPLEMENTATION
+// stb keeps its PNG code but compresses with the engine deflate
+#define STBIW_ZLIB_COMPRESS engine::Deflate::zlibCompress
 #include "ImageCreator.h"
 
 
@@ -39,17 +57,54 @@ engine::ShaderProgram* skyboxShader;
 engine::Cubemap* skybox;
 engine::Camera* camera;
 engine::SceneGraph* sceneGraph;
-engine::SceneNode* ground, * ball, * ball2, * pin;
+engine::TextureArray* materialTextures;
+engine::VirtualTexture* groundTexture;
+engine::SceneNode* ground, * ball, * ball2, * pin, * wobbler;
+engine::Skeleton* pinSkeleton;
+engine::AnimationClip* pinClip;
+engine::Skin* pinSkin;
 engine::Vector3 lightPos = engine::Vector3(1.0, 20.0, -10.0);
-unsigned int depthMapFBO;
-unsigned int depthMap;
-const unsigned int SHADOW_WIDTH = 3840, SHADOW_HEIGHT = 2160;
+// Per-frame data of every scene and depth program, std140 layout of the FrameBlock
+struct FrameData {
+	GLfloat lightSpaceMatrices[engine::ShadowCascades::MAX_CASCADES][16];
+	GLfloat cascadeSplits[4];
+	GLfloat cascadeScales[4];
+	GLfloat lightPos[3];
+	GLfloat powerSlide;
+	GLfloat viewPos[3];
+	GLint cascadeCount;
+};
+engine::ShadowCascades* shadowCascades;
+engine::FrameCapture* frameCapture;
+const std::string SCREENSHOT_DIRECTORY = "../../screenshots/";
+// Resolution budget of each shadow cascade, nearest first, and how far shadows reach
+const int SHADOW_CASCADES = 3;
+const GLsizei CASCADE_RESOLUTIONS[SHADOW_CASCADES] = { 2048, 2048, 1024 };
+const float SHADOW_DISTANCE = 60.0f;
 const unsigned int WINDOW_WIDTH = 1024, WINDOW_HEIGHT = 720;
 float turbPower = 1.0f;
+// Time the GL thread may spend per frame applying streamed-in assets
+const double UPLOAD_BUDGET_MS = 2.0;
+// Layer size and capacity of the packed material textures
+const int MATERIAL_TEXTURE_SIZE = 256, MATERIAL_TEXTURE_LAYERS = 8;
+// Pages across the streamed ground texture and slots across its atlas
+const int GROUND_PAGES = 32, GROUND_ATLAS_SLOTS = 16;
+// Joints along the skinned pin, and the sway of each one in degrees
+const int PIN_JOINTS = 4;
+const float PIN_SWAY = 12.0f;
+// Skinned instances drawn and deformed by the skinning benchmark, and the runs averaged
+const int SKINNING_BENCHMARK_INSTANCES = 256, SKINNING_BENCHMARK_RUNS = 10;
 
 bool firstFrame = true;
 
-std::map<engine::SceneNode*, engine::Animator*>* animators = new std::map<engine::SceneNode*, engine::Animator*>();
+// Version of the casters the cached static shadows were drawn with
+unsigned int casterVersion = 0;
+
+// Skinning benchmark in progress, one run per frame, and the times summed over its runs
+std::vector<engine::Skin*> benchmarkSkins;
+int benchmarkRuns = 0;
+double benchmarkCpu[2], benchmarkUpload;
+GLuint64 benchmarkGpu[2];
 
 ////////////////////////////////////////////////// ERROR CALLBACK (OpenGL 4.3+)
 
@@ -114,17 +169,24 @@ void setupErrorCallback() {
 /////////////////////////////////////////////////////////////////////// SHADERs
 
 void createShaderProgram() {
-	std::ifstream vertexFile("vertex_shader.glsl");
-	std::ifstream fragmentFile("fragment_shader.glsl");
-	shaderProgram = new engine::ShaderProgram(&vertexFile, &fragmentFile, 0);
-
-	std::ifstream vertexFile2("shadowVS.glsl");
-	std::ifstream fragmentFile2("shadowFS.glsl");
-	simpleDepthShader = new engine::ShaderProgram(&vertexFile2, &fragmentFile2, 1);
-
-	std::ifstream vertexFile3("skyboxVS.glsl");
-	std::ifstream fragmentFile3("skyboxFS.glsl");
-	skyboxShader = new engine::ShaderProgram(&vertexFile3, &fragmentFile3, 2);
+	shaderProgram = engine::ShaderProgram::fromFiles("vertex_shader.glsl", "fragment_shader.glsl", 0);
+	simpleDepthShader = engine::ShaderProgram::fromFiles("shadowVS.glsl", "shadowFS.glsl", 1);
+	skyboxShader = engine::ShaderProgram::fromFiles("skyboxVS.glsl", "skyboxFS.glsl", 2);
+
+	// Edited shader files are picked up at the start of the next frame
+	engine::ShaderWatcher* watcher = engine::ShaderWatcher::getInstance();
+	watcher->watch(shaderProgram);
+	watcher->watch(simpleDepthShader);
+	watcher->watch(skyboxShader);
+
+	// Depth permutations the render queue draws with, shadow and pre-pass; the scene ones depend on the nodes
+	for (unsigned int depthOnly : { 0u, engine::ShaderProgram::DEPTH_ONLY }) {
+		simpleDepthShader->getVariant(depthOnly);
+		simpleDepthShader->getVariant(depthOnly | engine::ShaderProgram::INSTANCED);
+		if (engine::RenderQueue::isIndirectSupported()) {
+			simpleDepthShader->getVariant(depthOnly | engine::ShaderProgram::INDIRECT);
+		}
+	}
 }
 
 void createCamera(int winx, int winy) {
@@ -133,21 +195,48 @@ void createCamera(int winx, int winy) {
 
 /////////////////////////////////////////////////////////////////////// SCENE
 
+/**
+* Builds the shader permutations of the subtree up front, instead of on their first draw
+*/
+void warmShaderVariants(engine::SceneNode* node) {
+	for (engine::SceneNode* child : node->getChildren()) {
+		if (child->getSkin() != nullptr) {
+			// Skinned nodes are never batched, their depth is drawn skinned on the GPU
+			child->getDrawProgram();
+			child->getShadowShaderProgram()->getVariant(engine::ShaderProgram::SKINNED);
+			child->getShadowShaderProgram()->getVariant(engine::ShaderProgram::DEPTH_ONLY | engine::ShaderProgram::SKINNED);
+		}
+		else if (child->getMesh() != nullptr) {
+			engine::ShaderProgram* program = child->getDrawProgram();
+			program->getVariant(engine::ShaderProgram::INSTANCED);
+			if (engine::RenderQueue::isIndirectSupported()) {
+				program->getVariant(engine::ShaderProgram::INDIRECT);
+			}
+		}
+		warmShaderVariants(child);
+	}
+}
+
 void createBase() {
-	engine::Mesh* mesh = engine::Mesh::parseMesh("../../assets/models/ground.obj", shaderProgram);
-	engine::Mesh* mesh2 = engine::Mesh::parseMesh("../../assets/models/ground.obj", simpleDepthShader);
+	engine::AssetLoader* loader = engine::AssetLoader::getInstance();
+	engine::Mesh* mesh = loader->loadMesh("../../assets/models/ground.obj", shaderProgram);
 
 	engine::Material* baseMaterial = engine::Material::parseMaterial(0.3f, 0.3f, 12, 1.0f, 2);
-	engine::PerlinTexture* basePerlin = engine::PerlinTexture::parsePerlin();
+	// Noise projected from above onto the ground, streamed in pages around the camera
+	groundTexture = new engine::VirtualTexture(GROUND_PAGES, GROUND_ATLAS_SLOTS, engine::NoiseType::TURBULENCE);
+	groundTexture->setSurface(engine::Vector3(-10.0f, -18.75f, -10.0f), engine::Vector2(20.0f, 20.0f));
 
 	ground = sceneGraph->createNode();
-	ground->setPerlinTexture(basePerlin);
-	ground->setMesh(mesh->inColor(WOOD_BROWN));
+	ground->setVirtualTexture(groundTexture);
+	ground->setMesh(mesh);
+	ground->setColor(WOOD_BROWN);
 	ground->setMaterial(baseMaterial);
-	ground->setShadowMesh(mesh2->inColor(WOOD_BROWN));
+	ground->setShadowMesh(engine::MeshCache::loadMesh("../../assets/models/ground.obj", simpleDepthShader));
 	ground->setScale({ 7.0f, 0.5f, 20.0f });
 	ground->setPosition({ 0.0f, -19.0f, 0.0f });
 	ground->addComponent(engine::Physics::newRigidBody(0.0f));
+	// Colliders are built from the vertices, so they need the decoded mesh
+	loader->wait(mesh);
 	ground->addComponent(engine::Physics::newBoxCollider(mesh));
 
 }
@@ -156,129 +245,228 @@ void createObjects() {
 	engine::SceneNode* superglue = sceneGraph->createNode();
 	superglue->setPosition({ 0.0f, 1.90f, 1/2.5f });
 
-	engine::Mesh* ballMesh = engine::Mesh::parseMesh("../../assets/models/ball.obj", shaderProgram);
-	engine::Mesh* pinMesh = engine::Mesh::parseMesh("../../assets/models/pin.obj", shaderProgram);
-
-	engine::Mesh* ballMesh2 = engine::Mesh::parseMesh("../../assets/models/ball.obj", simpleDepthShader);
-	engine::Mesh* pinMesh2 = engine::Mesh::parseMesh("../../assets/models/pin.obj", simpleDepthShader);
+	// The shadow pass shares the same meshes (and GPU buffers) through the cache
+	engine::AssetLoader* loader = engine::AssetLoader::getInstance();
+	engine::Mesh* ballMesh = loader->loadMesh("../../assets/models/ball.obj", shaderProgram);
+	engine::Mesh* pinMesh = loader->loadMesh("../../assets/models/pin.obj", shaderProgram);
 	
-	engine::PerlinTexture* textPerlin = engine::PerlinTexture::parsePerlin();
-	engine::Texture* crystalTexture = engine::Texture::parseTexture("../../assets/textures/glass.jpg");
+	int textPerlin = loader->loadPerlinLayer(materialTextures);
+	int crystalTexture = loader->loadLayer(materialTextures, "../../assets/textures/glass.jpg");
 
 	engine::Material* ballMaterial = engine::Material::parseMaterial(0.3f, 0.5f, 32.0f, 1.0f, 3);
 	engine::Material* transparentMaterial = engine::Material::parseMaterial(0.3f, 0.5f, 32.0f, 0.7f, 0);
 	engine::Material* pinMaterial = engine::Material::parseMaterial(0.2f, 0.3f, 24.0f, 1.0f, 1);
 	
 	pin = superglue->createNode();
-	pin->setMesh(pinMesh->inColor(TEST_1));
-	pin->setPerlinTexture(textPerlin);
+	pin->setMesh(pinMesh);
+	pin->setColor(TEST_1);
+	pin->setTextureLayer(materialTextures, textPerlin);
 	pin->setMaterial(pinMaterial);
-	pin->setShadowMesh(pinMesh2->inColor(TEST_1));
+	pin->setShadowMesh(engine::MeshCache::loadMesh("../../assets/models/pin.obj", simpleDepthShader));
 	pin->setScale({ 1.5f, 1.5f, 1.5f });
 	pin->setPosition({ 0.0f, -19.2f, -5.0f });
 	pin->setRotation(engine::Quaternion::fromAngleAxis(90.0f, engine::Vector3(1.0f, 0.0f, 0.0f)));
 	pin->addComponent(engine::Physics::newRigidBody(0.1f));
+	loader->wait(pinMesh);
 	pin->addComponent(engine::Physics::newBoxCollider(pinMesh));
 
 	ball2 = superglue->createNode();
-	ball2->setMesh(ballMesh->inColor(RED));
+	ball2->setMesh(ballMesh);
+	ball2->setColor(RED);
 	ball2->setMaterial(ballMaterial);
 	ball2->setPosition({ 0.0f, -19.3f, 0.0f });
-	ball2->setShadowMesh(ballMesh2->inColor(RED));
+	ball2->setShadowMesh(engine::MeshCache::loadMesh("../../assets/models/ball.obj", simpleDepthShader));
 	ball2->addComponent(engine::Physics::newRigidBody(1.0f));
+	loader->wait(ballMesh);
 	ball2->addComponent(engine::Physics::newBoxCollider(ballMesh));
 
 	ball = superglue->createNode();
-	ball->setMesh(ballMesh->inColor(TEST_1));
-	//ball->setPerlinTexture(textPerlin);
-	ball->setTexture(crystalTexture);
+	ball->setMesh(ballMesh);
+	ball->setColor(TEST_1);
+	//ball->setTextureLayer(materialTextures, textPerlin);
+	ball->setTextureLayer(materialTextures, crystalTexture);
 	ball->setMaterial(transparentMaterial);
 	ball->setPosition({ 0.0f, -19.3f, 5.0f });
-	ball->setShadowMesh(ballMesh2->inColor(TEST_1));
+	ball->setShadowMesh(engine::MeshCache::loadMesh("../../assets/models/ball.obj", simpleDepthShader));
 	ball->addComponent(engine::Physics::newSphericalRigidBody(1.0f));
 	ball->addComponent(engine::Physics::newBoxCollider(ballMesh));
 }
 
+/**
+* Sways a chain of joints along the longest axis of the mesh, as a clip sampled here and compressed
+*/
+void createPinAnimation(engine::Mesh* mesh) {
+	const std::vector<float> bounds = mesh->getBoundingCoords();
+	int axis = 0;
+	for (int i = 1; i < 3; i++) {
+		if (bounds[i * 2] - bounds[i * 2 + 1] > bounds[axis * 2] - bounds[axis * 2 + 1]) {
+			axis = i;
+		}
+	}
+	const float step = (bounds[axis * 2] - bounds[axis * 2 + 1]) / PIN_JOINTS;
+
+	pinSkeleton = new engine::Skeleton();
+	for (int joint = 0; joint < PIN_JOINTS; joint++) {
+		engine::ClipTransform bind;
+		if (joint == 0) {
+			bind.translation[0] = (bounds[0] + bounds[1]) / 2.0f;
+			bind.translation[1] = (bounds[2] + bounds[3]) / 2.0f;
+			bind.translation[2] = (bounds[4] + bounds[5]) / 2.0f;
+			bind.translation[axis] = bounds[axis * 2 + 1];
+		}
+		else {
+			bind.translation[axis] = step;
+		}
+		pinSkeleton->addJoint("pin" + std::to_string(joint), joint - 1, bind);
+	}
+	mesh->setSkinWeights(pinSkeleton->computeSkinWeights(mesh->getVertices(), step * 0.5f));
+
+	// Every joint sways a little more, a little later than its parent
+	const float sampleRate = 30.0f, period = 2.0f;
+	const int frames = (int)(sampleRate * period) + 1;
+	const int bendAxis = (axis + 1) % 3;
+	std::vector<engine::AnimationClip::RawCurve> curves;
+	for (int joint = 0; joint < PIN_JOINTS; joint++) {
+		engine::AnimationClip::RawCurve curve = { (uint16_t)joint, engine::ClipChannel::ROTATION, {} };
+		for (int frame = 0; frame < frames; frame++) {
+			const float phase = 2.0f * 3.14159265f * (frame / (float)(frames - 1) - joint * 0.1f);
+			const float angle = PIN_SWAY * 3.14159265f / 180.0f * std::sin(phase);
+			float rotation[4] = { 0.0f, 0.0f, 0.0f, std::cos(angle / 2.0f) };
+			rotation[bendAxis] = std::sin(angle / 2.0f);
+			curve.values.insert(curve.values.end(), rotation, rotation + 4);
+		}
+		curves.push_back(curve);
+	}
+	pinClip = engine::AnimationClip::compress(curves, sampleRate);
+}
+
+void createSkinnedObjects() {
+	// Its own copy of the pin, the skin weights are added to its buffers
+	engine::Mesh* mesh = engine::Mesh::parseMesh("../../assets/models/pin.obj", shaderProgram);
+	createPinAnimation(mesh);
+
+	engine::Material* material = engine::Material::parseMaterial(0.2f, 0.3f, 24.0f, 1.0f, 1);
+	pinSkin = new engine::Skin(pinSkeleton, mesh);
+	// The shadows come from the CPU skinned vertices
+	pinSkin->setCpuSkinning(true);
+
+	wobbler = sceneGraph->createNode();
+	wobbler->setMesh(mesh);
+	wobbler->setSkin(pinSkin);
+	wobbler->setColor(TEST_1);
+	wobbler->setMaterial(material);
+	wobbler->setScale({ 1.5f, 1.5f, 1.5f });
+	wobbler->setPosition({ 3.0f, -17.3f, -4.6f });
+	wobbler->setRotation(engine::Quaternion::fromAngleAxis(90.0f, engine::Vector3(1.0f, 0.0f, 0.0f)));
+	engine::AnimationSystem::getInstance()->play(pinSkin, pinClip);
+}
+
 void createSceneGraph() {
 	sceneGraph = new engine::SceneGraph();
 	sceneGraph->setCamera(camera);
 
+	// Small material textures are packed into one array, so their nodes share a single binding
+	materialTextures = new engine::TextureArray(MATERIAL_TEXTURE_SIZE, MATERIAL_TEXTURE_SIZE, MATERIAL_TEXTURE_LAYERS);
+
 	engine::SceneNode* root = sceneGraph->getRoot();
 	root->setShaderProgram(shaderProgram);
 	root->setShadowShaderProgram(simpleDepthShader);
 
 	createBase();
 	createObjects();
+	createSkinnedObjects();
 	//createTransperentObjects();
+
+	warmShaderVariants(root);
 }
 
 void drawScene() {
 	// Move light position
 	//lightPos.x = float(1.0f + sin(glfwGetTime()) * 2.0f);
 	//lightPos.z = float(sin(glfwGetTime() / 2.0f) * 1.0f);
-	// Create light model matrix
-	engine::Matrix4 lightOrtho = camera->createOrthographicProjectionMatrix(-20, 20, -20, 20, 0.5, 100);
-	engine::Matrix4 lightView = camera->createViewMatrix(lightPos, engine::Vector3(0), engine::Vector3(0.0f, 1.0f, 0.0f));
-	engine::Matrix4 lightSpaceMatrix = lightOrtho * lightView;
-	
-	// Set uniform light matrix in depth shader
-	simpleDepthShader->use();
-	glUniformMatrix4fv(glGetUniformLocation(simpleDepthShader->getShaderId(), "lightSpaceMatrix"), 1, GL_FALSE, lightSpaceMatrix.elements);
-	// Draw depth map scene
-	glViewport(0, 0, SHADOW_WIDTH, SHADOW_HEIGHT);
-	glBindFramebuffer(GL_FRAMEBUFFER, depthMapFBO);
-		glClear(GL_DEPTH_BUFFER_BIT);
-
-		sceneGraph->drawDepthMap(simpleDepthShader);
+	// Fit the shadow cascades to the camera frustum
+	shadowCascades->update(camera, lightPos);
+	const int cascades = shadowCascades->getCascadeCount();
+	engine::Vector3 eye = camera->getEye();
+
+	// One FrameBlock for every program, written to the stream buffer
+	engine::StreamBuffer* stream = engine::StreamBuffer::getInstance();
+	engine::RenderState* state = engine::RenderState::getInstance();
+	engine::StreamBuffer::Allocation frame = stream->allocateUniform(sizeof(FrameData));
+	if (frame.isValid()) {
+		FrameData* data = (FrameData*)frame.data;
+		std::memset(data, 0, sizeof(FrameData));
+		for (int i = 0; i < cascades; i++) {
+			std::memcpy(data->lightSpaceMatrices[i], shadowCascades->getMatrix(i).elements, sizeof(data->lightSpaceMatrices[i]));
+			data->cascadeSplits[i] = shadowCascades->getSplit(i);
+			data->cascadeScales[i] = shadowCascades->getScale(i);
+		}
+		data->lightPos[0] = lightPos.x;
+		data->lightPos[1] = lightPos.y;
+		data->lightPos[2] = lightPos.z;
+		data->powerSlide = turbPower;
+		data->viewPos[0] = eye.x;
+		data->viewPos[1] = eye.y;
+		data->viewPos[2] = eye.z;
+		data->cascadeCount = cascades;
+		stream->flush();
+		state->bindBufferRange(GL_UNIFORM_BUFFER, shaderProgram->getBinding("FRAME_BP"),
+			stream->getId(), frame.offset, frame.size);
+	}
+	// Nodes that started or stopped moving, or whose mesh finished loading, must leave or join the cached static casters
+	if (casterVersion != engine::SceneNode::getCasterVersion()) {
+		casterVersion = engine::SceneNode::getCasterVersion();
+		shadowCascades->invalidateCache();
+	}
+	// Draw the depth of each cascade into its layer, the depth programs read its matrix from the CascadeBlock
+	for (int i = 0; i < cascades; i++) {
+		engine::StreamBuffer::Allocation cascade = stream->allocateUniform(sizeof(engine::Matrix4::elements));
+		if (!cascade.isValid()) {
+			break;
+		}
+		std::memcpy(cascade.data, shadowCascades->getMatrix(i).elements, cascade.size);
+		stream->flush();
+		state->bindBufferRange(GL_UNIFORM_BUFFER, simpleDepthShader->getBinding("CASCADE_BP"),
+			stream->getId(), cascade.offset, cascade.size);
+		shadowCascades->bindLayer(i);
+		// Static casters come from the cache while the cascade stays put, dynamic ones are drawn on top
+		if (!shadowCascades->restoreCache(i)) {
+			glClear(GL_DEPTH_BUFFER_BIT);
+			sceneGraph->drawDepthMap(simpleDepthShader, shadowCascades->getMatrix(i), engine::ShadowCasters::STATIC);
+			shadowCascades->storeCache(i);
+		}
+		sceneGraph->drawDepthMap(simpleDepthShader, shadowCascades->getMatrix(i), engine::ShadowCasters::DYNAMIC);
+	}
 	glBindFramebuffer(GL_FRAMEBUFFER, 0);
 	glViewport(0, 0, WINDOW_WIDTH, WINDOW_HEIGHT);
 	glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-	// Set light uniforms in normal shader
-	shaderProgram->use();
-	glUniform3f(glGetUniformLocation(shaderProgram->getShaderId(), "lightPos"), lightPos.x, lightPos.y, lightPos.z);
-	engine::Vector3 eye = camera->getEye();
-	glUniform3f(glGetUniformLocation(shaderProgram->getShaderId(), "viewPos"), eye.x, eye.y, eye.z);
-	glUniformMatrix4fv(glGetUniformLocation(shaderProgram->getShaderId(), "lightSpaceMatrix"), 1, GL_FALSE, lightSpaceMatrix.elements);
 	// Draw normal scene
-	glActiveTexture(GL_TEXTURE0);
-	glBindTexture(GL_TEXTURE_2D, depthMap);
+	state->bindTexture(0, GL_TEXTURE_2D_ARRAY, shadowCascades->getTexture());
     if (firstFrame) {
 		firstFrame = false;
 	} else { 
 		engine::Physics::getInstance()->update();
 	}
 
-	glCullFace(GL_BACK);
+	state->cullFace(GL_BACK);
 	skyboxShader->use();
 	skybox->drawCubemap();
-	glCullFace(GL_FRONT);
+	state->cullFace(GL_FRONT);
 
+	groundTexture->update(camera, WINDOW_HEIGHT);
 	sceneGraph->draw();
 }
 
-void createDepthMap() {
-	glGenFramebuffers(1, &depthMapFBO);
-	// Create depth texture
-	glGenTextures(1, &depthMap);
-	glBindTexture(GL_TEXTURE_2D, depthMap);
-	glTexImage2D(GL_TEXTURE_2D, 0, GL_DEPTH_COMPONENT, SHADOW_WIDTH, SHADOW_HEIGHT, 0, GL_DEPTH_COMPONENT, GL_FLOAT, NULL);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
-
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_BORDER);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_BORDER);
-	float borderColor[] = { 1.0, 1.0, 1.0, 1.0 };
-	glTexParameterfv(GL_TEXTURE_2D, GL_TEXTURE_BORDER_COLOR, borderColor);
-	// Attach depth texture as FBO's depth buffer
-	glBindFramebuffer(GL_FRAMEBUFFER, depthMapFBO);
-	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D, depthMap, 0);
-	glDrawBuffer(GL_NONE);
-	glReadBuffer(GL_NONE);
-	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+void createShadowCascades() {
+	shadowCascades = new engine::ShadowCascades(SHADOW_CASCADES, CASCADE_RESOLUTIONS[0]);
+	for (int i = 0; i < SHADOW_CASCADES; i++) {
+		shadowCascades->setResolution(i, CASCADE_RESOLUTIONS[i]);
+	}
+	shadowCascades->setMaxDistance(SHADOW_DISTANCE);
 }
 
 void createSkybox() {
-	engine::Mesh* skymesh = engine::Mesh::parseMesh("../../assets/models/skybox.obj", skyboxShader);
+	engine::Mesh* skymesh = engine::AssetLoader::getInstance()->loadMesh("../../assets/models/skybox.obj", skyboxShader);
 	
 		std::vector<std::string> faces
 	{
@@ -299,7 +487,7 @@ void createSkybox() {
 		"../../assets/skybox/dt/back.jpg"
 	};
 
-	skybox = engine::Cubemap::loadCubemap(faces2, skymesh);
+	skybox = engine::AssetLoader::getInstance()->loadCubemap(faces2, skymesh);
 }
 
 ///////////////////////////////////////////////////////////////////// CALLBACKS
@@ -340,36 +528,141 @@ void moveDown() {
 const char* createScreenshotBasename() {
 	static char basename[30];
 	time_t t = time(NULL);
-	strftime(basename, 30, "%Y%m%d_%H%M%S.png", localtime(&t));
+	strftime(basename, 30, "%Y%m%d_%H%M%S", localtime(&t));
 	return basename;
 }
 
 void saveScreenshot() {
-	unsigned char* pixels = (unsigned char*)malloc(WINDOW_WIDTH * WINDOW_HEIGHT * 4);
-	if (pixels != NULL) {
-		glReadPixels(0, 0, WINDOW_WIDTH, WINDOW_HEIGHT, GL_RGBA, GL_UNSIGNED_BYTE, pixels);
+	frameCapture->screenshot(SCREENSHOT_DIRECTORY + createScreenshotBasename() + ".png");
+}
+
+void toggleRecording(const engine::CaptureFormat format) {
+	if (frameCapture->isRecording()) {
+		frameCapture->stopRecording();
+		return;
+	}
+	const std::string basename = SCREENSHOT_DIRECTORY + "capture_" + createScreenshotBasename();
+	if (frameCapture->startRecording(basename, format)) {
+		std::cout << "Recording to " << basename << std::endl;
 	}
-	char filename[50];
-	strcpy(filename, "../../screenshots/");
-	strcat(filename, createScreenshotBasename());
+}
 
-	stbi_flip_vertically_on_write(1);
-	int saved = stbi_write_png(filename, WINDOW_WIDTH, WINDOW_HEIGHT, 4, pixels, 0);
+/**
+* Starts benchmarking both skinning paths on many copies of the skinned pin, one run per frame:
+* the CPU path deforms the vertices on the workers and uploads them, the GPU path deforms them in the
+* vertex shader of the depth pre-pass, which is timed against drawing the already deformed vertices
+*/
+void startSkinningBenchmark() {
+	if (!benchmarkSkins.empty()) {
+		return;
+	}
+	for (int i = 0; i < SKINNING_BENCHMARK_INSTANCES; i++) {
+		engine::Skin* skin = new engine::Skin(pinSkeleton, pinSkin->getMesh());
+		skin->getPose() = pinSkin->getPose();
+		skin->setCpuSkinning(true);
+		benchmarkSkins.push_back(skin);
+	}
+	benchmarkRuns = 0;
+	benchmarkCpu[0] = benchmarkCpu[1] = benchmarkUpload = 0.0;
+	benchmarkGpu[0] = benchmarkGpu[1] = 0;
+}
 
-	if (saved) printf("Successfully Saved Image: %s\n", filename);
-	else fprintf(stderr, "Failed Saving Image: %s\n", filename);
+void stopSkinningBenchmark() {
+	for (engine::Skin* skin : benchmarkSkins) {
+		delete skin;
+	}
+	benchmarkSkins.clear();
+}
+
+/**
+* Prints the times of the skinning benchmark, per run
+*/
+void printSkinningBenchmark() {
+	const double runs = benchmarkRuns;
+	std::cout << "Skinning " << benchmarkSkins.size() << " x " << pinSkin->getMesh()->getVertices().size() << " vertices, per frame:" << std::endl
+		<< "  CPU " << benchmarkCpu[1] / runs << " ms on the workers (" << benchmarkCpu[0] / runs << " ms on one thread), "
+		<< benchmarkUpload / runs << " ms to upload" << std::endl
+		<< "  GPU " << benchmarkGpu[0] / runs / 1e6 << " ms skinned in the vertex shader, "
+		<< benchmarkGpu[1] / runs / 1e6 << " ms drawing the CPU skinned vertices" << std::endl;
+}
+
+/**
+* Runs one frame of the skinning benchmark, between the begin and the end of the stream buffer frame
+* The palettes are bound from the stream buffer, so a single frame cannot hold every run
+*/
+void runSkinningBenchmark() {
+	if (benchmarkSkins.empty()) {
+		return;
+	}
+	engine::AnimationSystem* animations = engine::AnimationSystem::getInstance();
+	typedef std::chrono::steady_clock Clock;
+	for (int threaded = 0; threaded < 2; threaded++) {
+		animations->setParallel(threaded == 1);
+		const Clock::time_point start = Clock::now();
+		for (engine::Skin* skin : benchmarkSkins) {
+			skin->updatePalette();
+		}
+		animations->skinVertices(benchmarkSkins);
+		benchmarkCpu[threaded] += std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+	}
+	animations->setParallel(true);
+	const Clock::time_point start = Clock::now();
+	for (engine::Skin* skin : benchmarkSkins) {
+		skin->getPosedMesh();
+	}
+	glFinish();
+	benchmarkUpload += std::chrono::duration<double, std::milli>(Clock::now() - start).count();
 
-	free(pixels);
+	// GPU time of the same draws, skinned in the vertex shader or reading the CPU skinned vertices
+	engine::ShaderProgram* programs[2] = {
+		simpleDepthShader->getVariant(engine::ShaderProgram::DEPTH_ONLY | engine::ShaderProgram::SKINNED),
+		simpleDepthShader->getVariant(engine::ShaderProgram::DEPTH_ONLY)
+	};
+	GLuint queries[2];
+	glGenQueries(2, queries);
+	bool bound = true;
+	for (int path = 0; path < 2 && bound; path++) {
+		programs[path]->use();
+		glUniformMatrix4fv(programs[path]->getUniform("model"), 1, GL_FALSE, wobbler->getWorldMatrix()->elements);
+		glBeginQuery(GL_TIME_ELAPSED, queries[path]);
+		for (engine::Skin* skin : benchmarkSkins) {
+			if (path == 0) {
+				// A draw without its own palette would time nothing meaningful
+				bound = skin->bind(programs[path]->getBinding("SKIN_BP"));
+				if (!bound) {
+					break;
+				}
+				skin->getMesh()->draw();
+			}
+			else {
+				skin->getPosedMesh()->draw();
+			}
+		}
+		glEndQuery(GL_TIME_ELAPSED);
+		GLuint64 elapsed;
+		glGetQueryObjectui64v(queries[path], GL_QUERY_RESULT, &elapsed);
+		benchmarkGpu[path] += elapsed;
+	}
+	glDeleteQueries(2, queries);
+	glClear(GL_DEPTH_BUFFER_BIT);
+
+	if (!bound) {
+		std::cerr << "[Skinning benchmark] The stream buffer is full, the benchmark is stopped" << std::endl;
+		stopSkinningBenchmark();
+		return;
+	}
+	if (++benchmarkRuns == SKINNING_BENCHMARK_RUNS) {
+		printSkinningBenchmark();
+		stopSkinningBenchmark();
+	}
 }
 
 void increaseTurbPower() {
 	turbPower += 1.0f;
-	glUniform1f(shaderProgram->getUniform("powerSlide"), turbPower);
 }
 
 void decreaseTurbPower() {
 	turbPower -= 1.0f;
-	glUniform1f(shaderProgram->getUniform("powerSlide"), turbPower);
 }
 
 void setupKeyBufferCallbacks() {
@@ -437,6 +730,32 @@ void keyboard_callback(GLFWwindow* win, int key, int scancode, int action, int m
 			saveScreenshot();
 		}
 		return;
+	case GLFW_KEY_R:
+		if (action == GLFW_PRESS) {
+			toggleRecording(engine::CaptureFormat::PNG_SEQUENCE);
+		}
+		return;
+	case GLFW_KEY_Y:
+		if (action == GLFW_PRESS) {
+			toggleRecording(engine::CaptureFormat::RAW_YUV);
+		}
+		return;
+	case GLFW_KEY_M:
+		if (action == GLFW_PRESS) {
+			engine::RenderQueue& queue = sceneGraph->getRenderQueue();
+			queue.setIndirect(!queue.isIndirect());
+		}
+		return;
+	case GLFW_KEY_O:
+		if (action == GLFW_PRESS) {
+			sceneGraph->setDepthPrepass(!sceneGraph->isDepthPrepass());
+		}
+		return;
+	case GLFW_KEY_K:
+		if (action == GLFW_PRESS) {
+			startSkinningBenchmark();
+		}
+		return;
 	default:
 		break;
 	}
@@ -527,16 +846,17 @@ void setupOpenGL(int winx, int winy) {
 	checkOpenGLInfo();
 #endif
 	glClearColor(0.2f, 0.3f, 0.3f, 1.0f);
-	glEnable(GL_DEPTH_TEST);
-	glEnable(GL_BLEND);
-	glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
-	glDepthFunc(GL_LEQUAL);
-	glDepthMask(GL_TRUE);
+	engine::RenderState* state = engine::RenderState::getInstance();
+	state->enable(GL_DEPTH_TEST);
+	state->enable(GL_BLEND);
+	state->blendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+	state->depthFunc(GL_LEQUAL);
+	state->depthMask(GL_TRUE);
 	glDepthRange(0.0, 1.0);
 	glClearDepth(1.0);
-	glEnable(GL_CULL_FACE);
-	glCullFace(GL_FRONT);
-	glFrontFace(GL_CCW);
+	state->enable(GL_CULL_FACE);
+	state->cullFace(GL_FRONT);
+	state->frontFace(GL_CCW);
 	glViewport(0, 0, winx, winy);
 }
 
@@ -546,19 +866,35 @@ GLFWwindow* setup(int major = 4, int minor = 3, int winx = WINDOW_WIDTH, int win
 	setupOpenGL(winx, winy);
 	setupKeyBufferCallbacks();
 	setupErrorCallback();
+	const double shaderStart = glfwGetTime();
 	createShaderProgram();
+	std::cout << "Shader programs ready in " << (glfwGetTime() - shaderStart) * 1000.0 << " ms"
+		<< (engine::ShaderCache::isSupported() ? " (binary cache enabled)" : "") << std::endl;
 	createCamera(winx, winy);
-	createDepthMap();
+	createShadowCascades();
 	createSkybox();
 	createSceneGraph();
+	frameCapture = new engine::FrameCapture();
 	return win;
 }
 
 ////////////////////////////////////////////////////////////////////////// RUN
 
 void display(GLFWwindow* win, double elapsed_sec) {
-	glfwSetWindowTitle(win, std::string(title).append(" - ").append(std::to_string(elapsed_sec)).append("s").c_str());
+	engine::RenderState* state = engine::RenderState::getInstance();
+	glfwSetWindowTitle(win, std::string(title).append(" - ").append(std::to_string(elapsed_sec)).append("s")
+		.append(" - draw calls ").append(std::to_string(sceneGraph->getRenderQueue().getDrawCalls()))
+		.append(sceneGraph->getRenderQueue().isIndirect() ? " (indirect)" : "")
+		.append(" - GL state calls ").append(std::to_string(state->getIssued()))
+		.append(" (").append(std::to_string(state->getAvoided())).append(" skipped)")
+		.append(" - shaded samples ").append(std::to_string(sceneGraph->getShadedSamples()))
+		.append(sceneGraph->isDepthPrepass() ? " (depth pre-pass)" : "").c_str());
+	engine::StreamBuffer* stream = engine::StreamBuffer::getInstance();
+	stream->beginFrame();
+	runSkinningBenchmark();
 	drawScene();
+	stream->endFrame();
+	state->endFrame();
 }
 
 void run(GLFWwindow* win) {
@@ -569,18 +905,67 @@ void run(GLFWwindow* win) {
 		last_time = time;
 
 		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+		engine::ShaderWatcher::getInstance()->poll();
+		engine::AssetLoader::getInstance()->processUploads(UPLOAD_BUDGET_MS);
 		engine::KeyBuffer::runCallbacks();
+		engine::AnimationSystem::getInstance()->update((float)elapsed_time);
 		display(win, elapsed_time);
+		int width, height;
+		glfwGetFramebufferSize(win, &width, &height);
+		frameCapture->endFrame(width, height);
 		glfwSwapBuffers(win);
 		glfwPollEvents();
 	}
+	// Finishes writing the captured frames while the context is still alive
+	frameCapture->stopRecording();
+	delete frameCapture;
+	delete groundTexture;
+	stopSkinningBenchmark();
+	engine::AnimationSystem::getInstance()->stop(pinSkin);
+	delete pinSkin;
+	delete pinClip;
+	delete pinSkeleton;
 	glfwDestroyWindow(win);
 	glfwTerminate();
 }
 
 ////////////////////////////////////////////////////////////////////////// MAIN
 
+/**
+* Offline texture compression: CGJ-Engine --compress <source> <destination.dds> <bc1|bc3|bc7>
+*/
+int compressTexture(int argc, char* argv[]) {
+	if (argc != 5) {
+		std::cerr << "Usage: " << argv[0] << " --compress <source> <destination.dds> <bc1|bc3|bc7>" << std::endl;
+		return EXIT_FAILURE;
+	}
+	std::string name(argv[4]);
+	engine::BlockFormat format;
+	if (name == "bc1") {
+		format = engine::BlockFormat::BC1;
+	}
+	else if (name == "bc3") {
+		format = engine::BlockFormat::BC3;
+	}
+	else if (name == "bc7") {
+		format = engine::BlockFormat::BC7;
+	}
+	else {
+		std::cerr << "Unknown block format " << name << std::endl;
+		return EXIT_FAILURE;
+	}
+	if (!engine::TextureCompressor::compressFile(argv[2], argv[3], format)) {
+		std::cerr << "Failed to compress " << argv[2] << std::endl;
+		return EXIT_FAILURE;
+	}
+	std::cout << "Compressed " << argv[2] << " to " << argv[3] << std::endl;
+	return EXIT_SUCCESS;
+}
+
 int main(int argc, char* argv[]) {
+	if (argc > 1 && std::string(argv[1]) == "--compress") {
+		return compressTexture(argc, argv);
+	}
 	GLFWwindow* win = setup();
 	run(win);
 	exit(EXIT_SUCCESS);
@@ -1,4 +1,8 @@
 #include "camera/Camera.h"
+#include "render/RenderState.h"
+#include "render/StreamBuffer.h"
+#include <cmath>
+#include <cstring>
 using namespace std;
 
 namespace engine {
@@ -203,35 +207,67 @@ namespace engine {
 		}
 	}
 
+	Vector3 Camera::getDirection() const {
+		// The view starts from the rotation matrices, before the first mouse move sets a direction
+		if (center.length() == 0.0f) {
+			return Vector3(0.0f, 0.0f, -1.0f);
+		}
+		return center.normalize();
+	}
+
+	const float Camera::getFov() const {
+		return fov;
+	}
+
+	const float Camera::getAspect() const {
+		return aspect;
+	}
+
+	const float Camera::getNear() const {
+		return n;
+	}
+
+	const float Camera::getFar() const {
+		return f;
+	}
+
+	Vector2 Camera::getOrthographicExtent() const {
+		return Vector2(std::fabs(r - l) / 2.0f, std::fabs(t - b) / 2.0f);
+	}
+
+	const bool Camera::isOrthographic() const {
+		return ortho;
+	}
+
 	void Camera::toggleProjection() { 
 		ortho = !ortho;
 	}
 
 	void Camera::createBufferObject() {
+		RenderState* state = RenderState::getInstance();
 		glGenVertexArrays(1, &VaoId);
-		glBindVertexArray(VaoId);
-		glGenBuffers(1, &VboId);
-		glBindBuffer(GL_UNIFORM_BUFFER, VboId); {
-			glBufferData(GL_UNIFORM_BUFFER, Matrix4::size() * 2, 0, GL_STREAM_DRAW);
-			glBindBufferBase(GL_UNIFORM_BUFFER, ubo_bp, VboId);
-		}
+		state->bindVertexArray(VaoId);
+		state->bindVertexArray(0);
 	}
 
 	void Camera::destroyBufferObject() const {
-		glBindVertexArray(VaoId);
-		glDeleteBuffers(1, &VboId);
+		RenderState* state = RenderState::getInstance();
 		glDeleteVertexArrays(1, &VaoId);
-		glBindBuffer(GL_UNIFORM_BUFFER, 0);
-		glBindVertexArray(0);
+		state->forgetVertexArray(VaoId);
 	}
 
 	void Camera::draw() {
-		glBindVertexArray(VaoId);
-		glBindBuffer(GL_UNIFORM_BUFFER, VboId); {
-			glBufferSubData(GL_UNIFORM_BUFFER, 0, Matrix4::size(), &getViewMatrix());
-			glBufferSubData(GL_UNIFORM_BUFFER, Matrix4::size(), Matrix4::size(), &getProjectionMatrix());
+		// The matrices of each frame get their own slice of the stream buffer, no sync with the GPU
+		StreamBuffer* stream = StreamBuffer::getInstance();
+		StreamBuffer::Allocation matrices = stream->allocateUniform(Matrix4::size() * 2);
+		if (!matrices.isValid()) {
+			return;
 		}
-		glBindBuffer(GL_UNIFORM_BUFFER, 0);
-		glBindVertexArray(0);
+		const Matrix4 view = getViewMatrix();
+		const Matrix4 projection = getProjectionMatrix();
+		std::memcpy(matrices.data, view.elements, Matrix4::size());
+		std::memcpy((unsigned char*)matrices.data + Matrix4::size(), projection.elements, Matrix4::size());
+		stream->flush();
+		RenderState::getInstance()->bindBufferRange(GL_UNIFORM_BUFFER, ubo_bp, stream->getId(), matrices.offset, matrices.size);
 	}
 }
\ No newline at end of file
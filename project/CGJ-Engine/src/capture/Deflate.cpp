@@ -0,0 +1,492 @@
+#include "capture/Deflate.h"
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <queue>
+
+namespace engine {
+
+	/**
+	* For all implementations in this file, @see Deflate.h for details
+	*/
+
+	static const uint16_t LENGTH_BASE[29] = { 3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31, 35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258 };
+	static const uint8_t LENGTH_EXTRA[29] = { 0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2, 3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0 };
+	static const uint16_t DISTANCE_BASE[30] = { 1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193, 257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577 };
+	static const uint8_t DISTANCE_EXTRA[30] = { 0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6, 7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13 };
+	// Order the code length code lengths are written in
+	static const uint8_t CODE_LENGTH_ORDER[19] = { 16, 17, 18, 0, 8, 7, 9, 6, 10, 5, 11, 4, 12, 3, 13, 2, 14, 1, 15 };
+
+	/**
+	* Length and distance codes by value, distances below 257 directly and the others by 128
+	*/
+	struct CodeTables {
+		uint8_t length[259];
+		uint8_t distance[512];
+		uint32_t crc[256];
+
+		CodeTables() {
+			for (uint8_t code = 0; code < 29; code++) {
+				for (int l = LENGTH_BASE[code]; l < LENGTH_BASE[code] + (1 << LENGTH_EXTRA[code]) && l <= 258; l++) {
+					length[l] = code;
+				}
+			}
+			// 258 has its own code, not the last one of 227
+			length[258] = 28;
+			for (uint8_t code = 0; code < 30; code++) {
+				for (int d = DISTANCE_BASE[code]; d < DISTANCE_BASE[code] + (1 << DISTANCE_EXTRA[code]); d++) {
+					const int index = d - 1 < 256 ? d - 1 : 256 + ((d - 1) >> 7);
+					distance[index] = code;
+				}
+			}
+			for (uint32_t n = 0; n < 256; n++) {
+				uint32_t c = n;
+				for (int k = 0; k < 8; k++) {
+					c = c & 1 ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+				}
+				crc[n] = c;
+			}
+		}
+
+		static const CodeTables& get() {
+			static const CodeTables tables;
+			return tables;
+		}
+
+		const uint8_t distanceCode(const int d) const {
+			return distance[d - 1 < 256 ? d - 1 : 256 + ((d - 1) >> 7)];
+		}
+	};
+
+	void Deflate::BitWriter::put(const uint32_t bits, const int length) {
+		buffer |= (uint64_t)bits << count;
+		count += length;
+		while (count >= 8) {
+			out.push_back((unsigned char)buffer);
+			buffer >>= 8;
+			count -= 8;
+		}
+	}
+
+	void Deflate::BitWriter::align() {
+		if (count > 0) {
+			out.push_back((unsigned char)buffer);
+		}
+		buffer = 0;
+		count = 0;
+	}
+
+	Deflate::Deflate(const CompressionLevel compression) : level(compression) {
+		if (level == CompressionLevel::FAST) {
+			maxChain = 4;
+			niceLength = 32;
+			lazy = false;
+		}
+		else {
+			maxChain = 64;
+			niceLength = 128;
+			lazy = true;
+		}
+		head.resize(1 << HASH_BITS);
+		prev.resize(WINDOW_SIZE);
+	}
+
+	/**
+	* Gives unused symbols a count until two are used, a code of one symbol is incomplete
+	*/
+	static void completeCode(std::vector<uint32_t>& frequencies) {
+		size_t used = frequencies.size() - std::count(frequencies.begin(), frequencies.end(), 0u);
+		for (size_t i = 0; i < frequencies.size() && used < 2; i++) {
+			if (frequencies[i] == 0) {
+				frequencies[i] = 1;
+				used++;
+			}
+		}
+	}
+
+	static inline uint32_t hash(const unsigned char* p) {
+		return ((uint32_t)(p[0] << 16 | p[1] << 8 | p[2]) * 2654435761u) >> (32 - 15);
+	}
+
+	void Deflate::insert(const unsigned char* data, const size_t pos) {
+		const uint32_t h = hash(data + pos);
+		prev[pos & (WINDOW_SIZE - 1)] = head[h];
+		head[h] = (int32_t)pos;
+	}
+
+	int Deflate::findMatch(const unsigned char* data, const size_t length, const size_t pos, int& distance) const {
+		const int maxLength = (int)std::min((size_t)MAX_MATCH, length - pos);
+		if (maxLength < MIN_MATCH) {
+			return 0;
+		}
+		const unsigned char* current = data + pos;
+		int best = MIN_MATCH - 1;
+		int chain = maxChain;
+		int32_t candidate = head[hash(current)];
+		while (candidate >= 0 && chain-- > 0) {
+			const size_t d = pos - candidate;
+			if (d > WINDOW_SIZE) {
+				break;
+			}
+			const unsigned char* match = data + candidate;
+			// The byte that would make the match longer first, it differs most often
+			if (match[best] == current[best] && match[0] == current[0] && match[1] == current[1]) {
+				// Eight bytes at a time while they agree
+				int l = 2;
+				while (l + 8 <= maxLength && std::memcmp(match + l, current + l, 8) == 0) {
+					l += 8;
+				}
+				while (l < maxLength && match[l] == current[l]) {
+					l++;
+				}
+				if (l > best) {
+					best = l;
+					distance = (int)d;
+					if (l >= niceLength || l == maxLength) {
+						break;
+					}
+				}
+			}
+			const int32_t next = prev[candidate & (WINDOW_SIZE - 1)];
+			if (next >= candidate) {
+				break;
+			}
+			candidate = next;
+		}
+		return best >= MIN_MATCH ? best : 0;
+	}
+
+	void Deflate::compress(const unsigned char* data, const size_t length, const bool final, std::vector<unsigned char>& out) {
+		BitWriter writer(out);
+		std::fill(head.begin(), head.end(), -1);
+		symbols.clear();
+		symbols.reserve(std::min(length, (size_t)BLOCK_SYMBOLS));
+
+		// Positions inside long matches are not indexed at the fast level
+		const int indexedLength = level == CompressionLevel::FAST ? 16 : MAX_MATCH;
+		size_t indexed = 0;
+		size_t pos = 0;
+		while (pos < length) {
+			while (indexed < pos && indexed + MIN_MATCH <= length) {
+				insert(data, indexed++);
+			}
+			indexed = std::max(indexed, pos);
+
+			int distance = 0;
+			int matched = findMatch(data, length, pos, distance);
+			if (matched != 0 && lazy && matched < niceLength && pos + 1 + MIN_MATCH <= length) {
+				insert(data, indexed++);
+				int nextDistance = 0;
+				// A longer match on the next byte is worth a literal
+				if (findMatch(data, length, pos + 1, nextDistance) > matched) {
+					matched = 0;
+				}
+			}
+			if (matched != 0) {
+				symbols.push_back({ (uint16_t)matched, (uint16_t)distance });
+				pos += matched;
+				if (matched > indexedLength) {
+					indexed = pos;
+				}
+			}
+			else {
+				symbols.push_back({ data[pos], 0 });
+				pos++;
+			}
+			if (symbols.size() >= BLOCK_SYMBOLS) {
+				writeBlock(writer, false);
+				symbols.clear();
+			}
+		}
+		writeBlock(writer, final);
+		symbols.clear();
+
+		if (!final) {
+			// Empty stored block, aligns the output so the next piece starts on a byte
+			writer.put(0, 3);
+			writer.align();
+			writer.put(0x0000, 16);
+			writer.put(0xFFFF, 16);
+		}
+		writer.align();
+	}
+
+	void Deflate::buildLengths(const std::vector<uint32_t>& frequencies, const int maxBits, std::vector<uint8_t>& lengths) {
+		lengths.assign(frequencies.size(), 0);
+		std::vector<int> used;
+		for (size_t i = 0; i < frequencies.size(); i++) {
+			if (frequencies[i] != 0) {
+				used.push_back((int)i);
+			}
+		}
+		if (used.size() < 2) {
+			for (int symbol : used) {
+				lengths[symbol] = 1;
+			}
+			return;
+		}
+
+		// Plain Huffman tree, leaves first, parents in creation order
+		typedef std::pair<uint64_t, int> Node;
+		std::priority_queue<Node, std::vector<Node>, std::greater<Node>> queue;
+		std::vector<int> parent(used.size() * 2 - 1, -1);
+		for (size_t i = 0; i < used.size(); i++) {
+			queue.push(Node(frequencies[used[i]], (int)i));
+		}
+		int created = (int)used.size();
+		while (queue.size() > 1) {
+			const Node a = queue.top();
+			queue.pop();
+			const Node b = queue.top();
+			queue.pop();
+			parent[a.second] = parent[b.second] = created;
+			queue.push(Node(a.first + b.first, created++));
+		}
+		std::vector<int> depth(created, 0);
+		int counts[64] = { 0 };
+		for (int node = created - 2; node >= 0; node--) {
+			depth[node] = depth[parent[node]] + 1;
+			if (node < (int)used.size()) {
+				counts[std::min(depth[node], 63)]++;
+			}
+		}
+
+		// Moves the leaves that are too deep up, then lengthens the shortest codes until the code is complete again
+		for (int l = maxBits + 1; l < 64; l++) {
+			counts[maxBits] += counts[l];
+			counts[l] = 0;
+		}
+		uint32_t total = 0;
+		for (int l = 1; l <= maxBits; l++) {
+			total += (uint32_t)counts[l] << (maxBits - l);
+		}
+		while (total != (1u << maxBits)) {
+			counts[maxBits]--;
+			for (int l = maxBits - 1; l > 0; l--) {
+				if (counts[l] != 0) {
+					counts[l]--;
+					counts[l + 1] += 2;
+					break;
+				}
+			}
+			total--;
+		}
+
+		// The most frequent symbols get the shortest codes
+		std::stable_sort(used.begin(), used.end(), [&frequencies](const int a, const int b) {
+			return frequencies[a] > frequencies[b];
+		});
+		size_t next = 0;
+		for (int l = 1; l <= maxBits; l++) {
+			for (int i = 0; i < counts[l]; i++) {
+				lengths[used[next++]] = (uint8_t)l;
+			}
+		}
+	}
+
+	void Deflate::buildCodes(const std::vector<uint8_t>& lengths, std::vector<uint16_t>& codes) {
+		int counts[16] = { 0 };
+		for (uint8_t l : lengths) {
+			counts[l]++;
+		}
+		counts[0] = 0;
+		uint16_t next[16] = { 0 };
+		uint16_t code = 0;
+		for (int bits = 1; bits < 16; bits++) {
+			code = (uint16_t)((code + counts[bits - 1]) << 1);
+			next[bits] = code;
+		}
+		codes.assign(lengths.size(), 0);
+		for (size_t i = 0; i < lengths.size(); i++) {
+			const int l = lengths[i];
+			if (l == 0) {
+				continue;
+			}
+			// Huffman codes are written from their most significant bit
+			uint16_t c = next[l]++;
+			uint16_t reversed = 0;
+			for (int b = 0; b < l; b++) {
+				reversed = (uint16_t)((reversed << 1) | (c & 1));
+				c >>= 1;
+			}
+			codes[i] = reversed;
+		}
+	}
+
+	void Deflate::writeBlock(BitWriter& writer, const bool final) {
+		const CodeTables& tables = CodeTables::get();
+		std::vector<uint32_t> literalFrequencies(286, 0), distanceFrequencies(30, 0);
+		for (const Symbol& symbol : symbols) {
+			if (symbol.distance == 0) {
+				literalFrequencies[symbol.length]++;
+			}
+			else {
+				literalFrequencies[257 + tables.length[symbol.length]]++;
+				distanceFrequencies[tables.distanceCode(symbol.distance)]++;
+			}
+		}
+		literalFrequencies[256] = 1;
+
+		completeCode(literalFrequencies);
+		completeCode(distanceFrequencies);
+
+		std::vector<uint8_t> literalLengths, distanceLengths;
+		buildLengths(literalFrequencies, 15, literalLengths);
+		buildLengths(distanceFrequencies, 15, distanceLengths);
+		int literals = 286, distances = 30;
+		while (literals > 257 && literalLengths[literals - 1] == 0) {
+			literals--;
+		}
+		while (distances > 1 && distanceLengths[distances - 1] == 0) {
+			distances--;
+		}
+
+		// Both code lengths run length encoded with the codes 16 (repeat), 17 and 18 (zeros)
+		std::vector<uint8_t> all(literalLengths.begin(), literalLengths.begin() + literals);
+		all.insert(all.end(), distanceLengths.begin(), distanceLengths.begin() + distances);
+		std::vector<std::pair<uint8_t, uint8_t>> runs;
+		for (size_t i = 0; i < all.size();) {
+			const uint8_t l = all[i];
+			size_t run = 1;
+			while (i + run < all.size() && all[i + run] == l) {
+				run++;
+			}
+			i += run;
+			if (l == 0) {
+				while (run >= 11) {
+					const size_t r = std::min(run, (size_t)138);
+					runs.push_back(std::make_pair(18, (uint8_t)(r - 11)));
+					run -= r;
+				}
+				if (run >= 3) {
+					runs.push_back(std::make_pair(17, (uint8_t)(run - 3)));
+					run = 0;
+				}
+			}
+			else {
+				runs.push_back(std::make_pair(l, 0));
+				run--;
+				while (run >= 3) {
+					const size_t r = std::min(run, (size_t)6);
+					runs.push_back(std::make_pair(16, (uint8_t)(r - 3)));
+					run -= r;
+				}
+			}
+			for (; run > 0; run--) {
+				runs.push_back(std::make_pair(l, 0));
+			}
+		}
+		std::vector<uint32_t> lengthFrequencies(19, 0);
+		for (const std::pair<uint8_t, uint8_t>& run : runs) {
+			lengthFrequencies[run.first]++;
+		}
+		completeCode(lengthFrequencies);
+		std::vector<uint8_t> lengthLengths;
+		buildLengths(lengthFrequencies, 7, lengthLengths);
+		int lengthCount = 19;
+		while (lengthCount > 4 && lengthLengths[CODE_LENGTH_ORDER[lengthCount - 1]] == 0) {
+			lengthCount--;
+		}
+
+		std::vector<uint16_t> literalCodes, distanceCodes, lengthCodes;
+		buildCodes(literalLengths, literalCodes);
+		buildCodes(distanceLengths, distanceCodes);
+		buildCodes(lengthLengths, lengthCodes);
+
+		writer.put(final ? 1 : 0, 1);
+		writer.put(2, 2);
+		writer.put(literals - 257, 5);
+		writer.put(distances - 1, 5);
+		writer.put(lengthCount - 4, 4);
+		for (int i = 0; i < lengthCount; i++) {
+			writer.put(lengthLengths[CODE_LENGTH_ORDER[i]], 3);
+		}
+		for (const std::pair<uint8_t, uint8_t>& run : runs) {
+			writer.put(lengthCodes[run.first], lengthLengths[run.first]);
+			if (run.first == 16) {
+				writer.put(run.second, 2);
+			}
+			else if (run.first == 17) {
+				writer.put(run.second, 3);
+			}
+			else if (run.first == 18) {
+				writer.put(run.second, 7);
+			}
+		}
+
+		for (const Symbol& symbol : symbols) {
+			if (symbol.distance == 0) {
+				writer.put(literalCodes[symbol.length], literalLengths[symbol.length]);
+				continue;
+			}
+			const uint8_t lengthCode = tables.length[symbol.length];
+			writer.put(literalCodes[257 + lengthCode], literalLengths[257 + lengthCode]);
+			writer.put(symbol.length - LENGTH_BASE[lengthCode], LENGTH_EXTRA[lengthCode]);
+			const uint8_t distanceCode = tables.distanceCode(symbol.distance);
+			writer.put(distanceCodes[distanceCode], distanceLengths[distanceCode]);
+			writer.put(symbol.distance - DISTANCE_BASE[distanceCode], DISTANCE_EXTRA[distanceCode]);
+		}
+		writer.put(literalCodes[256], literalLengths[256]);
+	}
+
+	uint32_t Deflate::adler32(const unsigned char* data, const size_t length, const uint32_t adler) {
+		uint32_t a = adler & 0xFFFF, b = adler >> 16;
+		size_t remaining = length;
+		while (remaining > 0) {
+			// Largest run before b can overflow
+			size_t n = std::min(remaining, (size_t)5552);
+			remaining -= n;
+			while (n-- > 0) {
+				a += *data++;
+				b += a;
+			}
+			a %= 65521;
+			b %= 65521;
+		}
+		return b << 16 | a;
+	}
+
+	uint32_t Deflate::adler32Combine(const uint32_t first, const uint32_t second, const size_t length) {
+		const uint32_t BASE = 65521;
+		const uint32_t remainder = (uint32_t)(length % BASE);
+		uint32_t a = first & 0xFFFF;
+		uint32_t b = (uint32_t)(((uint64_t)remainder * a) % BASE);
+		a += (second & 0xFFFF) + BASE - 1;
+		b += (first >> 16) + (second >> 16) + BASE - remainder;
+		if (a >= BASE) a -= BASE;
+		if (a >= BASE) a -= BASE;
+		if (b >= BASE << 1) b -= BASE << 1;
+		if (b >= BASE) b -= BASE;
+		return b << 16 | a;
+	}
+
+	uint32_t Deflate::crc32(const unsigned char* data, const size_t length, const uint32_t crc) {
+		const uint32_t* table = CodeTables::get().crc;
+		uint32_t c = crc ^ 0xFFFFFFFFu;
+		for (size_t i = 0; i < length; i++) {
+			c = table[(c ^ data[i]) & 0xFF] ^ (c >> 8);
+		}
+		return c ^ 0xFFFFFFFFu;
+	}
+
+	unsigned char* Deflate::zlibCompress(unsigned char* data, int length, int* outLength, int quality) {
+		const CompressionLevel compression = quality < 5 ? CompressionLevel::FAST : CompressionLevel::DEFAULT;
+		std::vector<unsigned char> stream;
+		stream.push_back(0x78);
+		stream.push_back(compression == CompressionLevel::FAST ? 0x01 : 0x9C);
+		Deflate(compression).compress(data, (size_t)length, true, stream);
+		const uint32_t adler = adler32(data, (size_t)length);
+		for (int shift = 24; shift >= 0; shift -= 8) {
+			stream.push_back((unsigned char)(adler >> shift));
+		}
+		unsigned char* result = (unsigned char*)malloc(stream.size());
+		if (result == nullptr) {
+			return nullptr;
+		}
+		std::memcpy(result, stream.data(), stream.size());
+		*outLength = (int)stream.size();
+		return result;
+	}
+
+}
@@ -0,0 +1,294 @@
+#include "capture/FrameCapture.h"
+#include "loader/AssetLoader.h"
+#include "render/RenderState.h"
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+
+namespace engine {
+
+	/**
+	* For all implementations in this file, @see FrameCapture.h for details
+	*/
+
+	// RGB only: blending also scales the alpha of the back buffer, translucent surfaces leave it below 1
+	static const int CHANNELS = 3;
+
+	FrameCapture::FrameCapture() : writer(1) {
+		for (int i = 0; i < BUFFERS; i++) {
+			glGenBuffers(1, &readbacks[i].buffer);
+		}
+	}
+
+	FrameCapture::~FrameCapture() {
+		RenderState* state = RenderState::getInstance();
+		for (int i = 0; i < BUFFERS; i++) {
+			collect(readbacks[(next + i) % BUFFERS], true);
+		}
+		for (int i = 0; i < BUFFERS; i++) {
+			glDeleteBuffers(1, &readbacks[i].buffer);
+			state->forgetBuffer(readbacks[i].buffer);
+		}
+		for (std::future<bool>& job : jobs) {
+			job.wait();
+		}
+		finishJobs();
+	}
+
+	void FrameCapture::screenshot(const std::string& path) {
+		screenshotPath = path;
+	}
+
+	bool FrameCapture::startRecording(const std::string& name, const CaptureFormat captureFormat) {
+		stopRecording();
+		basename = name;
+		format = captureFormat;
+		frame = 0;
+		dropped = 0;
+		stalls = 0;
+		{
+			std::lock_guard<std::mutex> lock(statsMutex);
+			encodedBytes = 0;
+			encodeSeconds = 0.0;
+		}
+		if (format == CaptureFormat::RAW_YUV) {
+			stream = std::make_shared<std::ofstream>(basename + ".yuv", std::ios::binary | std::ios::trunc);
+			if (!stream->is_open()) {
+				std::cerr << "[FrameCapture] Cannot open " << basename << ".yuv" << std::endl;
+				stream.reset();
+				return false;
+			}
+		}
+		recording = true;
+		return true;
+	}
+
+	void FrameCapture::stopRecording() {
+		if (!recording) {
+			return;
+		}
+		recording = false;
+		// The jobs in flight keep the stream open until they are done
+		stream.reset();
+		std::cout << "[FrameCapture] Recorded " << frame << " frames to " << basename
+			<< (format == CaptureFormat::RAW_YUV ? ".yuv (I420 " + std::to_string(width) + "x" + std::to_string(height) + ")" : "_*.png")
+			<< ", " << dropped << " dropped, " << stalls << " stalled, " << failed << " failed writes" << std::endl;
+		failed = 0;
+		if (format == CaptureFormat::PNG_SEQUENCE) {
+			// Only the frames encoded so far
+			std::lock_guard<std::mutex> lock(statsMutex);
+			if (encodeSeconds > 0.0) {
+				std::cout << "[FrameCapture] Encoded " << encodedBytes / (1024 * 1024) << " MB of pixels at "
+					<< encodedBytes / (1024.0 * 1024.0) / encodeSeconds << " MB/s" << std::endl;
+			}
+		}
+	}
+
+	const bool FrameCapture::isRecording() const {
+		return recording;
+	}
+
+	void FrameCapture::setCompression(const CompressionLevel level) {
+		compression = level;
+	}
+
+	void FrameCapture::finishJobs() {
+		size_t kept = 0;
+		for (size_t i = 0; i < jobs.size(); i++) {
+			if (jobs[i].wait_for(std::chrono::seconds(0)) != std::future_status::ready) {
+				jobs[kept++] = std::move(jobs[i]);
+			}
+			else if (!jobs[i].get()) {
+				failed++;
+			}
+		}
+		jobs.resize(kept);
+	}
+
+	bool FrameCapture::collect(Readback& readback, const bool wait) {
+		if (readback.fence == 0) {
+			return true;
+		}
+		// Flush the commands on the first try, the fence could never signal otherwise
+		GLenum result = glClientWaitSync(readback.fence, GL_SYNC_FLUSH_COMMANDS_BIT, 0);
+		while (wait && result == GL_TIMEOUT_EXPIRED) {
+			result = glClientWaitSync(readback.fence, 0, 1000000);
+		}
+		if (result == GL_TIMEOUT_EXPIRED) {
+			return false;
+		}
+		glDeleteSync(readback.fence);
+		readback.fence = 0;
+
+		// GL rows go bottom-up, files top-down
+		const size_t row = (size_t)readback.width * CHANNELS;
+		std::shared_ptr<std::vector<unsigned char>> pixels = std::make_shared<std::vector<unsigned char>>(row * readback.height);
+		RenderState* state = RenderState::getInstance();
+		state->bindBuffer(GL_PIXEL_PACK_BUFFER, readback.buffer);
+		const unsigned char* mapped = (const unsigned char*)glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, row * readback.height, GL_MAP_READ_BIT);
+		if (mapped == nullptr) {
+			std::cerr << "[FrameCapture] Cannot map the pixel buffer" << std::endl;
+			state->bindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+			return true;
+		}
+		for (GLsizei y = 0; y < readback.height; y++) {
+			std::memcpy(pixels->data() + row * y, mapped + row * (readback.height - 1 - y), row);
+		}
+		glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+		state->bindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+		const GLsizei w = readback.width, h = readback.height;
+		ThreadPool* workers = AssetLoader::getInstance()->getWorkers();
+		if (!readback.screenshot.empty()) {
+			const std::string path = readback.screenshot;
+			jobs.push_back(workers->submit([pixels, w, h, path, workers]() {
+				PngStats stats;
+				const bool saved = PngEncoder::write(path, pixels->data(), w, h, CHANNELS, CompressionLevel::DEFAULT, workers, &stats);
+				if (saved) {
+					std::cout << "[FrameCapture] Saved image " << path << " (" << stats.encodedBytes / 1024 << " KB, "
+						<< stats.getThroughput() << " MB/s)" << std::endl;
+				}
+				else {
+					std::cerr << "[FrameCapture] Failed saving image " << path << std::endl;
+				}
+				return saved;
+			}));
+		}
+		if (!readback.path.empty()) {
+			const std::string path = readback.path;
+			const CompressionLevel level = compression;
+			jobs.push_back(workers->submit([this, pixels, w, h, path, level, workers]() {
+				PngStats stats;
+				const bool saved = PngEncoder::write(path, pixels->data(), w, h, CHANNELS, level, workers, &stats);
+				if (!saved) {
+					std::cerr << "[FrameCapture] Failed saving image " << path << std::endl;
+				}
+				std::lock_guard<std::mutex> lock(statsMutex);
+				encodedBytes += stats.rawBytes;
+				encodeSeconds += stats.seconds;
+				return saved;
+			}));
+		}
+		if (readback.stream) {
+			std::shared_ptr<std::ofstream> file = readback.stream;
+			jobs.push_back(writer.submit([pixels, w, h, file]() {
+				return writeYUV(*file, *pixels, w, h);
+			}));
+		}
+		readback.screenshot.clear();
+		readback.path.clear();
+		readback.stream.reset();
+		return true;
+	}
+
+	bool FrameCapture::writeYUV(std::ofstream& file, const std::vector<unsigned char>& pixels, const GLsizei w, const GLsizei h) {
+		// BT.601 limited range, chroma averaged over 2x2 blocks
+		const GLsizei cw = (w + 1) / 2, ch = (h + 1) / 2;
+		std::vector<unsigned char> planes((size_t)w * h + 2 * (size_t)cw * ch);
+		unsigned char* luma = planes.data();
+		unsigned char* u = luma + (size_t)w * h;
+		unsigned char* v = u + (size_t)cw * ch;
+		for (GLsizei y = 0; y < h; y++) {
+			const unsigned char* p = pixels.data() + (size_t)y * w * CHANNELS;
+			for (GLsizei x = 0; x < w; x++, p += CHANNELS) {
+				luma[(size_t)y * w + x] = (unsigned char)(((66 * p[0] + 129 * p[1] + 25 * p[2] + 128) >> 8) + 16);
+			}
+		}
+		for (GLsizei cy = 0; cy < ch; cy++) {
+			for (GLsizei cx = 0; cx < cw; cx++) {
+				int r = 0, g = 0, b = 0, n = 0;
+				for (GLsizei y = cy * 2; y < cy * 2 + 2 && y < h; y++) {
+					for (GLsizei x = cx * 2; x < cx * 2 + 2 && x < w; x++) {
+						const unsigned char* p = pixels.data() + ((size_t)y * w + x) * CHANNELS;
+						r += p[0];
+						g += p[1];
+						b += p[2];
+						n++;
+					}
+				}
+				r /= n;
+				g /= n;
+				b /= n;
+				u[(size_t)cy * cw + cx] = (unsigned char)(((-38 * r - 74 * g + 112 * b + 128) >> 8) + 128);
+				v[(size_t)cy * cw + cx] = (unsigned char)(((112 * r - 94 * g - 18 * b + 128) >> 8) + 128);
+			}
+		}
+		file.write((const char*)planes.data(), planes.size());
+		if (!file) {
+			std::cerr << "[FrameCapture] Failed writing a YUV frame" << std::endl;
+			return false;
+		}
+		return true;
+	}
+
+	void FrameCapture::endFrame(const GLsizei frameWidth, const GLsizei frameHeight) {
+		for (int i = 0; i < BUFFERS; i++) {
+			collect(readbacks[(next + i) % BUFFERS], false);
+		}
+		finishJobs();
+
+		bool record = recording;
+		if (record && jobs.size() >= MAX_PENDING) {
+			dropped++;
+			record = false;
+		}
+		if (!record && screenshotPath.empty()) {
+			return;
+		}
+
+		// Both buffers still in flight, the GPU is more than a frame behind
+		Readback& readback = readbacks[next];
+		if (readback.fence != 0) {
+			stalls++;
+			collect(readback, true);
+		}
+
+		RenderState* state = RenderState::getInstance();
+		const GLsizeiptr size = (GLsizeiptr)frameWidth * frameHeight * CHANNELS;
+		state->bindBuffer(GL_PIXEL_PACK_BUFFER, readback.buffer);
+		if (readback.capacity < size) {
+			glBufferData(GL_PIXEL_PACK_BUFFER, size, nullptr, GL_STREAM_READ);
+			readback.capacity = size;
+		}
+		glBindFramebuffer(GL_READ_FRAMEBUFFER, 0);
+		glReadBuffer(GL_BACK);
+		// Tightly packed RGB rows, their size is not always a multiple of 4
+		glPixelStorei(GL_PACK_ALIGNMENT, 1);
+		// Into the bound pixel buffer, returns without waiting for the frame
+		glReadPixels(0, 0, frameWidth, frameHeight, GL_RGB, GL_UNSIGNED_BYTE, nullptr);
+		glPixelStorei(GL_PACK_ALIGNMENT, 4);
+		state->bindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+		readback.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+		readback.width = width = frameWidth;
+		readback.height = height = frameHeight;
+
+		readback.screenshot = screenshotPath;
+		screenshotPath.clear();
+		if (record) {
+			if (format == CaptureFormat::PNG_SEQUENCE) {
+				char index[16];
+				snprintf(index, sizeof(index), "_%06u.png", frame);
+				readback.path = basename + index;
+			}
+			else {
+				readback.stream = stream;
+			}
+			frame++;
+		}
+		next = (next + 1) % BUFFERS;
+	}
+
+	const unsigned int FrameCapture::getFrames() const {
+		return frame;
+	}
+
+	const unsigned int FrameCapture::getDropped() const {
+		return dropped;
+	}
+
+	const unsigned int FrameCapture::getStalls() const {
+		return stalls;
+	}
+
+}
@@ -0,0 +1,190 @@
+#include "capture/PngEncoder.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <functional>
+
+namespace engine {
+
+	/**
+	* For all implementations in this file, @see PngEncoder.h for details
+	*/
+
+	static inline unsigned char paeth(const int a, const int b, const int c) {
+		const int p = a + b - c;
+		const int pa = std::abs(p - a), pb = std::abs(p - b), pc = std::abs(p - c);
+		if (pa <= pb && pa <= pc) return (unsigned char)a;
+		if (pb <= pc) return (unsigned char)b;
+		return (unsigned char)c;
+	}
+
+	static void putBigEndian(unsigned char* out, const uint32_t value) {
+		out[0] = (unsigned char)(value >> 24);
+		out[1] = (unsigned char)(value >> 16);
+		out[2] = (unsigned char)(value >> 8);
+		out[3] = (unsigned char)value;
+	}
+
+	/**
+	* Appends a whole chunk
+	*/
+	static void putChunk(std::vector<unsigned char>& out, const char* type, const unsigned char* data, const uint32_t length) {
+		const size_t start = out.size();
+		out.resize(start + 12 + length);
+		putBigEndian(&out[start], length);
+		std::memcpy(&out[start + 4], type, 4);
+		if (length != 0) {
+			std::memcpy(&out[start + 8], data, length);
+		}
+		putBigEndian(&out[start + 8 + length], Deflate::crc32(&out[start + 4], length + 4));
+	}
+
+	void PngEncoder::filterRow(const unsigned char* row, const unsigned char* prior, const int bpp, const size_t length,
+		const CompressionLevel level, unsigned char* out, std::vector<unsigned char>& scratch) {
+		static const int FAST_FILTERS[] = { 1, 2 };
+		static const int ALL_FILTERS[] = { 0, 1, 2, 3, 4 };
+		const int* filters = level == CompressionLevel::FAST ? FAST_FILTERS : ALL_FILTERS;
+		const int filterCount = level == CompressionLevel::FAST ? 2 : 5;
+
+		uint64_t bestCost = UINT64_MAX;
+		for (int f = 0; f < filterCount; f++) {
+			const int filter = filters[f];
+			unsigned char* target = scratch.data();
+			// The first pixel has no left neighbour, the first row no row above
+			const size_t left = std::min((size_t)bpp, length);
+			for (size_t i = 0; i < left; i++) {
+				const int b = prior != nullptr ? prior[i] : 0;
+				target[i] = (unsigned char)(row[i] - (filter == 2 || filter == 4 ? b : filter == 3 ? b >> 1 : 0));
+			}
+			switch (filter) {
+			case 0:
+				std::memcpy(target + left, row + left, length - left);
+				break;
+			case 1:
+				for (size_t i = left; i < length; i++) target[i] = (unsigned char)(row[i] - row[i - bpp]);
+				break;
+			case 2:
+				for (size_t i = left; i < length; i++) target[i] = (unsigned char)(row[i] - (prior != nullptr ? prior[i] : 0));
+				break;
+			case 3:
+				for (size_t i = left; i < length; i++) target[i] = (unsigned char)(row[i] - ((row[i - bpp] + (prior != nullptr ? prior[i] : 0)) >> 1));
+				break;
+			default:
+				for (size_t i = left; i < length; i++) {
+					target[i] = prior != nullptr ? (unsigned char)(row[i] - paeth(row[i - bpp], prior[i], prior[i - bpp])) : (unsigned char)(row[i] - row[i - bpp]);
+				}
+				break;
+			}
+			// Small signed differences compress best
+			uint64_t cost = 0;
+			for (size_t i = 0; i < length; i++) {
+				cost += (uint64_t)std::abs((int)(signed char)target[i]);
+			}
+			if (cost < bestCost) {
+				bestCost = cost;
+				out[0] = (unsigned char)filter;
+				std::memcpy(out + 1, target, length);
+			}
+		}
+	}
+
+	bool PngEncoder::encode(const unsigned char* pixels, const int width, const int height, const int channels, std::vector<unsigned char>& out,
+		const CompressionLevel level, ThreadPool* workers, PngStats* stats) {
+		if (pixels == nullptr || width <= 0 || height <= 0 || channels < 1 || channels > 4) {
+			return false;
+		}
+		const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+		const size_t stride = (size_t)width * channels;
+		const size_t filteredRow = stride + 1;
+
+		// Enough bands for every thread, none too small to compress well
+		const unsigned int threads = workers != nullptr ? workers->size() + 1 : 1;
+		const size_t byBytes = std::max((size_t)1, filteredRow * height / MIN_BAND_BYTES);
+		const int rowsPerBand = (int)((height + std::min(byBytes, (size_t)threads * 2) - 1) / std::min(byBytes, (size_t)threads * 2));
+		const int bandCount = (height + rowsPerBand - 1) / rowsPerBand;
+
+		std::vector<std::vector<unsigned char>> chunks(bandCount);
+		std::vector<uint32_t> adlers(bandCount);
+		std::vector<size_t> sizes(bandCount);
+
+		const unsigned char colorTypes[] = { 0, 4, 2, 6 };
+		const std::function<void(int)> encodeBand = [&](const int band) {
+			const int first = band * rowsPerBand;
+			const int last = std::min(height, first + rowsPerBand);
+			std::vector<unsigned char> filtered(filteredRow * (last - first));
+			std::vector<unsigned char> scratch(stride);
+			for (int y = first; y < last; y++) {
+				filterRow(pixels + stride * y, y > 0 ? pixels + stride * (y - 1) : nullptr, channels, stride,
+					level, &filtered[filteredRow * (y - first)], scratch);
+			}
+			adlers[band] = Deflate::adler32(filtered.data(), filtered.size());
+			sizes[band] = filtered.size();
+
+			// Chunk length and type first, the zlib header in the first chunk
+			std::vector<unsigned char>& chunk = chunks[band];
+			chunk.reserve(filtered.size() / 2 + 64);
+			chunk.resize(8);
+			std::memcpy(&chunk[4], "IDAT", 4);
+			if (band == 0) {
+				chunk.push_back(0x78);
+				chunk.push_back(level == CompressionLevel::FAST ? 0x01 : 0x9C);
+			}
+			Deflate(level).compress(filtered.data(), filtered.size(), band == bandCount - 1, chunk);
+			putBigEndian(&chunk[0], (uint32_t)(chunk.size() - 8));
+			const uint32_t crc = Deflate::crc32(&chunk[4], chunk.size() - 4);
+			chunk.resize(chunk.size() + 4);
+			putBigEndian(&chunk[chunk.size() - 4], crc);
+		};
+		if (workers != nullptr) {
+			workers->parallelFor(bandCount, encodeBand);
+		}
+		else {
+			for (int band = 0; band < bandCount; band++) {
+				encodeBand(band);
+			}
+		}
+
+		const unsigned char signature[] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n' };
+		out.assign(signature, signature + 8);
+		unsigned char header[13];
+		putBigEndian(header, (uint32_t)width);
+		putBigEndian(header + 4, (uint32_t)height);
+		header[8] = 8;
+		header[9] = colorTypes[channels - 1];
+		header[10] = header[11] = header[12] = 0;
+		putChunk(out, "IHDR", header, 13);
+		uint32_t adler = adlers[0];
+		for (int band = 0; band < bandCount; band++) {
+			out.insert(out.end(), chunks[band].begin(), chunks[band].end());
+			if (band > 0) {
+				adler = Deflate::adler32Combine(adler, adlers[band], sizes[band]);
+			}
+		}
+		// The zlib trailer in a chunk of its own, once every band is known
+		unsigned char trailer[4];
+		putBigEndian(trailer, adler);
+		putChunk(out, "IDAT", trailer, 4);
+		putChunk(out, "IEND", nullptr, 0);
+
+		if (stats != nullptr) {
+			stats->rawBytes = stride * height;
+			stats->encodedBytes = out.size();
+			stats->seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+		}
+		return true;
+	}
+
+	bool PngEncoder::write(const std::string& path, const unsigned char* pixels, const int width, const int height, const int channels,
+		const CompressionLevel level, ThreadPool* workers, PngStats* stats) {
+		std::vector<unsigned char> png;
+		if (!encode(pixels, width, height, channels, png, level, workers, stats)) {
+			return false;
+		}
+		std::ofstream file(path, std::ios::binary | std::ios::trunc);
+		file.write((const char*)png.data(), png.size());
+		return file.good();
+	}
+
+}
@@ -0,0 +1,272 @@
+#include "loader/AssetLoader.h"
+#include "mesh/MeshCache.h"
+#include "scene/SceneNode.h"
+#include <chrono>
+#include <iostream>
+#include <limits>
+
+namespace engine {
+
+	/**
+	* For all implementations in this file, @see AssetLoader.h for details
+	*/
+
+	typedef std::chrono::steady_clock Clock;
+
+	static double millisecondsSince(const Clock::time_point start) {
+		return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+	}
+
+	AssetLoader* AssetLoader::instance;
+
+	AssetLoader* AssetLoader::getInstance() {
+		if (instance == nullptr) {
+			instance = new AssetLoader();
+		}
+		return instance;
+	}
+
+	AssetLoader::AssetLoader() {
+		workers = new ThreadPool();
+		pending = 0;
+	}
+
+	void AssetLoader::enqueueUpload(std::function<void()> upload) {
+		std::lock_guard<std::mutex> lock(uploadMutex);
+		uploads.push_back(upload);
+	}
+
+	void AssetLoader::startDecode(const void* asset, std::function<void()> decode) {
+		pending++;
+		decodes[asset] = workers->submit(decode).share();
+	}
+
+	std::shared_future<void> AssetLoader::decodeImages(const std::vector<std::string>& files,
+		std::function<void(std::vector<ImageData>&, std::vector<double>&)> onDecoded) {
+
+		struct ParallelDecode {
+			std::vector<ImageData> images;
+			std::vector<double> times;
+			std::atomic<size_t> remaining;
+			std::promise<void> done;
+		};
+
+		std::shared_ptr<ParallelDecode> decode = std::make_shared<ParallelDecode>();
+		decode->images.resize(files.size());
+		decode->times.resize(files.size());
+		decode->remaining = files.size();
+		std::shared_future<void> decoded = decode->done.get_future().share();
+
+		if (files.empty()) {
+			onDecoded(decode->images, decode->times);
+			decode->done.set_value();
+			return decoded;
+		}
+
+		for (size_t i = 0; i < files.size(); i++) {
+			const std::string file = files[i];
+			workers->submit([decode, file, i, onDecoded]() {
+				Clock::time_point start = Clock::now();
+				decode->images[i] = ImageData::decode(file);
+				decode->times[i] = millisecondsSince(start);
+				if (--decode->remaining == 0) {
+					onDecoded(decode->images, decode->times);
+					decode->done.set_value();
+				}
+			});
+		}
+		return decoded;
+	}
+
+	void AssetLoader::reportTimings(const std::string& name, const std::vector<std::string>& files,
+		const std::vector<double>& decodeTimes, const double wallTime, const double uploadTime) const {
+
+		double slowest = 0.0, total = 0.0;
+		for (double time : decodeTimes) {
+			slowest = time > slowest ? time : slowest;
+			total += time;
+		}
+		std::cout << "[AssetLoader] " << name << ": " << files.size() << " image(s) decoded in " << wallTime
+			<< " ms (slowest " << slowest << " ms, serial " << total << " ms), uploaded in " << uploadTime << " ms" << std::endl;
+		if (files.size() > 1) {
+			for (size_t i = 0; i < files.size(); i++) {
+				std::cout << "    " << files[i] << ": " << decodeTimes[i] << " ms" << std::endl;
+			}
+		}
+	}
+
+	Texture* AssetLoader::loadTexture(const std::string fileName) {
+		Texture* texture = new Texture();
+		const std::vector<std::string> files = { fileName };
+		const Clock::time_point start = Clock::now();
+
+		if (CompressedImage::isCompressedFile(fileName)) {
+			startDecode(texture, [this, texture, files, start]() {
+				std::shared_ptr<CompressedImage> image = std::make_shared<CompressedImage>(CompressedImage::load(files[0]));
+				const std::vector<double> decodeTimes = { millisecondsSince(start) };
+				enqueueUpload([this, texture, files, image, decodeTimes]() {
+					Clock::time_point uploadStart = Clock::now();
+					texture->upload(*image);
+					reportTimings("compressed texture", files, decodeTimes, decodeTimes[0], millisecondsSince(uploadStart));
+				});
+			});
+			return texture;
+		}
+
+		pending++;
+		decodes[texture] = decodeImages(files, [this, texture, files, start](std::vector<ImageData>& images, std::vector<double>& times) {
+			const double wallTime = millisecondsSince(start);
+			ImageData image = images[0];
+			std::vector<double> decodeTimes = times;
+			enqueueUpload([this, texture, files, image, decodeTimes, wallTime]() mutable {
+				Clock::time_point uploadStart = Clock::now();
+				texture->upload(image);
+				image.release();
+				reportTimings("texture", files, decodeTimes, wallTime, millisecondsSince(uploadStart));
+			});
+		});
+		return texture;
+	}
+
+	int AssetLoader::loadLayer(TextureArray* textures, const std::string fileName) {
+		const int layer = textures->reserveLayer();
+		if (layer < 0) {
+			return layer;
+		}
+		const std::vector<std::string> files = { fileName };
+		const Clock::time_point start = Clock::now();
+		pending++;
+		decodeImages(files, [this, textures, layer, files, start](std::vector<ImageData>& images, std::vector<double>& times) {
+			const double wallTime = millisecondsSince(start);
+			ImageData image = images[0];
+			std::vector<double> decodeTimes = times;
+			enqueueUpload([this, textures, layer, files, image, decodeTimes, wallTime]() mutable {
+				Clock::time_point uploadStart = Clock::now();
+				textures->upload(layer, image);
+				image.release();
+				reportTimings("texture layer", files, decodeTimes, wallTime, millisecondsSince(uploadStart));
+			});
+		});
+		return layer;
+	}
+
+	int AssetLoader::loadPerlinLayer(TextureArray* textures) {
+		const int layer = textures->reserveLayer();
+		if (layer < 0) {
+			return layer;
+		}
+		pending++;
+		workers->submit([this, textures, layer]() {
+			ImageData image = PerlinTexture::createImageData();
+			enqueueUpload([textures, layer, image]() mutable {
+				textures->upload(layer, image);
+				image.release();
+			});
+		});
+		return layer;
+	}
+
+	Mesh* AssetLoader::loadMesh(const char* path, ShaderProgram* shaderProgram) {
+		Mesh* mesh = MeshCache::getInstance()->find(path, shaderProgram);
+		if (mesh != nullptr) {
+			return mesh;
+		}
+		mesh = new Mesh();
+		MeshCache::getInstance()->insert(path, shaderProgram, mesh);
+
+		const std::string file(path);
+		startDecode(mesh, [this, mesh, shaderProgram, file]() {
+			try {
+				mesh->loadFromFile(file.c_str());
+			}
+			catch (const char* error) {
+				std::cerr << "Failed to load mesh " << file << ": " << error << std::endl;
+			}
+			enqueueUpload([mesh, shaderProgram]() {
+				mesh->upload(shaderProgram);
+				// The cached static shadows were drawn without this mesh
+				SceneNode::invalidateCasters();
+			});
+		});
+		return mesh;
+	}
+
+	Cubemap* AssetLoader::loadCubemap(std::vector<std::string> faces, Mesh* mesh) {
+		Cubemap* cubemap = new Cubemap(mesh);
+		const Clock::time_point start = Clock::now();
+		pending++;
+		decodes[cubemap] = decodeImages(faces, [this, cubemap, faces, start](std::vector<ImageData>& decoded, std::vector<double>& times) {
+			const double wallTime = millisecondsSince(start);
+			std::vector<ImageData> images = decoded;
+			std::vector<double> decodeTimes = times;
+			enqueueUpload([this, cubemap, faces, images, decodeTimes, wallTime]() mutable {
+				Clock::time_point uploadStart = Clock::now();
+				cubemap->upload(images);
+				for (ImageData& image : images) {
+					image.release();
+				}
+				reportTimings("cubemap", faces, decodeTimes, wallTime, millisecondsSince(uploadStart));
+			});
+		});
+		return cubemap;
+	}
+
+	PerlinTexture* AssetLoader::loadPerlin(const NoiseParams& params) {
+		PerlinTexture* texture = new PerlinTexture(params);
+		startDecode(texture, [this, texture]() {
+			texture->createImage();
+			enqueueUpload([texture]() {
+				texture->upload();
+			});
+		});
+		return texture;
+	}
+
+	void AssetLoader::wait(const void* asset) {
+		std::map<const void*, std::shared_future<void>>::iterator it = decodes.find(asset);
+		if (it != decodes.end()) {
+			it->second.wait();
+		}
+	}
+
+	const unsigned int AssetLoader::processUploads(const double budget) {
+		Clock::time_point start = Clock::now();
+		unsigned int applied = 0;
+		while (true) {
+			std::function<void()> upload;
+			{
+				std::lock_guard<std::mutex> lock(uploadMutex);
+				if (uploads.empty()) {
+					break;
+				}
+				upload = std::move(uploads.front());
+				uploads.pop_front();
+			}
+			upload();
+			pending--;
+			applied++;
+
+			if (millisecondsSince(start) >= budget) {
+				break;
+			}
+		}
+		return applied;
+	}
+
+	void AssetLoader::finish() {
+		while (pending > 0) {
+			if (processUploads(std::numeric_limits<double>::infinity()) == 0) {
+				std::this_thread::yield();
+			}
+		}
+	}
+
+	const unsigned int AssetLoader::getPending() const {
+		return pending;
+	}
+
+	ThreadPool* AssetLoader::getWorkers() const {
+		return workers;
+	}
+
+}
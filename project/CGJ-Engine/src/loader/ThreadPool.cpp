@@ -0,0 +1,91 @@
+#include "loader/ThreadPool.h"
+#include <algorithm>
+
+namespace engine {
+
+	/**
+	* For all implementations in this file, @see ThreadPool.h for details
+	*/
+
+	ThreadPool::ThreadPool(unsigned int threads) {
+		if (threads == 0) {
+			unsigned int hardware = std::thread::hardware_concurrency();
+			threads = hardware > 1 ? hardware - 1 : 1;
+		}
+		for (unsigned int i = 0; i < threads; i++) {
+			workers.push_back(std::thread(&ThreadPool::work, this));
+		}
+	}
+
+	ThreadPool::~ThreadPool() {
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			stopping = true;
+		}
+		condition.notify_all();
+		for (std::thread& worker : workers) {
+			worker.join();
+		}
+	}
+
+	void ThreadPool::work() {
+		while (true) {
+			std::function<void()> task;
+			{
+				std::unique_lock<std::mutex> lock(mutex);
+				condition.wait(lock, [this]() { return stopping || !tasks.empty(); });
+				if (tasks.empty()) {
+					return;
+				}
+				task = std::move(tasks.front());
+				tasks.pop_front();
+				running++;
+			}
+			task();
+			{
+				std::lock_guard<std::mutex> lock(mutex);
+				running--;
+			}
+			idleCondition.notify_all();
+		}
+	}
+
+	void ThreadPool::waitIdle() {
+		std::unique_lock<std::mutex> lock(mutex);
+		idleCondition.wait(lock, [this]() { return tasks.empty() && running == 0; });
+	}
+
+	void ThreadPool::parallelFor(const int count, const std::function<void(int)>& body) {
+		struct Loop {
+			std::atomic<int> next;
+			int done = 0;
+			std::mutex mutex;
+			std::condition_variable finished;
+		};
+		std::shared_ptr<Loop> loop = std::make_shared<Loop>();
+		loop->next = 0;
+		// Helpers that start late find nothing left to claim and never run the body
+		const std::function<void()> claim = [loop, count, body]() {
+			int index;
+			while ((index = loop->next++) < count) {
+				body(index);
+				std::lock_guard<std::mutex> lock(loop->mutex);
+				if (++loop->done == count) {
+					loop->finished.notify_all();
+				}
+			}
+		};
+		const int helpers = std::min((int)workers.size(), count - 1);
+		for (int i = 0; i < helpers; i++) {
+			submit(claim);
+		}
+		claim();
+		std::unique_lock<std::mutex> lock(loop->mutex);
+		loop->finished.wait(lock, [&loop, count]() { return loop->done >= count; });
+	}
+
+	const unsigned int ThreadPool::size() const {
+		return (unsigned int)workers.size();
+	}
+
+}
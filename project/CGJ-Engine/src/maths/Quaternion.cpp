@@ -1,5 +1,13 @@
 #include "maths/Quaternion.h"
 #include "Utils.h"
+#include <cmath>
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#define QUATERNION_X86 1
+#include <emmintrin.h>
+#else
+#define QUATERNION_X86 0
+#endif
 
 namespace engine {
 
@@ -7,40 +15,25 @@ namespace engine {
 	* For all implementations in this file, @see Quaternion.h for details
 	*/
 
+	static_assert(sizeof(Quaternion) == 4 * sizeof(float), "The batches load quaternions as 4 packed floats");
+
+	const float Quaternion::threshold = (float)1.0e-5;
+
 	Quaternion::operator const Vector4() const {
 		return Vector4(x, y, z, t);
 	}
 
 	Quaternion::operator const Matrix4() const {
-		
-		Matrix4 *m = new Matrix4(t), *m2 = new Matrix4(t);
-
-		m->cols[0].y = -z; m->cols[0].z = y; m->cols[0].w = -x;
-		m->cols[1].x = z; m->cols[1].z = -x; m->cols[1].w = -y;
-		m->cols[2].x = -y; m->cols[2].y = x; m->cols[2].w = -z;
-		m->cols[3].x = x; m->cols[3].y = y; m->cols[3].z = z;
-
-		m2->cols[0].y = -z; m2->cols[0].z = y; m2->cols[0].w = x;
-		m2->cols[1].x = z; m2->cols[1].z = -x; m2->cols[1].w = y;
-		m2->cols[2].x = -y; m2->cols[2].y = x; m2->cols[2].w = z;
-		m2->cols[3].x = -x; m2->cols[3].y = -y; m2->cols[3].z = -z;
-
-		return *m * *m2;
-
-		/*float n = pow(length(), 2);
-		float s = n == 0 ? 0 : 2 / n;
-		float tx = s * t * x, ty = s * t * y, tz = s * t * z;
-		float xx = s * x * x, xy = s * x * y, xz = s * x * z;
-		float yy = s * y * y, yz = s * y * z, zz = s * z * z;
-
-		Matrix4* m = new Matrix4(1);
-		m->cols[0] = Vector4(1.0f - (yy + zz), xy - tz, xz + ty, 0.0f);
-		m->cols[1] = Vector4(xy + tz, 1.0f - (xx + zz), yz - tx, 0.0f);
-		m->cols[2] = Vector4(xz - ty, yz + tx, 1.0f - (xx + yy), 0.0f);
-
-		//m->clean();
-
-		return *m;*/
+		const float tt = t * t, xx = x * x, yy = y * y, zz = z * z;
+		const float xy = x * y, xz = x * z, yz = y * z;
+		const float tx = t * x, ty = t * y, tz = t * z;
+
+		Matrix4 m;
+		m.cols[0] = Vector4(tt + xx - yy - zz, 2.0f * (xy - tz), 2.0f * (xz + ty), 0.0f);
+		m.cols[1] = Vector4(2.0f * (xy + tz), tt - xx + yy - zz, 2.0f * (yz - tx), 0.0f);
+		m.cols[2] = Vector4(2.0f * (xz - ty), 2.0f * (yz + tx), tt - xx - yy + zz, 0.0f);
+		m.cols[3] = Vector4(0.0f, 0.0f, 0.0f, tt + xx + yy + zz);
+		return m;
 	}
 
 	void Quaternion::operator = (const Quaternion q) {
@@ -91,10 +84,12 @@ namespace engine {
 	}
 
 	const Quaternion Quaternion::operator*= (const Quaternion q) {
-		t = t * q.t - x * q.x - y * q.y - z * q.z;
-		x = t * q.x + x * q.t + y * q.z - z * q.y;
-		y = t * q.y + y * q.t + z * q.x - x * q.z;
-		z = t * q.z + z * q.t + x * q.y - y * q.x;
+		// Every component needs the previous values of the others
+		const float pt = t, px = x, py = y, pz = z;
+		t = pt * q.t - px * q.x - py * q.y - pz * q.z;
+		x = pt * q.x + px * q.t + py * q.z - pz * q.y;
+		y = pt * q.y + py * q.t + pz * q.x - px * q.z;
+		z = pt * q.z + pz * q.t + px * q.y - py * q.x;
 		return (*this);
 	}
 
@@ -113,7 +108,7 @@ namespace engine {
 		q.z = axisn.z * s;
 		q.clean();
 
-		return (*new Quaternion(q.normalize()));
+		return q.normalize();
 	}
 
 	void Quaternion::toAngleAxis(float& theta, Vector3& axis) const {
@@ -138,42 +133,52 @@ namespace engine {
 	}
 
 	const Quaternion Quaternion::normalize() const {
-		Quaternion q = (*new Quaternion(*this));
-		float s = 1.0f / this->length();
-		q = q * s;
-		return (*new Quaternion(*this));
+		const float norm = x * x + y * y + z * z + t * t;
+		if (norm <= 0.0f) {
+			return (*this);
+		}
+		const float s = 1.0f / std::sqrt(norm);
+		return Quaternion(t * s, x * s, y * s, z * s);
 	}
 
 	const Quaternion Quaternion::conjugate() const {
-		Quaternion conjugate = { t, -x, -y, -z };
-		return (*new Quaternion(conjugate));
+		return Quaternion(t, -x, -y, -z);
 	}
 
 	const Quaternion Quaternion::inverse() const {
-		Quaternion q = (conjugate() * (1.0f / length()));
+		// The conjugate over the squared length
+		const float norm = x * x + y * y + z * z + t * t;
+		Quaternion q = conjugate() * (1.0f / norm);
 		q.clean();
-		return (*new Quaternion(q));
+		return q;
 	}
 
 	const Quaternion Quaternion::lerp(const Quaternion q, const float k) const {
-		float cos_angle = x * q.x + y * q.y + z * q.z + t * q.t;
-		float k0 = 1.0f - k;
-		float k1 = (cos_angle > 0) ? k : -k;
-		Quaternion qf;
-		Quaternion qi = (*new Quaternion(*this));
-		qi = qi * Math::cleanFloat(k0, threshold);
-		qf = qi + (q * Math::cleanFloat(k1, threshold));
-		return (*new Quaternion(qf.normalize()));
+		Quaternion result;
+		interpolate(this, &q, &k, &result, 1, false);
+		return result;
 	}
 
 	const Quaternion Quaternion::slerp(const Quaternion q, const float k) const {
-		float angle = acos(x * q.x + y * q.y + z * q.z + t * q.t);
-		float k0 = sin((1 - k) * angle) / sin(angle);
-		float k1 = sin(k * angle) / sin(angle);
-		Quaternion qi = (*new Quaternion(*this));
-		qi *= k0;
-		qi += q * k1;
-		return (*new Quaternion(qi.normalize()));
+		// The shortest arc goes to whichever of q and -q is closer
+		float cosine = x * q.x + y * q.y + z * q.z + t * q.t;
+		const float sign = cosine < 0.0f ? -1.0f : 1.0f;
+		cosine *= sign;
+		// Nearly equal rotations blend linearly, the sine of their angle is too small to divide by
+		if (cosine > 0.9995f) {
+			return lerp(q, k);
+		}
+		const float angle = std::acos(cosine);
+		const float inverseSine = 1.0f / std::sin(angle);
+		const float k0 = std::sin((1.0f - k) * angle) * inverseSine;
+		const float k1 = std::sin(k * angle) * inverseSine * sign;
+		return ((*this) * k0 + q * k1).normalize();
+	}
+
+	const Quaternion Quaternion::fastSlerp(const Quaternion q, const float k) const {
+		Quaternion result;
+		interpolate(this, &q, &k, &result, 1, true);
+		return result;
 	}
 
 	void Quaternion::clean() {
@@ -183,6 +188,154 @@ namespace engine {
 		t = Math::cleanFloat(t, threshold);
 	}
 
+	/**
+	* Corrects an nlerp factor so the nlerp follows the slerp curve, from the cosine of the arc
+	* The correction is a polynomial fit of the error of nlerp over the arc (D. Kapoulkine)
+	*/
+	static float correctFactor(const float k, const float cosine) {
+		const float a = 1.0904f + cosine * (-3.2452f + cosine * (3.55645f - cosine * 1.43519f));
+		const float b = 0.848013f + cosine * (-1.06021f + cosine * 0.215638f);
+		const float c = a * (k - 0.5f) * (k - 0.5f) + b;
+		return k + k * (k - 0.5f) * (k - 1.0f) * c;
+	}
+
+#if QUATERNION_X86
+	static __m128 correctFactor(const __m128 k, const __m128 cosine) {
+		const __m128 a = _mm_add_ps(_mm_set1_ps(1.0904f), _mm_mul_ps(cosine, _mm_add_ps(_mm_set1_ps(-3.2452f),
+			_mm_mul_ps(cosine, _mm_sub_ps(_mm_set1_ps(3.55645f), _mm_mul_ps(cosine, _mm_set1_ps(1.43519f)))))));
+		const __m128 b = _mm_add_ps(_mm_set1_ps(0.848013f), _mm_mul_ps(cosine, _mm_add_ps(_mm_set1_ps(-1.06021f),
+			_mm_mul_ps(cosine, _mm_set1_ps(0.215638f)))));
+		const __m128 centered = _mm_sub_ps(k, _mm_set1_ps(0.5f));
+		const __m128 c = _mm_add_ps(_mm_mul_ps(a, _mm_mul_ps(centered, centered)), b);
+		return _mm_add_ps(k, _mm_mul_ps(_mm_mul_ps(k, centered), _mm_mul_ps(_mm_sub_ps(k, _mm_set1_ps(1.0f)), c)));
+	}
+
+	/**
+	* Gets 1 / length from the squared lengths, or 1 for the quaternions of length 0
+	*/
+	static __m128 inverseLengths(const __m128 norm) {
+		const __m128 valid = _mm_cmpgt_ps(norm, _mm_setzero_ps());
+		const __m128 inverse = _mm_div_ps(_mm_set1_ps(1.0f), _mm_sqrt_ps(norm));
+		return _mm_or_ps(_mm_and_ps(valid, inverse), _mm_andnot_ps(valid, _mm_set1_ps(1.0f)));
+	}
+#endif
+
+	void Quaternion::toMatrices(const Quaternion* quaternions, Matrix4* matrices, const size_t count) {
+		size_t i = 0;
+#if QUATERNION_X86
+		const __m128 two = _mm_set1_ps(2.0f);
+		for (; i + 4 <= count; i += 4) {
+			// Transposed to one component of the 4 quaternions per register
+			__m128 x = _mm_loadu_ps(&quaternions[i].x), y = _mm_loadu_ps(&quaternions[i + 1].x);
+			__m128 z = _mm_loadu_ps(&quaternions[i + 2].x), t = _mm_loadu_ps(&quaternions[i + 3].x);
+			_MM_TRANSPOSE4_PS(x, y, z, t);
+			const __m128 tt = _mm_mul_ps(t, t), xx = _mm_mul_ps(x, x), yy = _mm_mul_ps(y, y), zz = _mm_mul_ps(z, z);
+			const __m128 xy = _mm_mul_ps(x, y), xz = _mm_mul_ps(x, z), yz = _mm_mul_ps(y, z);
+			const __m128 tx = _mm_mul_ps(t, x), ty = _mm_mul_ps(t, y), tz = _mm_mul_ps(t, z);
+			const __m128 ttxx = _mm_add_ps(tt, xx), ttmxx = _mm_sub_ps(tt, xx), yyzz = _mm_add_ps(yy, zz), yymzz = _mm_sub_ps(yy, zz);
+
+			// Element [column][row] of the 4 matrices, then transposed back to a column of each matrix
+			__m128 columns[4][4] = {
+				{ _mm_sub_ps(ttxx, yyzz), _mm_mul_ps(two, _mm_sub_ps(xy, tz)), _mm_mul_ps(two, _mm_add_ps(xz, ty)), _mm_setzero_ps() },
+				{ _mm_mul_ps(two, _mm_add_ps(xy, tz)), _mm_add_ps(ttmxx, yymzz), _mm_mul_ps(two, _mm_sub_ps(yz, tx)), _mm_setzero_ps() },
+				{ _mm_mul_ps(two, _mm_sub_ps(xz, ty)), _mm_mul_ps(two, _mm_add_ps(yz, tx)), _mm_sub_ps(ttmxx, yymzz), _mm_setzero_ps() },
+				{ _mm_setzero_ps(), _mm_setzero_ps(), _mm_setzero_ps(), _mm_add_ps(ttxx, yyzz) }
+			};
+			for (int column = 0; column < 4; column++) {
+				__m128* c = columns[column];
+				_MM_TRANSPOSE4_PS(c[0], c[1], c[2], c[3]);
+				for (int k = 0; k < 4; k++) {
+					_mm_storeu_ps(&matrices[i + k].elements[column * 4], c[k]);
+				}
+			}
+		}
+#endif
+		for (; i < count; i++) {
+			matrices[i] = quaternions[i];
+		}
+	}
+
+	void Quaternion::normalize(Quaternion* quaternions, const size_t count) {
+		size_t i = 0;
+#if QUATERNION_X86
+		for (; i + 4 <= count; i += 4) {
+			__m128 q0 = _mm_loadu_ps(&quaternions[i].x), q1 = _mm_loadu_ps(&quaternions[i + 1].x);
+			__m128 q2 = _mm_loadu_ps(&quaternions[i + 2].x), q3 = _mm_loadu_ps(&quaternions[i + 3].x);
+			__m128 x = q0, y = q1, z = q2, t = q3;
+			_MM_TRANSPOSE4_PS(x, y, z, t);
+			const __m128 norm = _mm_add_ps(_mm_add_ps(_mm_mul_ps(x, x), _mm_mul_ps(y, y)), _mm_add_ps(_mm_mul_ps(z, z), _mm_mul_ps(t, t)));
+			const __m128 inverse = inverseLengths(norm);
+			_mm_storeu_ps(&quaternions[i].x, _mm_mul_ps(q0, _mm_shuffle_ps(inverse, inverse, _MM_SHUFFLE(0, 0, 0, 0))));
+			_mm_storeu_ps(&quaternions[i + 1].x, _mm_mul_ps(q1, _mm_shuffle_ps(inverse, inverse, _MM_SHUFFLE(1, 1, 1, 1))));
+			_mm_storeu_ps(&quaternions[i + 2].x, _mm_mul_ps(q2, _mm_shuffle_ps(inverse, inverse, _MM_SHUFFLE(2, 2, 2, 2))));
+			_mm_storeu_ps(&quaternions[i + 3].x, _mm_mul_ps(q3, _mm_shuffle_ps(inverse, inverse, _MM_SHUFFLE(3, 3, 3, 3))));
+		}
+#endif
+		for (; i < count; i++) {
+			quaternions[i] = quaternions[i].normalize();
+		}
+	}
+
+	void Quaternion::lerp(const Quaternion* from, const Quaternion* to, const float* k, Quaternion* out, const size_t count) {
+		interpolate(from, to, k, out, count, false);
+	}
+
+	void Quaternion::fastSlerp(const Quaternion* from, const Quaternion* to, const float* k, Quaternion* out, const size_t count) {
+		interpolate(from, to, k, out, count, true);
+	}
+
+	void Quaternion::interpolate(const Quaternion* from, const Quaternion* to, const float* k, Quaternion* out, const size_t count, const bool corrected) {
+		size_t i = 0;
+#if QUATERNION_X86
+		const __m128 signBit = _mm_set1_ps(-0.0f);
+		for (; i + 4 <= count; i += 4) {
+			__m128 ax = _mm_loadu_ps(&from[i].x), ay = _mm_loadu_ps(&from[i + 1].x);
+			__m128 az = _mm_loadu_ps(&from[i + 2].x), at = _mm_loadu_ps(&from[i + 3].x);
+			__m128 bx = _mm_loadu_ps(&to[i].x), by = _mm_loadu_ps(&to[i + 1].x);
+			__m128 bz = _mm_loadu_ps(&to[i + 2].x), bt = _mm_loadu_ps(&to[i + 3].x);
+			_MM_TRANSPOSE4_PS(ax, ay, az, at);
+			_MM_TRANSPOSE4_PS(bx, by, bz, bt);
+
+			// The shortest arc goes to whichever of q and -q is closer: the sign of the cosine flips the target
+			const __m128 cosine = _mm_add_ps(_mm_add_ps(_mm_mul_ps(ax, bx), _mm_mul_ps(ay, by)), _mm_add_ps(_mm_mul_ps(az, bz), _mm_mul_ps(at, bt)));
+			const __m128 sign = _mm_and_ps(cosine, signBit);
+			bx = _mm_xor_ps(bx, sign);
+			by = _mm_xor_ps(by, sign);
+			bz = _mm_xor_ps(bz, sign);
+			bt = _mm_xor_ps(bt, sign);
+
+			__m128 factor = _mm_loadu_ps(&k[i]);
+			if (corrected) {
+				factor = correctFactor(factor, _mm_andnot_ps(signBit, cosine));
+			}
+			__m128 x = _mm_add_ps(ax, _mm_mul_ps(_mm_sub_ps(bx, ax), factor));
+			__m128 y = _mm_add_ps(ay, _mm_mul_ps(_mm_sub_ps(by, ay), factor));
+			__m128 z = _mm_add_ps(az, _mm_mul_ps(_mm_sub_ps(bz, az), factor));
+			__m128 t = _mm_add_ps(at, _mm_mul_ps(_mm_sub_ps(bt, at), factor));
+			const __m128 inverse = inverseLengths(_mm_add_ps(_mm_add_ps(_mm_mul_ps(x, x), _mm_mul_ps(y, y)), _mm_add_ps(_mm_mul_ps(z, z), _mm_mul_ps(t, t))));
+			x = _mm_mul_ps(x, inverse);
+			y = _mm_mul_ps(y, inverse);
+			z = _mm_mul_ps(z, inverse);
+			t = _mm_mul_ps(t, inverse);
+
+			_MM_TRANSPOSE4_PS(x, y, z, t);
+			_mm_storeu_ps(&out[i].x, x);
+			_mm_storeu_ps(&out[i + 1].x, y);
+			_mm_storeu_ps(&out[i + 2].x, z);
+			_mm_storeu_ps(&out[i + 3].x, t);
+		}
+#endif
+		for (; i < count; i++) {
+			const Quaternion& a = from[i];
+			const Quaternion& b = to[i];
+			const float cosine = a.x * b.x + a.y * b.y + a.z * b.z + a.t * b.t;
+			const float sign = cosine < 0.0f ? -1.0f : 1.0f;
+			const float factor = corrected ? correctFactor(k[i], std::fabs(cosine)) : k[i];
+			const float k0 = 1.0f - factor, k1 = factor * sign;
+			out[i] = Quaternion(a.t * k0 + b.t * k1, a.x * k0 + b.x * k1, a.y * k0 + b.y * k1, a.z * k0 + b.z * k1).normalize();
+		}
+	}
+
 	void Quaternion::printAngleAxis(const std::string& s) const {
 		std::cout << s << " = [" << std::endl;
 
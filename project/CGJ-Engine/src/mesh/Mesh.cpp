@@ -1,14 +1,47 @@
 #include "Mesh/Mesh.h"
 #include "Utils.h"
+#include "render/RenderState.h"
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <iostream>
 #include <string>
 #include <strstream>
 
 namespace engine {
 
-	int Mesh::vertexAttrib = -1, Mesh::texcoordAttrib = -1, Mesh::normalAttrib = -1;
+	int Mesh::vertexAttrib = -1, Mesh::texcoordAttrib = -1, Mesh::normalAttrib = -1, Mesh::jointAttrib = -1, Mesh::weightAttrib = -1;
+
+	SkinWeights SkinWeights::fromWeights(const int* joints, const float* weights, const int count) {
+		// Largest influences first
+		int order[8];
+		const int kept = std::min(count, 8);
+		for (int i = 0; i < kept; i++) {
+			order[i] = i;
+		}
+		std::sort(order, order + kept, [weights](const int a, const int b) { return weights[a] > weights[b]; });
+
+		SkinWeights skin = {};
+		float total = 0.0f;
+		for (int i = 0; i < std::min(kept, 4); i++) {
+			total += std::max(weights[order[i]], 0.0f);
+		}
+		if (total <= 0.0f) {
+			skin.weights[0] = 255;
+			return skin;
+		}
+		// Rounding error goes to the largest weight, so the bytes add up to 255
+		int sum = 0;
+		for (int i = 0; i < std::min(kept, 4); i++) {
+			skin.joints[i] = (GLubyte)joints[order[i]];
+			skin.weights[i] = (GLubyte)std::lround(std::max(weights[order[i]], 0.0f) / total * 255.0f);
+			sum += skin.weights[i];
+		}
+		skin.weights[0] = (GLubyte)(skin.weights[0] + 255 - sum);
+		return skin;
+	}
 
 	Mesh::Mesh() {
-		this->color = { 1.0f, 1.0f, 1.0f, 1.0f };
 	}
 
 	Mesh::~Mesh() {
@@ -36,6 +69,19 @@ namespace engine {
 		normalData.push_back(n);
 	}
 
+	void Mesh::parseSkin(std::stringstream& sin)
+	{
+		int joints[4];
+		float weights[4];
+		int count = 0;
+		while (count < 4 && sin >> joints[count] >> weights[count]) {
+			count++;
+		}
+		// Positions before this one without influences are bound to joint 0
+		skinData.resize(std::max(vertexData.size(), (size_t)1) - 1, SkinWeights::fromWeights(nullptr, nullptr, 0));
+		skinData.push_back(SkinWeights::fromWeights(joints, weights, count));
+	}
+
 	void Mesh::parseFace(std::stringstream& sin)
 	{
 		std::string token;
@@ -68,6 +114,7 @@ namespace engine {
 		if (s.compare("v") == 0) parseVertex(sin);
 		else if (s.compare("vt") == 0) parseTexCoord(sin);
 		else if (s.compare("vn") == 0) parseNormal(sin);
+		else if (s.compare("vs") == 0) parseSkin(sin);
 		else if (s.compare("f") == 0) parseFace(sin);
 	}
 
@@ -84,6 +131,9 @@ namespace engine {
 
 	void Mesh::processMeshData()
 	{
+		if (!skinData.empty()) {
+			skinData.resize(vertexData.size(), SkinWeights::fromWeights(nullptr, nullptr, 0));
+		}
 		for (unsigned int i = 0; i < vertexIdx.size(); i++) {
 			unsigned int vi = vertexIdx[i];
 			Vertex v = vertexData[vi - 1];
@@ -98,7 +148,26 @@ namespace engine {
 				Vertex n = normalData[ni - 1];
 				normals.push_back(n);
 			}
+			if (!skinData.empty()) {
+				skinWeights.push_back(skinData[vi - 1]);
+			}
+		}
+		computeBounds();
+	}
+
+	void Mesh::computeBounds() {
+		if (vertices.empty()) {
+			return;
+		}
+		// Center of the bounding box, close enough to the smallest sphere for culling
+		std::vector<float> bounds = getBoundingCoords();
+		boundsCenter = Vector3((bounds[0] + bounds[1]) / 2.0f, (bounds[2] + bounds[3]) / 2.0f, (bounds[4] + bounds[5]) / 2.0f);
+		float radius = 0.0f;
+		for (const Vertex& v : vertices) {
+			const Vector3 offset = Vector3(v.XYZW[0], v.XYZW[1], v.XYZW[2]) - boundsCenter;
+			radius = std::max(radius, offset.dot(offset));
 		}
+		boundsRadius = std::sqrt(radius);
 	}
 
 	void Mesh::freeMeshData()
@@ -109,22 +178,66 @@ namespace engine {
 		vertexIdx.clear();
 		texCoordIdx.clear();
 		normalIdx.clear();
+		skinData.clear();
 	}
 
 	Mesh* Mesh::parseMesh(const char* wavefrontObjPath, ShaderProgram* shaderProgram) {
 
 		Mesh* m = new Mesh();
-		m->loadMeshData(wavefrontObjPath);
-		m->processMeshData();
-		m->freeMeshData();
-		m->setVertexAttrib(shaderProgram->getBinding("VERTICES"));
-		m->setTexCoordAttrib(shaderProgram->getBinding("TEX_COORDS"));
-		m->setNormalAttrib(shaderProgram->getBinding("NORMALS"));
-		m->createBufferObject();
+		m->loadFromFile(wavefrontObjPath);
+		m->upload(shaderProgram);
 		return m;
 
 	}
 
+	void Mesh::loadFromFile(const char* wavefrontObjPath) {
+		loadMeshData(wavefrontObjPath);
+		processMeshData();
+		freeMeshData();
+	}
+
+	void Mesh::upload(ShaderProgram* shaderProgram) {
+		setVertexAttrib(shaderProgram->getBinding("VERTICES"));
+		setTexCoordAttrib(shaderProgram->getBinding("TEX_COORDS"));
+		setNormalAttrib(shaderProgram->getBinding("NORMALS"));
+		setSkinAttribs(shaderProgram->getBinding("JOINTS"), shaderProgram->getBinding("WEIGHTS"));
+		createBufferObject();
+	}
+
+	Mesh* Mesh::createDynamicCopy() const {
+		Mesh* copy = new Mesh();
+		copy->vertices = vertices;
+		copy->boundsCenter = boundsCenter;
+		copy->boundsRadius = boundsRadius;
+		copy->dynamic = true;
+		copy->createBufferObject();
+		return copy;
+	}
+
+	void Mesh::updateVertices(const std::vector<Vertex>& updated) {
+		if (updated.size() != vertices.size()) {
+			std::cerr << "[Mesh] Cannot update " << vertices.size() << " vertices with " << updated.size() << std::endl;
+			return;
+		}
+		vertices = updated;
+		// Orphans the storage, the draws of the previous frames may still read it
+		RenderState::getInstance()->bindBuffer(GL_ARRAY_BUFFER, VboId);
+		glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(Vertex), vertices.data(), GL_DYNAMIC_DRAW);
+		computeBounds();
+	}
+
+	const bool Mesh::isLoaded() const {
+		return VaoId != 0;
+	}
+
+	const Vector3& Mesh::getBoundsCenter() const {
+		return boundsCenter;
+	}
+
+	const float Mesh::getBoundsRadius() const {
+		return boundsRadius;
+	}
+
 	void Mesh::setVertexAttrib(const GLuint attrib) {
 		this->vertexAttrib = attrib;
 	}
@@ -137,6 +250,11 @@ namespace engine {
 		this->normalAttrib = attrib;
 	}
 
+	void Mesh::setSkinAttribs(const GLuint joints, const GLuint weights) {
+		this->jointAttrib = joints;
+		this->weightAttrib = weights;
+	}
+
 	const bool Mesh::operator== (const Mesh& mesh) const {
 		return this->vertices.data() == mesh.getVertices().data();
 	}
@@ -149,22 +267,50 @@ namespace engine {
 		return vertices;
 	}
 
-	const Matrix4 Mesh::getModelMatrix() const {
-		return modelMatrix;
+	const std::vector<TexCoord>& Mesh::getTexCoords() const {
+		return texCoords;
+	}
+
+	const std::vector<Vertex>& Mesh::getNormals() const {
+		return normals;
 	}
 
-	const Vertex Mesh::getColor() const {
-		return color;
+	const std::vector<SkinWeights>& Mesh::getSkinWeights() const {
+		return skinWeights;
+	}
+
+	void Mesh::setSkinWeights(const std::vector<SkinWeights>& weights) {
+		if (weights.size() != vertices.size()) {
+			std::cerr << "[Mesh] " << weights.size() << " skin weights for " << vertices.size() << " vertices" << std::endl;
+			return;
+		}
+		skinWeights = weights;
+		if (isLoaded() && jointAttrib != -1) {
+			if (SkinVboId != 0) {
+				glDeleteBuffers(1, &SkinVboId);
+				RenderState::getInstance()->forgetBuffer(SkinVboId);
+			}
+			createSkinBuffer();
+		}
+	}
+
+	const bool Mesh::isSkinned() const {
+		return !skinWeights.empty();
+	}
+
+	const Matrix4 Mesh::getModelMatrix() const {
+		return modelMatrix;
 	}
 
 	void Mesh::createBufferObject() {
+		RenderState* state = RenderState::getInstance();
 		glGenVertexArrays(1, &VaoId);
-		glBindVertexArray(VaoId);
+		state->bindVertexArray(VaoId);
 
 		glGenBuffers(1, &VboId);
-		glBindBuffer(GL_ARRAY_BUFFER, VboId);
+		state->bindBuffer(GL_ARRAY_BUFFER, VboId);
 		{
-			glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(Vertex), vertices.data(), GL_STATIC_DRAW);
+			glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(Vertex), vertices.data(), dynamic ? GL_DYNAMIC_DRAW : GL_STATIC_DRAW);
 			glEnableVertexAttribArray(Mesh::vertexAttrib);
 			glVertexAttribPointer(Mesh::vertexAttrib, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), 0);
 		}
@@ -172,7 +318,7 @@ namespace engine {
 		if (texcoordAttrib != -1 && TexcoordsLoaded) {
 
 			glGenBuffers(1, &TexCoordVboId);
-			glBindBuffer(GL_ARRAY_BUFFER, TexCoordVboId);
+			state->bindBuffer(GL_ARRAY_BUFFER, TexCoordVboId);
 			{
 				glBufferData(GL_ARRAY_BUFFER, texCoords.size() * sizeof(TexCoord), &texCoords[0], GL_STATIC_DRAW);
 				glEnableVertexAttribArray(texcoordAttrib);
@@ -183,7 +329,7 @@ namespace engine {
 		if (normalAttrib != -1 && NormalsLoaded) {
 
 			glGenBuffers(1, &NormalVboId);
-			glBindBuffer(GL_ARRAY_BUFFER, NormalVboId);
+			state->bindBuffer(GL_ARRAY_BUFFER, NormalVboId);
 			{
 				glBufferData(GL_ARRAY_BUFFER, normals.size() * sizeof(Vertex), &normals[0], GL_STATIC_DRAW);
 				glEnableVertexAttribArray(normalAttrib);
@@ -191,30 +337,79 @@ namespace engine {
 			}
 		}
 
-		glBindVertexArray(0);
-		glBindBuffer(GL_ARRAY_BUFFER, 0);
+		state->bindVertexArray(0);
+		state->bindBuffer(GL_ARRAY_BUFFER, 0);
+
+		if (jointAttrib != -1 && !skinWeights.empty()) {
+			createSkinBuffer();
+		}
+	}
+
+	void Mesh::createSkinBuffer() {
+		RenderState* state = RenderState::getInstance();
+		state->bindVertexArray(VaoId);
+
+		glGenBuffers(1, &SkinVboId);
+		state->bindBuffer(GL_ARRAY_BUFFER, SkinVboId);
+		{
+			glBufferData(GL_ARRAY_BUFFER, skinWeights.size() * sizeof(SkinWeights), skinWeights.data(), GL_STATIC_DRAW);
+			// Joint indices stay integers, weights are read normalized
+			glEnableVertexAttribArray(jointAttrib);
+			glVertexAttribIPointer(jointAttrib, 4, GL_UNSIGNED_BYTE, sizeof(SkinWeights), 0);
+			glEnableVertexAttribArray(weightAttrib);
+			glVertexAttribPointer(weightAttrib, 4, GL_UNSIGNED_BYTE, GL_TRUE, sizeof(SkinWeights), (const GLvoid*)offsetof(SkinWeights, weights));
+		}
+
+		state->bindVertexArray(0);
+		state->bindBuffer(GL_ARRAY_BUFFER, 0);
 	}
 
 	void Mesh::destroyBufferObject() const {
-		glBindVertexArray(VaoId);
+		RenderState* state = RenderState::getInstance();
+		state->bindVertexArray(VaoId);
 		glDisableVertexAttribArray(vertexAttrib);
 		glDeleteBuffers(1, &VboId);
+		state->forgetBuffer(VboId);
 		if (texcoordAttrib != -1) {
 			glDisableVertexAttribArray(texcoordAttrib);
 			glDeleteBuffers(1, &TexCoordVboId);
+			state->forgetBuffer(TexCoordVboId);
 		}
 		if (normalAttrib != -1) {
 			glDisableVertexAttribArray(normalAttrib);
 			glDeleteBuffers(1, &NormalVboId);
+			state->forgetBuffer(NormalVboId);
+		}
+		if (SkinVboId != 0) {
+			glDisableVertexAttribArray(jointAttrib);
+			glDisableVertexAttribArray(weightAttrib);
+			glDeleteBuffers(1, &SkinVboId);
+			state->forgetBuffer(SkinVboId);
 		}
 		glDeleteVertexArrays(1, &VaoId);
-		glBindBuffer(GL_ARRAY_BUFFER, 0);
+		state->forgetVertexArray(VaoId);
+		state->bindBuffer(GL_ARRAY_BUFFER, 0);
 	}
 
 	void Mesh::draw() {
-		glBindVertexArray(VaoId);
+		if (!isLoaded()) {
+			return;
+		}
+		// The VAO stays bound, the next draw of the same mesh skips the bind
+		RenderState::getInstance()->bindVertexArray(VaoId);
 		glDrawArrays(GL_TRIANGLES, 0, (GLsizei)vertices.size());
-		glBindVertexArray(0);
+	}
+
+	void Mesh::drawInstanced(const InstanceBuffer* instances, const ShaderProgram* shaderProgram, const GLsizei count, const GLuint baseInstance) {
+		if (!isLoaded()) {
+			return;
+		}
+		if (InstanceVboId != instances->getId()) {
+			instances->attach(VaoId, shaderProgram);
+			InstanceVboId = instances->getId();
+		}
+		RenderState::getInstance()->bindVertexArray(VaoId);
+		glDrawArraysInstancedBaseInstance(GL_TRIANGLES, 0, (GLsizei)vertices.size(), count, baseInstance);
 	}
 
 	void Mesh::scale(const float x, const float y, const float z) {
@@ -232,12 +427,6 @@ namespace engine {
 		modelMatrix = MatrixFactory::Translate(x, y, z) * modelMatrix;
 	}
 
-	Mesh* Mesh::inColor(Vertex color) {
-		Mesh* m = new Mesh(*this);
-		m->color = color;
-		return m;
-	}
-
 	std::vector<float> Mesh::getBoundingCoords() const {
 		float constexpr inf = std::numeric_limits<float>::infinity();
 		std::vector<float> bounds = { -inf, inf, -inf, inf, -inf, inf };
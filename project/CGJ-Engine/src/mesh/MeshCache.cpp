@@ -0,0 +1,69 @@
+#include "mesh/MeshCache.h"
+
+namespace engine {
+
+	/**
+	* For all implementations in this file, @see MeshCache.h for details
+	*/
+
+	MeshCache* MeshCache::instance;
+
+	MeshCache* MeshCache::getInstance() {
+		if (instance == nullptr) {
+			instance = new MeshCache();
+		}
+		return instance;
+	}
+
+	Mesh* MeshCache::loadMesh(const char* path, ShaderProgram* shaderProgram) {
+		return getInstance()->load(path, shaderProgram);
+	}
+
+	MeshCache::MeshCache() {
+	}
+
+	const std::string MeshCache::createKey(const char* path, ShaderProgram* shaderProgram) const {
+		return std::string(path)
+			.append("|").append(std::to_string(shaderProgram->getBinding("VERTICES")))
+			.append("|").append(std::to_string(shaderProgram->getBinding("TEX_COORDS")))
+			.append("|").append(std::to_string(shaderProgram->getBinding("NORMALS")));
+	}
+
+	Mesh* MeshCache::load(const char* path, ShaderProgram* shaderProgram) {
+		const std::string key = createKey(path, shaderProgram);
+		std::map<std::string, Mesh*>::iterator it = meshes.find(key);
+		if (it != meshes.end()) {
+			hits++;
+			return it->second;
+		}
+		Mesh* mesh = Mesh::parseMesh(path, shaderProgram);
+		meshes.insert(std::pair<std::string, Mesh*>(key, mesh));
+		return mesh;
+	}
+
+	Mesh* MeshCache::find(const char* path, ShaderProgram* shaderProgram) const {
+		std::map<std::string, Mesh*>::const_iterator it = meshes.find(createKey(path, shaderProgram));
+		return it != meshes.end() ? it->second : nullptr;
+	}
+
+	void MeshCache::insert(const char* path, ShaderProgram* shaderProgram, Mesh* mesh) {
+		meshes[createKey(path, shaderProgram)] = mesh;
+	}
+
+	const size_t MeshCache::size() const {
+		return meshes.size();
+	}
+
+	const unsigned int MeshCache::getHits() const {
+		return hits;
+	}
+
+	void MeshCache::clear() {
+		for (std::pair<const std::string, Mesh*>& entry : meshes) {
+			delete entry.second;
+		}
+		meshes.clear();
+		hits = 0;
+	}
+
+}
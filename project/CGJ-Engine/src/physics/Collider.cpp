@@ -31,6 +31,10 @@ namespace engine {
 		return bounds[0] - bounds[1];
 	}
 
+	const Vertex Collider::getColor() const {
+		return color;
+	}
+
 	void Collider::update() {
 		// DETECT COLLISIONS
 		if (Physics::getInstance()->showColliders()) {
@@ -0,0 +1,43 @@
+#include "render/IndirectBuffer.h"
+#include "render/RenderState.h"
+#include "render/StreamBuffer.h"
+#include <cstring>
+
+namespace engine {
+
+	/**
+	* For all implementations in this file, @see IndirectBuffer.h for details
+	*/
+
+	bool IndirectBuffer::upload(const std::vector<DrawCommand>& commands, const std::vector<InstanceData>& parameters) {
+		if (commands.empty()) {
+			return true;
+		}
+		StreamBuffer* stream = StreamBuffer::getInstance();
+		StreamBuffer::Allocation commandData = stream->allocate(commands.size() * sizeof(DrawCommand), sizeof(GLuint));
+		StreamBuffer::Allocation parameterData = stream->allocateStorage(parameters.size() * sizeof(InstanceData));
+		if (!commandData.isValid() || !parameterData.isValid()) {
+			return false;
+		}
+		std::memcpy(commandData.data, commands.data(), commandData.size);
+		std::memcpy(parameterData.data, parameters.data(), parameterData.size);
+		stream->flush();
+
+		commandOffset = commandData.offset;
+		parameterOffset = parameterData.offset;
+		parameterSize = parameterData.size;
+		return true;
+	}
+
+	void IndirectBuffer::bind(const GLuint bindingPoint) const {
+		RenderState* state = RenderState::getInstance();
+		const GLuint stream = StreamBuffer::getInstance()->getId();
+		state->bindBuffer(GL_DRAW_INDIRECT_BUFFER, stream);
+		state->bindBufferRange(GL_SHADER_STORAGE_BUFFER, bindingPoint, stream, parameterOffset, parameterSize);
+	}
+
+	const GLintptr IndirectBuffer::getCommandOffset(const GLuint command) const {
+		return commandOffset + command * sizeof(DrawCommand);
+	}
+
+}
@@ -0,0 +1,62 @@
+#include "render/InstanceBuffer.h"
+#include "render/RenderState.h"
+#include "render/StreamBuffer.h"
+#include <cstddef>
+#include <cstring>
+
+namespace engine {
+
+	/**
+	* For all implementations in this file, @see InstanceBuffer.h for details
+	*/
+
+	bool InstanceBuffer::upload(const std::vector<InstanceData>& instances) {
+		if (instances.empty()) {
+			return true;
+		}
+		// Aligned to whole instances, so the base instance can address them from the buffer start
+		StreamBuffer* stream = StreamBuffer::getInstance();
+		StreamBuffer::Allocation allocation = stream->allocate(instances.size() * sizeof(InstanceData), sizeof(InstanceData));
+		if (!allocation.isValid()) {
+			return false;
+		}
+		std::memcpy(allocation.data, instances.data(), allocation.size);
+		stream->flush();
+		firstInstance = (GLuint)(allocation.offset / sizeof(InstanceData));
+		return true;
+	}
+
+	void InstanceBuffer::attach(const GLuint vertexArray, const ShaderProgram* shaderProgram) const {
+		RenderState* state = RenderState::getInstance();
+		state->bindVertexArray(vertexArray);
+		state->bindBuffer(GL_ARRAY_BUFFER, getId());
+
+		// A mat4 attribute takes four consecutive locations, one per column
+		const GLuint matrix = shaderProgram->getBinding("INSTANCE_MATRIX");
+		for (GLuint column = 0; column < 4; column++) {
+			glEnableVertexAttribArray(matrix + column);
+			glVertexAttribPointer(matrix + column, 4, GL_FLOAT, GL_FALSE, sizeof(InstanceData),
+				(const GLvoid*)(offsetof(InstanceData, modelMatrix) + column * 4 * sizeof(GLfloat)));
+			glVertexAttribDivisor(matrix + column, 1);
+		}
+
+		const GLuint color = shaderProgram->getBinding("INSTANCE_COLOR");
+		glEnableVertexAttribArray(color);
+		glVertexAttribPointer(color, 4, GL_FLOAT, GL_FALSE, sizeof(InstanceData), (const GLvoid*)offsetof(InstanceData, color));
+		glVertexAttribDivisor(color, 1);
+
+		const GLuint layer = shaderProgram->getBinding("INSTANCE_LAYER");
+		glEnableVertexAttribArray(layer);
+		glVertexAttribIPointer(layer, 1, GL_INT, sizeof(InstanceData), (const GLvoid*)offsetof(InstanceData, textureLayer));
+		glVertexAttribDivisor(layer, 1);
+	}
+
+	const GLuint InstanceBuffer::getId() const {
+		return StreamBuffer::getInstance()->getId();
+	}
+
+	const GLuint InstanceBuffer::getFirstInstance() const {
+		return firstInstance;
+	}
+
+}
@@ -0,0 +1,159 @@
+#include "render/MeshArena.h"
+#include "render/RenderState.h"
+#include <cstddef>
+#include <cstring>
+
+namespace engine {
+
+	/**
+	* For all implementations in this file, @see MeshArena.h for details
+	*/
+
+	struct ArenaVertexHash {
+		size_t operator()(const ArenaVertex& vertex) const {
+			// FNV-1a over the bytes of the vertex
+			const unsigned char* bytes = (const unsigned char*)&vertex;
+			size_t hash = 2166136261u;
+			for (size_t i = 0; i < sizeof(ArenaVertex); i++) {
+				hash = (hash ^ bytes[i]) * 16777619u;
+			}
+			return hash;
+		}
+	};
+
+	struct ArenaVertexEqual {
+		bool operator()(const ArenaVertex& a, const ArenaVertex& b) const {
+			return std::memcmp(&a, &b, sizeof(ArenaVertex)) == 0;
+		}
+	};
+
+	MeshArena::MeshArena() {
+	}
+
+	MeshArena::~MeshArena() {
+		RenderState* state = RenderState::getInstance();
+		const GLuint buffers[] = { VboId, IndexVboId, DrawIdVboId };
+		glDeleteBuffers(3, buffers);
+		for (GLuint buffer : buffers) {
+			state->forgetBuffer(buffer);
+		}
+		glDeleteVertexArrays(1, &VaoId);
+		state->forgetVertexArray(VaoId);
+	}
+
+	const MeshArena::Range& MeshArena::add(const Mesh* mesh) {
+		const std::vector<Vertex> positions = mesh->getVertices();
+		const std::vector<TexCoord>& texCoords = mesh->getTexCoords();
+		const std::vector<Vertex>& normals = mesh->getNormals();
+
+		Range range = { (GLuint)indices.size(), (GLuint)positions.size(), (GLint)vertices.size() };
+		std::unordered_map<ArenaVertex, GLuint, ArenaVertexHash, ArenaVertexEqual> unique;
+		for (size_t i = 0; i < positions.size(); i++) {
+			ArenaVertex vertex;
+			std::memset(&vertex, 0, sizeof(vertex));
+			std::memcpy(vertex.position, positions[i].XYZW, sizeof(vertex.position));
+			if (i < texCoords.size()) {
+				std::memcpy(vertex.texCoord, texCoords[i].UV, sizeof(vertex.texCoord));
+			}
+			if (i < normals.size()) {
+				std::memcpy(vertex.normal, normals[i].XYZW, sizeof(vertex.normal));
+			}
+
+			// Indices are relative to the base vertex of the mesh
+			std::unordered_map<ArenaVertex, GLuint, ArenaVertexHash, ArenaVertexEqual>::iterator it = unique.find(vertex);
+			if (it == unique.end()) {
+				it = unique.insert(std::make_pair(vertex, (GLuint)(vertices.size() - range.baseVertex))).first;
+				vertices.push_back(vertex);
+			}
+			indices.push_back(it->second);
+		}
+
+		dirty = true;
+		return ranges[mesh] = range;
+	}
+
+	const MeshArena::Range* MeshArena::find(const Mesh* mesh) {
+		if (mesh == nullptr) {
+			return nullptr;
+		}
+		std::unordered_map<const Mesh*, Range>::const_iterator it = ranges.find(mesh);
+		if (it != ranges.end()) {
+			return &it->second;
+		}
+		if (!mesh->isLoaded()) {
+			return nullptr;
+		}
+		return &add(mesh);
+	}
+
+	void MeshArena::createVertexArray(const ShaderProgram* shaderProgram) {
+		RenderState* state = RenderState::getInstance();
+		glGenVertexArrays(1, &VaoId);
+		glGenBuffers(1, &VboId);
+		glGenBuffers(1, &IndexVboId);
+		glGenBuffers(1, &DrawIdVboId);
+		state->bindVertexArray(VaoId);
+
+		state->bindBuffer(GL_ARRAY_BUFFER, VboId);
+		{
+			const GLuint position = shaderProgram->getBinding("VERTICES");
+			glEnableVertexAttribArray(position);
+			glVertexAttribPointer(position, 3, GL_FLOAT, GL_FALSE, sizeof(ArenaVertex), (const GLvoid*)offsetof(ArenaVertex, position));
+
+			const GLuint texCoord = shaderProgram->getBinding("TEX_COORDS");
+			glEnableVertexAttribArray(texCoord);
+			glVertexAttribPointer(texCoord, 2, GL_FLOAT, GL_FALSE, sizeof(ArenaVertex), (const GLvoid*)offsetof(ArenaVertex, texCoord));
+
+			const GLuint normal = shaderProgram->getBinding("NORMALS");
+			glEnableVertexAttribArray(normal);
+			glVertexAttribPointer(normal, 3, GL_FLOAT, GL_FALSE, sizeof(ArenaVertex), (const GLvoid*)offsetof(ArenaVertex, normal));
+		}
+
+		state->bindBuffer(GL_ARRAY_BUFFER, DrawIdVboId);
+		{
+			const GLuint drawId = shaderProgram->getBinding("DRAW_ID");
+			glEnableVertexAttribArray(drawId);
+			glVertexAttribIPointer(drawId, 1, GL_UNSIGNED_INT, sizeof(GLuint), 0);
+			glVertexAttribDivisor(drawId, 1);
+		}
+
+		// The element buffer binding is part of the vertex array state
+		state->bindBuffer(GL_ELEMENT_ARRAY_BUFFER, IndexVboId);
+	}
+
+	void MeshArena::upload(const ShaderProgram* shaderProgram, const size_t drawCount) {
+		RenderState* state = RenderState::getInstance();
+		if (VaoId == 0) {
+			createVertexArray(shaderProgram);
+		}
+
+		if (dirty) {
+			// Meshes are only added while streaming in, a full upload is simpler than tracking ranges
+			state->bindBuffer(GL_ARRAY_BUFFER, VboId);
+			glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(ArenaVertex), vertices.data(), GL_STATIC_DRAW);
+			state->bindVertexArray(VaoId);
+			state->bindBuffer(GL_ELEMENT_ARRAY_BUFFER, IndexVboId);
+			glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(GLuint), indices.data(), GL_STATIC_DRAW);
+			dirty = false;
+		}
+
+		if (drawCount > drawIds) {
+			drawIds = drawCount * 2;
+			std::vector<GLuint> ids(drawIds);
+			for (size_t i = 0; i < drawIds; i++) {
+				ids[i] = (GLuint)i;
+			}
+			state->bindBuffer(GL_ARRAY_BUFFER, DrawIdVboId);
+			glBufferData(GL_ARRAY_BUFFER, ids.size() * sizeof(GLuint), ids.data(), GL_STATIC_DRAW);
+		}
+	}
+
+	void MeshArena::bind() const {
+		RenderState::getInstance()->bindVertexArray(VaoId);
+	}
+
+	const size_t MeshArena::getVertexCount() const {
+		return vertices.size();
+	}
+
+}
@@ -0,0 +1,291 @@
+#include "render/RenderQueue.h"
+#include "scene/SceneNode.h"
+#include "render/RenderState.h"
+#include <algorithm>
+#include <cstring>
+
+namespace engine {
+
+	/**
+	* For all implementations in this file, @see RenderQueue.h for details
+	*/
+
+	uint64_t RenderQueue::makeKey(const RenderPass pass, const bool translucent, const unsigned int shader,
+		const unsigned int material, const unsigned int texture, const unsigned int mesh, const float depth) {
+
+		// Positive floats sort like their bit patterns, keep the top bits
+		float distance = std::max(0.0f, depth);
+		uint32_t bits;
+		std::memcpy(&bits, &distance, sizeof(bits));
+
+		const uint64_t state = ((uint64_t)(shader & ((1 << SHADER_BITS) - 1)) << (MATERIAL_BITS + TEXTURE_BITS))
+			| ((uint64_t)(material & ((1 << MATERIAL_BITS) - 1)) << TEXTURE_BITS)
+			| (uint64_t)(texture & ((1 << TEXTURE_BITS) - 1));
+
+		uint64_t key = (uint64_t)pass << 60;
+		if (translucent) {
+			// Back to front: the farthest draw gets the smallest key
+			const uint64_t depthKey = ((1 << DEPTH_BITS) - 1) - (bits >> (32 - DEPTH_BITS));
+			key |= (uint64_t)1 << 59;
+			key |= depthKey << (SHADER_BITS + MATERIAL_BITS + TEXTURE_BITS);
+			key |= state;
+		}
+		else {
+			// Same mesh next to each other for instancing, then front to back to help early depth rejection
+			key |= state << (MESH_BITS + OPAQUE_DEPTH_BITS);
+			key |= (uint64_t)(mesh & ((1 << MESH_BITS) - 1)) << OPAQUE_DEPTH_BITS;
+			key |= bits >> (32 - OPAQUE_DEPTH_BITS);
+		}
+		return key;
+	}
+
+	RenderPass RenderQueue::getPass(const uint64_t key) {
+		return (RenderPass)(key >> 60);
+	}
+
+	unsigned int RenderQueue::getId(const void* object) {
+		if (object == nullptr) {
+			return 0;
+		}
+		std::unordered_map<const void*, unsigned int>::iterator it = ids.find(object);
+		if (it != ids.end()) {
+			return it->second;
+		}
+		const unsigned int id = (unsigned int)ids.size() + 1;
+		ids[object] = id;
+		return id;
+	}
+
+	void RenderQueue::clear() {
+		packets.clear();
+	}
+
+	void RenderQueue::push(const uint64_t key, SceneNode* node) {
+		packets.push_back({ key, node });
+	}
+
+	void RenderQueue::sort() {
+		std::sort(packets.begin(), packets.end(), [](const DrawPacket& a, const DrawPacket& b) { return a.key < b.key; });
+	}
+
+	RenderQueue::~RenderQueue() {
+		delete instanceBuffer;
+		delete indirectBuffer;
+		delete arena;
+	}
+
+	bool RenderQueue::isIndirectSupported() {
+		return GLEW_VERSION_4_3 || (GLEW_ARB_multi_draw_indirect && GLEW_ARB_base_instance
+			&& GLEW_ARB_shader_storage_buffer_object && GLEW_ARB_program_interface_query);
+	}
+
+	void RenderQueue::setIndirect(const bool enabled) {
+		indirect = enabled;
+	}
+
+	void RenderQueue::setDepthEqual(const bool enabled) {
+		depthEqual = enabled;
+	}
+
+	const bool RenderQueue::isIndirect() const {
+		return indirect && isIndirectSupported();
+	}
+
+	bool RenderQueue::canBatch(const DrawPacket& first, const DrawPacket& packet) {
+		if (first.key & ((uint64_t)1 << 59)) {
+			return false;
+		}
+		// Every skinned node has its own palette
+		if (first.node->getSkin() != nullptr || packet.node->getSkin() != nullptr) {
+			return false;
+		}
+		if ((first.key >> OPAQUE_DEPTH_BITS) != (packet.key >> OPAQUE_DEPTH_BITS) || !isSameState(first, packet)) {
+			return false;
+		}
+		// Mesh ids are truncated in the key, compare the meshes themselves
+		if (isDepthOnly(first.key)) {
+			return first.node->getDepthMesh() == packet.node->getDepthMesh();
+		}
+		return first.node->getMesh() == packet.node->getMesh();
+	}
+
+	uint64_t RenderQueue::getState(const uint64_t key) {
+		if (key & ((uint64_t)1 << 59)) {
+			// Translucent keys keep their state in the low bits, below the depth
+			const uint64_t stateMask = ((uint64_t)1 << (SHADER_BITS + MATERIAL_BITS + TEXTURE_BITS)) - 1;
+			return ((key >> 59) << 59) | (key & stateMask);
+		}
+		return key >> (MESH_BITS + OPAQUE_DEPTH_BITS);
+	}
+
+	bool RenderQueue::isSameState(const DrawPacket& first, const DrawPacket& packet) {
+		if (getState(first.key) != getState(packet.key)) {
+			return false;
+		}
+		// Program ids and object ids are truncated in the key, compare the objects themselves
+		const SceneNode* a = first.node;
+		const SceneNode* b = packet.node;
+		if (isDepthOnly(first.key)) {
+			return a->getShadowShaderProgram() == b->getShadowShaderProgram();
+		}
+		return a->getDrawProgram() == b->getDrawProgram() && a->getMaterial() == b->getMaterial()
+			&& a->getDrawTexture() == b->getDrawTexture();
+	}
+
+	bool RenderQueue::isDepthOnly(const uint64_t key) {
+		return getPass(key) != RenderPass::MAIN;
+	}
+
+	InstanceData RenderQueue::getDrawData(const SceneNode* node) {
+		InstanceData data;
+		std::memcpy(data.modelMatrix, node->getWorldMatrix()->elements, sizeof(data.modelMatrix));
+		std::memcpy(data.color, node->getColor().XYZW, sizeof(data.color));
+		data.textureLayer = node->getTextureArray() != nullptr ? node->getTextureLayer() : -1;
+		data.padding[0] = data.padding[1] = data.padding[2] = 0;
+		return data;
+	}
+
+	RenderQueue::Batch RenderQueue::buildIndirectBatch(const size_t first, const size_t end) {
+		const bool depthOnly = isDepthOnly(packets[first].key);
+		Batch batch = { first, end - first, (GLuint)commands.size(), BatchType::INDIRECT, 0 };
+		for (size_t i = first; i < end; i++) {
+			const SceneNode* node = packets[i].node;
+			const MeshArena::Range* range = arena->find(depthOnly ? node->getDepthMesh() : node->getMesh());
+			if (range == nullptr) {
+				// Still streaming in, Mesh::draw would not draw it either
+				continue;
+			}
+			// The base instance is the draw id, the index of the draw parameters
+			const GLuint drawId = (GLuint)commands.size();
+			commands.push_back({ range->indexCount, 1, range->firstIndex, range->baseVertex, drawId });
+			parameters.push_back(getDrawData(node));
+			batch.commandCount++;
+		}
+		return batch;
+	}
+
+	void RenderQueue::buildBatches(ShaderProgram* depthShader) {
+		batches.clear();
+		instances.clear();
+		commands.clear();
+		parameters.clear();
+
+		const bool useIndirect = isIndirect();
+		if (useIndirect && arena == nullptr) {
+			arena = new MeshArena();
+		}
+
+		size_t first = 0;
+		while (first < packets.size()) {
+			SceneNode* node = packets[first].node;
+			ShaderProgram* program = isDepthOnly(packets[first].key) ? depthShader : node->getDrawProgram();
+
+			if (useIndirect && node->getSkin() == nullptr && program != nullptr && program->getVariant(ShaderProgram::INDIRECT) != nullptr) {
+				size_t end = first + 1;
+				while (end < packets.size() && isSameState(packets[first], packets[end])
+					&& packets[end].node->getSkin() == nullptr) {
+					end++;
+				}
+				Batch batch = buildIndirectBatch(first, end);
+				if (batch.commandCount > 0) {
+					batches.push_back(batch);
+				}
+				first = end;
+				continue;
+			}
+
+			size_t end = first + 1;
+			while (end < packets.size() && canBatch(packets[first], packets[end])) {
+				end++;
+			}
+			Batch batch = { first, end - first, (GLuint)instances.size(), BatchType::SINGLE, 0 };
+			if (batch.count >= MIN_INSTANCES && program != nullptr && program->getVariant(ShaderProgram::INSTANCED) != nullptr) {
+				batch.type = BatchType::INSTANCED;
+				for (size_t i = first; i < end; i++) {
+					instances.push_back(getDrawData(packets[i].node));
+				}
+			}
+			batches.push_back(batch);
+			first = end;
+		}
+	}
+
+	void RenderQueue::submit(ShaderProgram* depthShader) {
+		buildBatches(depthShader);
+		if (instanceBuffer == nullptr) {
+			instanceBuffer = new InstanceBuffer();
+		}
+		if (indirectBuffer == nullptr) {
+			indirectBuffer = new IndirectBuffer();
+		}
+		// If the stream buffer is full, the batches are drawn one packet at a time
+		const bool instancesReady = instanceBuffer->upload(instances);
+		const bool commandsReady = indirectBuffer->upload(commands, parameters);
+
+		RenderState* state = RenderState::getInstance();
+		for (const Batch& batch : batches) {
+			SceneNode* node = packets[batch.first].node;
+			const bool depthOnly = isDepthOnly(packets[batch.first].key);
+			if (depthEqual && !depthOnly) {
+				// Batches never mix opaque and translucent packets
+				const bool translucent = (packets[batch.first].key & ((uint64_t)1 << 59)) != 0;
+				state->depthFunc(translucent ? GL_LEQUAL : GL_EQUAL);
+				state->depthMask(translucent ? GL_TRUE : GL_FALSE);
+			}
+			if (batch.type == BatchType::INDIRECT && commandsReady) {
+				ShaderProgram* variant = (depthOnly ? depthShader : node->getDrawProgram())->getVariant(ShaderProgram::INDIRECT);
+				if (depthOnly) {
+					variant->use();
+				}
+				else {
+					node->bindDrawState(variant);
+				}
+				arena->upload(variant, commands.size());
+				arena->bind();
+				indirectBuffer->bind(variant->getBinding("DRAW_BP"));
+				glMultiDrawElementsIndirect(GL_TRIANGLES, GL_UNSIGNED_INT,
+					(const GLvoid*)indirectBuffer->getCommandOffset(batch.baseInstance), batch.commandCount, 0);
+				continue;
+			}
+			if (batch.type == BatchType::INSTANCED && instancesReady) {
+				if (depthOnly) {
+					ShaderProgram* variant = depthShader->getVariant(ShaderProgram::INSTANCED);
+					variant->use();
+					node->getDepthMesh()->drawInstanced(instanceBuffer, variant, (GLsizei)batch.count, instanceBuffer->getFirstInstance() + batch.baseInstance);
+				}
+				else {
+					ShaderProgram* variant = node->getDrawProgram()->getVariant(ShaderProgram::INSTANCED);
+					node->bindDrawState(variant);
+					node->getMesh()->drawInstanced(instanceBuffer, variant, (GLsizei)batch.count, instanceBuffer->getFirstInstance() + batch.baseInstance);
+				}
+				continue;
+			}
+			for (size_t i = batch.first; i < batch.first + batch.count; i++) {
+				if (depthOnly) {
+					packets[i].node->drawShadow(depthShader);
+				}
+				else {
+					packets[i].node->draw();
+				}
+			}
+		}
+		if (depthEqual) {
+			// Back to the state the rest of the frame expects
+			state->depthFunc(GL_LEQUAL);
+			state->depthMask(GL_TRUE);
+		}
+	}
+
+	const size_t RenderQueue::getDrawCalls() const {
+		size_t drawCalls = 0;
+		for (const Batch& batch : batches) {
+			drawCalls += batch.type == BatchType::SINGLE ? batch.count : 1;
+		}
+		return drawCalls;
+	}
+
+	const size_t RenderQueue::size() const {
+		return packets.size();
+	}
+
+}
@@ -0,0 +1,249 @@
+#include "render/RenderState.h"
+
+namespace engine {
+
+	/**
+	* For all implementations in this file, @see RenderState.h for details
+	*/
+
+	RenderState* RenderState::instance;
+
+	RenderState* RenderState::getInstance() {
+		if (instance == nullptr) {
+			instance = new RenderState();
+		}
+		return instance;
+	}
+
+	RenderState::RenderState() {
+		issued = avoided = 0;
+		lastIssued = lastAvoided = 0;
+		invalidate();
+	}
+
+	bool RenderState::change(GLuint& current, const GLuint value) {
+		if (current == value) {
+			avoided++;
+			return false;
+		}
+		current = value;
+		issued++;
+		return true;
+	}
+
+	void RenderState::invalidate() {
+		program = UNKNOWN;
+		vertexArray = UNKNOWN;
+		activeUnit = UNKNOWN;
+		textures.clear();
+		buffers.clear();
+		indexedBuffers.clear();
+		indexedRanges.clear();
+		capabilities.clear();
+		blendSource = blendDestination = UNKNOWN;
+		cullMode = UNKNOWN;
+		frontFaceMode = UNKNOWN;
+		depthFunction = UNKNOWN;
+		depthWrite = UNKNOWN;
+		colorWrite = UNKNOWN;
+	}
+
+	void RenderState::endFrame() {
+		lastIssued = issued;
+		lastAvoided = avoided;
+		issued = avoided = 0;
+	}
+
+	void RenderState::useProgram(const GLuint id) {
+		if (change(program, id)) {
+			glUseProgram(id);
+		}
+	}
+
+	void RenderState::bindVertexArray(const GLuint id) {
+		if (change(vertexArray, id)) {
+			glBindVertexArray(id);
+			// The element array binding is part of the vertex array state
+			buffers.erase(GL_ELEMENT_ARRAY_BUFFER);
+		}
+	}
+
+	void RenderState::activeTexture(const GLuint unit) {
+		if (change(activeUnit, unit)) {
+			glActiveTexture(GL_TEXTURE0 + unit);
+		}
+	}
+
+	void RenderState::bindTexture(const GLenum target, const GLuint id) {
+		if (activeUnit == UNKNOWN) {
+			activeTexture(0);
+		}
+		std::map<std::pair<GLuint, GLenum>, GLuint>::iterator it = textures.find(std::make_pair(activeUnit, target));
+		if (it == textures.end()) {
+			it = textures.insert(std::make_pair(std::make_pair(activeUnit, target), UNKNOWN)).first;
+		}
+		if (change(it->second, id)) {
+			glBindTexture(target, id);
+		}
+	}
+
+	void RenderState::bindTexture(const GLuint unit, const GLenum target, const GLuint id) {
+		std::map<std::pair<GLuint, GLenum>, GLuint>::iterator it = textures.find(std::make_pair(unit, target));
+		if (it != textures.end() && it->second == id) {
+			avoided++;
+			return;
+		}
+		activeTexture(unit);
+		bindTexture(target, id);
+	}
+
+	void RenderState::bindBuffer(const GLenum target, const GLuint id) {
+		std::map<GLenum, GLuint>::iterator it = buffers.find(target);
+		if (it == buffers.end()) {
+			it = buffers.insert(std::make_pair(target, UNKNOWN)).first;
+		}
+		if (change(it->second, id)) {
+			glBindBuffer(target, id);
+		}
+	}
+
+	void RenderState::bindBufferBase(const GLenum target, const GLuint index, const GLuint id) {
+		std::map<std::pair<GLenum, GLuint>, GLuint>::iterator it = indexedBuffers.find(std::make_pair(target, index));
+		if (it == indexedBuffers.end()) {
+			it = indexedBuffers.insert(std::make_pair(std::make_pair(target, index), UNKNOWN)).first;
+		}
+		// A range of the same buffer is not the same binding
+		std::pair<GLintptr, GLsizeiptr>& range = indexedRanges[std::make_pair(target, index)];
+		if (range.second != 0) {
+			it->second = UNKNOWN;
+			range = std::make_pair((GLintptr)0, (GLsizeiptr)0);
+		}
+		if (change(it->second, id)) {
+			glBindBufferBase(target, index, id);
+			// Binding an indexed point also binds the generic target
+			buffers[target] = id;
+		}
+	}
+
+	void RenderState::bindBufferRange(const GLenum target, const GLuint index, const GLuint id, const GLintptr offset, const GLsizeiptr size) {
+		std::map<std::pair<GLenum, GLuint>, GLuint>::iterator it = indexedBuffers.find(std::make_pair(target, index));
+		if (it == indexedBuffers.end()) {
+			it = indexedBuffers.insert(std::make_pair(std::make_pair(target, index), UNKNOWN)).first;
+		}
+		std::pair<GLintptr, GLsizeiptr>& range = indexedRanges[std::make_pair(target, index)];
+		if (range != std::make_pair(offset, size)) {
+			it->second = UNKNOWN;
+			range = std::make_pair(offset, size);
+		}
+		if (change(it->second, id)) {
+			glBindBufferRange(target, index, id, offset, size);
+			buffers[target] = id;
+		}
+	}
+
+	void RenderState::enable(const GLenum capability) {
+		std::map<GLenum, bool>::iterator it = capabilities.find(capability);
+		if (it != capabilities.end() && it->second) {
+			avoided++;
+			return;
+		}
+		capabilities[capability] = true;
+		issued++;
+		glEnable(capability);
+	}
+
+	void RenderState::disable(const GLenum capability) {
+		std::map<GLenum, bool>::iterator it = capabilities.find(capability);
+		if (it != capabilities.end() && !it->second) {
+			avoided++;
+			return;
+		}
+		capabilities[capability] = false;
+		issued++;
+		glDisable(capability);
+	}
+
+	void RenderState::blendFunc(const GLenum source, const GLenum destination) {
+		if (blendSource == source && blendDestination == destination) {
+			avoided++;
+			return;
+		}
+		blendSource = source;
+		blendDestination = destination;
+		issued++;
+		glBlendFunc(source, destination);
+	}
+
+	void RenderState::cullFace(const GLenum mode) {
+		if (change(cullMode, mode)) {
+			glCullFace(mode);
+		}
+	}
+
+	void RenderState::frontFace(const GLenum mode) {
+		if (change(frontFaceMode, mode)) {
+			glFrontFace(mode);
+		}
+	}
+
+	void RenderState::depthFunc(const GLenum function) {
+		if (change(depthFunction, function)) {
+			glDepthFunc(function);
+		}
+	}
+
+	void RenderState::depthMask(const GLboolean flag) {
+		if (change(depthWrite, flag)) {
+			glDepthMask(flag);
+		}
+	}
+
+	void RenderState::colorMask(const GLboolean flag) {
+		if (change(colorWrite, flag)) {
+			glColorMask(flag, flag, flag, flag);
+		}
+	}
+
+	void RenderState::forgetProgram(const GLuint id) {
+		if (program == id) {
+			program = UNKNOWN;
+		}
+	}
+
+	void RenderState::forgetVertexArray(const GLuint id) {
+		if (vertexArray == id) {
+			vertexArray = UNKNOWN;
+			buffers.erase(GL_ELEMENT_ARRAY_BUFFER);
+		}
+	}
+
+	void RenderState::forgetTexture(const GLuint id) {
+		for (std::pair<const std::pair<GLuint, GLenum>, GLuint>& binding : textures) {
+			if (binding.second == id) {
+				binding.second = UNKNOWN;
+			}
+		}
+	}
+
+	void RenderState::forgetBuffer(const GLuint id) {
+		for (std::pair<const GLenum, GLuint>& binding : buffers) {
+			if (binding.second == id) {
+				binding.second = UNKNOWN;
+			}
+		}
+		for (std::pair<const std::pair<GLenum, GLuint>, GLuint>& binding : indexedBuffers) {
+			if (binding.second == id) {
+				binding.second = UNKNOWN;
+			}
+		}
+	}
+
+	const unsigned int RenderState::getIssued() const {
+		return lastIssued;
+	}
+
+	const unsigned int RenderState::getAvoided() const {
+		return lastAvoided;
+	}
+
+}
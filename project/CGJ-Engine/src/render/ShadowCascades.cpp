@@ -0,0 +1,233 @@
+#include "render/ShadowCascades.h"
+#include "render/RenderState.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include "Utils.h"
+
+namespace engine {
+
+	/**
+	* For all implementations in this file, @see ShadowCascades.h for details
+	*/
+
+	ShadowCascades::ShadowCascades(const int count, const GLsizei resolution) {
+		setCascadeCount(count);
+		setResolution(resolution);
+		for (int i = 0; i < MAX_CASCADES; i++) {
+			splits[i] = 0.0f;
+			matrices[i] = Matrix4(1);
+			cached[i] = false;
+		}
+	}
+
+	ShadowCascades::~ShadowCascades() {
+		RenderState* state = RenderState::getInstance();
+		if (texture != 0) {
+			glDeleteTextures(1, &texture);
+			state->forgetTexture(texture);
+		}
+		if (cacheTexture != 0) {
+			glDeleteTextures(1, &cacheTexture);
+			state->forgetTexture(cacheTexture);
+		}
+		if (framebuffer != 0) {
+			glDeleteFramebuffers(1, &framebuffer);
+		}
+	}
+
+	void ShadowCascades::setCascadeCount(const int cascades) {
+		count = std::max(1, std::min(cascades, MAX_CASCADES));
+		dirty = true;
+	}
+
+	const int ShadowCascades::getCascadeCount() const {
+		return count;
+	}
+
+	void ShadowCascades::setResolution(const int cascade, const GLsizei resolution) {
+		if (cascade < 0 || cascade >= MAX_CASCADES) {
+			return;
+		}
+		resolutions[cascade] = std::max(resolution, 1);
+		dirty = true;
+	}
+
+	void ShadowCascades::setResolution(const GLsizei resolution) {
+		for (int i = 0; i < MAX_CASCADES; i++) {
+			setResolution(i, resolution);
+		}
+	}
+
+	const GLsizei ShadowCascades::getResolution(const int cascade) const {
+		return resolutions[cascade];
+	}
+
+	void ShadowCascades::setMaxDistance(const float distance) {
+		maxDistance = distance;
+	}
+
+	void ShadowCascades::setSplitWeight(const float weight) {
+		splitWeight = std::max(0.0f, std::min(weight, 1.0f));
+	}
+
+	void ShadowCascades::allocate() {
+		size = 0;
+		for (int i = 0; i < count; i++) {
+			size = std::max(size, resolutions[i]);
+		}
+		if (texture == 0) {
+			glGenTextures(1, &texture);
+			glGenFramebuffers(1, &framebuffer);
+		}
+		RenderState::getInstance()->bindTexture(GL_TEXTURE_2D_ARRAY, texture);
+		glTexImage3D(GL_TEXTURE_2D_ARRAY, 0, GL_DEPTH_COMPONENT24, size, size, count, 0, GL_DEPTH_COMPONENT, GL_FLOAT, NULL);
+		glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+		glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+		glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_BORDER);
+		glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_BORDER);
+		float borderColor[] = { 1.0, 1.0, 1.0, 1.0 };
+		glTexParameterfv(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_BORDER_COLOR, borderColor);
+
+		// Only copied from and to, never sampled
+		if (isCacheSupported()) {
+			if (cacheTexture == 0) {
+				glGenTextures(1, &cacheTexture);
+			}
+			RenderState::getInstance()->bindTexture(GL_TEXTURE_2D_ARRAY, cacheTexture);
+			glTexImage3D(GL_TEXTURE_2D_ARRAY, 0, GL_DEPTH_COMPONENT24, size, size, count, 0, GL_DEPTH_COMPONENT, GL_FLOAT, NULL);
+			glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+			glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+		}
+		invalidateCache();
+		dirty = false;
+	}
+
+	void ShadowCascades::update(Camera* camera, const Vector3& lightPos) {
+		const float near = camera->getNear();
+		const float far = std::max(near, std::min(camera->getFar(), maxDistance));
+		const Vector3 eye = camera->getEye();
+		const Vector3 direction = camera->getDirection();
+		const Vector2 extent = camera->getOrthographicExtent();
+		const float tangent = std::tan(Math::angleToRad(camera->getFov() / 2.0f));
+
+		Matrix4 lightView = camera->createViewMatrix(lightPos, Vector3(0), Vector3(0.0f, 1.0f, 0.0f));
+
+		float start = near;
+		for (int i = 0; i < count; i++) {
+			const float ratio = (float)(i + 1) / count;
+			const float logarithmic = near * std::pow(far / near, ratio);
+			const float uniform = near + (far - near) * ratio;
+			splits[i] = splitWeight * logarithmic + (1.0f - splitWeight) * uniform;
+			const float end = splits[i];
+
+			// Squared distances of the slice corners to the view axis
+			float startCorner, endCorner;
+			if (camera->isOrthographic()) {
+				startCorner = endCorner = extent.x * extent.x + extent.y * extent.y;
+			}
+			else {
+				const float halfRatio = 1.0f + camera->getAspect() * camera->getAspect();
+				startCorner = start * start * tangent * tangent * halfRatio;
+				endCorner = end * end * tangent * tangent * halfRatio;
+			}
+			// Sphere centered on the view axis, as far from the near corners as from the far ones
+			float center = ((end * end + endCorner) - (start * start + startCorner)) / (2.0f * (end - start));
+			center = std::max(start, std::min(center, end));
+			float radius = std::sqrt(std::max((center - start) * (center - start) + startCorner, (end - center) * (end - center) + endCorner));
+			// Same radius every frame, even with rounding errors
+			radius = std::ceil(radius * 16.0f) / 16.0f;
+
+			// Snapped to whole texels across and along the light, so the cascade matrix, and with it the depth
+			// of static casters, only changes once the camera moved by a texel
+			const Vector4 lightCenter = lightView * Vector4(eye + direction * center);
+			const float texel = 2.0f * radius / resolutions[i];
+			const float x = std::floor(lightCenter.x / texel) * texel;
+			const float y = std::floor(lightCenter.y / texel) * texel;
+			const float depth = std::floor(-lightCenter.z / texel) * texel;
+
+			// Top and bottom in the order of the previous single shadow map, so the shadow pass keeps its winding
+			// The far plane is a texel further, the snapped depth is up to a texel short of the center
+			Matrix4 projection = camera->createOrthographicProjectionMatrix(x - radius, x + radius, y - radius, y + radius,
+				depth - radius - casterDistance, depth + radius + texel);
+			matrices[i] = projection * lightView;
+			start = end;
+		}
+	}
+
+	const Matrix4& ShadowCascades::getMatrix(const int cascade) const {
+		return matrices[cascade];
+	}
+
+	const float ShadowCascades::getSplit(const int cascade) const {
+		return splits[cascade];
+	}
+
+	const float ShadowCascades::getScale(const int cascade) const {
+		// The size the layers have, or will have once allocated
+		GLsizei largest = 0;
+		for (int i = 0; i < count; i++) {
+			largest = std::max(largest, resolutions[i]);
+		}
+		return (float)resolutions[cascade] / largest;
+	}
+
+	void ShadowCascades::bindLayer(const int cascade) {
+		if (dirty) {
+			allocate();
+		}
+		glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+		glFramebufferTextureLayer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, texture, 0, cascade);
+		glDrawBuffer(GL_NONE);
+		glReadBuffer(GL_NONE);
+		glViewport(0, 0, resolutions[cascade], resolutions[cascade]);
+	}
+
+	const GLuint ShadowCascades::getTexture() const {
+		return texture;
+	}
+
+	bool ShadowCascades::isCacheSupported() {
+		return GLEW_VERSION_4_3 || GLEW_ARB_copy_image;
+	}
+
+	void ShadowCascades::setCaching(const bool enabled) {
+		caching = enabled;
+		invalidateCache();
+	}
+
+	const bool ShadowCascades::isCaching() const {
+		return caching && isCacheSupported();
+	}
+
+	void ShadowCascades::invalidateCache() {
+		for (int i = 0; i < MAX_CASCADES; i++) {
+			cached[i] = false;
+		}
+	}
+
+	bool ShadowCascades::restoreCache(const int cascade) {
+		if (!isCaching() || cacheTexture == 0 || !cached[cascade]) {
+			return false;
+		}
+		// Any move of the cascade, even by one snapped texel, moves every static shadow in it
+		if (std::memcmp(cachedMatrices[cascade].elements, matrices[cascade].elements, sizeof(matrices[cascade].elements)) != 0) {
+			return false;
+		}
+		glCopyImageSubData(cacheTexture, GL_TEXTURE_2D_ARRAY, 0, 0, 0, cascade,
+			texture, GL_TEXTURE_2D_ARRAY, 0, 0, 0, cascade, resolutions[cascade], resolutions[cascade], 1);
+		return true;
+	}
+
+	bool ShadowCascades::storeCache(const int cascade) {
+		if (!isCaching() || cacheTexture == 0) {
+			return false;
+		}
+		glCopyImageSubData(texture, GL_TEXTURE_2D_ARRAY, 0, 0, 0, cascade,
+			cacheTexture, GL_TEXTURE_2D_ARRAY, 0, 0, 0, cascade, resolutions[cascade], resolutions[cascade], 1);
+		cachedMatrices[cascade] = matrices[cascade];
+		cached[cascade] = true;
+		return true;
+	}
+
+}
@@ -0,0 +1,147 @@
+#include "render/StreamBuffer.h"
+#include "render/RenderState.h"
+#include <cstring>
+#include <iostream>
+
+namespace engine {
+
+	/**
+	* For all implementations in this file, @see StreamBuffer.h for details
+	*/
+
+	StreamBuffer* StreamBuffer::instance;
+
+	StreamBuffer* StreamBuffer::getInstance() {
+		if (instance == nullptr) {
+			instance = new StreamBuffer();
+		}
+		return instance;
+	}
+
+	StreamBuffer::StreamBuffer() {
+		for (int i = 0; i < FRAMES; i++) {
+			fences[i] = 0;
+		}
+		glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &uniformAlignment);
+		if (GLEW_ARB_shader_storage_buffer_object) {
+			glGetIntegerv(GL_SHADER_STORAGE_BUFFER_OFFSET_ALIGNMENT, &storageAlignment);
+		}
+
+		// The copy target is not used for drawing, binding it disturbs nothing
+		RenderState* state = RenderState::getInstance();
+		glGenBuffers(1, &BufferId);
+		state->bindBuffer(GL_COPY_WRITE_BUFFER, BufferId);
+
+		persistent = GLEW_ARB_buffer_storage != 0;
+		if (persistent) {
+			const GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+			glBufferStorage(GL_COPY_WRITE_BUFFER, FRAMES * FRAME_SIZE, nullptr, flags);
+			mapped = (unsigned char*)glMapBufferRange(GL_COPY_WRITE_BUFFER, 0, FRAMES * FRAME_SIZE, flags);
+			if (mapped == nullptr) {
+				std::cerr << "[StreamBuffer] Persistent mapping failed" << std::endl;
+			}
+		}
+		else {
+			glBufferData(GL_COPY_WRITE_BUFFER, FRAMES * FRAME_SIZE, nullptr, GL_STREAM_DRAW);
+			staging.resize(FRAME_SIZE);
+		}
+	}
+
+	StreamBuffer::~StreamBuffer() {
+		RenderState* state = RenderState::getInstance();
+		for (int i = 0; i < FRAMES; i++) {
+			if (fences[i] != 0) {
+				glDeleteSync(fences[i]);
+			}
+		}
+		if (mapped != nullptr) {
+			state->bindBuffer(GL_COPY_WRITE_BUFFER, BufferId);
+			glUnmapBuffer(GL_COPY_WRITE_BUFFER);
+		}
+		glDeleteBuffers(1, &BufferId);
+		state->forgetBuffer(BufferId);
+	}
+
+	void StreamBuffer::beginFrame() {
+		head = 0;
+		flushed = 0;
+
+		GLsync fence = fences[frame];
+		if (fence != 0) {
+			// Flush the commands on the first try, the fence could never signal otherwise
+			GLenum result = glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 0);
+			if (result == GL_TIMEOUT_EXPIRED) {
+				waits++;
+				while (result == GL_TIMEOUT_EXPIRED) {
+					result = glClientWaitSync(fence, 0, 1000000);
+				}
+			}
+			glDeleteSync(fence);
+			fences[frame] = 0;
+		}
+
+		if (!persistent && frame == 0) {
+			// Fresh storage for the next cycle, the old one lives while the GPU reads it
+			RenderState::getInstance()->bindBuffer(GL_COPY_WRITE_BUFFER, BufferId);
+			glBufferData(GL_COPY_WRITE_BUFFER, FRAMES * FRAME_SIZE, nullptr, GL_STREAM_DRAW);
+		}
+	}
+
+	void StreamBuffer::endFrame() {
+		flush();
+		fences[frame] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+		frame = (frame + 1) % FRAMES;
+	}
+
+	StreamBuffer::Allocation StreamBuffer::allocate(const GLsizeiptr size, const GLsizeiptr alignment) {
+		// Align the offset in the whole buffer, the region start is not aligned to every size
+		const GLintptr regionStart = (GLintptr)frame * FRAME_SIZE;
+		const GLintptr offset = (regionStart + head + alignment - 1) / alignment * alignment;
+		if (offset + size > regionStart + FRAME_SIZE) {
+			if (!overflowReported) {
+				std::cerr << "[StreamBuffer] Frame region of " << FRAME_SIZE << " bytes is full" << std::endl;
+				overflowReported = true;
+			}
+			return { nullptr, 0, 0 };
+		}
+		head = offset + size - regionStart;
+
+		if (persistent) {
+			if (mapped == nullptr) {
+				return { nullptr, 0, 0 };
+			}
+			return { mapped + offset, offset, size };
+		}
+		return { staging.data() + (offset - regionStart), offset, size };
+	}
+
+	StreamBuffer::Allocation StreamBuffer::allocateUniform(const GLsizeiptr size) {
+		return allocate(size, uniformAlignment);
+	}
+
+	StreamBuffer::Allocation StreamBuffer::allocateStorage(const GLsizeiptr size) {
+		return allocate(size, storageAlignment);
+	}
+
+	void StreamBuffer::flush() {
+		if (persistent || head == flushed) {
+			return;
+		}
+		RenderState::getInstance()->bindBuffer(GL_COPY_WRITE_BUFFER, BufferId);
+		glBufferSubData(GL_COPY_WRITE_BUFFER, (GLintptr)frame * FRAME_SIZE + flushed, head - flushed, staging.data() + flushed);
+		flushed = head;
+	}
+
+	const GLuint StreamBuffer::getId() const {
+		return BufferId;
+	}
+
+	const bool StreamBuffer::isPersistent() const {
+		return persistent;
+	}
+
+	const unsigned int StreamBuffer::getWaits() const {
+		return waits;
+	}
+
+}
@@ -0,0 +1,346 @@
+#include "scene/AnimationClip.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+
+namespace engine {
+
+	/**
+	* For all implementations in this file, @see AnimationClip.h for details
+	*/
+
+	const uint32_t AnimationClip::VERSION;
+
+	static const char MAGIC[4] = { 'E', 'X', 'A', 'C' };
+
+	// The three smallest components of a unit quaternion are within +-1/sqrt(2)
+	static const float SMALLEST_RANGE = 0.70710678f;
+
+	static const float QUANTIZED = 65535.0f, QUANTIZED_ROTATION = 32767.0f;
+
+	static const int componentsOf(const ClipChannel channel) {
+		return channel == ClipChannel::ROTATION ? 4 : 3;
+	}
+
+	/**
+	* Interpolates two rotations linearly and normalizes the result, on the shortest arc
+	*/
+	static void nlerp(const float* a, const float* b, const float alpha, float* out) {
+		const float sign = a[0] * b[0] + a[1] * b[1] + a[2] * b[2] + a[3] * b[3] < 0.0f ? -1.0f : 1.0f;
+		float length = 0.0f;
+		for (int i = 0; i < 4; i++) {
+			out[i] = a[i] + (sign * b[i] - a[i]) * alpha;
+			length += out[i] * out[i];
+		}
+		const float inverse = length > 0.0f ? 1.0f / std::sqrt(length) : 0.0f;
+		for (int i = 0; i < 4; i++) {
+			out[i] *= inverse;
+		}
+	}
+
+	/**
+	* Gets the error of an interpolated value against the sampled one
+	*/
+	static float errorOf(const float* interpolated, const float* sample, const int components) {
+		if (components == 4) {
+			const float cosine = std::fabs(interpolated[0] * sample[0] + interpolated[1] * sample[1]
+				+ interpolated[2] * sample[2] + interpolated[3] * sample[3]);
+			return 2.0f * std::acos(std::min(cosine, 1.0f));
+		}
+		float error = 0.0f;
+		for (int i = 0; i < components; i++) {
+			error = std::max(error, std::fabs(interpolated[i] - sample[i]));
+		}
+		return error;
+	}
+
+	void AnimationClip::encodeRotation(const float* q, uint16_t* out) {
+		int largest = 0;
+		for (int i = 1; i < 4; i++) {
+			if (std::fabs(q[i]) > std::fabs(q[largest])) {
+				largest = i;
+			}
+		}
+		// q and -q are the same rotation, the largest component is stored positive
+		const float sign = q[largest] < 0.0f ? -1.0f : 1.0f;
+		int packed = 0;
+		for (int i = 0; i < 4; i++) {
+			if (i == largest) {
+				continue;
+			}
+			const float normalized = std::max(-1.0f, std::min(sign * q[i] / SMALLEST_RANGE, 1.0f));
+			out[packed++] = (uint16_t)std::lround((normalized * 0.5f + 0.5f) * QUANTIZED_ROTATION);
+		}
+		out[0] |= (uint16_t)((largest & 1) << 15);
+		out[1] |= (uint16_t)((largest >> 1) << 15);
+	}
+
+	void AnimationClip::decodeRotation(const uint16_t* in, float* q) {
+		const int largest = (in[0] >> 15) | ((in[1] >> 15) << 1);
+		float sum = 0.0f;
+		int packed = 0;
+		for (int i = 0; i < 4; i++) {
+			if (i == largest) {
+				continue;
+			}
+			q[i] = ((in[packed++] & 0x7FFF) / QUANTIZED_ROTATION * 2.0f - 1.0f) * SMALLEST_RANGE;
+			sum += q[i] * q[i];
+		}
+		q[largest] = std::sqrt(std::max(0.0f, 1.0f - sum));
+	}
+
+	void AnimationClip::decode(const Curve& curve, const size_t key, float* out) const {
+		const uint16_t* values = &curve.values[key * 3];
+		if (curve.channel == ClipChannel::ROTATION) {
+			decodeRotation(values, out);
+			return;
+		}
+		for (int i = 0; i < 3; i++) {
+			out[i] = curve.minimum[i] + values[i] * (curve.extent[i] / QUANTIZED);
+		}
+	}
+
+	std::vector<uint16_t> AnimationClip::reduceKeys(const float* values, const int components, const size_t frameCount, const float tolerance) {
+		std::vector<uint16_t> keys(1, 0);
+		// Grows the segment from the last kept key until interpolating it misses a sample
+		size_t start = 0;
+		float interpolated[4];
+		for (size_t end = start + 2; end < frameCount; end++) {
+			const float* a = values + start * components;
+			const float* b = values + end * components;
+			bool fits = true;
+			for (size_t frame = start + 1; frame < end && fits; frame++) {
+				const float alpha = (float)(frame - start) / (end - start);
+				if (components == 4) {
+					nlerp(a, b, alpha, interpolated);
+				}
+				else {
+					for (int i = 0; i < components; i++) {
+						interpolated[i] = a[i] + (b[i] - a[i]) * alpha;
+					}
+				}
+				fits = errorOf(interpolated, values + frame * components, components) <= tolerance;
+			}
+			if (!fits) {
+				start = end - 1;
+				keys.push_back((uint16_t)start);
+			}
+		}
+		if (frameCount > 1) {
+			keys.push_back((uint16_t)(frameCount - 1));
+		}
+		return keys;
+	}
+
+	AnimationClip* AnimationClip::compress(const std::vector<RawCurve>& raw, const float sampleRate, const float translationTolerance,
+		const float rotationTolerance) {
+		if (raw.empty() || !(sampleRate > 0.0f)) {
+			std::cerr << "[AnimationClip] Nothing to compress" << std::endl;
+			return nullptr;
+		}
+		const size_t frameCount = raw[0].values.size() / componentsOf(raw[0].channel);
+		if (frameCount == 0 || frameCount > 65536) {
+			std::cerr << "[AnimationClip] Clips hold from 1 to 65536 frames, not " << frameCount << std::endl;
+			return nullptr;
+		}
+
+		AnimationClip* clip = new AnimationClip();
+		clip->sampleRate = sampleRate;
+		clip->frames = (uint32_t)frameCount;
+		for (const RawCurve& source : raw) {
+			const int components = componentsOf(source.channel);
+			if (source.values.size() != frameCount * components) {
+				std::cerr << "[AnimationClip] Every curve must have " << frameCount << " frames" << std::endl;
+				delete clip;
+				return nullptr;
+			}
+			std::vector<float> values = source.values;
+			if (source.channel == ClipChannel::ROTATION) {
+				// Unit length, and each sample on the hemisphere of the previous one so neighbours interpolate the short way
+				for (size_t frame = 0; frame < frameCount; frame++) {
+					float* q = &values[frame * 4];
+					const float length = std::sqrt(q[0] * q[0] + q[1] * q[1] + q[2] * q[2] + q[3] * q[3]);
+					const float* previous = frame > 0 ? q - 4 : nullptr;
+					const float sign = previous != nullptr && q[0] * previous[0] + q[1] * previous[1] + q[2] * previous[2] + q[3] * previous[3] < 0.0f ? -1.0f : 1.0f;
+					for (int i = 0; i < 4; i++) {
+						q[i] = length > 0.0f ? sign * q[i] / length : (i == 3 ? 1.0f : 0.0f);
+					}
+				}
+			}
+
+			Curve curve;
+			curve.target = source.target;
+			curve.channel = source.channel;
+			curve.frames = reduceKeys(values.data(), components, frameCount,
+				source.channel == ClipChannel::ROTATION ? rotationTolerance : translationTolerance);
+			std::fill(curve.minimum, curve.minimum + 3, 0.0f);
+			std::fill(curve.extent, curve.extent + 3, 0.0f);
+			if (source.channel != ClipChannel::ROTATION) {
+				for (int i = 0; i < 3; i++) {
+					float low = values[i], high = values[i];
+					for (const uint16_t frame : curve.frames) {
+						low = std::min(low, values[frame * 3 + i]);
+						high = std::max(high, values[frame * 3 + i]);
+					}
+					curve.minimum[i] = low;
+					curve.extent[i] = high - low;
+				}
+			}
+			curve.values.resize(curve.frames.size() * 3);
+			for (size_t key = 0; key < curve.frames.size(); key++) {
+				const float* value = &values[curve.frames[key] * components];
+				uint16_t* packed = &curve.values[key * 3];
+				if (source.channel == ClipChannel::ROTATION) {
+					encodeRotation(value, packed);
+					continue;
+				}
+				for (int i = 0; i < 3; i++) {
+					packed[i] = curve.extent[i] > 0.0f ? (uint16_t)std::lround((value[i] - curve.minimum[i]) / curve.extent[i] * QUANTIZED) : 0;
+				}
+			}
+			clip->curves.push_back(curve);
+			clip->targetCount = std::max(clip->targetCount, (int)curve.target + 1);
+		}
+		return clip;
+	}
+
+	template<typename T>
+	static void writeValue(std::ofstream& file, const T& value) {
+		file.write((const char*)&value, sizeof(T));
+	}
+
+	template<typename T>
+	static bool readValue(std::ifstream& file, T& value) {
+		return (bool)file.read((char*)&value, sizeof(T));
+	}
+
+	bool AnimationClip::saveToFile(const std::string& path) const {
+		std::ofstream file(path, std::ios::binary | std::ios::trunc);
+		if (!file) {
+			std::cerr << "[AnimationClip] Cannot write " << path << std::endl;
+			return false;
+		}
+		file.write(MAGIC, 4);
+		writeValue(file, VERSION);
+		writeValue(file, sampleRate);
+		writeValue(file, frames);
+		writeValue(file, (uint32_t)curves.size());
+		for (const Curve& curve : curves) {
+			writeValue(file, curve.target);
+			writeValue(file, curve.channel);
+			writeValue(file, (uint8_t)0);
+			writeValue(file, (uint32_t)curve.frames.size());
+			file.write((const char*)curve.minimum, sizeof(curve.minimum));
+			file.write((const char*)curve.extent, sizeof(curve.extent));
+			file.write((const char*)curve.frames.data(), curve.frames.size() * sizeof(uint16_t));
+			file.write((const char*)curve.values.data(), curve.values.size() * sizeof(uint16_t));
+		}
+		return file.good();
+	}
+
+	AnimationClip* AnimationClip::loadFromFile(const std::string& path) {
+		std::ifstream file(path, std::ios::binary);
+		char magic[4];
+		uint32_t version = 0, curveCount = 0;
+		AnimationClip* clip = new AnimationClip();
+		if (!file.read(magic, 4) || std::memcmp(magic, MAGIC, 4) != 0 || !readValue(file, version) || version != VERSION
+			|| !readValue(file, clip->sampleRate) || !readValue(file, clip->frames) || !readValue(file, curveCount)
+			|| !(clip->sampleRate > 0.0f) || clip->frames == 0 || clip->frames > 65536) {
+			std::cerr << "[AnimationClip] " << path << " is not a clip" << std::endl;
+			delete clip;
+			return nullptr;
+		}
+		clip->curves.resize(curveCount);
+		for (Curve& curve : clip->curves) {
+			uint8_t padding;
+			uint32_t keys = 0;
+			bool valid = readValue(file, curve.target) && readValue(file, curve.channel) && readValue(file, padding) && readValue(file, keys)
+				&& (uint8_t)curve.channel <= (uint8_t)ClipChannel::SCALE && keys > 0 && keys <= clip->frames;
+			if (valid) {
+				curve.frames.resize(keys);
+				curve.values.resize(keys * 3);
+				valid = file.read((char*)curve.minimum, sizeof(curve.minimum)) && file.read((char*)curve.extent, sizeof(curve.extent))
+					&& file.read((char*)curve.frames.data(), keys * sizeof(uint16_t))
+					&& file.read((char*)curve.values.data(), keys * 3 * sizeof(uint16_t));
+			}
+			// Sampling relies on increasing key frames inside the clip
+			for (uint32_t key = 1; valid && key < keys; key++) {
+				valid = curve.frames[key] > curve.frames[key - 1];
+			}
+			if (!valid || curve.frames.back() >= clip->frames) {
+				std::cerr << "[AnimationClip] " << path << " is truncated or corrupt" << std::endl;
+				delete clip;
+				return nullptr;
+			}
+			clip->targetCount = std::max(clip->targetCount, (int)curve.target + 1);
+		}
+		return clip;
+	}
+
+	void AnimationClip::sample(const float time, ClipCursor& cursor, ClipTransform* out) const {
+		if (cursor.keys.size() != curves.size()) {
+			cursor.keys.assign(curves.size(), 0);
+		}
+		const float frame = std::max(0.0f, std::min(time * sampleRate, (float)(frames - 1)));
+		float a[4], b[4];
+		for (size_t c = 0; c < curves.size(); c++) {
+			const Curve& curve = curves[c];
+			const size_t last = curve.frames.size() - 1;
+			size_t key = cursor.keys[c];
+			if (key > last || curve.frames[key] > frame) {
+				// Played backwards or looped, the key is searched for again
+				key = std::upper_bound(curve.frames.begin(), curve.frames.end(), (uint16_t)frame) - curve.frames.begin() - 1;
+			}
+			while (key < last && curve.frames[key + 1] <= frame) {
+				key++;
+			}
+			cursor.keys[c] = (uint16_t)key;
+
+			ClipTransform& transform = out[curve.target];
+			float* target = curve.channel == ClipChannel::TRANSLATION ? transform.translation
+				: curve.channel == ClipChannel::ROTATION ? transform.rotation : transform.scale;
+			decode(curve, key, a);
+			if (key == last) {
+				std::memcpy(target, a, componentsOf(curve.channel) * sizeof(float));
+				continue;
+			}
+			decode(curve, key + 1, b);
+			const float alpha = (frame - curve.frames[key]) / (curve.frames[key + 1] - curve.frames[key]);
+			if (curve.channel == ClipChannel::ROTATION) {
+				nlerp(a, b, alpha, target);
+			}
+			else {
+				for (int i = 0; i < 3; i++) {
+					target[i] = a[i] + (b[i] - a[i]) * alpha;
+				}
+			}
+		}
+	}
+
+	const float AnimationClip::getDuration() const {
+		return frames > 0 ? (frames - 1) / sampleRate : 0.0f;
+	}
+
+	const int AnimationClip::getTargetCount() const {
+		return targetCount;
+	}
+
+	const size_t AnimationClip::getKeyCount() const {
+		size_t keys = 0;
+		for (const Curve& curve : curves) {
+			keys += curve.frames.size();
+		}
+		return keys;
+	}
+
+	const size_t AnimationClip::getMemoryUsage() const {
+		size_t bytes = sizeof(AnimationClip);
+		for (const Curve& curve : curves) {
+			bytes += sizeof(Curve) + (curve.frames.size() + curve.values.size()) * sizeof(uint16_t);
+		}
+		return bytes;
+	}
+
+}
@@ -0,0 +1,438 @@
+#include "scene/AnimationSystem.h"
+#include "loader/AssetLoader.h"
+#include <algorithm>
+#include <cmath>
+
+namespace engine {
+
+	/**
+	* For all implementations in this file, @see AnimationSystem.h for details
+	*/
+
+	/**
+	* Removes an element by moving the last one into its place
+	*/
+	template<typename T>
+	static void eraseAt(std::vector<T>& values, const size_t index) {
+		values[index] = values.back();
+		values.pop_back();
+	}
+
+	AnimationSystem* AnimationSystem::instance;
+
+	AnimationSystem* AnimationSystem::getInstance() {
+		if (instance == nullptr) {
+			instance = new AnimationSystem();
+		}
+		return instance;
+	}
+
+	AnimationSystem::AnimationSystem() {}
+
+	void AnimationSystem::Timing::push(const float duration, const Easing easing) {
+		// Cubic coefficients of each curve, every one goes from 0 to 1
+		static const float CURVES[][3] = {
+			{ 0.0f, 0.0f, 1.0f },	// LINEAR, t
+			{ 0.0f, 1.0f, 0.0f },	// EASE_IN, t^2
+			{ 0.0f, -1.0f, 2.0f },	// EASE_OUT, 2t - t^2
+			{ -2.0f, 3.0f, 0.0f },	// EASE_IN_OUT, 3t^2 - 2t^3
+			{ 1.0f, 0.0f, 0.0f },	// EASE_IN_CUBIC, t^3
+			{ 1.0f, -3.0f, 3.0f }	// EASE_OUT_CUBIC, 1 - (1 - t)^3
+		};
+		const float* curve = CURVES[(int)easing];
+		elapsed.push_back(0.0f);
+		inverseDuration.push_back(1.0f / std::max(duration, 1e-6f));
+		curveA.push_back(curve[0]);
+		curveB.push_back(curve[1]);
+		curveC.push_back(curve[2]);
+		weights.push_back(0.0f);
+	}
+
+	void AnimationSystem::Timing::remove(const size_t index) {
+		eraseAt(elapsed, index);
+		eraseAt(inverseDuration, index);
+		eraseAt(curveA, index);
+		eraseAt(curveB, index);
+		eraseAt(curveC, index);
+		eraseAt(weights, index);
+	}
+
+	void AnimationSystem::advance(Timing& timing, const size_t first, const size_t last, const float deltaTime) {
+		float* elapsed = timing.elapsed.data();
+		const float* inverseDuration = timing.inverseDuration.data();
+		const float* a = timing.curveA.data();
+		const float* b = timing.curveB.data();
+		const float* c = timing.curveC.data();
+		float* weights = timing.weights.data();
+		for (size_t i = first; i < last; i++) {
+			elapsed[i] += deltaTime;
+			const float t = std::min(elapsed[i] * inverseDuration[i], 1.0f);
+			weights[i] = ((a[i] * t + b[i]) * t + c[i]) * t;
+		}
+	}
+
+	void AnimationSystem::evaluate(VectorTracks& tracks, const size_t first, const size_t last) {
+		const float* weights = tracks.timing.weights.data();
+		for (size_t i = first; i < last; i++) {
+			const float k = weights[i];
+			Vector3* target = tracks.targets[i];
+			target->x = tracks.fromX[i] + (tracks.toX[i] - tracks.fromX[i]) * k;
+			target->y = tracks.fromY[i] + (tracks.toY[i] - tracks.fromY[i]) * k;
+			target->z = tracks.fromZ[i] + (tracks.toZ[i] - tracks.fromZ[i]) * k;
+		}
+	}
+
+	void AnimationSystem::evaluate(RotationTracks& tracks, const size_t first, const size_t last) {
+		// The targets are spread over the nodes, the batch is interpolated in chunks on the stack
+		const size_t CHUNK = 64;
+		Quaternion results[CHUNK];
+		for (size_t chunk = first; chunk < last; chunk += CHUNK) {
+			const size_t count = std::min(CHUNK, last - chunk);
+			Quaternion::fastSlerp(&tracks.from[chunk], &tracks.to[chunk], &tracks.timing.weights[chunk], results, count);
+			for (size_t i = 0; i < count; i++) {
+				*tracks.targets[chunk + i] = results[i];
+			}
+		}
+	}
+
+	/**
+	* Advances the time of a clip instance, wrapping it around or clamping it to the clip
+	*/
+	static void advanceClip(float& time, const float deltaTime, const float speed, const bool loop, const float duration) {
+		time += deltaTime * speed;
+		if (loop && duration > 0.0f) {
+			time = std::fmod(time, duration);
+			if (time < 0.0f) {
+				time += duration;
+			}
+		}
+		else {
+			time = std::max(0.0f, std::min(time, duration));
+		}
+	}
+
+	/**
+	* Checks if a clip instance that does not loop reached the end it plays towards
+	*/
+	static bool isFinished(const float time, const float speed, const bool loop, const float duration) {
+		return !loop && time == (speed < 0.0f ? 0.0f : duration);
+	}
+
+	void AnimationSystem::evaluate(ClipInstances& instances, const size_t first, const size_t last, const float deltaTime) {
+		// Clips animating more than the node still sample every target, into a buffer reused over the batch
+		std::vector<ClipTransform> transforms(1);
+		for (size_t i = first; i < last; i++) {
+			const AnimationClip* clip = instances.clips[i];
+			advanceClip(instances.times[i], deltaTime, instances.speeds[i], instances.loops[i] != 0, clip->getDuration());
+
+			if (transforms.size() < (size_t)clip->getTargetCount()) {
+				transforms.resize(clip->getTargetCount());
+			}
+			// Channels the clip does not animate keep their current value
+			SceneNode* node = instances.nodes[i];
+			Vector3* position = node->getPosition();
+			Vector3* scale = node->getScale();
+			Quaternion* rotation = node->getRotation();
+			const Vector4 q = *rotation;
+			ClipTransform& transform = transforms[0];
+			transform.translation[0] = position->x;
+			transform.translation[1] = position->y;
+			transform.translation[2] = position->z;
+			transform.rotation[0] = q.x;
+			transform.rotation[1] = q.y;
+			transform.rotation[2] = q.z;
+			transform.rotation[3] = q.w;
+			transform.scale[0] = scale->x;
+			transform.scale[1] = scale->y;
+			transform.scale[2] = scale->z;
+
+			clip->sample(instances.times[i], instances.cursors[i], transforms.data());
+
+			position->x = transform.translation[0];
+			position->y = transform.translation[1];
+			position->z = transform.translation[2];
+			*rotation = Quaternion(transform.rotation[3], transform.rotation[0], transform.rotation[1], transform.rotation[2]);
+			scale->x = transform.scale[0];
+			scale->y = transform.scale[1];
+			scale->z = transform.scale[2];
+		}
+	}
+
+	void AnimationSystem::removeFinished(VectorTracks& tracks) {
+		for (size_t i = 0; i < tracks.size();) {
+			if (tracks.timing.elapsed[i] * tracks.timing.inverseDuration[i] < 1.0f) {
+				i++;
+				continue;
+			}
+			tracks.timing.remove(i);
+			eraseAt(tracks.fromX, i);
+			eraseAt(tracks.fromY, i);
+			eraseAt(tracks.fromZ, i);
+			eraseAt(tracks.toX, i);
+			eraseAt(tracks.toY, i);
+			eraseAt(tracks.toZ, i);
+			eraseAt(tracks.targets, i);
+			tracks.nodes[i]->addAnimations(-1);
+			eraseAt(tracks.nodes, i);
+		}
+	}
+
+	void AnimationSystem::removeFinished(RotationTracks& tracks) {
+		for (size_t i = 0; i < tracks.size();) {
+			if (tracks.timing.elapsed[i] * tracks.timing.inverseDuration[i] < 1.0f) {
+				i++;
+				continue;
+			}
+			tracks.timing.remove(i);
+			eraseAt(tracks.from, i);
+			eraseAt(tracks.to, i);
+			eraseAt(tracks.targets, i);
+			tracks.nodes[i]->addAnimations(-1);
+			eraseAt(tracks.nodes, i);
+		}
+	}
+
+	void AnimationSystem::evaluate(SkinInstances& instances, const size_t first, const size_t last, const float deltaTime) {
+		for (size_t i = first; i < last; i++) {
+			const AnimationClip* clip = instances.clips[i];
+			Skin* skin = instances.skins[i];
+			advanceClip(instances.times[i], deltaTime, instances.speeds[i], instances.loops[i] != 0, clip->getDuration());
+			// Targets past the joints of the skeleton are not sampled
+			std::vector<ClipTransform>& pose = skin->getPose();
+			if (clip->getTargetCount() <= (int)pose.size()) {
+				clip->sample(instances.times[i], instances.cursors[i], pose.data());
+			}
+			skin->updatePalette();
+		}
+	}
+
+	void AnimationSystem::skinVertices(const std::vector<Skin*>& targets) {
+		vertexBatches.clear();
+		for (Skin* skin : targets) {
+			if (!skin->isCpuSkinning()) {
+				continue;
+			}
+			for (size_t first = 0; first < skin->getVertexCount(); first += VERTEX_BATCH) {
+				vertexBatches.push_back({ skin, first, std::min(skin->getVertexCount(), first + VERTEX_BATCH) });
+			}
+		}
+		if (!parallel || vertexBatches.size() <= 1) {
+			for (const VertexBatch& batch : vertexBatches) {
+				batch.skin->skinVertices(batch.first, batch.last);
+			}
+			return;
+		}
+		AssetLoader::getInstance()->getWorkers()->parallelFor((int)vertexBatches.size(), [this](const int index) {
+			const VertexBatch& batch = vertexBatches[index];
+			batch.skin->skinVertices(batch.first, batch.last);
+		});
+	}
+
+	void AnimationSystem::removeFinished(ClipInstances& instances) {
+		for (size_t i = 0; i < instances.size();) {
+			if (!isFinished(instances.times[i], instances.speeds[i], instances.loops[i] != 0, instances.clips[i]->getDuration())) {
+				i++;
+				continue;
+			}
+			instances.nodes[i]->addAnimations(-1);
+			eraseAt(instances.clips, i);
+			eraseAt(instances.nodes, i);
+			eraseAt(instances.times, i);
+			eraseAt(instances.speeds, i);
+			eraseAt(instances.loops, i);
+			instances.cursors[i].keys.swap(instances.cursors.back().keys);
+			instances.cursors.pop_back();
+		}
+	}
+
+	void AnimationSystem::removeClip(ClipInstances& instances, const SceneNode* node) {
+		for (size_t i = 0; i < instances.size(); i++) {
+			if (instances.nodes[i] == node) {
+				instances.nodes[i]->addAnimations(-1);
+				eraseAt(instances.clips, i);
+				eraseAt(instances.nodes, i);
+				eraseAt(instances.times, i);
+				eraseAt(instances.speeds, i);
+				eraseAt(instances.loops, i);
+				instances.cursors[i].keys.swap(instances.cursors.back().keys);
+				instances.cursors.pop_back();
+				return;
+			}
+		}
+	}
+
+	void AnimationSystem::removeFinished(SkinInstances& instances) {
+		for (size_t i = 0; i < instances.size();) {
+			if (!isFinished(instances.times[i], instances.speeds[i], instances.loops[i] != 0, instances.clips[i]->getDuration())) {
+				i++;
+				continue;
+			}
+			eraseAt(instances.clips, i);
+			eraseAt(instances.skins, i);
+			eraseAt(instances.times, i);
+			eraseAt(instances.speeds, i);
+			eraseAt(instances.loops, i);
+			instances.cursors[i].keys.swap(instances.cursors.back().keys);
+			instances.cursors.pop_back();
+		}
+	}
+
+	void AnimationSystem::removeClip(SkinInstances& instances, const Skin* skin) {
+		for (size_t i = 0; i < instances.size(); i++) {
+			if (instances.skins[i] == skin) {
+				eraseAt(instances.clips, i);
+				eraseAt(instances.skins, i);
+				eraseAt(instances.times, i);
+				eraseAt(instances.speeds, i);
+				eraseAt(instances.loops, i);
+				instances.cursors[i].keys.swap(instances.cursors.back().keys);
+				instances.cursors.pop_back();
+				return;
+			}
+		}
+	}
+
+	void AnimationSystem::removeTarget(VectorTracks& tracks, const Vector3* target) {
+		for (size_t i = 0; i < tracks.size(); i++) {
+			if (tracks.targets[i] == target) {
+				// Marked as finished, without evaluating it again
+				tracks.timing.elapsed[i] = 1.0f;
+				tracks.timing.inverseDuration[i] = 1.0f;
+			}
+		}
+		removeFinished(tracks);
+	}
+
+	void AnimationSystem::removeTarget(RotationTracks& tracks, const Quaternion* target) {
+		for (size_t i = 0; i < tracks.size(); i++) {
+			if (tracks.targets[i] == target) {
+				tracks.timing.elapsed[i] = 1.0f;
+				tracks.timing.inverseDuration[i] = 1.0f;
+			}
+		}
+		removeFinished(tracks);
+	}
+
+	void AnimationSystem::addTrack(VectorTracks& tracks, SceneNode* node, Vector3* target, const Vector3& value, const float duration, const Easing easing) {
+		removeTarget(tracks, target);
+		tracks.timing.push(duration, easing);
+		tracks.fromX.push_back(target->x);
+		tracks.fromY.push_back(target->y);
+		tracks.fromZ.push_back(target->z);
+		tracks.toX.push_back(value.x);
+		tracks.toY.push_back(value.y);
+		tracks.toZ.push_back(value.z);
+		tracks.targets.push_back(target);
+		tracks.nodes.push_back(node);
+		node->addAnimations(1);
+	}
+
+	template<typename F>
+	void AnimationSystem::forEachBatch(const size_t count, F batch, const size_t size) {
+		if (!parallel || count <= size) {
+			batch(0, count);
+			return;
+		}
+		const int batches = (int)((count + size - 1) / size);
+		AssetLoader::getInstance()->getWorkers()->parallelFor(batches, [&](const int index) {
+			const size_t first = (size_t)index * size;
+			batch(first, std::min(count, first + size));
+		});
+	}
+
+	void AnimationSystem::moveTo(SceneNode* node, const Vector3& position, const float duration, const Easing easing) {
+		addTrack(translations, node, node->getPosition(), position, duration, easing);
+	}
+
+	void AnimationSystem::scaleTo(SceneNode* node, const Vector3& scale, const float duration, const Easing easing) {
+		addTrack(scales, node, node->getScale(), scale, duration, easing);
+	}
+
+	void AnimationSystem::rotateTo(SceneNode* node, const Quaternion& rotation, const float duration, const Easing easing) {
+		Quaternion* target = node->getRotation();
+		removeTarget(rotations, target);
+
+		// The interpolation takes the shortest arc itself
+		rotations.timing.push(duration, easing);
+		rotations.from.push_back(*target);
+		rotations.to.push_back(rotation);
+		rotations.targets.push_back(target);
+		rotations.nodes.push_back(node);
+		node->addAnimations(1);
+	}
+
+	void AnimationSystem::play(SceneNode* node, const AnimationClip* clip, const bool loop, const float speed) {
+		removeClip(clips, node);
+		if (clip == nullptr) {
+			return;
+		}
+		clips.clips.push_back(clip);
+		clips.nodes.push_back(node);
+		clips.times.push_back(speed < 0.0f ? clip->getDuration() : 0.0f);
+		clips.speeds.push_back(speed);
+		clips.loops.push_back(loop ? 1 : 0);
+		clips.cursors.push_back(ClipCursor());
+		node->addAnimations(1);
+	}
+
+	void AnimationSystem::play(Skin* skin, const AnimationClip* clip, const bool loop, const float speed) {
+		removeClip(skins, skin);
+		if (clip == nullptr) {
+			return;
+		}
+		skins.clips.push_back(clip);
+		skins.skins.push_back(skin);
+		skins.times.push_back(speed < 0.0f ? clip->getDuration() : 0.0f);
+		skins.speeds.push_back(speed);
+		skins.loops.push_back(loop ? 1 : 0);
+		skins.cursors.push_back(ClipCursor());
+	}
+
+	void AnimationSystem::stop(Skin* skin) {
+		removeClip(skins, skin);
+	}
+
+	void AnimationSystem::stop(SceneNode* node) {
+		removeTarget(translations, node->getPosition());
+		removeTarget(scales, node->getScale());
+		removeTarget(rotations, node->getRotation());
+		removeClip(clips, node);
+	}
+
+	void AnimationSystem::update(const float deltaTime) {
+		forEachBatch(translations.size(), [this, deltaTime](const size_t first, const size_t last) {
+			advance(translations.timing, first, last, deltaTime);
+			evaluate(translations, first, last);
+		});
+		forEachBatch(scales.size(), [this, deltaTime](const size_t first, const size_t last) {
+			advance(scales.timing, first, last, deltaTime);
+			evaluate(scales, first, last);
+		});
+		forEachBatch(rotations.size(), [this, deltaTime](const size_t first, const size_t last) {
+			advance(rotations.timing, first, last, deltaTime);
+			evaluate(rotations, first, last);
+		});
+		forEachBatch(clips.size(), [this, deltaTime](const size_t first, const size_t last) {
+			evaluate(clips, first, last, deltaTime);
+		});
+		forEachBatch(skins.size(), [this, deltaTime](const size_t first, const size_t last) {
+			evaluate(skins, first, last, deltaTime);
+		}, SKIN_BATCH);
+		skinVertices(skins.skins);
+		// The last evaluation of a finished track wrote its end value
+		removeFinished(translations);
+		removeFinished(scales);
+		removeFinished(rotations);
+		removeFinished(clips);
+		removeFinished(skins);
+	}
+
+	void AnimationSystem::setParallel(const bool parallel) {
+		this->parallel = parallel;
+	}
+
+	const size_t AnimationSystem::getTrackCount() const {
+		return translations.size() + scales.size() + rotations.size() + clips.size() + skins.size();
+	}
+
+}
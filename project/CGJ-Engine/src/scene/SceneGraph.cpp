@@ -1,4 +1,5 @@
 #include "scene/SceneGraph.h"
+#include "render/RenderState.h"
 
 namespace engine {
 
@@ -32,15 +33,75 @@ namespace engine {
 
 	}
 
+	const RenderQueue& SceneGraph::getRenderQueue() const {
+		return queue;
+	}
+
+	RenderQueue& SceneGraph::getRenderQueue() {
+		return queue;
+	}
+
+	void SceneGraph::setDepthPrepass(const bool enabled) {
+		depthPrepass = enabled;
+	}
+
+	const bool SceneGraph::isDepthPrepass() const {
+		return depthPrepass;
+	}
+
+	const GLuint SceneGraph::getShadedSamples() const {
+		return shadedSamples;
+	}
+
+	bool SceneGraph::drawDepthPrepass() {
+		ShaderProgram* depthShader = root->getShadowShaderProgram()->getVariant(ShaderProgram::DEPTH_ONLY);
+		if (depthShader == nullptr) {
+			return false;
+		}
+		RenderState* state = RenderState::getInstance();
+		queue.clear();
+		root->collect(queue, RenderPass::DEPTH, camera->getViewMatrix());
+		queue.sort();
+		state->colorMask(GL_FALSE);
+		queue.submit(depthShader);
+		state->colorMask(GL_TRUE);
+		return true;
+	}
+
 	void SceneGraph::draw() {
 
 		camera->draw();
 
-		root->draw();
+		const bool prepassed = depthPrepass && drawDepthPrepass();
+
+		queue.clear();
+		root->collect(queue, RenderPass::MAIN, camera->getViewMatrix());
+		queue.sort();
+		queue.setDepthEqual(prepassed);
+
+		if (sampleQueries[0] == 0) {
+			glGenQueries(2, sampleQueries);
+		}
+		// The query of two frames ago is usually done by now, else keep the last count
+		const GLuint query = sampleQueries[frame % 2];
+		if (frame >= 2) {
+			GLuint available = GL_FALSE;
+			glGetQueryObjectuiv(query, GL_QUERY_RESULT_AVAILABLE, &available);
+			if (available == GL_TRUE) {
+				glGetQueryObjectuiv(query, GL_QUERY_RESULT, &shadedSamples);
+			}
+		}
+		glBeginQuery(GL_SAMPLES_PASSED, query);
+		queue.submit();
+		glEndQuery(GL_SAMPLES_PASSED);
+		frame++;
 	}
 
-	void SceneGraph::drawDepthMap(engine::ShaderProgram* shader) {
-		root->drawShadow(shader);
+	void SceneGraph::drawDepthMap(engine::ShaderProgram* shader, const Matrix4& lightSpace, const ShadowCasters casters) {
+		queue.clear();
+		root->collectCasters(queue, lightSpace, casters);
+		queue.sort();
+		queue.submit(shader);
 	}
 
 }
\ No newline at end of file
@@ -2,9 +2,13 @@
 #include "physics/Collider.h"
 #include "physics/CollisionListener.h"
 #include "physics/RigidBody.h"
+#include <algorithm>
+#include <cmath>
 
 namespace engine {
 
+	unsigned int SceneNode::casterVersion = 0;
+
 	SceneNode::SceneNode() {
 		this->shaderProgram = nullptr;
 		this->shadowShaderProgram = nullptr;
@@ -18,31 +22,56 @@ namespace engine {
 		this->rotation = new Quaternion();
 		this->texture = nullptr;
 		this->perlinTexture = nullptr;
+		this->textureArray = nullptr;
+		this->textureLayer = -1;
+		this->virtualTexture = nullptr;
+		this->skin = nullptr;
 		this->material = nullptr;
+		this->receiveShadows = true;
+		this->dynamicCaster = false;
+		this->animations = 0;
 	}
 
 	const SceneNode* SceneNode::operator= (SceneNode* node) {
-		this->localMatrix = node->getMatrix();
+		this->localMatrix = new Matrix4(node->getMatrix());
 		this->worldMatrix = node->getWorldMatrix();
 		this->scale = node->getScale();
 		this->position = node->getPosition();
 		this->rotation = node->getRotation();
 		this->mesh = node->getMesh();
+		this->color = node->getColor();
 		this->shaderProgram = node->getShaderProgram();
 		this->shadowShaderProgram = node->getShadowShaderProgram();
 		this->parent = node->getParent();
 		this->children = node->getChildren();
 		this->texture = node->getTexture();
 		this->perlinTexture = node->getPerlinTexture();
+		this->textureArray = node->getTextureArray();
+		this->textureLayer = node->getTextureLayer();
+		this->virtualTexture = node->getVirtualTexture();
+		this->skin = node->getSkin();
 		this->material = node->getMaterial();
 		return this;
 	}
 
-	Matrix4* SceneNode::getMatrix() const {
-		return new Matrix4(*this->localMatrix *
-						   MatrixFactory::Translate(*position) *
-						   (Matrix4)*rotation *
-						   MatrixFactory::Scale(*scale));
+	const Matrix4 SceneNode::getMatrix(const Matrix4& rotation) const {
+		// Translate * rotation * Scale, without the products
+		Matrix4 m = rotation;
+		const float scales[3] = { scale->x, scale->y, scale->z };
+		for (int column = 0; column < 3; column++) {
+			for (int row = 0; row < 3; row++) {
+				m.elements[column * 4 + row] *= scales[column];
+			}
+		}
+		const float w = rotation.elements[15];
+		m.elements[12] = position->x * w;
+		m.elements[13] = position->y * w;
+		m.elements[14] = position->z * w;
+		return *this->localMatrix * m;
+	}
+
+	const Matrix4 SceneNode::getMatrix() const {
+		return getMatrix(*rotation);
 	}
 
 	Matrix4* SceneNode::getLocalMatrix() const {
@@ -86,11 +115,32 @@ namespace engine {
 	}
 
 	void SceneNode::updateWorldMatrix() {
+		updateWorldMatrix(*rotation);
+	}
+
+	void SceneNode::updateWorldMatrix(const Matrix4& rotation) {
 		if (this->parent->getWorldMatrix() != nullptr) {
-			*this->worldMatrix = *this->parent->getWorldMatrix() * *this->getMatrix();
+			*this->worldMatrix = *this->parent->getWorldMatrix() * getMatrix(rotation);
 		}
 		else {
-			this->worldMatrix = this->getMatrix();
+			*this->worldMatrix = getMatrix(rotation);
+		}
+	}
+
+	void SceneNode::updateChildMatrices() {
+		// Only the GL thread collects the scene, every node reuses the same buffers before going down
+		static std::vector<Quaternion> rotations;
+		static std::vector<Matrix4> matrices;
+		rotations.clear();
+		for (SceneNode* node : children) {
+			rotations.push_back(*node->rotation);
+		}
+		if (matrices.size() < rotations.size()) {
+			matrices.resize(rotations.size());
+		}
+		Quaternion::toMatrices(rotations.data(), matrices.data(), rotations.size());
+		for (size_t i = 0; i < children.size(); i++) {
+			children[i]->updateWorldMatrix(matrices[i]);
 		}
 	}
 
@@ -106,6 +156,22 @@ namespace engine {
 		this->shadowMesh = mesh;
 	}
 
+	Mesh* SceneNode::getShadowMesh() const {
+		return shadowMesh;
+	}
+
+	Mesh* SceneNode::getDepthMesh() const {
+		return shadowMesh != nullptr ? shadowMesh : mesh;
+	}
+
+	const Vertex SceneNode::getColor() const {
+		return color;
+	}
+
+	void SceneNode::setColor(Vertex color) {
+		this->color = color;
+	}
+
 	Texture* SceneNode::getTexture() const
 	{
 		return texture;
@@ -126,6 +192,48 @@ namespace engine {
 		this->perlinTexture = texture;
 	}
 
+	TextureArray* SceneNode::getTextureArray() const
+	{
+		return textureArray;
+	}
+
+	const int SceneNode::getTextureLayer() const
+	{
+		return textureLayer;
+	}
+
+	void SceneNode::setTextureLayer(TextureArray* textures, int layer)
+	{
+		this->textureArray = textures;
+		this->textureLayer = layer;
+	}
+
+	VirtualTexture* SceneNode::getVirtualTexture() const
+	{
+		return virtualTexture;
+	}
+
+	void SceneNode::setVirtualTexture(VirtualTexture* texture)
+	{
+		this->virtualTexture = texture;
+	}
+
+	Skin* SceneNode::getSkin() const
+	{
+		return skin;
+	}
+
+	void SceneNode::setSkin(Skin* skin)
+	{
+		this->skin = skin;
+	}
+
+	const void* SceneNode::getDrawTexture() const {
+		return virtualTexture != nullptr ? (const void*)virtualTexture
+			: textureArray != nullptr ? (const void*)textureArray
+			: texture != nullptr ? (const void*)texture : (const void*)perlinTexture;
+	}
+
 	Material* SceneNode::getMaterial() const
 	{
 		return material;
@@ -144,6 +252,71 @@ namespace engine {
 		return shadowShaderProgram != nullptr ? shadowShaderProgram : parent->getShadowShaderProgram();
 	}
 
+	const bool SceneNode::getReceiveShadows() const {
+		return receiveShadows;
+	}
+
+	void SceneNode::setReceiveShadows(const bool receive) {
+		this->receiveShadows = receive;
+	}
+
+	const bool SceneNode::isDynamicCaster() const {
+		if (dynamicCaster || skin != nullptr || animations > 0) {
+			return true;
+		}
+		RigidBody* body = getRigidBody();
+		return body != nullptr && body->getMass() > 0.0f;
+	}
+
+	void SceneNode::setDynamicCaster(const bool dynamic) {
+		if (dynamic != this->dynamicCaster) {
+			casterVersion++;
+		}
+		this->dynamicCaster = dynamic;
+	}
+
+	void SceneNode::addAnimations(const int count) {
+		const bool animated = animations > 0;
+		animations += count;
+		if (animated != (animations > 0)) {
+			casterVersion++;
+		}
+	}
+
+	const unsigned int SceneNode::getCasterVersion() {
+		return casterVersion;
+	}
+
+	void SceneNode::invalidateCasters() {
+		casterVersion++;
+	}
+
+	const unsigned int SceneNode::getShaderFeatures() const {
+		unsigned int features = 0;
+		if (!receiveShadows) {
+			features |= ShaderProgram::NO_SHADOWS;
+		}
+		if (virtualTexture != nullptr) {
+			features |= ShaderProgram::VIRTUAL_TEXTURE;
+		}
+		else if (texture == nullptr && perlinTexture == nullptr && textureArray == nullptr) {
+			features |= ShaderProgram::NO_TEXTURE;
+		}
+		if (material != nullptr) {
+			features |= ShaderProgram::materialFeature(material->getMaterialType());
+		}
+		if (skin != nullptr) {
+			features |= ShaderProgram::SKINNED;
+		}
+		return features;
+	}
+
+	ShaderProgram* SceneNode::getDrawProgram() const {
+		ShaderProgram* program = getShaderProgram();
+		ShaderProgram* variant = program->getVariant(getShaderFeatures());
+		return variant != nullptr ? variant : program;
+	}
+
 	void SceneNode::setShaderProgram(ShaderProgram* shaderProgram) {
 		this->shaderProgram = shaderProgram;
 	}
@@ -211,50 +384,147 @@ namespace engine {
 			
 	}
 
-	void SceneNode::draw() {
+	void SceneNode::collect(RenderQueue& queue, const RenderPass pass, const Matrix4& view) {
+		updateChildMatrices();
+		for (SceneNode* node : children) {
 
-		getShaderProgram()->use();
+			const bool translucent = node->material != nullptr && node->material->isTranslucent();
+			if ((pass == RenderPass::MAIN || (pass == RenderPass::DEPTH && !translucent)) && node->mesh != nullptr) {
+				const Matrix4* world = node->getWorldMatrix();
+				const Vector4 eyePosition = view * Vector4(world->elements[12], world->elements[13], world->elements[14], 1.0f);
+				if (pass == RenderPass::DEPTH) {
+					// Every opaque draw of the main pass needs its depth, shadow mesh or not
+					queue.push(RenderQueue::makeKey(pass, false, node->getShadowShaderProgram()->getShaderId(), 0, 0,
+						queue.getId(node->getDepthMesh()), -eyePosition.z), node);
+				}
+				else {
+					queue.push(RenderQueue::makeKey(pass, translucent, node->getDrawProgram()->getShaderId(),
+						queue.getId(node->material), queue.getId(node->getDrawTexture()), queue.getId(node->mesh), -eyePosition.z), node);
+				}
+			}
+
+			node->collect(queue, pass, view);
+		}
+	}
+
+	/**
+	* Checks if a bounding sphere intersects the clip volume of an orthographic projection
+	*/
+	static bool intersects(const Matrix4& lightSpace, const Vector3& center, const float radius) {
+		const Vector4 clip = lightSpace * Vector4(center);
+		const float* m = lightSpace.elements;
+		const float position[3] = { clip.x, clip.y, clip.z };
+		for (int row = 0; row < 3; row++) {
+			// Clip units per world unit along this axis
+			const float scale = std::sqrt(m[row] * m[row] + m[row + 4] * m[row + 4] + m[row + 8] * m[row + 8]);
+			if (std::fabs(position[row]) > 1.0f + radius * scale) {
+				return false;
+			}
+		}
+		return true;
+	}
+
+	void SceneNode::collectCasters(RenderQueue& queue, const Matrix4& lightSpace, const ShadowCasters casters, const bool dynamicParent) {
+		updateChildMatrices();
+		for (SceneNode* node : children) {
+
+			const bool dynamic = dynamicParent || node->isDynamicCaster();
+			const bool translucent = node->material != nullptr && node->material->isTranslucent();
+			const bool wanted = casters == ShadowCasters::ALL || dynamic == (casters == ShadowCasters::DYNAMIC);
+			// Skinned nodes cast the shadow of their CPU skinned vertices, or of their mesh skinned on the GPU
+			Mesh* casterMesh = node->skin != nullptr ? node->skin->getPosedMesh() : node->shadowMesh;
+			if (node->skin != nullptr && casterMesh == nullptr) {
+				casterMesh = node->mesh;
+			}
+			if (wanted && casterMesh != nullptr && !translucent) {
+				bool visible = true;
+				// Meshes still streaming in have no bounds yet, and are not drawn anyway
+				if (casterMesh->isLoaded()) {
+					const Matrix4* world = node->getWorldMatrix();
+					const float* w = world->elements;
+					float scale = 0.0f;
+					for (int column = 0; column < 3; column++) {
+						scale = std::max(scale, w[column * 4] * w[column * 4] + w[column * 4 + 1] * w[column * 4 + 1] + w[column * 4 + 2] * w[column * 4 + 2]);
+					}
+					const Vector4 center = (*world) * Vector4(casterMesh->getBoundsCenter());
+					visible = intersects(lightSpace, Vector3(center.x, center.y, center.z), casterMesh->getBoundsRadius() * std::sqrt(scale));
+				}
+				if (visible) {
+					queue.push(RenderQueue::makeKey(RenderPass::SHADOW, false, node->getShadowShaderProgram()->getShaderId(), 0, 0, queue.getId(casterMesh), 0.0f), node);
+				}
+			}
+
+			node->collectCasters(queue, lightSpace, casters, dynamic);
+		}
+	}
+
+	void SceneNode::bindDrawState(ShaderProgram* program) const {
+		program->use();
 
 		if (texture != nullptr) {
-			glUniform1i(glGetUniformLocation(getShaderProgram()->getShaderId(), "ourSampler"), 1);
+			glUniform1i(program->getUniform("ourSampler"), 1);
 			getTexture()->Bind(1);
 		}
 		if (perlinTexture != nullptr) {
-			glUniform1i(glGetUniformLocation(getShaderProgram()->getShaderId(), "ourSampler"), 1);
+			glUniform1i(program->getUniform("ourSampler"), 1);
 			getPerlinTexture()->Bind(1);
 		}
+		// Always set, samplers of different types must not share a texture unit
+		glUniform1i(program->getUniform("layerSampler"), 2);
+		if (textureArray != nullptr) {
+			getTextureArray()->Bind(2);
+		}
+		// Atlas and page table on units 3 and 4
+		if (virtualTexture != nullptr) {
+			getVirtualTexture()->Bind(program, 3);
+		}
 
 		if (material != nullptr) {
-			glUniform1f(glGetUniformLocation(getShaderProgram()->getShaderId(), "material.ambientStrength"), getMaterial()->getAmbientStrength());
-			glUniform1f(glGetUniformLocation(getShaderProgram()->getShaderId(), "material.specularStrength"), getMaterial()->getSpecularStrength());
-			glUniform1f(glGetUniformLocation(getShaderProgram()->getShaderId(), "material.shininess"), getMaterial()->getShininess());
-			glUniform1f(glGetUniformLocation(getShaderProgram()->getShaderId(), "material.transparency"), getMaterial()->getTransparency());
-			glUniform1i(glGetUniformLocation(getShaderProgram()->getShaderId(), "material.type"), getMaterial()->getMaterialType());
+			getMaterial()->bind(program->getBinding("MATERIAL_BP"));
 		}
+	}
 
-		if (mesh != nullptr) {
-			glUniform4fv(getShaderProgram()->getUniform("Color"), 1, getMesh()->getColor().XYZW);
-			glUniformMatrix4fv(getShaderProgram()->getUniform("ModelMatrix"), 1, GL_FALSE, getWorldMatrix()->elements);
-			mesh->draw();
+	void SceneNode::draw() {
+		if (mesh == nullptr) {
+			return;
 		}
-		for (SceneNode* node : children) {
-			node->updateWorldMatrix();
-			node->draw();
+
+		ShaderProgram* program = getDrawProgram();
+		bindDrawState(program);
+		glUniform1i(program->getUniform("textureLayer"), textureArray != nullptr ? textureLayer : -1);
+		glUniform4fv(program->getUniform("Color"), 1, color.XYZW);
+		glUniformMatrix4fv(program->getUniform("ModelMatrix"), 1, GL_FALSE, getWorldMatrix()->elements);
+		if (skin != nullptr && !skin->bind(program->getBinding("SKIN_BP"))) {
+			return;
 		}
+		mesh->draw();
 	}
 
 	void SceneNode::drawShadow(engine::ShaderProgram* shader) const {
-		shader->use();
-
-		if (shadowMesh != nullptr) {
-			if (!material->isTranslucent()) {
-				glUniformMatrix4fv(glGetUniformLocation(getShadowShaderProgram()->getShaderId(), "model"), 1, GL_FALSE, getWorldMatrix()->elements);
-				shadowMesh->draw();
+		Mesh* depthMesh = getDepthMesh();
+		if (skin != nullptr) {
+			// The depth pre-pass must match the main pass depth exactly, it skins on the GPU as well
+			Mesh* posed = (shader->getFeatures() & ShaderProgram::DEPTH_ONLY) ? nullptr : skin->getPosedMesh();
+			ShaderProgram* skinned = shader->getVariant(ShaderProgram::SKINNED);
+			if (posed != nullptr) {
+				depthMesh = posed;
+			}
+			else if (skinned != nullptr) {
+				skinned->use();
+				glUniformMatrix4fv(skinned->getUniform("model"), 1, GL_FALSE, getWorldMatrix()->elements);
+				if (skin->bind(skinned->getBinding("SKIN_BP"))) {
+					mesh->draw();
+				}
+				return;
 			}
 		}
-		for (SceneNode* node : children) {
-			node->drawShadow(shader);
+		if (depthMesh == nullptr) {
+			return;
 		}
+		shader->use();
+		// The location may differ between permutations, ask the program in use
+		glUniformMatrix4fv(shader->getUniform("model"), 1, GL_FALSE, getWorldMatrix()->elements);
+		depthMesh->draw();
 	}
 
-}
\ No newline at end of file
+}
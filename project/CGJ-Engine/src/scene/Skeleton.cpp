@@ -0,0 +1,178 @@
+#include "scene/Skeleton.h"
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+
+namespace engine {
+
+	/**
+	* For all implementations in this file, @see Skeleton.h for details
+	*/
+
+	static const JointMatrix IDENTITY = { { { 1.0f, 0.0f, 0.0f, 0.0f }, { 0.0f, 1.0f, 0.0f, 0.0f }, { 0.0f, 0.0f, 1.0f, 0.0f } } };
+
+	const int Skeleton::addJoint(const std::string& name, const int parent, const ClipTransform& bind) {
+		const int index = (int)parents.size();
+		if (parent < -1 || parent >= index || index >= MAX_JOINTS) {
+			std::cerr << "[Skeleton] Cannot add joint " << name << " to parent " << parent << std::endl;
+			return -1;
+		}
+		names.push_back(name);
+		parents.push_back(parent);
+		bindPose.push_back(bind);
+
+		// Model transform of the joint in the bind pose, up the hierarchy
+		JointMatrix model = toMatrix(bind), product;
+		for (int joint = parent; joint != -1; joint = parents[joint]) {
+			multiply(toMatrix(bindPose[joint]), model, product);
+			model = product;
+		}
+		JointMatrix inverse;
+		invert(model, inverse);
+		inverseBind.push_back(inverse);
+		return index;
+	}
+
+	const int Skeleton::findJoint(const std::string& name) const {
+		std::vector<std::string>::const_iterator it = std::find(names.begin(), names.end(), name);
+		return it != names.end() ? (int)(it - names.begin()) : -1;
+	}
+
+	const int Skeleton::getJointCount() const {
+		return (int)parents.size();
+	}
+
+	const int Skeleton::getParent(const int joint) const {
+		return parents[joint];
+	}
+
+	const std::vector<ClipTransform>& Skeleton::getBindPose() const {
+		return bindPose;
+	}
+
+	void Skeleton::computePalette(const ClipTransform* pose, JointMatrix* model, JointMatrix* palette) const {
+		// Parents come first, their model transform is ready when their children need it
+		for (size_t joint = 0; joint < parents.size(); joint++) {
+			const JointMatrix local = toMatrix(pose[joint]);
+			if (parents[joint] < 0) {
+				model[joint] = local;
+			}
+			else {
+				multiply(model[parents[joint]], local, model[joint]);
+			}
+			multiply(model[joint], inverseBind[joint], palette[joint]);
+		}
+	}
+
+	/**
+	* Gets the distance from a point to a segment
+	*/
+	static float distanceToSegment(const float* point, const float* a, const float* b) {
+		float ab[3], ap[3];
+		float length = 0.0f, projection = 0.0f;
+		for (int i = 0; i < 3; i++) {
+			ab[i] = b[i] - a[i];
+			ap[i] = point[i] - a[i];
+			length += ab[i] * ab[i];
+			projection += ab[i] * ap[i];
+		}
+		const float t = length > 0.0f ? std::max(0.0f, std::min(projection / length, 1.0f)) : 0.0f;
+		float distance = 0.0f;
+		for (int i = 0; i < 3; i++) {
+			const float d = ap[i] - ab[i] * t;
+			distance += d * d;
+		}
+		return std::sqrt(distance);
+	}
+
+	std::vector<SkinWeights> Skeleton::computeSkinWeights(const std::vector<Vertex>& vertices, const float falloff) const {
+		const int joints = getJointCount();
+		// Each bone goes from its joint to its first child, the bones of leaf joints are points
+		std::vector<float> starts(joints * 3), ends(joints * 3);
+		for (int joint = 0; joint < joints; joint++) {
+			JointMatrix model;
+			invert(inverseBind[joint], model);
+			for (int i = 0; i < 3; i++) {
+				starts[joint * 3 + i] = ends[joint * 3 + i] = model.rows[i][3];
+			}
+		}
+		for (int joint = joints - 1; joint >= 0; joint--) {
+			if (parents[joint] >= 0) {
+				std::copy(&starts[joint * 3], &starts[joint * 3] + 3, &ends[parents[joint] * 3]);
+			}
+		}
+
+		std::vector<SkinWeights> skin;
+		skin.reserve(vertices.size());
+		std::vector<int> indices(joints);
+		std::vector<float> weights(joints);
+		for (const Vertex& vertex : vertices) {
+			for (int joint = 0; joint < joints; joint++) {
+				const float distance = distanceToSegment(vertex.XYZW, &starts[joint * 3], &ends[joint * 3]) / falloff;
+				indices[joint] = joint;
+				weights[joint] = 1.0f / (1.0f + distance * distance);
+			}
+			// Only the 4 heaviest bones are kept
+			const int kept = std::min(joints, 4);
+			std::partial_sort(indices.begin(), indices.begin() + kept, indices.end(),
+				[&weights](const int a, const int b) { return weights[a] > weights[b]; });
+			float nearest[4];
+			for (int i = 0; i < kept; i++) {
+				nearest[i] = weights[indices[i]];
+			}
+			skin.push_back(SkinWeights::fromWeights(indices.data(), nearest, kept));
+		}
+		return skin;
+	}
+
+	JointMatrix Skeleton::toMatrix(const ClipTransform& transform) {
+		// Clip rotations are x, y, z, w
+		const Matrix4 rotation = Quaternion(transform.rotation[3], transform.rotation[0], transform.rotation[1], transform.rotation[2]);
+		JointMatrix m;
+		for (int row = 0; row < 3; row++) {
+			for (int column = 0; column < 3; column++) {
+				m.rows[row][column] = rotation.elements[column * 4 + row] * transform.scale[column];
+			}
+			m.rows[row][3] = transform.translation[row];
+		}
+		return m;
+	}
+
+	void Skeleton::multiply(const JointMatrix& a, const JointMatrix& b, JointMatrix& out) {
+		for (int row = 0; row < 3; row++) {
+			for (int column = 0; column < 4; column++) {
+				out.rows[row][column] = a.rows[row][0] * b.rows[0][column] + a.rows[row][1] * b.rows[1][column]
+					+ a.rows[row][2] * b.rows[2][column];
+			}
+			out.rows[row][3] += a.rows[row][3];
+		}
+	}
+
+	void Skeleton::invert(const JointMatrix& m, JointMatrix& out) {
+		const float (*r)[4] = m.rows;
+		// Inverse of the 3x3 part from its cofactors
+		const float c00 = r[1][1] * r[2][2] - r[1][2] * r[2][1];
+		const float c01 = r[1][2] * r[2][0] - r[1][0] * r[2][2];
+		const float c02 = r[1][0] * r[2][1] - r[1][1] * r[2][0];
+		const float determinant = r[0][0] * c00 + r[0][1] * c01 + r[0][2] * c02;
+		if (std::fabs(determinant) < 1e-12f) {
+			out = IDENTITY;
+			return;
+		}
+		const float inverse = 1.0f / determinant;
+		out.rows[0][0] = c00 * inverse;
+		out.rows[1][0] = c01 * inverse;
+		out.rows[2][0] = c02 * inverse;
+		out.rows[0][1] = (r[0][2] * r[2][1] - r[0][1] * r[2][2]) * inverse;
+		out.rows[1][1] = (r[0][0] * r[2][2] - r[0][2] * r[2][0]) * inverse;
+		out.rows[2][1] = (r[0][1] * r[2][0] - r[0][0] * r[2][1]) * inverse;
+		out.rows[0][2] = (r[0][1] * r[1][2] - r[0][2] * r[1][1]) * inverse;
+		out.rows[1][2] = (r[0][2] * r[1][0] - r[0][0] * r[1][2]) * inverse;
+		out.rows[2][2] = (r[0][0] * r[1][1] - r[0][1] * r[1][0]) * inverse;
+		// Translation of the inverse, -inverse(R) * t
+		for (int row = 0; row < 3; row++) {
+			out.rows[row][3] = -(out.rows[row][0] * r[0][3] + out.rows[row][1] * r[1][3] + out.rows[row][2] * r[2][3]);
+		}
+	}
+
+}
@@ -0,0 +1,183 @@
+#include "scene/Skin.h"
+#include "render/RenderState.h"
+#include "render/StreamBuffer.h"
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#define SKIN_X86 1
+#include <emmintrin.h>
+#else
+#define SKIN_X86 0
+#endif
+
+namespace engine {
+
+	/**
+	* For all implementations in this file, @see Skin.h for details
+	*/
+
+	static const JointMatrix IDENTITY = { { { 1.0f, 0.0f, 0.0f, 0.0f }, { 0.0f, 1.0f, 0.0f, 0.0f }, { 0.0f, 0.0f, 1.0f, 0.0f } } };
+
+	Skin::Skin(const Skeleton* skeleton, Mesh* mesh) {
+		this->skeleton = skeleton;
+		this->mesh = mesh;
+		this->pose = skeleton->getBindPose();
+		this->joints.resize(skeleton->getJointCount(), IDENTITY);
+
+		// Influences on joints the skeleton does not have are left with an identity matrix
+		int highest = skeleton->getJointCount() - 1;
+		for (const SkinWeights& weights : mesh->getSkinWeights()) {
+			for (int i = 0; i < 4; i++) {
+				highest = std::max(highest, weights.weights[i] != 0 ? (int)weights.joints[i] : 0);
+			}
+		}
+		if (highest >= skeleton->getJointCount()) {
+			std::cerr << "[Skin] The mesh uses joint " << highest << ", the skeleton has " << skeleton->getJointCount() << std::endl;
+		}
+		this->palette.resize(highest + 1, IDENTITY);
+		updatePalette();
+	}
+
+	Skin::~Skin() {
+		delete posedMesh;
+	}
+
+	const Skeleton* Skin::getSkeleton() const {
+		return skeleton;
+	}
+
+	Mesh* Skin::getMesh() const {
+		return mesh;
+	}
+
+	std::vector<ClipTransform>& Skin::getPose() {
+		return pose;
+	}
+
+	void Skin::updatePalette() {
+		skeleton->computePalette(pose.data(), joints.data(), palette.data());
+		poseVersion++;
+	}
+
+	const std::vector<JointMatrix>& Skin::getPalette() const {
+		return palette;
+	}
+
+	const std::vector<JointMatrix>& Skin::getJointTransforms() const {
+		return joints;
+	}
+
+	void Skin::setCpuSkinning(const bool enabled) {
+		cpuSkinning = enabled && mesh->isSkinned();
+		if (cpuSkinning) {
+			bindVertices = mesh->getVertices();
+			skinnedVertices = bindVertices;
+			skinVertices(0, bindVertices.size());
+		}
+		else {
+			bindVertices.clear();
+			skinnedVertices.clear();
+		}
+	}
+
+	const bool Skin::isCpuSkinning() const {
+		return cpuSkinning;
+	}
+
+	const size_t Skin::getVertexCount() const {
+		return bindVertices.size();
+	}
+
+	void Skin::skinVertices(const size_t first, const size_t last) {
+		const size_t end = std::min(last, bindVertices.size());
+		if (first >= end) {
+			return;
+		}
+		skin(&bindVertices[first], &mesh->getSkinWeights()[first], palette.data(), &skinnedVertices[first], end - first);
+	}
+
+	const std::vector<Vertex>& Skin::getSkinnedVertices() const {
+		return skinnedVertices;
+	}
+
+	Mesh* Skin::getPosedMesh() {
+		if (!cpuSkinning || !mesh->isLoaded()) {
+			return nullptr;
+		}
+		if (posedMesh == nullptr) {
+			posedMesh = mesh->createDynamicCopy();
+			posedVersion = poseVersion - 1;
+		}
+		if (posedVersion != poseVersion) {
+			posedMesh->updateVertices(skinnedVertices);
+			posedVersion = poseVersion;
+		}
+		return posedMesh;
+	}
+
+	const bool Skin::bind(const GLuint binding) const {
+		// The storage block is unsized, so only the joints of the palette are allocated and bound
+		StreamBuffer* stream = StreamBuffer::getInstance();
+		StreamBuffer::Allocation allocation = stream->allocateStorage(palette.size() * sizeof(JointMatrix));
+		if (!allocation.isValid()) {
+			return false;
+		}
+		std::memcpy(allocation.data, palette.data(), palette.size() * sizeof(JointMatrix));
+		stream->flush();
+		RenderState::getInstance()->bindBufferRange(GL_SHADER_STORAGE_BUFFER, binding, stream->getId(), allocation.offset, allocation.size);
+		return true;
+	}
+
+	void Skin::skin(const Vertex* vertices, const SkinWeights* weights, const JointMatrix* palette, Vertex* out, const size_t count) {
+		const float unit = 1.0f / 255.0f;
+#if SKIN_X86
+		const __m128 one = _mm_setr_ps(1.0f, 0.0f, 0.0f, 0.0f);
+		for (size_t i = 0; i < count; i++) {
+			// Weighted sum of the rows of the influencing joints, most vertices have one or two
+			__m128 row0 = _mm_setzero_ps(), row1 = _mm_setzero_ps(), row2 = _mm_setzero_ps();
+			for (int k = 0; k < 4; k++) {
+				if (weights[i].weights[k] == 0) {
+					continue;
+				}
+				const __m128 weight = _mm_set1_ps(weights[i].weights[k] * unit);
+				const JointMatrix& joint = palette[weights[i].joints[k]];
+				row0 = _mm_add_ps(row0, _mm_mul_ps(_mm_loadu_ps(joint.rows[0]), weight));
+				row1 = _mm_add_ps(row1, _mm_mul_ps(_mm_loadu_ps(joint.rows[1]), weight));
+				row2 = _mm_add_ps(row2, _mm_mul_ps(_mm_loadu_ps(joint.rows[2]), weight));
+			}
+			const __m128 position = _mm_setr_ps(vertices[i].XYZW[0], vertices[i].XYZW[1], vertices[i].XYZW[2], 1.0f);
+			__m128 x = _mm_mul_ps(row0, position);
+			__m128 y = _mm_mul_ps(row1, position);
+			__m128 z = _mm_mul_ps(row2, position);
+			// The fourth row sums to w = 1
+			__m128 w = one;
+			_MM_TRANSPOSE4_PS(x, y, z, w);
+			_mm_storeu_ps(out[i].XYZW, _mm_add_ps(_mm_add_ps(x, y), _mm_add_ps(z, w)));
+		}
+#else
+		for (size_t i = 0; i < count; i++) {
+			float rows[3][4] = {};
+			for (int k = 0; k < 4; k++) {
+				if (weights[i].weights[k] == 0) {
+					continue;
+				}
+				const float weight = weights[i].weights[k] * unit;
+				const JointMatrix& joint = palette[weights[i].joints[k]];
+				for (int row = 0; row < 3; row++) {
+					for (int column = 0; column < 4; column++) {
+						rows[row][column] += joint.rows[row][column] * weight;
+					}
+				}
+			}
+			const float* p = vertices[i].XYZW;
+			for (int row = 0; row < 3; row++) {
+				out[i].XYZW[row] = rows[row][0] * p[0] + rows[row][1] * p[1] + rows[row][2] * p[2] + rows[row][3];
+			}
+			out[i].XYZW[3] = 1.0f;
+		}
+#endif
+	}
+
+}
@@ -0,0 +1,129 @@
+#include "shader/ShaderCache.h"
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <sys/stat.h>
+#ifdef _WIN32
+#include <direct.h>
+#endif
+
+namespace engine {
+
+	/**
+	* For all implementations in this file, @see ShaderCache.h for details
+	*/
+
+	std::string ShaderCache::directory = "shader_cache";
+
+	// File header, followed by the binary
+	struct BinaryHeader {
+		char magic[4];
+		uint64_t key;
+		GLenum format;
+		GLint length;
+	};
+
+	static const char MAGIC[4] = { 'C', 'G', 'J', 'B' };
+
+	bool ShaderCache::isSupported() {
+		if (!GLEW_ARB_get_program_binary) {
+			return false;
+		}
+		GLint formats = 0;
+		glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formats);
+		return formats > 0;
+	}
+
+	void ShaderCache::setDirectory(const std::string& path) {
+		directory = path;
+	}
+
+	std::string ShaderCache::getPath(const uint64_t key) {
+		char name[17];
+		std::snprintf(name, sizeof(name), "%016llx", (unsigned long long)key);
+		return directory + "/" + name + ".bin";
+	}
+
+	bool ShaderCache::createDirectory() {
+		struct stat info;
+		if (stat(directory.c_str(), &info) == 0) {
+			return (info.st_mode & S_IFDIR) != 0;
+		}
+#ifdef _WIN32
+		return _mkdir(directory.c_str()) == 0;
+#else
+		return mkdir(directory.c_str(), 0755) == 0;
+#endif
+	}
+
+	uint64_t ShaderCache::makeKey(const std::vector<std::string>& sources, const int kind) {
+		std::vector<std::string> parts = sources;
+		parts.push_back(std::to_string(kind));
+		const GLenum strings[] = { GL_VENDOR, GL_RENDERER, GL_VERSION };
+		for (GLenum name : strings) {
+			const GLubyte* value = glGetString(name);
+			parts.push_back(value != nullptr ? (const char*)value : "");
+		}
+
+		uint64_t hash = 14695981039346656037ull;
+		for (const std::string& part : parts) {
+			for (unsigned char c : part) {
+				hash = (hash ^ c) * 1099511628211ull;
+			}
+			// Separator, so moving text from one part to the next changes the key
+			hash = (hash ^ 0xFF) * 1099511628211ull;
+		}
+		return hash;
+	}
+
+	bool ShaderCache::load(const GLuint program, const uint64_t key) {
+		if (!isSupported()) {
+			return false;
+		}
+		std::ifstream file(getPath(key), std::ios::binary);
+		if (!file.is_open()) {
+			return false;
+		}
+		BinaryHeader header;
+		file.read((char*)&header, sizeof(header));
+		if (!file || std::memcmp(header.magic, MAGIC, sizeof(MAGIC)) != 0 || header.key != key || header.length <= 0) {
+			return false;
+		}
+		std::vector<char> binary(header.length);
+		file.read(binary.data(), header.length);
+		if (!file) {
+			return false;
+		}
+
+		glProgramBinary(program, header.format, binary.data(), header.length);
+		GLint linked = GL_FALSE;
+		glGetProgramiv(program, GL_LINK_STATUS, &linked);
+		return linked == GL_TRUE;
+	}
+
+	void ShaderCache::save(const GLuint program, const uint64_t key) {
+		if (!isSupported() || !createDirectory()) {
+			return;
+		}
+		GLint length = 0;
+		glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &length);
+		if (length <= 0) {
+			return;
+		}
+		BinaryHeader header;
+		std::memcpy(header.magic, MAGIC, sizeof(MAGIC));
+		header.key = key;
+		std::vector<char> binary(length);
+		glGetProgramBinary(program, length, &header.length, &header.format, binary.data());
+
+		std::ofstream file(getPath(key), std::ios::binary | std::ios::trunc);
+		if (!file.is_open()) {
+			std::cerr << "[ShaderCache] Cannot write " << getPath(key) << std::endl;
+			return;
+		}
+		file.write((const char*)&header, sizeof(header));
+		file.write(binary.data(), header.length);
+	}
+
+}
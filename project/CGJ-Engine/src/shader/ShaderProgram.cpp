@@ -1,5 +1,8 @@
 #include "Shader/ShaderProgram.h"
 #include "Utils.h"
+#include "render/RenderState.h"
+#include "shader/ShaderCache.h"
+#include "shader/ShaderWatcher.h"
 
 namespace engine {
 
@@ -19,13 +22,91 @@ namespace engine {
 	}
 
 	ShaderProgram::ShaderProgram(std::ifstream* vertexShaderFile, std::ifstream* fragmentShaderFile, bool isShadow) {
-		const GLchar* VertexShader = IO::readLinesFromFile(vertexShaderFile);
-		const GLchar* FragmentShader = IO::readLinesFromFile(fragmentShaderFile);
+		// Kept to build the permutations of this program
+		this->vertexSource = IO::readFile(vertexShaderFile);
+		this->fragmentSource = IO::readFile(fragmentShaderFile);
 		this->isShadowShader = isShadow;
 		if (!this->isShadowShader)
-			Init(VertexShader, FragmentShader);
+			Init(vertexSource.c_str(), fragmentSource.c_str());
 		else
-			InitShadow(VertexShader, FragmentShader);
+			InitShadow(vertexSource.c_str(), fragmentSource.c_str());
+	}
+
+	ShaderProgram::ShaderProgram(const std::string& vertexSource, const std::string& fragmentSource, bool isShadow, const std::vector<std::string>& defines) {
+		const std::string vertexShader = injectDefines(vertexSource, defines);
+		const std::string fragmentShader = injectDefines(fragmentSource, defines);
+		this->isShadowShader = isShadow;
+		if (!this->isShadowShader)
+			Init(vertexShader.c_str(), fragmentShader.c_str());
+		else
+			InitShadow(vertexShader.c_str(), fragmentShader.c_str());
+	}
+
+	ShaderProgram* ShaderProgram::fromFiles(const std::string& vertexPath, const std::string& fragmentPath, bool isShadow) {
+		std::string vertexSource, fragmentSource;
+		std::vector<std::string> dependencies;
+		if (!readSource(vertexPath, vertexSource, dependencies) || !readSource(fragmentPath, fragmentSource, dependencies)) {
+			std::cerr << "[ShaderProgram] Cannot load " << vertexPath << " and " << fragmentPath << std::endl;
+		}
+		ShaderProgram* program = new ShaderProgram(vertexSource, fragmentSource, isShadow, {});
+		program->vertexSource = vertexSource;
+		program->fragmentSource = fragmentSource;
+		program->vertexPath = vertexPath;
+		program->fragmentPath = fragmentPath;
+		program->dependencies = dependencies;
+		return program;
+	}
+
+	bool ShaderProgram::readSource(const std::string& path, std::string& source, std::vector<std::string>& dependencies, const int depth) {
+		if (depth > MAX_INCLUDE_DEPTH) {
+			std::cerr << "[ShaderProgram] #include nested too deep in " << path << std::endl;
+			return false;
+		}
+		std::string contents;
+		if (!IO::readFile(path, contents)) {
+			std::cerr << "[ShaderProgram] Cannot read " << path << std::endl;
+			return false;
+		}
+		dependencies.push_back(path);
+
+		std::istringstream lines(contents);
+		std::string line;
+		while (std::getline(lines, line)) {
+			const size_t directive = line.find_first_not_of(" \t");
+			if (directive == std::string::npos || line.compare(directive, 8, "#include") != 0) {
+				source += line;
+				source += '\n';
+				continue;
+			}
+			const size_t open = line.find('"', directive + 8);
+			const size_t close = open == std::string::npos ? std::string::npos : line.find('"', open + 1);
+			if (close == std::string::npos) {
+				std::cerr << "[ShaderProgram] Malformed #include in " << path << ": " << line << std::endl;
+				return false;
+			}
+			const std::string included = IO::joinPath(IO::directoryOf(path), line.substr(open + 1, close - open - 1));
+			if (!readSource(included, source, dependencies, depth + 1)) {
+				return false;
+			}
+		}
+		return true;
+	}
+
+	std::string ShaderProgram::injectDefines(const std::string& source, const std::vector<std::string>& defines) {
+		std::string lines;
+		for (const std::string& define : defines) {
+			lines += "#define " + define + "\n";
+		}
+		// #version must stay the first directive of the source
+		size_t version = source.find("#version");
+		if (version == std::string::npos) {
+			return lines + source;
+		}
+		size_t lineEnd = source.find('\n', version);
+		if (lineEnd == std::string::npos) {
+			return source + "\n" + lines;
+		}
+		return source.substr(0, lineEnd + 1) + lines + source.substr(lineEnd + 1);
 	}
 
 	const char* shaderType(const GLenum shaderType) {
@@ -77,13 +158,102 @@ namespace engine {
 
 	}
 
-	void ShaderProgram::insertUniform(const char* name) {
-		uniforms.insert(std::pair<std::string, GLuint>(std::string(name), glGetUniformLocation(ProgramId, name)));
+	void ShaderProgram::reflect() {
+		uniforms.clear();
+		uniformBlocks.clear();
+
+		GLint count, maxLength;
+		glGetProgramiv(ProgramId, GL_ACTIVE_UNIFORMS, &count);
+		glGetProgramiv(ProgramId, GL_ACTIVE_UNIFORM_MAX_LENGTH, &maxLength);
+		std::vector<GLchar> name(maxLength > 0 ? maxLength : 1);
+		for (GLint i = 0; i < count; i++) {
+			GLint size;
+			GLenum type;
+			glGetActiveUniform(ProgramId, (GLuint)i, (GLsizei)name.size(), nullptr, &size, &type, name.data());
+			// Members of uniform blocks have no location
+			const GLint location = glGetUniformLocation(ProgramId, name.data());
+			if (location < 0) {
+				continue;
+			}
+			std::string uniform(name.data());
+			uniforms[uniform] = location;
+			if (uniform.size() > 3 && uniform.compare(uniform.size() - 3, 3, "[0]") == 0) {
+				uniforms[uniform.substr(0, uniform.size() - 3)] = location;
+			}
+		}
+
+		glGetProgramiv(ProgramId, GL_ACTIVE_UNIFORM_BLOCKS, &count);
+		glGetProgramiv(ProgramId, GL_ACTIVE_UNIFORM_BLOCK_MAX_NAME_LENGTH, &maxLength);
+		name.resize(maxLength > 0 ? maxLength : 1);
+		for (GLint i = 0; i < count; i++) {
+			glGetActiveUniformBlockName(ProgramId, (GLuint)i, (GLsizei)name.size(), nullptr, name.data());
+			uniformBlocks[std::string(name.data())] = (GLuint)i;
+		}
+
+		if (getUniformBlock("SharedMatrices") != GL_INVALID_INDEX) {
+			glUniformBlockBinding(ProgramId, getUniformBlock("SharedMatrices"), bindings.at("UBO_BP"));
+		}
+		if (getUniformBlock("MaterialBlock") != GL_INVALID_INDEX) {
+			glUniformBlockBinding(ProgramId, getUniformBlock("MaterialBlock"), bindings.at("MATERIAL_BP"));
+		}
+		if (getUniformBlock("FrameBlock") != GL_INVALID_INDEX) {
+			glUniformBlockBinding(ProgramId, getUniformBlock("FrameBlock"), bindings.at("FRAME_BP"));
+		}
+		if (getUniformBlock("CascadeBlock") != GL_INVALID_INDEX) {
+			glUniformBlockBinding(ProgramId, getUniformBlock("CascadeBlock"), bindings.at("CASCADE_BP"));
+		}
+		// Storage blocks need GL 4.3, only the INDIRECT and SKINNED variants declare one
+		if (GLEW_ARB_shader_storage_buffer_object && GLEW_ARB_program_interface_query) {
+			const GLuint drawBlock = glGetProgramResourceIndex(ProgramId, GL_SHADER_STORAGE_BLOCK, "DrawBlock");
+			if (drawBlock != GL_INVALID_INDEX) {
+				glShaderStorageBlockBinding(ProgramId, drawBlock, bindings.at("DRAW_BP"));
+			}
+			const GLuint skinBlock = glGetProgramResourceIndex(ProgramId, GL_SHADER_STORAGE_BLOCK, "SkinBlock");
+			if (skinBlock != GL_INVALID_INDEX) {
+				glShaderStorageBlockBinding(ProgramId, skinBlock, bindings.at("SKIN_BP"));
+			}
+		}
+	}
+
+	const bool ShaderProgram::createProgram(const char* vertexShader, const char* fragmentShader) {
+		ProgramId = glCreateProgram();
+		cacheKey = ShaderCache::makeKey({ vertexShader, fragmentShader, getBindingKey() }, (int)isShadowShader);
+		if (!ShaderCache::load(ProgramId, cacheKey)) {
+			return false;
+		}
+		linked = true;
+		// Uniform block bindings are not part of the binary, reflect() sets them again
+		reflect();
+		return true;
+	}
+
+	const std::string ShaderProgram::getBindingKey() const {
+		// The map is ordered, the same bindings always give the same key
+		std::string key;
+		for (const std::pair<const std::string, const int>& binding : bindings) {
+			key += binding.first + "=" + std::to_string(binding.second) + ";";
+		}
+		return key;
+	}
+
+	void ShaderProgram::link() {
+		if (ShaderCache::isSupported()) {
+			glProgramParameteri(ProgramId, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+		}
+		glLinkProgram(ProgramId);
+		linked = checkLinkage() == GL_TRUE;
+		if (linked) {
+			ShaderCache::save(ProgramId, cacheKey);
+		}
+
+		reflect();
 	}
 
 	void ShaderProgram::Init(const char* vertexShader, const char* fragmentShader) {
 
-		ProgramId = glCreateProgram();
+		if (createProgram(vertexShader, fragmentShader)) {
+			return;
+		}
 
 		const GLuint VertexShaderId = addShader(vertexShader, GL_VERTEX_SHADER);
 		const GLuint FragmentShaderId = addShader(fragmentShader, GL_FRAGMENT_SHADER);
@@ -91,23 +261,14 @@ namespace engine {
 		glBindAttribLocation(ProgramId, bindings.at("VERTICES"), "in_Position");
 		glBindAttribLocation(ProgramId, bindings.at("TEX_COORDS"), "in_TexCoord");
 		glBindAttribLocation(ProgramId, bindings.at("NORMALS"), "in_Normal");
+		glBindAttribLocation(ProgramId, bindings.at("INSTANCE_MATRIX"), "in_ModelMatrix");
+		glBindAttribLocation(ProgramId, bindings.at("INSTANCE_COLOR"), "in_InstanceColor");
+		glBindAttribLocation(ProgramId, bindings.at("INSTANCE_LAYER"), "in_TextureLayer");
+		glBindAttribLocation(ProgramId, bindings.at("DRAW_ID"), "in_DrawId");
+		glBindAttribLocation(ProgramId, bindings.at("JOINTS"), "in_Joints");
+		glBindAttribLocation(ProgramId, bindings.at("WEIGHTS"), "in_Weights");
 
-		glLinkProgram(ProgramId);
-		checkLinkage();
-
-		insertUniform("Color");
-		insertUniform("ModelMatrix");
-		insertUniform("viewPos");
-		insertUniform("lightSpaceMatrix");
-		insertUniform("lightPos");
-		insertUniform("shadowMap");
-
-		insertUniform("ourSampler");
-		insertUniform("material");
-		insertUniform("powerSlide");
-
-		glUniformBlockBinding(ProgramId, glGetUniformBlockIndex(ProgramId, "SharedMatrices"), bindings.at("UBO_BP"));
-
+		link();
 
 		glDetachShader(ProgramId, VertexShaderId);
 		glDeleteShader(VertexShaderId);
@@ -118,19 +279,20 @@ namespace engine {
 
 	void ShaderProgram::InitShadow(const char* vertexShader, const char* fragmentShader) {
 
-		ProgramId = glCreateProgram();
+		if (createProgram(vertexShader, fragmentShader)) {
+			return;
+		}
 
 		const GLuint VertexShaderId = addShader(vertexShader, GL_VERTEX_SHADER);
 		const GLuint FragmentShaderId = addShader(fragmentShader, GL_FRAGMENT_SHADER);
 
 		glBindAttribLocation(ProgramId, bindings.at("VERTICES"), "in_Position");
+		glBindAttribLocation(ProgramId, bindings.at("INSTANCE_MATRIX"), "in_ModelMatrix");
+		glBindAttribLocation(ProgramId, bindings.at("DRAW_ID"), "in_DrawId");
+		glBindAttribLocation(ProgramId, bindings.at("JOINTS"), "in_Joints");
+		glBindAttribLocation(ProgramId, bindings.at("WEIGHTS"), "in_Weights");
 
-		glLinkProgram(ProgramId);
-		checkLinkage();
-
-		insertUniform("model");
-		insertUniform("lightSpaceMatrix");
-		insertUniform("shadowMap");
+		link();
 
 		glDetachShader(ProgramId, VertexShaderId);
 		glDeleteShader(VertexShaderId);
@@ -141,20 +303,16 @@ namespace engine {
 
 	void ShaderProgram::InitSkyBox(const char* vertexShader, const char* fragmentShader)
 	{
-		ProgramId = glCreateProgram();
+		if (createProgram(vertexShader, fragmentShader)) {
+			return;
+		}
 
 		const GLuint VertexShaderId = addShader(vertexShader, GL_VERTEX_SHADER);
 		const GLuint FragmentShaderId = addShader(fragmentShader, GL_FRAGMENT_SHADER);
 
 		glBindAttribLocation(ProgramId, bindings.at("VERTICES"), "in_Position");
 
-		glLinkProgram(ProgramId);
-		checkLinkage();
-
-		insertUniform("model");
-		
-		glUniformBlockBinding(ProgramId, glGetUniformBlockIndex(ProgramId, "SharedMatrices"), bindings.at("UBO_BP"));
-
+		link();
 
 		glDetachShader(ProgramId, VertexShaderId);
 		glDeleteShader(VertexShaderId);
@@ -163,26 +321,162 @@ namespace engine {
 	}
 
 	ShaderProgram::~ShaderProgram() {
-		glUseProgram(0);
+		if (!vertexPath.empty()) {
+			ShaderWatcher::getInstance()->unwatch(this);
+		}
+		for (std::pair<const unsigned int, ShaderProgram*>& variant : variants) {
+			delete variant.second;
+		}
+		RenderState::getInstance()->useProgram(0);
 		glDeleteProgram(ProgramId);
+		RenderState::getInstance()->forgetProgram(ProgramId);
 	}
 
 	const ShaderProgram& ShaderProgram::operator= (const ShaderProgram& shaderProgram) {
 		ProgramId = shaderProgram.ProgramId;
 		uniforms = shaderProgram.uniforms;
+		uniformBlocks = shaderProgram.uniformBlocks;
 		return (*this);
 	}
 
-	const GLuint ShaderProgram::getUniform(std::string name) const {
-		return uniforms.at(name);
+	const GLint ShaderProgram::getUniform(const std::string& name) const {
+		std::unordered_map<std::string, GLint>::const_iterator it = uniforms.find(name);
+		return it != uniforms.end() ? it->second : -1;
+	}
+
+	const GLuint ShaderProgram::getUniformBlock(const std::string& name) const {
+		std::unordered_map<std::string, GLuint>::const_iterator it = uniformBlocks.find(name);
+		return it != uniformBlocks.end() ? it->second : GL_INVALID_INDEX;
 	}
 
 	const int ShaderProgram::getBinding(std::string name) const {
 		return bindings.at(name);
 	}
 
+	unsigned int ShaderProgram::materialFeature(const int type) {
+		if (type < 0 || type + 1 >= (1 << MATERIAL_BITS)) {
+			return 0;
+		}
+		return (unsigned int)(type + 1) << MATERIAL_SHIFT;
+	}
+
+	std::vector<std::string> ShaderProgram::getDefines(const unsigned int features) {
+		std::vector<std::string> defines;
+		if (features & INSTANCED) {
+			defines.push_back("INSTANCED");
+		}
+		if (features & INDIRECT) {
+			defines.push_back("INDIRECT");
+		}
+		if (features & NO_SHADOWS) {
+			defines.push_back("NO_SHADOWS");
+		}
+		if (features & NO_TEXTURE) {
+			defines.push_back("NO_TEXTURE");
+		}
+		if (features & DEPTH_ONLY) {
+			defines.push_back("DEPTH_ONLY");
+		}
+		if (features & VIRTUAL_TEXTURE) {
+			defines.push_back("VIRTUAL_TEXTURE");
+		}
+		if (features & SKINNED) {
+			defines.push_back("SKINNED");
+		}
+		const unsigned int material = (features >> MATERIAL_SHIFT) & ((1 << MATERIAL_BITS) - 1);
+		if (material != 0) {
+			defines.push_back("MATERIAL_TYPE " + std::to_string(material - 1));
+		}
+		return defines;
+	}
+
+	ShaderProgram* ShaderProgram::getVariant(const unsigned int requested) {
+		// Permutations of a permutation are built from the original sources
+		if (base != nullptr) {
+			return base->getVariant(features | requested);
+		}
+		if (requested == 0) {
+			return this;
+		}
+		std::unordered_map<unsigned int, ShaderProgram*>::iterator it = variants.find(requested);
+		if (it != variants.end()) {
+			return it->second;
+		}
+		if (vertexSource.empty()) {
+			return nullptr;
+		}
+		ShaderProgram* variant = new ShaderProgram(vertexSource, fragmentSource, isShadowShader != 0, getDefines(requested));
+		variant->base = this;
+		variant->features = requested;
+		variants[requested] = variant;
+		return variant;
+	}
+
+	const unsigned int ShaderProgram::getFeatures() const {
+		return features;
+	}
+
+	void ShaderProgram::swapProgram(ShaderProgram& other) {
+		std::swap(ProgramId, other.ProgramId);
+		std::swap(cacheKey, other.cacheKey);
+		std::swap(linked, other.linked);
+		uniforms.swap(other.uniforms);
+		uniformBlocks.swap(other.uniformBlocks);
+	}
+
+	bool ShaderProgram::reload() {
+		if (base != nullptr) {
+			return base->reload();
+		}
+		if (vertexPath.empty()) {
+			return false;
+		}
+		std::string vertex, fragment;
+		std::vector<std::string> files;
+		if (!readSource(vertexPath, vertex, files) || !readSource(fragmentPath, fragment, files)) {
+			return false;
+		}
+
+		// Every program is linked before any is swapped, so the base and its
+		// permutations never run mismatched sources
+		std::vector<std::pair<ShaderProgram*, ShaderProgram*>> rebuilt;
+		rebuilt.push_back({ this, new ShaderProgram(vertex, fragment, isShadowShader != 0, {}) });
+		bool success = rebuilt.back().second->isLinked();
+		for (std::pair<const unsigned int, ShaderProgram*>& variant : variants) {
+			if (!success) {
+				break;
+			}
+			rebuilt.push_back({ variant.second, new ShaderProgram(vertex, fragment, isShadowShader != 0, getDefines(variant.first)) });
+			success = rebuilt.back().second->isLinked();
+		}
+
+		for (std::pair<ShaderProgram*, ShaderProgram*>& program : rebuilt) {
+			if (success) {
+				program.first->swapProgram(*program.second);
+			}
+			// Deletes the replaced GL program, or the one that failed
+			delete program.second;
+		}
+		if (!success) {
+			std::cerr << "[ShaderProgram] Reload of " << vertexPath << " and " << fragmentPath << " failed, keeping the running program" << std::endl;
+			return false;
+		}
+		vertexSource = vertex;
+		fragmentSource = fragment;
+		dependencies = files;
+		return true;
+	}
+
+	const std::vector<std::string>& ShaderProgram::getDependencies() const {
+		return dependencies;
+	}
+
+	const bool ShaderProgram::isLinked() const {
+		return linked;
+	}
+
 	void ShaderProgram::use() const {
-		glUseProgram(ProgramId);
+		RenderState::getInstance()->useProgram(ProgramId);
 	}
 
 }
\ No newline at end of file
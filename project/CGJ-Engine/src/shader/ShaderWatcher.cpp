@@ -0,0 +1,169 @@
+#include "shader/ShaderWatcher.h"
+#include "Utils.h"
+#include <algorithm>
+#include <iostream>
+#include <sys/stat.h>
+#ifdef __linux__
+#include <sys/inotify.h>
+#include <unistd.h>
+#endif
+
+namespace engine {
+
+	/**
+	* For all implementations in this file, @see ShaderWatcher.h for details
+	*/
+
+	ShaderWatcher* ShaderWatcher::instance;
+
+	const double ShaderWatcher::POLL_INTERVAL = 0.25;
+
+	ShaderWatcher* ShaderWatcher::getInstance() {
+		if (instance == nullptr) {
+			instance = new ShaderWatcher();
+		}
+		return instance;
+	}
+
+	ShaderWatcher::ShaderWatcher() {
+		lastPoll = std::chrono::steady_clock::now();
+#ifdef __linux__
+		notifier = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+		if (notifier < 0) {
+			std::cerr << "[ShaderWatcher] inotify unavailable, comparing modification times instead" << std::endl;
+		}
+#endif
+	}
+
+	ShaderWatcher::~ShaderWatcher() {
+#ifdef __linux__
+		if (notifier >= 0) {
+			close(notifier);
+		}
+#endif
+	}
+
+	time_t ShaderWatcher::getModifiedTime(const std::string& path) {
+		struct stat info;
+		if (stat(path.c_str(), &info) != 0) {
+			return 0;
+		}
+		return info.st_mtime;
+	}
+
+	void ShaderWatcher::addFiles(const ShaderProgram* program) {
+		for (const std::string& path : program->getDependencies()) {
+			if (files.find(path) != files.end()) {
+				continue;
+			}
+			files[path] = getModifiedTime(path);
+#ifdef __linux__
+			if (notifier < 0) {
+				continue;
+			}
+			const std::string directory = IO::directoryOf(path);
+			bool watched = false;
+			for (const std::pair<const int, std::string>& entry : directories) {
+				watched = watched || entry.second == directory;
+			}
+			if (watched) {
+				continue;
+			}
+			// Whole directories, editors often replace a file instead of writing it
+			const int descriptor = inotify_add_watch(notifier, directory.empty() ? "." : directory.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO | IN_CREATE);
+			if (descriptor < 0) {
+				std::cerr << "[ShaderWatcher] Cannot watch " << (directory.empty() ? "." : directory) << std::endl;
+				continue;
+			}
+			directories[descriptor] = directory;
+#endif
+		}
+	}
+
+	void ShaderWatcher::watch(ShaderProgram* program) {
+		if (program->getDependencies().empty()) {
+			std::cerr << "[ShaderWatcher] Program " << program->getShaderId() << " was not created from files" << std::endl;
+			return;
+		}
+		if (std::find(programs.begin(), programs.end(), program) == programs.end()) {
+			programs.push_back(program);
+		}
+		addFiles(program);
+	}
+
+	void ShaderWatcher::unwatch(ShaderProgram* program) {
+		programs.erase(std::remove(programs.begin(), programs.end(), program), programs.end());
+	}
+
+#ifdef __linux__
+	void ShaderWatcher::readEvents() {
+		alignas(inotify_event) char buffer[4096];
+		ssize_t length;
+		while ((length = read(notifier, buffer, sizeof(buffer))) > 0) {
+			for (char* next = buffer; next < buffer + length;) {
+				const inotify_event* event = (const inotify_event*)next;
+				next += sizeof(inotify_event) + event->len;
+				std::map<int, std::string>::const_iterator directory = directories.find(event->wd);
+				if (event->len == 0 || directory == directories.end()) {
+					continue;
+				}
+				const std::string path = IO::joinPath(directory->second, event->name);
+				if (files.find(path) != files.end()) {
+					changed.insert(path);
+				}
+			}
+		}
+	}
+#endif
+
+	void ShaderWatcher::checkTimes() {
+		const std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+		if (std::chrono::duration<double>(now - lastPoll).count() < POLL_INTERVAL) {
+			return;
+		}
+		lastPoll = now;
+		for (std::pair<const std::string, time_t>& file : files) {
+			const time_t modified = getModifiedTime(file.first);
+			// A missing file is being replaced, wait for the new one
+			if (modified != 0 && modified != file.second) {
+				file.second = modified;
+				changed.insert(file.first);
+			}
+		}
+	}
+
+	const unsigned int ShaderWatcher::poll() {
+#ifdef __linux__
+		if (notifier >= 0) {
+			readEvents();
+		}
+		else
+#endif
+		checkTimes();
+		if (changed.empty()) {
+			return 0;
+		}
+
+		unsigned int reloaded = 0;
+		const std::vector<ShaderProgram*> watched = programs;
+		for (ShaderProgram* program : watched) {
+			const std::vector<std::string>& dependencies = program->getDependencies();
+			bool affected = false;
+			for (const std::string& path : dependencies) {
+				affected = affected || changed.count(path) != 0;
+			}
+			if (!affected) {
+				continue;
+			}
+			if (program->reload()) {
+				reloaded++;
+				std::cout << "[ShaderWatcher] Reloaded the program of " << dependencies.front() << std::endl;
+			}
+			// The #include lines may have changed
+			addFiles(program);
+		}
+		changed.clear();
+		return reloaded;
+	}
+
+}
@@ -1,33 +1,21 @@
 #include "skybox/CubeMap.h"
+#include "loader/AssetLoader.h"
+#include "render/RenderState.h"
 
 namespace engine {
 
-	Cubemap::Cubemap()
-	{
-        this->mesh = nullptr;
-	}
-
-	Cubemap::Cubemap(std::vector<std::string> faces, Mesh* mesh)
+	Cubemap::Cubemap(Mesh* mesh)
 	{
         this->mesh = mesh;
 
+        const GLubyte placeholder[4] = { 51, 76, 76, 255 };
+
         glGenTextures(1, &m_cubemap_id);
-        glBindTexture(GL_TEXTURE_CUBE_MAP, m_cubemap_id);
+        RenderState::getInstance()->bindTexture(GL_TEXTURE_CUBE_MAP, m_cubemap_id);
 
-        int width, height, nrChannels;
-        for (unsigned int i = 0; i < faces.size(); i++)
+        for (unsigned int i = 0; i < 6; i++)
         {
-            unsigned char* data = stbi_load(faces[i].c_str(), &width, &height, &nrChannels, 4);
-            if (data)
-            {
-                glTexImage2D( GL_TEXTURE_CUBE_MAP_POSITIVE_X + i, 0, GL_RGBA, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, data );
-                stbi_image_free(data);
-            }
-            else
-            {
-                std::cout << "Cubemap texture failed to load at path: " << faces[i] << std::endl;
-                stbi_image_free(data);
-            }
+            glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + i, 0, GL_RGBA, 1, 1, 0, GL_RGBA, GL_UNSIGNED_BYTE, placeholder);
         }
         glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
         glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
@@ -36,15 +24,46 @@ namespace engine {
         glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
 	}
 
+	Cubemap::Cubemap(std::vector<std::string> faces, Mesh* mesh) : Cubemap(mesh)
+	{
+        // Decode the faces on the loader workers, the uploads stay on this (GL) thread
+        std::vector<ImageData> images(faces.size());
+        AssetLoader::getInstance()->getWorkers()->parallelFor((int)faces.size(), [&faces, &images](const int i)
+        {
+            images[i] = ImageData::decode(faces[i]);
+        });
+        upload(images);
+        for (ImageData& image : images)
+        {
+            image.release();
+        }
+	}
+
 	Cubemap::~Cubemap()
 	{
 	}
 
+    void Cubemap::upload(const std::vector<ImageData>& faces)
+    {
+        RenderState::getInstance()->bindTexture(GL_TEXTURE_CUBE_MAP, m_cubemap_id);
+        for (unsigned int i = 0; i < faces.size(); i++)
+        {
+            if (faces[i].isValid())
+            {
+                glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + i, 0, GL_RGBA, faces[i].width, faces[i].height, 0, GL_RGBA, GL_UNSIGNED_BYTE, faces[i].pixels);
+            }
+            else
+            {
+                std::cout << "Cubemap face " << i << " failed to load, keeping the placeholder" << std::endl;
+            }
+        }
+        loaded = true;
+    }
+
 	void Cubemap::Bind(unsigned int unit)
 	{
 		assert(unit >= 0 && unit <= 31);
-		glActiveTexture(GL_TEXTURE0 + unit);
-		glBindTexture(GL_TEXTURE_CUBE_MAP, m_cubemap_id);
+		RenderState::getInstance()->bindTexture(unit, GL_TEXTURE_CUBE_MAP, m_cubemap_id);
 	}
 
     void Cubemap::drawCubemap()
@@ -60,4 +79,4 @@ namespace engine {
 	}
 
     
-}
\ No newline at end of file
+}
@@ -0,0 +1,71 @@
+#include "textures/ImageData.h"
+#include <algorithm>
+#include <cstdlib>
+#include <iostream>
+#define STB_IMAGE_IMPLEMENTATION
+#include "ImageLoader.h"
+
+namespace engine {
+
+	void ImageData::release() {
+		if (pixels != nullptr) {
+			stbi_image_free(pixels);
+			pixels = nullptr;
+		}
+	}
+
+	ImageData ImageData::downsample() const {
+		ImageData level;
+		level.width = std::max(1, width / 2);
+		level.height = std::max(1, height / 2);
+		// Allocated with malloc, as stb_image does, so release() frees both alike
+		level.pixels = (unsigned char*)std::malloc((size_t)level.width * level.height * 4);
+		for (int y = 0; y < level.height; y++) {
+			const int y0 = std::min(y * 2, height - 1), y1 = std::min(y * 2 + 1, height - 1);
+			for (int x = 0; x < level.width; x++) {
+				const int x0 = std::min(x * 2, width - 1), x1 = std::min(x * 2 + 1, width - 1);
+				for (int c = 0; c < 4; c++) {
+					const int sum = pixels[((size_t)y0 * width + x0) * 4 + c] + pixels[((size_t)y0 * width + x1) * 4 + c]
+						+ pixels[((size_t)y1 * width + x0) * 4 + c] + pixels[((size_t)y1 * width + x1) * 4 + c];
+					level.pixels[((size_t)y * level.width + x) * 4 + c] = (unsigned char)((sum + 2) / 4);
+				}
+			}
+		}
+		return level;
+	}
+
+	ImageData ImageData::resize(const int newWidth, const int newHeight) const {
+		ImageData image;
+		image.width = newWidth;
+		image.height = newHeight;
+		image.pixels = (unsigned char*)std::malloc((size_t)newWidth * newHeight * 4);
+		for (int y = 0; y < newHeight; y++) {
+			// Sample at the texel centers, clamping at the edges
+			const float sy = std::max(0.0f, (y + 0.5f) * height / newHeight - 0.5f);
+			const int y0 = std::min((int)sy, height - 1), y1 = std::min(y0 + 1, height - 1);
+			const float fy = sy - y0;
+			for (int x = 0; x < newWidth; x++) {
+				const float sx = std::max(0.0f, (x + 0.5f) * width / newWidth - 0.5f);
+				const int x0 = std::min((int)sx, width - 1), x1 = std::min(x0 + 1, width - 1);
+				const float fx = sx - x0;
+				for (int c = 0; c < 4; c++) {
+					const float top = pixels[((size_t)y0 * width + x0) * 4 + c] * (1 - fx) + pixels[((size_t)y0 * width + x1) * 4 + c] * fx;
+					const float bottom = pixels[((size_t)y1 * width + x0) * 4 + c] * (1 - fx) + pixels[((size_t)y1 * width + x1) * 4 + c] * fx;
+					image.pixels[((size_t)y * newWidth + x) * 4 + c] = (unsigned char)(top * (1 - fy) + bottom * fy + 0.5f);
+				}
+			}
+		}
+		return image;
+	}
+
+	ImageData ImageData::decode(const std::string fileName) {
+		ImageData image;
+		int nrChannels;
+		image.pixels = stbi_load(fileName.c_str(), &image.width, &image.height, &nrChannels, 4);
+		if (image.pixels == NULL) {
+			std::cerr << "Failed to load image " << fileName << std::endl;
+		}
+		return image;
+	}
+
+}
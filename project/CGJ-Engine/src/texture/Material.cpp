@@ -1,4 +1,5 @@
 #include "textures/Material.h"
+#include "render/RenderState.h"
 namespace engine {
 
 	Material::Material() {
@@ -17,11 +18,34 @@ namespace engine {
 		this->materialType = type;
 	}
 
+	Material::~Material() {
+		if (ubo != 0) {
+			glDeleteBuffers(1, &ubo);
+			RenderState::getInstance()->forgetBuffer(ubo);
+		}
+	}
+
 	bool Material::isTranslucent() {
 		if (transparency < 1.0f) return true;
 		else return false;
 	}
 
+	void Material::bind(GLuint bindingPoint) {
+		if (ubo == 0) {
+			glGenBuffers(1, &ubo);
+			RenderState::getInstance()->bindBuffer(GL_UNIFORM_BUFFER, ubo);
+			glBufferData(GL_UNIFORM_BUFFER, sizeof(MaterialBlock), nullptr, GL_DYNAMIC_DRAW);
+			dirty = true;
+		}
+		if (dirty) {
+			MaterialBlock block = { ambientStrength, specularStrength, shininess, transparency, materialType, { 0, 0, 0 } };
+			RenderState::getInstance()->bindBuffer(GL_UNIFORM_BUFFER, ubo);
+			glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(MaterialBlock), &block);
+			dirty = false;
+		}
+		RenderState::getInstance()->bindBufferBase(GL_UNIFORM_BUFFER, bindingPoint, ubo);
+	}
+
 	Material* Material::parseMaterial() {
 		Material* m = new Material();
 		return m;
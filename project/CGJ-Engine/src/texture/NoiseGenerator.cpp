@@ -0,0 +1,404 @@
+#include "textures/NoiseGenerator.h"
+#include "loader/AssetLoader.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <functional>
+#include <iostream>
+
+// The stb tables are used by the vector kernels, this is the only translation unit with them
+#define STB_PERLIN_IMPLEMENTATION
+#include "PerlinNoise.h"
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#define NOISE_X86 1
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+#else
+#define NOISE_X86 0
+#endif
+
+// GCC and clang only emit AVX2 in functions marked for it, MSVC emits any intrinsic
+#if NOISE_X86 && (defined(__GNUC__) || defined(__clang__))
+#define NOISE_AVX2 __attribute__((target("avx2")))
+#else
+#define NOISE_AVX2
+#endif
+
+namespace engine {
+
+	/**
+	* For all implementations in this file, @see NoiseGenerator.h for details
+	*/
+
+	bool NoiseParams::operator==(const NoiseParams& other) const {
+		return resolution == other.resolution && seed == other.seed && octaves == other.octaves
+			&& lacunarity == other.lacunarity && gain == other.gain && depth == other.depth;
+	}
+
+	size_t NoiseParams::Hash::operator()(const NoiseParams& params) const {
+		size_t hash = 14695981039346656037ull;
+		const auto mix = [&hash](const size_t value) {
+			hash = (hash ^ value) * 1099511628211ull;
+		};
+		mix(std::hash<int>()(params.resolution));
+		mix(std::hash<int>()(params.seed));
+		mix(std::hash<int>()(params.octaves));
+		mix(std::hash<float>()(params.lacunarity));
+		mix(std::hash<float>()(params.gain));
+		mix(std::hash<float>()(params.depth));
+		return hash;
+	}
+
+	/**
+	* The stb permutation and gradient tables widened to 32 bits, the vector kernels gather them
+	*/
+	struct NoiseTables {
+		int32_t permutation[512];
+		int32_t gradient[512];
+		float gradientX[12], gradientY[12], gradientZ[12];
+
+		NoiseTables() {
+			for (int i = 0; i < 512; i++) {
+				permutation[i] = stb__perlin_randtab[i];
+				gradient[i] = stb__perlin_randtab_grad_idx[i];
+			}
+			// stb__perlin_grad basis
+			const float basis[12][3] = {
+				{ 1, 1, 0 }, { -1, 1, 0 }, { 1, -1, 0 }, { -1, -1, 0 },
+				{ 1, 0, 1 }, { -1, 0, 1 }, { 1, 0, -1 }, { -1, 0, -1 },
+				{ 0, 1, 1 }, { 0, -1, 1 }, { 0, 1, -1 }, { 0, -1, -1 }
+			};
+			for (int i = 0; i < 12; i++) {
+				gradientX[i] = basis[i][0];
+				gradientY[i] = basis[i][1];
+				gradientZ[i] = basis[i][2];
+			}
+		}
+
+		static const NoiseTables& get() {
+			static const NoiseTables tables;
+			return tables;
+		}
+	};
+
+	static void turbulenceScalar(const float x, const float* y, const int count, const NoiseParams& params, float* out) {
+		for (int i = 0; i < count; i++) {
+			float frequency = 1.0f, amplitude = 1.0f, sum = 0.0f;
+			for (int octave = 0; octave < params.octaves; octave++) {
+				const float r = stb_perlin_noise3_internal(x * frequency, y[i] * frequency, params.depth * frequency,
+					0, 0, 0, (unsigned char)(params.seed + octave)) * amplitude;
+				sum += (float)fabs(r);
+				frequency *= params.lacunarity;
+				amplitude *= params.gain;
+			}
+			out[i] = sum;
+		}
+	}
+
+#if NOISE_X86
+
+	////////////////////////////////////////////////////////////////////// SSE2
+
+	static inline __m128 easeSSE2(const __m128 a) {
+		const __m128 t = _mm_add_ps(_mm_mul_ps(_mm_sub_ps(_mm_mul_ps(a, _mm_set1_ps(6.0f)), _mm_set1_ps(15.0f)), a), _mm_set1_ps(10.0f));
+		return _mm_mul_ps(_mm_mul_ps(_mm_mul_ps(t, a), a), a);
+	}
+
+	static inline __m128 lerpSSE2(const __m128 a, const __m128 b, const __m128 t) {
+		return _mm_add_ps(a, _mm_mul_ps(_mm_sub_ps(b, a), t));
+	}
+
+	/**
+	* Floors to whole numbers, SSE2 has no floor instruction
+	*/
+	static inline __m128i floorSSE2(const __m128 x) {
+		const __m128i truncated = _mm_cvttps_epi32(x);
+		// All ones, so -1, where truncation went up
+		const __m128 above = _mm_cmplt_ps(x, _mm_cvtepi32_ps(truncated));
+		return _mm_add_epi32(truncated, _mm_castps_si128(above));
+	}
+
+	static inline __m128 gradientSSE2(const int32_t* index, const NoiseTables& t, const __m128 x, const __m128 y, const __m128 z) {
+		const __m128 gx = _mm_setr_ps(t.gradientX[index[0]], t.gradientX[index[1]], t.gradientX[index[2]], t.gradientX[index[3]]);
+		const __m128 gy = _mm_setr_ps(t.gradientY[index[0]], t.gradientY[index[1]], t.gradientY[index[2]], t.gradientY[index[3]]);
+		const __m128 gz = _mm_setr_ps(t.gradientZ[index[0]], t.gradientZ[index[1]], t.gradientZ[index[2]], t.gradientZ[index[3]]);
+		return _mm_add_ps(_mm_add_ps(_mm_mul_ps(gx, x), _mm_mul_ps(gy, y)), _mm_mul_ps(gz, z));
+	}
+
+	static inline __m128 noiseSSE2(__m128 x, __m128 y, __m128 z, const int seed, const NoiseTables& t) {
+		const __m128i px = floorSSE2(x), py = floorSSE2(y), pz = floorSSE2(z);
+		x = _mm_sub_ps(x, _mm_cvtepi32_ps(px));
+		y = _mm_sub_ps(y, _mm_cvtepi32_ps(py));
+		z = _mm_sub_ps(z, _mm_cvtepi32_ps(pz));
+		const __m128 u = easeSSE2(x), v = easeSSE2(y), w = easeSSE2(z);
+
+		// No gathers before AVX2, the hashing is done lane by lane
+		alignas(16) int32_t cx[4], cy[4], cz[4];
+		_mm_store_si128((__m128i*)cx, px);
+		_mm_store_si128((__m128i*)cy, py);
+		_mm_store_si128((__m128i*)cz, pz);
+		alignas(16) int32_t corners[8][4];
+		for (int lane = 0; lane < 4; lane++) {
+			const int x0 = cx[lane] & 255, x1 = (cx[lane] + 1) & 255;
+			const int y0 = cy[lane] & 255, y1 = (cy[lane] + 1) & 255;
+			const int z0 = cz[lane] & 255, z1 = (cz[lane] + 1) & 255;
+			const int r0 = t.permutation[x0 + seed], r1 = t.permutation[x1 + seed];
+			const int r00 = t.permutation[r0 + y0], r01 = t.permutation[r0 + y1];
+			const int r10 = t.permutation[r1 + y0], r11 = t.permutation[r1 + y1];
+			corners[0][lane] = t.gradient[r00 + z0];
+			corners[1][lane] = t.gradient[r00 + z1];
+			corners[2][lane] = t.gradient[r01 + z0];
+			corners[3][lane] = t.gradient[r01 + z1];
+			corners[4][lane] = t.gradient[r10 + z0];
+			corners[5][lane] = t.gradient[r10 + z1];
+			corners[6][lane] = t.gradient[r11 + z0];
+			corners[7][lane] = t.gradient[r11 + z1];
+		}
+		const __m128 one = _mm_set1_ps(1.0f);
+		const __m128 x1 = _mm_sub_ps(x, one), y1 = _mm_sub_ps(y, one), z1 = _mm_sub_ps(z, one);
+		const __m128 n00 = lerpSSE2(gradientSSE2(corners[0], t, x, y, z), gradientSSE2(corners[1], t, x, y, z1), w);
+		const __m128 n01 = lerpSSE2(gradientSSE2(corners[2], t, x, y1, z), gradientSSE2(corners[3], t, x, y1, z1), w);
+		const __m128 n10 = lerpSSE2(gradientSSE2(corners[4], t, x1, y, z), gradientSSE2(corners[5], t, x1, y, z1), w);
+		const __m128 n11 = lerpSSE2(gradientSSE2(corners[6], t, x1, y1, z), gradientSSE2(corners[7], t, x1, y1, z1), w);
+		return lerpSSE2(lerpSSE2(n00, n01, v), lerpSSE2(n10, n11, v), u);
+	}
+
+	static void turbulenceSSE2(const float x, const float* y, const int count, const NoiseParams& params, float* out) {
+		const NoiseTables& t = NoiseTables::get();
+		const __m128 sign = _mm_set1_ps(-0.0f);
+		int i = 0;
+		for (; i + 4 <= count; i += 4) {
+			const __m128 ys = _mm_loadu_ps(y + i);
+			__m128 sum = _mm_setzero_ps();
+			float frequency = 1.0f, amplitude = 1.0f;
+			for (int octave = 0; octave < params.octaves; octave++) {
+				const __m128 f = _mm_set1_ps(frequency);
+				const __m128 r = _mm_mul_ps(noiseSSE2(_mm_set1_ps(x * frequency), _mm_mul_ps(ys, f), _mm_set1_ps(params.depth * frequency),
+					(params.seed + octave) & 255, t), _mm_set1_ps(amplitude));
+				sum = _mm_add_ps(sum, _mm_andnot_ps(sign, r));
+				frequency *= params.lacunarity;
+				amplitude *= params.gain;
+			}
+			_mm_storeu_ps(out + i, sum);
+		}
+		turbulenceScalar(x, y + i, count - i, params, out + i);
+	}
+
+	////////////////////////////////////////////////////////////////////// AVX2
+
+	NOISE_AVX2 static inline __m256 easeAVX2(const __m256 a) {
+		const __m256 t = _mm256_add_ps(_mm256_mul_ps(_mm256_sub_ps(_mm256_mul_ps(a, _mm256_set1_ps(6.0f)), _mm256_set1_ps(15.0f)), a), _mm256_set1_ps(10.0f));
+		return _mm256_mul_ps(_mm256_mul_ps(_mm256_mul_ps(t, a), a), a);
+	}
+
+	NOISE_AVX2 static inline __m256 lerpAVX2(const __m256 a, const __m256 b, const __m256 t) {
+		return _mm256_add_ps(a, _mm256_mul_ps(_mm256_sub_ps(b, a), t));
+	}
+
+	/**
+	* Looks up 8 of the 12 gradient components, two in-register permutes instead of a gather
+	*/
+	NOISE_AVX2 static inline __m256 componentAVX2(const float* component, const __m256i index, const __m256i upper) {
+		const __m256 low = _mm256_permutevar8x32_ps(_mm256_loadu_ps(component), index);
+		const __m256 high = _mm256_permutevar8x32_ps(_mm256_loadu_ps(component + 4), _mm256_sub_epi32(index, _mm256_set1_epi32(4)));
+		return _mm256_blendv_ps(low, high, _mm256_castsi256_ps(upper));
+	}
+
+	NOISE_AVX2 static inline __m256 gradientAVX2(const __m256i index, const NoiseTables& t, const __m256 x, const __m256 y, const __m256 z) {
+		const __m256i upper = _mm256_cmpgt_epi32(index, _mm256_set1_epi32(7));
+		const __m256 gx = componentAVX2(t.gradientX, index, upper);
+		const __m256 gy = componentAVX2(t.gradientY, index, upper);
+		const __m256 gz = componentAVX2(t.gradientZ, index, upper);
+		return _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(gx, x), _mm256_mul_ps(gy, y)), _mm256_mul_ps(gz, z));
+	}
+
+	NOISE_AVX2 static inline __m256 noiseAVX2(__m256 x, __m256 y, __m256 z, const int seed, const NoiseTables& t) {
+		const __m256 fx = _mm256_floor_ps(x), fy = _mm256_floor_ps(y), fz = _mm256_floor_ps(z);
+		const __m256i px = _mm256_cvttps_epi32(fx), py = _mm256_cvttps_epi32(fy), pz = _mm256_cvttps_epi32(fz);
+		x = _mm256_sub_ps(x, fx);
+		y = _mm256_sub_ps(y, fy);
+		z = _mm256_sub_ps(z, fz);
+		const __m256 u = easeAVX2(x), v = easeAVX2(y), w = easeAVX2(z);
+
+		const __m256i mask = _mm256_set1_epi32(255), step = _mm256_set1_epi32(1);
+		const __m256i x0 = _mm256_and_si256(px, mask), x1 = _mm256_and_si256(_mm256_add_epi32(px, step), mask);
+		const __m256i y0 = _mm256_and_si256(py, mask), y1 = _mm256_and_si256(_mm256_add_epi32(py, step), mask);
+		const __m256i z0 = _mm256_and_si256(pz, mask), z1 = _mm256_and_si256(_mm256_add_epi32(pz, step), mask);
+		const __m256i offset = _mm256_set1_epi32(seed);
+		const __m256i r0 = _mm256_i32gather_epi32(t.permutation, _mm256_add_epi32(x0, offset), 4);
+		const __m256i r1 = _mm256_i32gather_epi32(t.permutation, _mm256_add_epi32(x1, offset), 4);
+		const __m256i r00 = _mm256_i32gather_epi32(t.permutation, _mm256_add_epi32(r0, y0), 4);
+		const __m256i r01 = _mm256_i32gather_epi32(t.permutation, _mm256_add_epi32(r0, y1), 4);
+		const __m256i r10 = _mm256_i32gather_epi32(t.permutation, _mm256_add_epi32(r1, y0), 4);
+		const __m256i r11 = _mm256_i32gather_epi32(t.permutation, _mm256_add_epi32(r1, y1), 4);
+
+		const __m256 one = _mm256_set1_ps(1.0f);
+		const __m256 xm = _mm256_sub_ps(x, one), ym = _mm256_sub_ps(y, one), zm = _mm256_sub_ps(z, one);
+		const __m256 n000 = gradientAVX2(_mm256_i32gather_epi32(t.gradient, _mm256_add_epi32(r00, z0), 4), t, x, y, z);
+		const __m256 n001 = gradientAVX2(_mm256_i32gather_epi32(t.gradient, _mm256_add_epi32(r00, z1), 4), t, x, y, zm);
+		const __m256 n010 = gradientAVX2(_mm256_i32gather_epi32(t.gradient, _mm256_add_epi32(r01, z0), 4), t, x, ym, z);
+		const __m256 n011 = gradientAVX2(_mm256_i32gather_epi32(t.gradient, _mm256_add_epi32(r01, z1), 4), t, x, ym, zm);
+		const __m256 n100 = gradientAVX2(_mm256_i32gather_epi32(t.gradient, _mm256_add_epi32(r10, z0), 4), t, xm, y, z);
+		const __m256 n101 = gradientAVX2(_mm256_i32gather_epi32(t.gradient, _mm256_add_epi32(r10, z1), 4), t, xm, y, zm);
+		const __m256 n110 = gradientAVX2(_mm256_i32gather_epi32(t.gradient, _mm256_add_epi32(r11, z0), 4), t, xm, ym, z);
+		const __m256 n111 = gradientAVX2(_mm256_i32gather_epi32(t.gradient, _mm256_add_epi32(r11, z1), 4), t, xm, ym, zm);
+		const __m256 n0 = lerpAVX2(lerpAVX2(n000, n001, w), lerpAVX2(n010, n011, w), v);
+		const __m256 n1 = lerpAVX2(lerpAVX2(n100, n101, w), lerpAVX2(n110, n111, w), v);
+		return lerpAVX2(n0, n1, u);
+	}
+
+	NOISE_AVX2 static void turbulenceAVX2(const float x, const float* y, const int count, const NoiseParams& params, float* out) {
+		const NoiseTables& t = NoiseTables::get();
+		const __m256 sign = _mm256_set1_ps(-0.0f);
+		int i = 0;
+		for (; i + 8 <= count; i += 8) {
+			const __m256 ys = _mm256_loadu_ps(y + i);
+			__m256 sum = _mm256_setzero_ps();
+			float frequency = 1.0f, amplitude = 1.0f;
+			for (int octave = 0; octave < params.octaves; octave++) {
+				const __m256 f = _mm256_set1_ps(frequency);
+				const __m256 r = _mm256_mul_ps(noiseAVX2(_mm256_set1_ps(x * frequency), _mm256_mul_ps(ys, f), _mm256_set1_ps(params.depth * frequency),
+					(params.seed + octave) & 255, t), _mm256_set1_ps(amplitude));
+				sum = _mm256_add_ps(sum, _mm256_andnot_ps(sign, r));
+				frequency *= params.lacunarity;
+				amplitude *= params.gain;
+			}
+			_mm256_storeu_ps(out + i, sum);
+		}
+		turbulenceSSE2(x, y + i, count - i, params, out + i);
+	}
+
+#endif
+
+	NoiseGenerator* NoiseGenerator::instance;
+
+	NoiseGenerator* NoiseGenerator::getInstance() {
+		if (instance == nullptr) {
+			instance = new NoiseGenerator();
+		}
+		return instance;
+	}
+
+	NoiseGenerator::NoiseGenerator() {
+		kernel = detectKernel();
+	}
+
+	NoiseGenerator::Kernel NoiseGenerator::detectKernel() {
+#if NOISE_X86 && defined(_MSC_VER)
+		int info[4];
+		__cpuid(info, 0);
+		const int highest = info[0];
+		__cpuid(info, 1);
+		// AVX state must also be saved by the OS
+		const bool avx = (info[2] & (1 << 27)) != 0 && (info[2] & (1 << 28)) != 0 && (_xgetbv(0) & 6) == 6;
+		if (avx && highest >= 7) {
+			__cpuidex(info, 7, 0);
+			if ((info[1] & (1 << 5)) != 0) {
+				return Kernel::AVX2;
+			}
+		}
+		return Kernel::SSE2;
+#elif NOISE_X86
+		if (__builtin_cpu_supports("avx2")) {
+			return Kernel::AVX2;
+		}
+		return __builtin_cpu_supports("sse2") ? Kernel::SSE2 : Kernel::SCALAR;
+#else
+		return Kernel::SCALAR;
+#endif
+	}
+
+	void NoiseGenerator::setKernel(const Kernel requested) {
+		const Kernel supported = detectKernel();
+		kernel = (int)requested <= (int)supported ? requested : supported;
+	}
+
+	const NoiseGenerator::Kernel NoiseGenerator::getKernel() const {
+		return kernel;
+	}
+
+	void NoiseGenerator::turbulenceRow(const float x, const float* y, const int count, const NoiseParams& params, float* out) const {
+		switch (kernel) {
+#if NOISE_X86
+		case Kernel::AVX2:
+			turbulenceAVX2(x, y, count, params, out);
+			return;
+		case Kernel::SSE2:
+			turbulenceSSE2(x, y, count, params, out);
+			return;
+#endif
+		default:
+			turbulenceScalar(x, y, count, params, out);
+			return;
+		}
+	}
+
+	NoiseGenerator::Image NoiseGenerator::createImage(const NoiseParams& params) const {
+		const int resolution = params.resolution;
+		std::shared_ptr<std::vector<GLubyte>> texels = std::make_shared<std::vector<GLubyte>>((size_t)resolution * resolution * 4);
+		GLubyte* pixels = texels->data();
+		const int tiles = (resolution + TILE - 1) / TILE;
+
+		const std::function<void(int)> fillTile = [this, &params, resolution, tiles, pixels](const int tile) {
+			const int firstRow = (tile / tiles) * TILE, firstColumn = (tile % tiles) * TILE;
+			const int rows = std::min(TILE, resolution - firstRow), columns = std::min(TILE, resolution - firstColumn);
+			float y[TILE], values[TILE];
+			for (int column = 0; column < columns; column++) {
+				y[column] = (float)(firstColumn + column) / resolution;
+			}
+			for (int row = firstRow; row < firstRow + rows; row++) {
+				turbulenceRow((float)row / resolution, y, columns, params, values);
+				GLubyte* texel = &pixels[((size_t)row * resolution + firstColumn) * 4];
+				for (int column = 0; column < columns; column++, texel += 4) {
+					const GLubyte value = (GLubyte)std::min(255, std::max(0, (int)(values[column] * 255)));
+					texel[0] = value;
+					texel[1] = value;
+					texel[2] = 255;
+					texel[3] = 0;
+				}
+			}
+		};
+		AssetLoader::getInstance()->getWorkers()->parallelFor(tiles * tiles, fillTile);
+		return texels;
+	}
+
+	NoiseGenerator::Image NoiseGenerator::generate(const NoiseParams& requested) {
+		NoiseParams params = requested;
+		params.resolution = std::max(1, params.resolution);
+		params.octaves = std::max(1, std::min(params.octaves, 32));
+
+		std::promise<Image> promise;
+		std::shared_future<Image> image;
+		bool owner = false;
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			std::unordered_map<NoiseParams, std::shared_future<Image>, NoiseParams::Hash>::iterator it = images.find(params);
+			if (it != images.end()) {
+				image = it->second;
+			}
+			else {
+				image = promise.get_future().share();
+				images[params] = image;
+				owner = true;
+			}
+		}
+		if (owner) {
+			const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+			promise.set_value(createImage(params));
+			const char* names[] = { "scalar", "SSE2", "AVX2" };
+			std::cout << "[NoiseGenerator] " << params.resolution << "x" << params.resolution << " noise, " << params.octaves << " octaves in "
+				<< std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count()
+				<< " ms (" << names[(int)kernel] << ")" << std::endl;
+		}
+		return image.get();
+	}
+
+	void NoiseGenerator::clear() {
+		std::lock_guard<std::mutex> lock(mutex);
+		images.clear();
+	}
+
+}
@@ -1,66 +1,69 @@
 #include "textures/PerlinTexture.h"
+#include "render/RenderState.h"
 #include <cassert>
+#include <cstdlib>
+#include <cstring>
 #include <iostream>
-
-#define STB_PERLIN_IMPLEMENTATION
 #include "PerlinNoise.h"
 
-GLubyte imageData[imageWidth][imageWidth][4];
-
 namespace engine {
-	PerlinTexture::PerlinTexture()
+	PerlinTexture::PerlinTexture(const NoiseParams& params) : params(params)
 	{
-		glGenTextures(1, &m_texture_id);
-		glBindTexture(GL_TEXTURE_2D, m_texture_id);
-		
-		createImage();
+		const GLubyte placeholder[4] = { 128, 128, 255, 0 };
 
-		glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, imageWidth, imageWidth, 0, GL_RGBA, GL_UNSIGNED_BYTE, imageData);
+		glGenTextures(1, &m_texture_id);
+		RenderState::getInstance()->bindTexture(GL_TEXTURE_2D, m_texture_id);
 
 		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
 		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
 		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
 		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
 
-		glGenerateMipmap(GL_TEXTURE_2D);
-		
+		glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, 1, 1, 0, GL_RGBA, GL_UNSIGNED_BYTE, placeholder);
 	}
 	
 	void PerlinTexture::createImage() {
-		bool mid = false;
-		for (int row = 0; row < imageWidth; row++) {
-			for (int col = 0; col < imageWidth; col++) {
-				float dx = (float) row / imageWidth;
-				float dy = (float) col / imageWidth;
-				float noise = stb_perlin_turbulence_noise3(dx, dy, 3.2f, 2.0f, 0.5f, 6);
-				
-				int colorValue = (int)(noise * 255);
+		imageData = NoiseGenerator::getInstance()->generate(params);
+	}
+
+	ImageData PerlinTexture::createImageData(const NoiseParams& params) {
+		NoiseGenerator::Image noise = NoiseGenerator::getInstance()->generate(params);
+		ImageData image;
+		image.width = params.resolution;
+		image.height = params.resolution;
+		image.pixels = (unsigned char*)malloc(noise->size());
+		memcpy(image.pixels, noise->data(), noise->size());
+		return image;
+	}
+
+	void PerlinTexture::upload() {
+		RenderState::getInstance()->bindTexture(GL_TEXTURE_2D, m_texture_id);
+		glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, params.resolution, params.resolution, 0, GL_RGBA, GL_UNSIGNED_BYTE, imageData->data());
+		glGenerateMipmap(GL_TEXTURE_2D);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
 
-				imageData[row][col][0] = colorValue;
-				imageData[row][col][1] = colorValue;
-				imageData[row][col][2] = colorValue;
-				imageData[row][col][2] = 255;
-			}
-		}
-		
+		imageData.reset();
+		loaded = true;
 	}
 
 	PerlinTexture::~PerlinTexture()
 	{
 		glDeleteTextures(1, &m_texture_id);
+		RenderState::getInstance()->forgetTexture(m_texture_id);
 	}
 
 	PerlinTexture* PerlinTexture::parsePerlin()
 	{
 		PerlinTexture* t = new PerlinTexture();
+		t->createImage();
+		t->upload();
 		return t;
 	}
 
 	void PerlinTexture::Bind(unsigned int unit)
 	{
 		assert(unit >= 0 && unit <= 31);
-		glActiveTexture(GL_TEXTURE0 + unit);
-		glBindTexture(GL_TEXTURE_2D, m_texture_id);
+		RenderState::getInstance()->bindTexture(unit, GL_TEXTURE_2D, m_texture_id);
 	}
 
 	void PerlinTexture::testPerlin(float x, float y)
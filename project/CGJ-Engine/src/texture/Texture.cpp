@@ -1,46 +1,91 @@
 #pragma once
 
 #include "textures/Texture.h"
+#include "render/RenderState.h"
+#include <algorithm>
 #include <cassert>
 #include <iostream>
-#define STB_IMAGE_IMPLEMENTATION
-#include "ImageLoader.h"
 
 namespace engine {
 
 	Texture::Texture() {
+		const GLubyte placeholder[4] = { 128, 128, 128, 255 };
 
-	}
-
-	Texture::Texture(const std::string fileName) {
 		glGenTextures(1, &m_texture_id);
-		glBindTexture(GL_TEXTURE_2D, m_texture_id);
-		
-		int width, height, nrChannels;
-		unsigned char* Imagedata = stbi_load(fileName.c_str(), &width, &height, &nrChannels, 4);
-		if(Imagedata == NULL)
-			std::cerr << "Failed to load texture" << fileName <<std::endl;
+		RenderState::getInstance()->bindTexture(GL_TEXTURE_2D, m_texture_id);
 
 		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
 		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
 		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
 		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
 
-		glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, Imagedata);
-		//glGenerateMipmap(GL_TEXTURE_2D);
-		
-		stbi_image_free(Imagedata);
+		glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, 1, 1, 0, GL_RGBA, GL_UNSIGNED_BYTE, placeholder);
+	}
+
+	Texture::Texture(const std::string fileName) : Texture() {
+		if (CompressedImage::isCompressedFile(fileName)) {
+			upload(CompressedImage::load(fileName));
+			return;
+		}
+		ImageData image = ImageData::decode(fileName);
+		upload(image);
+		image.release();
+	}
+
+	void Texture::upload(const ImageData& image) {
+		if (!image.isValid()) {
+			return;
+		}
+		RenderState::getInstance()->bindTexture(GL_TEXTURE_2D, m_texture_id);
+		glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, image.width, image.height, 0, GL_RGBA, GL_UNSIGNED_BYTE, image.pixels);
+		glGenerateMipmap(GL_TEXTURE_2D);
+
+		int maxLevel = 0;
+		for (int size = std::max(image.width, image.height); size > 1; size /= 2) {
+			maxLevel++;
+		}
+		setMipmapFiltering(maxLevel);
+		loaded = true;
 	}
 
+	void Texture::upload(const CompressedImage& image) {
+		if (!image.isValid()) {
+			return;
+		}
+		if (image.format == BlockFormat::BC7 && !GLEW_ARB_texture_compression_bptc) {
+			std::cerr << "BC7 textures are not supported by this driver" << std::endl;
+			return;
+		}
+		RenderState::getInstance()->bindTexture(GL_TEXTURE_2D, m_texture_id);
+		for (size_t level = 0; level < image.levels.size(); level++) {
+			const CompressedImage::Level& data = image.levels[level];
+			glCompressedTexImage2D(GL_TEXTURE_2D, (GLint)level, image.getInternalFormat(), data.width, data.height, 0,
+				(GLsizei)data.data.size(), data.data.data());
+		}
+		// Containers without a full chain are still complete up to their last level
+		setMipmapFiltering((int)image.levels.size() - 1);
+		loaded = true;
+	}
+
+	void Texture::setMipmapFiltering(int maxLevel) {
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, 0);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, maxLevel);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+		if (GLEW_EXT_texture_filter_anisotropic) {
+			GLfloat maxAnisotropy;
+			glGetFloatv(GL_MAX_TEXTURE_MAX_ANISOTROPY_EXT, &maxAnisotropy);
+			glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_MAX_ANISOTROPY_EXT, std::min(8.0f, maxAnisotropy));
+		}
+	}
 
 	Texture::~Texture() {
 		glDeleteTextures(1, &m_texture_id);
+		RenderState::getInstance()->forgetTexture(m_texture_id);
 	}
 
 	void Texture::Bind(unsigned int unit){
 		assert(unit >= 0 && unit <= 31);
-		glActiveTexture(GL_TEXTURE0 + unit);
-		glBindTexture(GL_TEXTURE_2D, m_texture_id);
+		RenderState::getInstance()->bindTexture(unit, GL_TEXTURE_2D, m_texture_id);
 
 	}
 	Texture* Texture::parseTexture(const std::string fileName)
@@ -48,4 +93,4 @@ namespace engine {
 		Texture* t = new Texture(fileName);
 		return t;
 	}
-}
\ No newline at end of file
+}
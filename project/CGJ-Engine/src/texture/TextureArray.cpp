@@ -0,0 +1,105 @@
+#include "textures/TextureArray.h"
+#include "render/RenderState.h"
+#include <algorithm>
+#include <cassert>
+#include <iostream>
+
+namespace engine {
+
+	/**
+	* For all implementations in this file, @see TextureArray.h for details
+	*/
+
+	TextureArray::TextureArray(const int width, const int height, const int layers) {
+		this->width = width;
+		this->height = height;
+		this->layers = layers;
+		this->levels = 1;
+		for (int size = std::max(width, height); size > 1; size /= 2) {
+			levels++;
+		}
+
+		glGenTextures(1, &m_texture_id);
+		RenderState::getInstance()->bindTexture(GL_TEXTURE_2D_ARRAY, m_texture_id);
+		glTexStorage3D(GL_TEXTURE_2D_ARRAY, levels, GL_RGBA8, width, height, layers);
+
+		glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_REPEAT);
+		glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_REPEAT);
+		glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+		glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+		if (GLEW_EXT_texture_filter_anisotropic) {
+			GLfloat maxAnisotropy;
+			glGetFloatv(GL_MAX_TEXTURE_MAX_ANISOTROPY_EXT, &maxAnisotropy);
+			glTexParameterf(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAX_ANISOTROPY_EXT, std::min(8.0f, maxAnisotropy));
+		}
+
+		// Layers show a grey placeholder until their image is uploaded
+		ImageData placeholder;
+		placeholder.width = 1;
+		placeholder.height = 1;
+		unsigned char grey[4] = { 128, 128, 128, 255 };
+		placeholder.pixels = grey;
+		ImageData level = placeholder.resize(width, height);
+		for (int layer = 0; layer < layers; layer++) {
+			glTexSubImage3D(GL_TEXTURE_2D_ARRAY, 0, 0, 0, layer, width, height, 1, GL_RGBA, GL_UNSIGNED_BYTE, level.pixels);
+		}
+		level.release();
+		glGenerateMipmap(GL_TEXTURE_2D_ARRAY);
+	}
+
+	TextureArray::~TextureArray() {
+		glDeleteTextures(1, &m_texture_id);
+		RenderState::getInstance()->forgetTexture(m_texture_id);
+	}
+
+	int TextureArray::reserveLayer() {
+		if (used >= layers) {
+			std::cerr << "Texture array is full (" << layers << " layers)" << std::endl;
+			return -1;
+		}
+		return used++;
+	}
+
+	void TextureArray::upload(const int layer, const ImageData& image) {
+		if (layer < 0 || layer >= layers || !image.isValid()) {
+			return;
+		}
+		RenderState::getInstance()->bindTexture(GL_TEXTURE_2D_ARRAY, m_texture_id);
+
+		// Mip levels are built per layer on the CPU, glGenerateMipmap would rebuild every layer
+		ImageData level = image.width == width && image.height == height ? image : image.resize(width, height);
+		for (int i = 0; i < levels; i++) {
+			glTexSubImage3D(GL_TEXTURE_2D_ARRAY, i, 0, 0, layer, level.width, level.height, 1, GL_RGBA, GL_UNSIGNED_BYTE, level.pixels);
+			if (i + 1 < levels) {
+				ImageData next = level.downsample();
+				if (level.pixels != image.pixels) {
+					level.release();
+				}
+				level = next;
+			}
+		}
+		if (level.pixels != image.pixels) {
+			level.release();
+		}
+	}
+
+	int TextureArray::addLayer(const ImageData& image) {
+		int layer = reserveLayer();
+		upload(layer, image);
+		return layer;
+	}
+
+	void TextureArray::Bind(unsigned int unit) {
+		assert(unit >= 0 && unit <= 31);
+		RenderState::getInstance()->bindTexture(unit, GL_TEXTURE_2D_ARRAY, m_texture_id);
+	}
+
+	const int TextureArray::getLayers() const {
+		return layers;
+	}
+
+	const int TextureArray::getUsedLayers() const {
+		return used;
+	}
+
+}
@@ -0,0 +1,587 @@
+#include "textures/TextureCompression.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+
+namespace engine {
+
+	/**
+	* For all implementations in this file, @see TextureCompression.h for details
+	*/
+
+	// DDS constants (see the DirectX "DDS" programming guide)
+	static const uint32_t DDS_MAGIC = 0x20534444; // "DDS "
+	static const uint32_t DDS_HEADER_SIZE = 124;
+	static const uint32_t DDS_DX10_HEADER_SIZE = 20;
+	static const uint32_t DDSD_MIPMAPCOUNT = 0x20000;
+	static const uint32_t DDPF_FOURCC = 0x4;
+	static const uint32_t FOURCC_DXT1 = 0x31545844;
+	static const uint32_t FOURCC_DXT5 = 0x35545844;
+	static const uint32_t FOURCC_DX10 = 0x30315844;
+	static const uint32_t DXGI_FORMAT_BC1_UNORM = 71, DXGI_FORMAT_BC1_UNORM_SRGB = 72;
+	static const uint32_t DXGI_FORMAT_BC3_UNORM = 77, DXGI_FORMAT_BC3_UNORM_SRGB = 78;
+	static const uint32_t DXGI_FORMAT_BC7_UNORM = 98, DXGI_FORMAT_BC7_UNORM_SRGB = 99;
+
+	// KTX2 constants (see the Khronos KTX 2.0 specification)
+	static const unsigned char KTX2_IDENTIFIER[12] = { 0xAB, 0x4B, 0x54, 0x58, 0x20, 0x32, 0x30, 0xBB, 0x0D, 0x0A, 0x1A, 0x0A };
+	static const size_t KTX2_LEVEL_INDEX_OFFSET = 80;
+	static const uint32_t VK_FORMAT_BC1_RGB_UNORM_BLOCK = 131, VK_FORMAT_BC1_RGB_SRGB_BLOCK = 132;
+	static const uint32_t VK_FORMAT_BC1_RGBA_UNORM_BLOCK = 133, VK_FORMAT_BC1_RGBA_SRGB_BLOCK = 134;
+	static const uint32_t VK_FORMAT_BC3_UNORM_BLOCK = 137, VK_FORMAT_BC3_SRGB_BLOCK = 138;
+	static const uint32_t VK_FORMAT_BC7_UNORM_BLOCK = 145, VK_FORMAT_BC7_SRGB_BLOCK = 146;
+
+	// BC7 4 bit index interpolation weights
+	static const int BC7_WEIGHTS4[16] = { 0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64 };
+
+	static bool readFile(const std::string fileName, std::vector<unsigned char>& bytes) {
+		std::ifstream file(fileName, std::ios::binary | std::ios::ate);
+		if (!file.is_open()) {
+			return false;
+		}
+		std::streamsize size = file.tellg();
+		file.seekg(0, std::ios::beg);
+		bytes.resize((size_t)size);
+		return size == 0 || (bool)file.read((char*)bytes.data(), size);
+	}
+
+	static uint32_t readU32(const std::vector<unsigned char>& bytes, const size_t offset) {
+		uint32_t value;
+		std::memcpy(&value, &bytes[offset], sizeof(value));
+		return value;
+	}
+
+	static uint64_t readU64(const std::vector<unsigned char>& bytes, const size_t offset) {
+		uint64_t value;
+		std::memcpy(&value, &bytes[offset], sizeof(value));
+		return value;
+	}
+
+	static int levelSize(const int width, const int height, const int blockSize) {
+		return std::max(1, (width + 3) / 4) * std::max(1, (height + 3) / 4) * blockSize;
+	}
+
+	///////////////////////
+	// Compressed Images //
+	///////////////////////
+
+	GLenum CompressedImage::getInternalFormat() const {
+		switch (format) {
+		case BlockFormat::BC1: return srgb ? GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT1_EXT : GL_COMPRESSED_RGBA_S3TC_DXT1_EXT;
+		case BlockFormat::BC3: return srgb ? GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT5_EXT : GL_COMPRESSED_RGBA_S3TC_DXT5_EXT;
+		case BlockFormat::BC7: return srgb ? GL_COMPRESSED_SRGB_ALPHA_BPTC_UNORM : GL_COMPRESSED_RGBA_BPTC_UNORM;
+		default: return 0;
+		}
+	}
+
+	int CompressedImage::getBlockSize() const {
+		return format == BlockFormat::BC1 ? 8 : 16;
+	}
+
+	bool CompressedImage::isCompressedFile(const std::string fileName) {
+		size_t dot = fileName.find_last_of('.');
+		if (dot == std::string::npos) {
+			return false;
+		}
+		std::string extension = fileName.substr(dot + 1);
+		std::transform(extension.begin(), extension.end(), extension.begin(), ::tolower);
+		return extension == "dds" || extension == "ktx2";
+	}
+
+	CompressedImage CompressedImage::load(const std::string fileName) {
+		std::string lower = fileName;
+		std::transform(lower.begin(), lower.end(), lower.begin(), ::tolower);
+		if (lower.size() > 5 && lower.compare(lower.size() - 5, 5, ".ktx2") == 0) {
+			return loadKTX2(fileName);
+		}
+		return loadDDS(fileName);
+	}
+
+	CompressedImage CompressedImage::loadDDS(const std::string fileName) {
+		CompressedImage image;
+		std::vector<unsigned char> bytes;
+		if (!readFile(fileName, bytes) || bytes.size() < 4 + DDS_HEADER_SIZE ||
+			readU32(bytes, 0) != DDS_MAGIC || readU32(bytes, 4) != DDS_HEADER_SIZE) {
+			std::cerr << "Failed to load DDS texture " << fileName << std::endl;
+			return image;
+		}
+
+		const uint32_t flags = readU32(bytes, 4 + 4);
+		const int height = (int)readU32(bytes, 4 + 8);
+		const int width = (int)readU32(bytes, 4 + 12);
+		const uint32_t mipCount = readU32(bytes, 4 + 24);
+		const uint32_t pixelFlags = readU32(bytes, 4 + 72 + 4);
+		const uint32_t fourCC = readU32(bytes, 4 + 72 + 8);
+		size_t offset = 4 + DDS_HEADER_SIZE;
+
+		if (!(pixelFlags & DDPF_FOURCC)) {
+			std::cerr << "Unsupported uncompressed DDS texture " << fileName << std::endl;
+			return image;
+		}
+		if (fourCC == FOURCC_DXT1) {
+			image.format = BlockFormat::BC1;
+		}
+		else if (fourCC == FOURCC_DXT5) {
+			image.format = BlockFormat::BC3;
+		}
+		else if (fourCC == FOURCC_DX10 && bytes.size() >= offset + DDS_DX10_HEADER_SIZE) {
+			const uint32_t dxgiFormat = readU32(bytes, offset);
+			offset += DDS_DX10_HEADER_SIZE;
+			switch (dxgiFormat) {
+			case DXGI_FORMAT_BC1_UNORM: image.format = BlockFormat::BC1; break;
+			case DXGI_FORMAT_BC1_UNORM_SRGB: image.format = BlockFormat::BC1; image.srgb = true; break;
+			case DXGI_FORMAT_BC3_UNORM: image.format = BlockFormat::BC3; break;
+			case DXGI_FORMAT_BC3_UNORM_SRGB: image.format = BlockFormat::BC3; image.srgb = true; break;
+			case DXGI_FORMAT_BC7_UNORM: image.format = BlockFormat::BC7; break;
+			case DXGI_FORMAT_BC7_UNORM_SRGB: image.format = BlockFormat::BC7; image.srgb = true; break;
+			default:
+				std::cerr << "Unsupported DXGI format " << dxgiFormat << " in " << fileName << std::endl;
+				return image;
+			}
+		}
+		else {
+			std::cerr << "Unsupported DDS format in " << fileName << std::endl;
+			return image;
+		}
+
+		const uint32_t levels = (flags & DDSD_MIPMAPCOUNT) && mipCount > 0 ? mipCount : 1;
+		for (uint32_t i = 0; i < levels; i++) {
+			Level level;
+			level.width = std::max(1, width >> i);
+			level.height = std::max(1, height >> i);
+			const size_t size = levelSize(level.width, level.height, image.getBlockSize());
+			if (offset + size > bytes.size()) {
+				std::cerr << "Truncated DDS texture " << fileName << std::endl;
+				break;
+			}
+			level.data.assign(bytes.begin() + offset, bytes.begin() + offset + size);
+			offset += size;
+			image.levels.push_back(level);
+		}
+		return image;
+	}
+
+	CompressedImage CompressedImage::loadKTX2(const std::string fileName) {
+		CompressedImage image;
+		std::vector<unsigned char> bytes;
+		if (!readFile(fileName, bytes) || bytes.size() < KTX2_LEVEL_INDEX_OFFSET ||
+			std::memcmp(bytes.data(), KTX2_IDENTIFIER, sizeof(KTX2_IDENTIFIER)) != 0) {
+			std::cerr << "Failed to load KTX2 texture " << fileName << std::endl;
+			return image;
+		}
+
+		const uint32_t vkFormat = readU32(bytes, 12);
+		const int width = (int)readU32(bytes, 20);
+		const int height = (int)readU32(bytes, 24);
+		const uint32_t faceCount = readU32(bytes, 36);
+		const uint32_t levelCount = std::max(1u, readU32(bytes, 40));
+		const uint32_t supercompression = readU32(bytes, 44);
+
+		if (supercompression != 0 || faceCount != 1) {
+			std::cerr << "Unsupported supercompressed or cubemap KTX2 texture " << fileName << std::endl;
+			return image;
+		}
+		switch (vkFormat) {
+		case VK_FORMAT_BC1_RGB_UNORM_BLOCK:
+		case VK_FORMAT_BC1_RGBA_UNORM_BLOCK: image.format = BlockFormat::BC1; break;
+		case VK_FORMAT_BC1_RGB_SRGB_BLOCK:
+		case VK_FORMAT_BC1_RGBA_SRGB_BLOCK: image.format = BlockFormat::BC1; image.srgb = true; break;
+		case VK_FORMAT_BC3_UNORM_BLOCK: image.format = BlockFormat::BC3; break;
+		case VK_FORMAT_BC3_SRGB_BLOCK: image.format = BlockFormat::BC3; image.srgb = true; break;
+		case VK_FORMAT_BC7_UNORM_BLOCK: image.format = BlockFormat::BC7; break;
+		case VK_FORMAT_BC7_SRGB_BLOCK: image.format = BlockFormat::BC7; image.srgb = true; break;
+		default:
+			std::cerr << "Unsupported VkFormat " << vkFormat << " in " << fileName << std::endl;
+			return image;
+		}
+
+		if (bytes.size() < KTX2_LEVEL_INDEX_OFFSET + levelCount * 24) {
+			std::cerr << "Truncated KTX2 texture " << fileName << std::endl;
+			return image;
+		}
+		for (uint32_t i = 0; i < levelCount; i++) {
+			const size_t entry = KTX2_LEVEL_INDEX_OFFSET + i * 24;
+			const uint64_t offset = readU64(bytes, entry);
+			const uint64_t length = readU64(bytes, entry + 8);
+			Level level;
+			level.width = std::max(1, width >> i);
+			level.height = std::max(1, height >> i);
+			if (offset + length > bytes.size() || length < (uint64_t)levelSize(level.width, level.height, image.getBlockSize())) {
+				std::cerr << "Truncated KTX2 texture " << fileName << std::endl;
+				break;
+			}
+			level.data.assign(bytes.begin() + (size_t)offset, bytes.begin() + (size_t)(offset + length));
+			image.levels.push_back(level);
+		}
+		return image;
+	}
+
+	bool CompressedImage::saveDDS(const std::string fileName) const {
+		if (!isValid()) {
+			return false;
+		}
+		std::ofstream file(fileName, std::ios::binary);
+		if (!file.is_open()) {
+			std::cerr << "Failed to write DDS texture " << fileName << std::endl;
+			return false;
+		}
+
+		uint32_t header[1 + DDS_HEADER_SIZE / 4] = { 0 };
+		header[0] = DDS_MAGIC;
+		header[1] = DDS_HEADER_SIZE;
+		header[2] = 0x1 | 0x2 | 0x4 | 0x1000 | DDSD_MIPMAPCOUNT | 0x80000; // caps, height, width, pixel format, mips, linear size
+		header[3] = levels[0].height;
+		header[4] = levels[0].width;
+		header[5] = (uint32_t)levels[0].data.size();
+		header[7] = (uint32_t)levels.size();
+		header[1 + 18] = 32;
+		header[1 + 19] = DDPF_FOURCC;
+		header[1 + 26] = 0x1000 | (levels.size() > 1 ? 0x400000 | 0x8 : 0); // texture, mipmap, complex
+
+		const bool dx10 = format == BlockFormat::BC7 || srgb;
+		if (dx10) {
+			header[1 + 20] = FOURCC_DX10;
+		}
+		else {
+			header[1 + 20] = format == BlockFormat::BC1 ? FOURCC_DXT1 : FOURCC_DXT5;
+		}
+		file.write((const char*)header, sizeof(header));
+
+		if (dx10) {
+			uint32_t dxgiFormat;
+			switch (format) {
+			case BlockFormat::BC1: dxgiFormat = srgb ? DXGI_FORMAT_BC1_UNORM_SRGB : DXGI_FORMAT_BC1_UNORM; break;
+			case BlockFormat::BC3: dxgiFormat = srgb ? DXGI_FORMAT_BC3_UNORM_SRGB : DXGI_FORMAT_BC3_UNORM; break;
+			default: dxgiFormat = srgb ? DXGI_FORMAT_BC7_UNORM_SRGB : DXGI_FORMAT_BC7_UNORM; break;
+			}
+			const uint32_t dx10Header[5] = { dxgiFormat, 3, 0, 1, 0 }; // 2D texture, 1 array element
+			file.write((const char*)dx10Header, sizeof(dx10Header));
+		}
+
+		for (const Level& level : levels) {
+			file.write((const char*)level.data.data(), level.data.size());
+		}
+		return (bool)file;
+	}
+
+	/////////////////////
+	// Block Encoding  //
+	/////////////////////
+
+	/**
+	* Finds the principal axis of the texels with a few power iterations,
+	* returning the mean and the extremes of the texels projected onto it
+	*/
+	static void principalAxisExtremes(const unsigned char* rgba, const int channels, float* low, float* high) {
+		float mean[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+		for (int i = 0; i < 16; i++) {
+			for (int c = 0; c < channels; c++) {
+				mean[c] += rgba[i * 4 + c] / 16.0f;
+			}
+		}
+
+		float covariance[4][4] = { { 0.0f } };
+		for (int i = 0; i < 16; i++) {
+			float d[4];
+			for (int c = 0; c < channels; c++) {
+				d[c] = rgba[i * 4 + c] - mean[c];
+			}
+			for (int a = 0; a < channels; a++) {
+				for (int b = 0; b < channels; b++) {
+					covariance[a][b] += d[a] * d[b];
+				}
+			}
+		}
+
+		float axis[4] = { 1.0f, 1.0f, 1.0f, 1.0f };
+		for (int iteration = 0; iteration < 8; iteration++) {
+			float next[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+			float length = 0.0f;
+			for (int a = 0; a < channels; a++) {
+				for (int b = 0; b < channels; b++) {
+					next[a] += covariance[a][b] * axis[b];
+				}
+				length += next[a] * next[a];
+			}
+			if (length < 1e-8f) {
+				break;
+			}
+			length = 1.0f / std::sqrt(length);
+			for (int c = 0; c < channels; c++) {
+				axis[c] = next[c] * length;
+			}
+		}
+
+		float minProjection = 1e30f, maxProjection = -1e30f;
+		for (int i = 0; i < 16; i++) {
+			float projection = 0.0f;
+			for (int c = 0; c < channels; c++) {
+				projection += (rgba[i * 4 + c] - mean[c]) * axis[c];
+			}
+			minProjection = std::min(minProjection, projection);
+			maxProjection = std::max(maxProjection, projection);
+		}
+
+		float axisLength = 0.0f;
+		for (int c = 0; c < channels; c++) {
+			axisLength += axis[c] * axis[c];
+		}
+		if (axisLength < 1e-8f) {
+			minProjection = maxProjection = 0.0f;
+		}
+		for (int c = 0; c < channels; c++) {
+			low[c] = std::min(255.0f, std::max(0.0f, mean[c] + axis[c] * minProjection));
+			high[c] = std::min(255.0f, std::max(0.0f, mean[c] + axis[c] * maxProjection));
+		}
+	}
+
+	static uint16_t packRGB565(const float* color) {
+		const int r = (int)(color[0] * 31.0f / 255.0f + 0.5f);
+		const int g = (int)(color[1] * 63.0f / 255.0f + 0.5f);
+		const int b = (int)(color[2] * 31.0f / 255.0f + 0.5f);
+		return (uint16_t)((r << 11) | (g << 5) | b);
+	}
+
+	static void unpackRGB565(const uint16_t packed, int* color) {
+		const int r = (packed >> 11) & 31, g = (packed >> 5) & 63, b = packed & 31;
+		color[0] = (r << 3) | (r >> 2);
+		color[1] = (g << 2) | (g >> 4);
+		color[2] = (b << 3) | (b >> 2);
+	}
+
+	void TextureCompressor::encodeBC1Block(const unsigned char* rgba, unsigned char* out) {
+		float low[4], high[4];
+		principalAxisExtremes(rgba, 3, low, high);
+
+		uint16_t color0 = packRGB565(high), color1 = packRGB565(low);
+		if (color0 < color1) {
+			std::swap(color0, color1);
+		}
+
+		uint32_t indices = 0;
+		if (color0 != color1) {
+			int palette[4][3];
+			unpackRGB565(color0, palette[0]);
+			unpackRGB565(color1, palette[1]);
+			for (int c = 0; c < 3; c++) {
+				palette[2][c] = (2 * palette[0][c] + palette[1][c]) / 3;
+				palette[3][c] = (palette[0][c] + 2 * palette[1][c]) / 3;
+			}
+			for (int i = 0; i < 16; i++) {
+				int best = 0, bestError = 1 << 30;
+				for (int p = 0; p < 4; p++) {
+					int error = 0;
+					for (int c = 0; c < 3; c++) {
+						const int d = rgba[i * 4 + c] - palette[p][c];
+						error += d * d;
+					}
+					if (error < bestError) {
+						bestError = error;
+						best = p;
+					}
+				}
+				indices |= (uint32_t)best << (2 * i);
+			}
+		}
+
+		out[0] = color0 & 0xFF; out[1] = color0 >> 8;
+		out[2] = color1 & 0xFF; out[3] = color1 >> 8;
+		out[4] = indices & 0xFF; out[5] = (indices >> 8) & 0xFF;
+		out[6] = (indices >> 16) & 0xFF; out[7] = indices >> 24;
+	}
+
+	void TextureCompressor::encodeAlphaBlock(const unsigned char* rgba, unsigned char* out) {
+		int alpha0 = 0, alpha1 = 255;
+		for (int i = 0; i < 16; i++) {
+			alpha0 = std::max(alpha0, (int)rgba[i * 4 + 3]);
+			alpha1 = std::min(alpha1, (int)rgba[i * 4 + 3]);
+		}
+
+		uint64_t indices = 0;
+		if (alpha0 != alpha1) {
+			int palette[8] = { alpha0, alpha1 };
+			for (int p = 1; p < 7; p++) {
+				palette[p + 1] = ((7 - p) * alpha0 + p * alpha1) / 7;
+			}
+			for (int i = 0; i < 16; i++) {
+				int best = 0, bestError = 1 << 30;
+				for (int p = 0; p < 8; p++) {
+					const int error = std::abs(rgba[i * 4 + 3] - palette[p]);
+					if (error < bestError) {
+						bestError = error;
+						best = p;
+					}
+				}
+				indices |= (uint64_t)best << (3 * i);
+			}
+		}
+
+		out[0] = (unsigned char)alpha0;
+		out[1] = (unsigned char)alpha1;
+		for (int b = 0; b < 6; b++) {
+			out[2 + b] = (indices >> (8 * b)) & 0xFF;
+		}
+	}
+
+	/**
+	* Quantizes a BC7 mode 6 endpoint to 7 bits per channel plus a shared p-bit
+	*/
+	static void quantizeBC7Endpoint(const float* endpoint, int* quantized, int& pbit) {
+		float bestError = 1e30f;
+		for (int p = 0; p < 2; p++) {
+			int candidate[4];
+			float error = 0.0f;
+			for (int c = 0; c < 4; c++) {
+				candidate[c] = std::min(127, std::max(0, (int)std::floor((endpoint[c] - p) / 2.0f + 0.5f)));
+				const float d = ((candidate[c] << 1) | p) - endpoint[c];
+				error += d * d;
+			}
+			if (error < bestError) {
+				bestError = error;
+				pbit = p;
+				std::memcpy(quantized, candidate, sizeof(candidate));
+			}
+		}
+	}
+
+	void TextureCompressor::encodeBC7Block(const unsigned char* rgba, unsigned char* out) {
+		float low[4], high[4];
+		principalAxisExtremes(rgba, 4, low, high);
+
+		int endpoints[2][4], pbits[2];
+		quantizeBC7Endpoint(low, endpoints[0], pbits[0]);
+		quantizeBC7Endpoint(high, endpoints[1], pbits[1]);
+
+		int palette[16][4];
+		for (int c = 0; c < 4; c++) {
+			const int e0 = (endpoints[0][c] << 1) | pbits[0];
+			const int e1 = (endpoints[1][c] << 1) | pbits[1];
+			for (int p = 0; p < 16; p++) {
+				palette[p][c] = ((64 - BC7_WEIGHTS4[p]) * e0 + BC7_WEIGHTS4[p] * e1 + 32) >> 6;
+			}
+		}
+
+		int indices[16];
+		for (int i = 0; i < 16; i++) {
+			int best = 0, bestError = 1 << 30;
+			for (int p = 0; p < 16; p++) {
+				int error = 0;
+				for (int c = 0; c < 4; c++) {
+					const int d = rgba[i * 4 + c] - palette[p][c];
+					error += d * d;
+				}
+				if (error < bestError) {
+					bestError = error;
+					best = p;
+				}
+			}
+			indices[i] = best;
+		}
+
+		// The most significant bit of the anchor (first) index is implicitly 0
+		if (indices[0] & 8) {
+			std::swap(endpoints[0], endpoints[1]);
+			std::swap(pbits[0], pbits[1]);
+			for (int i = 0; i < 16; i++) {
+				indices[i] = 15 - indices[i];
+			}
+		}
+
+		std::memset(out, 0, 16);
+		int bit = 0;
+		auto put = [out, &bit](const int value, const int bits) {
+			for (int b = 0; b < bits; b++, bit++) {
+				if ((value >> b) & 1) {
+					out[bit >> 3] |= (unsigned char)(1 << (bit & 7));
+				}
+			}
+		};
+		put(1 << 6, 7);
+		for (int c = 0; c < 4; c++) {
+			put(endpoints[0][c], 7);
+			put(endpoints[1][c], 7);
+		}
+		put(pbits[0], 1);
+		put(pbits[1], 1);
+		put(indices[0], 3);
+		for (int i = 1; i < 16; i++) {
+			put(indices[i], 4);
+		}
+	}
+
+	CompressedImage::Level TextureCompressor::compressLevel(const ImageData& image, const BlockFormat format) {
+		CompressedImage::Level level;
+		level.width = image.width;
+		level.height = image.height;
+
+		const int blockSize = format == BlockFormat::BC1 ? 8 : 16;
+		const int blocksX = std::max(1, (image.width + 3) / 4), blocksY = std::max(1, (image.height + 3) / 4);
+		level.data.resize((size_t)blocksX * blocksY * blockSize);
+
+		for (int by = 0; by < blocksY; by++) {
+			for (int bx = 0; bx < blocksX; bx++) {
+				// Gather the block, clamping at the edges of non multiple of 4 levels
+				unsigned char block[64];
+				for (int y = 0; y < 4; y++) {
+					for (int x = 0; x < 4; x++) {
+						const int sx = std::min(bx * 4 + x, image.width - 1);
+						const int sy = std::min(by * 4 + y, image.height - 1);
+						std::memcpy(&block[(y * 4 + x) * 4], &image.pixels[((size_t)sy * image.width + sx) * 4], 4);
+					}
+				}
+				unsigned char* out = &level.data[((size_t)by * blocksX + bx) * blockSize];
+				switch (format) {
+				case BlockFormat::BC1:
+					encodeBC1Block(block, out);
+					break;
+				case BlockFormat::BC3:
+					encodeAlphaBlock(block, out);
+					encodeBC1Block(block, out + 8);
+					break;
+				case BlockFormat::BC7:
+					encodeBC7Block(block, out);
+					break;
+				}
+			}
+		}
+		return level;
+	}
+
+	CompressedImage TextureCompressor::compress(const ImageData& image, const BlockFormat format, const bool mipmaps) {
+		CompressedImage compressed;
+		compressed.format = format;
+		if (!image.isValid()) {
+			return compressed;
+		}
+
+		compressed.levels.push_back(compressLevel(image, format));
+		if (mipmaps) {
+			ImageData level = image;
+			while (level.width > 1 || level.height > 1) {
+				ImageData next = level.downsample();
+				if (level.pixels != image.pixels) {
+					level.release();
+				}
+				level = next;
+				compressed.levels.push_back(compressLevel(level, format));
+			}
+			if (level.pixels != image.pixels) {
+				level.release();
+			}
+		}
+		return compressed;
+	}
+
+	bool TextureCompressor::compressFile(const std::string source, const std::string destination, const BlockFormat format) {
+		ImageData image = ImageData::decode(source);
+		if (!image.isValid()) {
+			return false;
+		}
+		CompressedImage compressed = compress(image, format);
+		image.release();
+		return compressed.saveDDS(destination);
+	}
+
+}
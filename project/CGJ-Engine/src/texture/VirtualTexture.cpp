@@ -0,0 +1,335 @@
+#include "textures/VirtualTexture.h"
+#include "loader/AssetLoader.h"
+#include "render/RenderState.h"
+#include "PerlinNoise.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+
+namespace engine {
+
+	/**
+	* For all implementations in this file, @see VirtualTexture.h for details
+	*/
+
+	VirtualTexture::VirtualTexture(const int pages, const int slots, const NoiseType type, const NoiseParams& noise, const float period) {
+		this->type = type;
+		this->noise = noise;
+		this->period = period;
+		this->pages = 1;
+		this->levels = 1;
+		while (this->pages < pages && this->pages < 4096) {
+			this->pages *= 2;
+			levels++;
+		}
+
+		// The atlas must fit in one texture
+		GLint maxSize;
+		glGetIntegerv(GL_MAX_TEXTURE_SIZE, &maxSize);
+		const int slotSize = PAGE_SIZE + 2 * BORDER;
+		this->slots = std::max(1, std::min(slots, (int)maxSize / slotSize));
+		for (int slot = getCapacity() - 1; slot >= 0; slot--) {
+			freeSlots.push_back(slot);
+		}
+
+		RenderState* state = RenderState::getInstance();
+		glGenTextures(1, &atlas);
+		state->bindTexture(GL_TEXTURE_2D, atlas);
+		glTexStorage2D(GL_TEXTURE_2D, 1, GL_RGBA8, this->slots * slotSize, this->slots * slotSize);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+
+		// Integer textures are only complete with nearest filtering
+		glGenTextures(1, &pageTable);
+		state->bindTexture(GL_TEXTURE_2D, pageTable);
+		glTexStorage2D(GL_TEXTURE_2D, levels, GL_RGBA8UI, this->pages, this->pages);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST_MIPMAP_NEAREST);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+
+		entries.resize(levels);
+		for (int level = 0; level < levels; level++) {
+			const int count = this->pages >> level;
+			entries[level].assign((size_t)count * count * 4, 0);
+		}
+		updatePageTable();
+	}
+
+	VirtualTexture::~VirtualTexture() {
+		// The workers write into the futures, they must be done before the texture goes away
+		for (std::pair<const uint32_t, std::future<std::vector<GLubyte>>>& page : generating) {
+			page.second.wait();
+		}
+		glDeleteTextures(1, &atlas);
+		glDeleteTextures(1, &pageTable);
+		RenderState::getInstance()->forgetTexture(atlas);
+		RenderState::getInstance()->forgetTexture(pageTable);
+	}
+
+	uint32_t VirtualTexture::makeKey(const int level, const int x, const int y) {
+		// The top bit keeps every key different from 0
+		return (1u << 31) | ((uint32_t)level << 24) | ((uint32_t)y << 12) | (uint32_t)x;
+	}
+
+	void VirtualTexture::setSurface(const Vector3& origin, const Vector2& size) {
+		this->origin = origin;
+		this->size = size;
+	}
+
+	std::vector<GLubyte> VirtualTexture::generatePage(const uint32_t key) const {
+		const int level = (key >> 24) & 127;
+		const int column = key & 4095, row = (key >> 12) & 4095;
+		const int side = PAGE_SIZE + 2 * BORDER;
+		// Texels across the surface at the finest level, and finest texels per texel of this level
+		const float virtualSize = (float)pages * PAGE_SIZE;
+		const float scale = (float)(1 << level);
+
+		// Octaves with cells smaller than two texels of this level would only alias
+		const int maxOctaves = std::max(1, std::min(noise.octaves, 32));
+		int octaves = 0;
+		int wraps[32];
+		for (float cells = period; octaves < maxOctaves; octaves++, cells *= noise.lacunarity) {
+			if (octaves > 0 && cells * scale / virtualSize > 0.5f) {
+				break;
+			}
+			// Whole numbers of cells repeat at the edges of the surface
+			const float whole = std::floor(cells + 0.5f);
+			wraps[octaves] = std::fabs(cells - whole) < 1e-3f && whole >= 1.0f && whole <= 256.0f ? (int)whole : 0;
+		}
+
+		std::vector<GLubyte> texels((size_t)side * side * 4);
+		for (int j = 0; j < side; j++) {
+			const float v = ((row * PAGE_SIZE + j - BORDER) + 0.5f) * scale / virtualSize;
+			for (int i = 0; i < side; i++) {
+				const float u = ((column * PAGE_SIZE + i - BORDER) + 0.5f) * scale / virtualSize;
+				float frequency = 1.0f, amplitude = type == NoiseType::RIDGE ? 0.5f : 1.0f;
+				float sum = 0.0f, prev = 1.0f;
+				for (int octave = 0; octave < octaves; octave++) {
+					const float r = stb_perlin_noise3_wrap_nonpow2(u * period * frequency, v * period * frequency, noise.depth * frequency,
+						wraps[octave], wraps[octave], 0, (unsigned char)(noise.seed + octave));
+					switch (type) {
+					case NoiseType::FBM:
+						sum += r * amplitude;
+						break;
+					case NoiseType::RIDGE: {
+						// stb_perlin_ridge_noise3 with an offset of 1
+						const float ridge = (1.0f - (float)fabs(r)) * (1.0f - (float)fabs(r));
+						sum += ridge * amplitude * prev;
+						prev = ridge;
+						break;
+					}
+					default:
+						sum += (float)fabs(r * amplitude);
+						break;
+					}
+					frequency *= noise.lacunarity;
+					amplitude *= noise.gain;
+				}
+				if (type == NoiseType::FBM) {
+					sum = sum * 0.5f + 0.5f;
+				}
+				const GLubyte value = (GLubyte)std::min(255, std::max(0, (int)(sum * 255)));
+				GLubyte* texel = &texels[((size_t)j * side + i) * 4];
+				texel[0] = value;
+				texel[1] = value;
+				texel[2] = value;
+				texel[3] = 255;
+			}
+		}
+		return texels;
+	}
+
+	void VirtualTexture::collectPages(const int level, const int x, const int y, const Matrix4& viewProjection, const Vector3& eye,
+		const float pixelScale, const bool orthographic, std::vector<uint32_t>& requests) {
+		const int count = pages >> level;
+		const float width = size.x / count, depth = size.y / count;
+		const float left = origin.x + width * x, front = origin.z + depth * y;
+
+		// Outside the frustum when every corner is outside the same clip plane
+		Vector4 corners[4];
+		for (int i = 0; i < 4; i++) {
+			corners[i] = viewProjection * Vector4(left + width * (i & 1), origin.y, front + depth * (i >> 1), 1.0f);
+		}
+		for (int plane = 0; plane < 6; plane++) {
+			const int axis = plane / 2;
+			const float sign = plane % 2 == 0 ? 1.0f : -1.0f;
+			bool outside = true;
+			for (int i = 0; i < 4 && outside; i++) {
+				const float coordinates[3] = { corners[i].x, corners[i].y, corners[i].z };
+				outside = sign * coordinates[axis] > corners[i].w;
+			}
+			if (outside) {
+				return;
+			}
+		}
+
+		const uint32_t key = makeKey(level, x, y);
+		// Coarser pages stay resident as fallbacks of the ones streaming in
+		if (resident.count(key) != 0) {
+			touch(key);
+		}
+
+		// The pixel size at the closest point of the page
+		float pixel = pixelScale;
+		if (!orthographic) {
+			const float closestX = std::max(left, std::min(eye.x, left + width));
+			const float closestZ = std::max(front, std::min(eye.z, front + depth));
+			const Vector3 offset = eye - Vector3(closestX, origin.y, closestZ);
+			pixel *= std::max(offset.length(), 1e-3f);
+		}
+		const float texel = std::max(width, depth) / PAGE_SIZE;
+		if (level > 0 && texel > pixel) {
+			for (int child = 0; child < 4; child++) {
+				collectPages(level - 1, x * 2 + (child & 1), y * 2 + (child >> 1), viewProjection, eye, pixelScale, orthographic, requests);
+			}
+			return;
+		}
+		requests.push_back(key);
+	}
+
+	void VirtualTexture::touch(const uint32_t key) {
+		Resident& page = resident[key];
+		if (page.lastUsed != frame) {
+			page.lastUsed = frame;
+			touched++;
+		}
+		lru.splice(lru.begin(), lru, page.position);
+	}
+
+	bool VirtualTexture::place(const uint32_t key, const std::vector<GLubyte>& texels) {
+		int slot;
+		if (!freeSlots.empty()) {
+			slot = freeSlots.back();
+			freeSlots.pop_back();
+		}
+		else {
+			if (lru.empty() || resident[lru.back()].lastUsed == frame) {
+				return false;
+			}
+			const uint32_t victim = lru.back();
+			slot = resident[victim].slot;
+			lru.pop_back();
+			resident.erase(victim);
+			evicted++;
+		}
+
+		const int slotSize = PAGE_SIZE + 2 * BORDER;
+		RenderState::getInstance()->bindTexture(GL_TEXTURE_2D, atlas);
+		glTexSubImage2D(GL_TEXTURE_2D, 0, (slot % slots) * slotSize, (slot / slots) * slotSize, slotSize, slotSize,
+			GL_RGBA, GL_UNSIGNED_BYTE, texels.data());
+
+		lru.push_front(key);
+		Resident page = { slot, frame, lru.begin() };
+		resident[key] = page;
+		touched++;
+		tableDirty = true;
+		return true;
+	}
+
+	void VirtualTexture::updatePageTable() {
+		RenderState::getInstance()->bindTexture(GL_TEXTURE_2D, pageTable);
+		for (int level = levels - 1; level >= 0; level--) {
+			const int count = pages >> level;
+			for (int y = 0; y < count; y++) {
+				for (int x = 0; x < count; x++) {
+					GLubyte* entry = &entries[level][((size_t)y * count + x) * 4];
+					std::unordered_map<uint32_t, Resident>::const_iterator it = resident.find(makeKey(level, x, y));
+					if (it != resident.end()) {
+						entry[0] = (GLubyte)(it->second.slot % slots);
+						entry[1] = (GLubyte)(it->second.slot / slots);
+						entry[2] = (GLubyte)level;
+						entry[3] = 1;
+					}
+					else if (level + 1 < levels) {
+						// The parent entry is already resolved to the nearest resident ancestor
+						const GLubyte* parent = &entries[level + 1][((size_t)(y / 2) * (count / 2) + x / 2) * 4];
+						std::copy(parent, parent + 4, entry);
+					}
+					else {
+						std::fill(entry, entry + 4, (GLubyte)0);
+					}
+				}
+			}
+			glTexSubImage2D(GL_TEXTURE_2D, level, 0, 0, count, count, GL_RGBA_INTEGER, GL_UNSIGNED_BYTE, entries[level].data());
+		}
+		tableDirty = false;
+	}
+
+	void VirtualTexture::update(Camera* camera, const int viewportHeight) {
+		frame++;
+		touched = 0;
+
+		const Matrix4 viewProjection = camera->getProjectionMatrix() * camera->getViewMatrix();
+		const bool orthographic = camera->isOrthographic();
+		const float pixelScale = orthographic ? 2.0f * camera->getOrthographicExtent().y / viewportHeight
+			: 2.0f * std::tan(Math::angleToRad(camera->getFov() / 2.0f)) / viewportHeight;
+		std::vector<uint32_t> requests;
+		collectPages(levels - 1, 0, 0, viewProjection, camera->getEye(), pixelScale, orthographic, requests);
+
+		// Finished pages first, they may take the slots of pages no longer needed
+		int uploads = 0;
+		for (std::unordered_map<uint32_t, std::future<std::vector<GLubyte>>>::iterator it = generating.begin();
+			it != generating.end() && uploads < MAX_UPLOADS;) {
+			if (it->second.wait_for(std::chrono::seconds(0)) != std::future_status::ready) {
+				++it;
+				continue;
+			}
+			const std::vector<GLubyte> texels = it->second.get();
+			generated++;
+			place(it->first, texels);
+			uploads++;
+			it = generating.erase(it);
+		}
+
+		// Coarse pages first, they cover the most of the surface while the fine ones stream in
+		std::stable_sort(requests.begin(), requests.end(), [](const uint32_t a, const uint32_t b) {
+			return ((a >> 24) & 127) > ((b >> 24) & 127);
+		});
+		ThreadPool* workers = AssetLoader::getInstance()->getWorkers();
+		for (const uint32_t key : requests) {
+			// Every slot is already needed this frame, more pages would only evict each other
+			if ((int)generating.size() >= MAX_GENERATING || touched + (int)generating.size() >= getCapacity()) {
+				break;
+			}
+			if (resident.count(key) != 0 || generating.count(key) != 0) {
+				continue;
+			}
+			generating[key] = workers->submit([this, key]() {
+				return generatePage(key);
+			});
+		}
+
+		if (tableDirty) {
+			updatePageTable();
+		}
+	}
+
+	void VirtualTexture::Bind(ShaderProgram* program, const unsigned int unit) {
+		RenderState* state = RenderState::getInstance();
+		state->bindTexture(unit, GL_TEXTURE_2D, atlas);
+		state->bindTexture(unit + 1, GL_TEXTURE_2D, pageTable);
+		glUniform1i(program->getUniform("pageAtlas"), unit);
+		glUniform1i(program->getUniform("pageTable"), unit + 1);
+		glUniform4f(program->getUniform("virtualSurface"), origin.x, origin.z, 1.0f / size.x, 1.0f / size.y);
+		glUniform4f(program->getUniform("virtualLayout"), (float)pages, (float)PAGE_SIZE, (float)BORDER,
+			(float)(slots * (PAGE_SIZE + 2 * BORDER)));
+	}
+
+	const int VirtualTexture::getResidentPages() const {
+		return (int)resident.size();
+	}
+
+	const int VirtualTexture::getCapacity() const {
+		return slots * slots;
+	}
+
+	const unsigned int VirtualTexture::getGeneratedPages() const {
+		return generated;
+	}
+
+	const unsigned int VirtualTexture::getEvictedPages() const {
+		return evicted;
+	}
+
+}
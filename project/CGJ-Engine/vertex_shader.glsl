@@ -1,4 +1,4 @@
-#version 330 core
+#version 430 core
 
 in vec3 in_Position;
 in vec2 in_TexCoord;
@@ -10,26 +10,70 @@ out vec2 ex_TexCoord;
 out vec4 ex_Color;
 out vec3 ex_Normal;
 out vec3 FragPos;
-out vec4 FragPosLightSpace;
 
+// Same depth as the DEPTH_ONLY pre-pass, the opaque draws are tested with GL_EQUAL
+invariant gl_Position;
+
+#ifdef INDIRECT
+struct DrawParameters {
+	mat4 modelMatrix;
+	vec4 color;
+	int textureLayer;
+};
+
+layout(std430) readonly buffer DrawBlock {
+	DrawParameters draws[];
+};
+
+in uint in_DrawId;
+
+flat out int ex_TextureLayer;
+#elif defined(INSTANCED)
+in mat4 in_ModelMatrix;
+in vec4 in_InstanceColor;
+in int in_TextureLayer;
+
+flat out int ex_TextureLayer;
+#else
 uniform vec4 Color;
 
 uniform mat4 ModelMatrix;
+#endif
 
 uniform SharedMatrices {
 	mat4 ViewMatrix;
 	mat4 ProjectionMatrix;
 };
 
-uniform mat4 lightSpaceMatrix;
+#include "frame_block.glsl"
+
+#ifdef SKINNED
+#include "skin_block.glsl"
+#endif
 
 void main(void) {
-	gl_Position = ProjectionMatrix * ViewMatrix * ModelMatrix * vec4(in_Position, 1);
+#ifdef INDIRECT
+	mat4 world = draws[in_DrawId].modelMatrix;
+	vec4 Color = draws[in_DrawId].color;
+	ex_TextureLayer = draws[in_DrawId].textureLayer;
+#elif defined(INSTANCED)
+	mat4 world = in_ModelMatrix;
+	vec4 Color = in_InstanceColor;
+	ex_TextureLayer = in_TextureLayer;
+#else
+	mat4 world = ModelMatrix;
+#endif
+#ifdef SKINNED
+	// From the bind pose to the animated one, same as the depth programs
+	world = world * skinMatrix();
+#endif
+	gl_Position = ProjectionMatrix * ViewMatrix * world * vec4(in_Position, 1);
 	ex_TexCoord = in_TexCoord;
 	ex_Color = Color;
 
-	FragPos = vec3(ModelMatrix * vec4(in_Position, 1));
-	ex_Normal = mat3(transpose(inverse(ModelMatrix))) * in_Normal;
+	FragPos = vec3(world * vec4(in_Position, 1));
+	ex_Normal = mat3(transpose(inverse(world))) * in_Normal;
 
-	FragPosLightSpace = lightSpaceMatrix * vec4(FragPos, 1.0);
+	// View depth, which picks the shadow cascade
+	zDepth = -(ViewMatrix * vec4(FragPos, 1.0)).z;
 }
\ No newline at end of file